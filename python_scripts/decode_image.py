@@ -0,0 +1,158 @@
+import sys
+import os
+import struct
+
+# The script needs Python 3 to run.
+# It decodes the frames of the image codec (see src/camera/image_codec.h) saved one after the other in a file,
+# as received from the SPI (request -'C') or Asercom2 (binary 'I' after the command 0x12) links, and writes
+# one pgm (greyscale) or ppm (RGB565 converted to 8 bits per component) file per frame in the output
+# directory (current directory by default):
+# python3 decode_image.py FRAMES.BIN [output_directory]
+
+HEADER = struct.Struct('<2sBBHHBBHI')  # magic, codec, format, width, height, near, reserved, frame, size
+MAGIC = b'EI'
+CODEC_RAW = 0
+CODEC_QOI565 = 1
+CODEC_GREY_DELTA = 2
+FORMAT_GREYSCALE = 1
+FORMAT_RGB565 = 2
+
+
+def decode_qoi565(payload, pixels):
+    out = []
+    index = [0] * 64
+    prev = 0
+    pos = 0
+    while len(out) < pixels:
+        b = payload[pos]
+        pos += 1
+        if b == 0xFE:
+            px = (payload[pos] << 8) | payload[pos + 1]
+            pos += 2
+        elif b >> 6 == 3:
+            out.extend([prev] * min((b & 0x3F) + 1, pixels - len(out)))
+            continue
+        elif b >> 6 == 0:
+            px = index[b]
+        else:
+            r, g, bl = prev >> 11, (prev >> 5) & 0x3F, prev & 0x1F
+            if b >> 6 == 1:
+                dr, dg, db = ((b >> 4) & 3) - 2, ((b >> 2) & 3) - 2, (b & 3) - 2
+            else:
+                dg = (b & 0x3F) - 32
+                b2 = payload[pos]
+                pos += 1
+                dr = (b2 >> 4) - 8 + (dg >> 1)
+                db = (b2 & 0x0F) - 8 + (dg >> 1)
+            px = (((r + dr) & 0x1F) << 11) | (((g + dg) & 0x3F) << 5) | ((bl + db) & 0x1F)
+        index[(3 * (px >> 11) + 5 * ((px >> 5) & 0x3F) + 7 * (px & 0x1F)) % 64] = px
+        out.append(px)
+        prev = px
+    return b''.join(struct.pack('>H', px) for px in out)
+
+
+def grey_residuals(payload):
+    pos = 0
+    while pos < len(payload):
+        b = payload[pos]
+        pos += 1
+        if b == 0xC0:
+            yield payload[pos] - 256 if payload[pos] >= 128 else payload[pos]
+            pos += 1
+        elif b >> 6 == 0:
+            yield (b & 0x3F) - 64 if b & 0x20 else b & 0x3F
+        elif b >> 6 == 1:
+            for _ in range((b & 0x3F) + 1):
+                yield 0
+        else:
+            yield ((b >> 3) & 7) - 4
+            yield (b & 7) - 4
+
+
+def predict(a, b, c):
+    if c >= max(a, b):
+        return min(a, b)
+    if c <= min(a, b):
+        return max(a, b)
+    return a + b - c
+
+
+def decode_grey_delta(payload, width, height, near):
+    out = bytearray(width * height)
+    step = 2 * near + 1
+    residuals = grey_residuals(payload)
+    for y in range(height):
+        for x in range(width):
+            i = y * width + x
+            if y == 0:
+                pred = 128 if x == 0 else out[i - 1]
+            elif x == 0:
+                pred = out[i - width]
+            else:
+                pred = predict(out[i - 1], out[i - width], out[i - width - 1])
+            e = next(residuals)
+            if near == 0:
+                out[i] = (pred + e) & 0xFF
+            else:
+                out[i] = min(max(pred + e * step, 0), 255)
+    return bytes(out)
+
+
+def decode_frame(header, payload):
+    magic, codec, fmt, width, height, near, reserved, frame, size = header
+    if codec == CODEC_QOI565:
+        return decode_qoi565(payload, width * height)
+    if codec == CODEC_GREY_DELTA:
+        return decode_grey_delta(payload, width, height, near)
+    return payload
+
+
+def write_image(path, pixels, fmt, width, height):
+    with open(path, 'wb') as f:
+        if fmt == FORMAT_GREYSCALE:
+            f.write(b'P5\n%d %d\n255\n' % (width, height))
+            f.write(pixels)
+        else:
+            f.write(b'P6\n%d %d\n255\n' % (width, height))
+            rgb = bytearray()
+            for i in range(0, len(pixels), 2):
+                px = (pixels[i] << 8) | pixels[i + 1]
+                rgb += bytes([(px >> 11) << 3, ((px >> 5) & 0x3F) << 2, (px & 0x1F) << 3])
+            f.write(rgb)
+
+
+def main():
+    if len(sys.argv) < 2:
+        print('Please give the file of frames to decode')
+        return
+    outdir = sys.argv[2] if len(sys.argv) > 2 else '.'
+
+    with open(sys.argv[1], 'rb') as f:
+        data = f.read()
+
+    pos = 0
+    last_frame = None
+    while pos + HEADER.size <= len(data):
+        header = HEADER.unpack_from(data, pos)
+        magic, codec, fmt, width, height, near, reserved, frame, size = header
+        if magic != MAGIC:
+            pos += 1  # Resynchronize on the next header.
+            continue
+        pos += HEADER.size
+        if pos + size > len(data):
+            print('Truncated frame at the end of the file')
+            break
+        if last_frame is not None and frame != (last_frame + 1) & 0xFFFF:
+            print('%d frames lost before frame %d' % ((frame - last_frame - 1) & 0xFFFF, frame))
+        last_frame = frame
+
+        pixels = decode_frame(header, data[pos:pos + size])
+        pos += size
+        ext = 'pgm' if fmt == FORMAT_GREYSCALE else 'ppm'
+        write_image(os.path.join(outdir, 'frame%05d.%s' % (frame, ext)), pixels, fmt, width, height)
+        print('frame %d: %dx%d, codec %d, %d bytes (%.1f%% of raw)' %
+              (frame, width, height, codec, size, 100.0 * size / (width * height * fmt)))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,102 @@
+import sys
+import os
+import struct
+
+# The script needs Python 3 to run.
+# It decodes a log written on the sd card by the sd_logger module (see src/sd_logger.h) and writes one csv
+# file per type of record in the output directory (current directory by default):
+# python3 decode_sd_log.py LOG.BIN [output_directory]
+# The first columns of each line are the time in seconds and the number of records lost just before it.
+
+RECORD_HEADER = struct.Struct('<HBBI')  # length, type, dropped, timestamp
+START = struct.Struct('<4sBBHI')        # magic, version, sources, mic_samples, tick_frequency
+MAGIC = b'EPLG'
+VERSION = 1
+
+# type: (name, payload format, csv columns)
+TYPES = {
+    1: ('proximity', struct.Struct('<8H8H'),
+        ['ambient%d' % i for i in range(8)] + ['delta%d' % i for i in range(8)]),
+    2: ('imu', struct.Struct('<3h3h3f'),
+        ['acc_x', 'acc_y', 'acc_z', 'gyro_x', 'gyro_y', 'gyro_z', 'mag_x', 'mag_y', 'mag_z']),
+    3: ('ground', struct.Struct('<5H5H'),
+        ['ambient%d' % i for i in range(5)] + ['delta%d' % i for i in range(5)]),
+    4: ('distance', struct.Struct('<HB'), ['dist_mm', 'status']),
+    6: ('motors', struct.Struct('<iihh'), ['left_pos', 'right_pos', 'left_speed', 'right_speed']),
+}
+TYPE_MIC = 5
+TYPE_START = 0
+
+
+def read_records(data):
+    pos = 0
+    while pos + RECORD_HEADER.size <= len(data):
+        length, rtype, dropped, timestamp = RECORD_HEADER.unpack_from(data, pos)
+        pos += RECORD_HEADER.size
+        if pos + length > len(data):
+            print('Truncated record at the end of the file')
+            return
+        yield rtype, dropped, timestamp, data[pos:pos + length]
+        pos += length
+
+
+def main():
+    if len(sys.argv) < 2:
+        print('Please give the log file to decode')
+        return
+    outdir = sys.argv[2] if len(sys.argv) > 2 else '.'
+
+    with open(sys.argv[1], 'rb') as f:
+        data = f.read()
+
+    records = read_records(data)
+    first = next(records, None)
+    if first is None or first[0] != TYPE_START:
+        print('Not a log file')
+        return
+    magic, version, sources, mic_samples, tick_frequency = START.unpack(first[3][:START.size])
+    if magic != MAGIC or version != VERSION:
+        print('Unsupported log format')
+        return
+
+    files = {}
+    counts = {}
+    dropped_counts = {}
+    for rtype, dropped, timestamp, payload in records:
+        counts[rtype] = counts.get(rtype, 0) + 1
+        dropped_counts[rtype] = dropped_counts.get(rtype, 0) + dropped
+        t = timestamp / tick_frequency
+
+        if rtype == TYPE_MIC:
+            name, columns = 'mic', ['mic0', 'mic1', 'mic2', 'mic3']
+            values = struct.unpack('<%dh' % mic_samples, payload)
+            # One line per sample time, the timestamp is the capture time of the last sample of
+            # the 10 ms frame, the previous samples are back-dated by the sample period.
+            lines = [values[i:i + 4] for i in range(0, len(values), 4)]
+            period = 0.010 / len(lines)
+        elif rtype in TYPES:
+            name, fmt, columns = TYPES[rtype]
+            lines = [fmt.unpack(payload)]
+        else:
+            name, columns = 'user%d' % rtype, ['payload']
+            lines = [[payload.hex()]]
+
+        if name not in files:
+            files[name] = open(os.path.join(outdir, name + '.csv'), 'w')
+            files[name].write(','.join(['time', 'dropped'] + columns) + '\n')
+        for i, line in enumerate(lines):
+            line_time = t - (len(lines) - 1 - i) * period if rtype == TYPE_MIC else t
+            files[name].write('%.5f,%d,' % (line_time, dropped if i == 0 else 0))
+            files[name].write(','.join(str(v) for v in line) + '\n')
+
+    for f in files.values():
+        f.close()
+
+    print('sources mask: %d, tick frequency: %d Hz' % (sources, tick_frequency))
+    for rtype in sorted(counts):
+        name = TYPES[rtype][0] if rtype in TYPES else ('mic' if rtype == TYPE_MIC else 'user%d' % rtype)
+        print('%-10s %8d records %8d dropped' % (name, counts[rtype], dropped_counts[rtype]))
+
+
+if __name__ == '__main__':
+    main()
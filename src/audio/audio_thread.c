@@ -1,67 +1,154 @@
 #include <ch.h>
 #include <hal.h>
 #include "audio_thread.h"
-
-#define STATE_STOPPED     0
-#define STATE_PLAYING     1
-#define SINUS_BUFFER_SIZE 360
+#include "mixer.h"
 
 #define DAC_USED          DACD2
 #define TIMER_DAC         GPTD6
 
+#define IDLE_HALVES       2 // Halves of silence played before stopping the DAC, the last samples are then played.
+#define LEGACY_RING_SIZE  2048 // Power of 2 above the samples of dac_play_buffer needed for two halves.
+
 /*
- * The DAC of the uC is configured to output a buffer given in a circular manner, 
- * in our case a sine wave to produce sound. A GPT (general purpose timer) is used to trigger
- * the DAC. Each time the DAC is triggered, it output the following value of the buffer.
- * 
- * By changing the interval of the GPT, we change the frequency of the sound.
+ * The DAC of the uC outputs in a circular manner a buffer made of two halves. A GPT (general purpose
+ * timer) triggers the DAC at AUDIO_MIXER_FREQ. Each time the DAC has finished a half, the mixer thread
+ * fills it with the next samples of all the voices (tones, melody, sound file, ...) while the other half
+ * is played.
  * 
+ * The DAC and the speaker are only powered while a voice plays, because the speaker produces noise
+ * due to noise on the alimentation.
  */
 
-/*
- * DAC test buffer (sine wave).
- * Values range from 1792 to 2304 (signal amplitude is 512, around 2048 that is the analog zero) to avoid distortion when playing from the speaker.
- * The audio will be multiplied by 5 in hardware before going to the speaker.
- */
-static const dacsample_t sinus_buffer[SINUS_BUFFER_SIZE] = {
-  2047, 2052, 2056, 2061, 2065, 2070, 2074, 2079, 2083, 2087, 2092, 2096,
-  2101, 2105, 2109, 2114, 2118, 2122, 2126, 2131, 2135, 2139, 2143, 2147,
-  2151, 2156, 2160, 2164, 2168, 2171, 2175, 2179, 2183, 2187, 2190, 2194,
-  2198, 2201, 2205, 2208, 2212, 2215, 2219, 2222, 2225, 2228, 2231, 2235,
-  2238, 2240, 2243, 2246, 2249, 2252, 2254, 2257, 2260, 2262, 2264, 2267,
-  2269, 2271, 2273, 2275, 2277, 2279, 2281, 2283, 2285, 2286, 2288, 2289,
-  2291, 2292, 2293, 2295, 2296, 2297, 2298, 2299, 2299, 2300, 2301, 2301,
-  2302, 2302, 2303, 2303, 2303, 2303, 2303, 2303, 2303, 2303, 2303, 2302,
-  2302, 2301, 2301, 2300, 2299, 2299, 2298, 2297, 2296, 2295, 2293, 2292,
-  2291, 2289, 2288, 2286, 2285, 2283, 2281, 2279, 2277, 2275, 2273, 2271,
-  2269, 2267, 2264, 2262, 2260, 2257, 2254, 2252, 2249, 2246, 2243, 2240,
-  2238, 2235, 2231, 2228, 2225, 2222, 2219, 2215, 2212, 2208, 2205, 2201,
-  2198, 2194, 2190, 2187, 2183, 2179, 2175, 2171, 2168, 2164, 2160, 2156,
-  2151, 2147, 2143, 2139, 2135, 2131, 2126, 2122, 2118, 2114, 2109, 2105,
-  2101, 2096, 2092, 2087, 2083, 2079, 2074, 2070, 2065, 2061, 2056, 2052,
-  2047, 2043, 2039, 2034, 2030, 2025, 2021, 2016, 2012, 2007, 2003, 1999,
-  1994, 1990, 1986, 1981, 1977, 1973, 1968, 1964, 1960, 1956, 1952, 1948,
-  1943, 1939, 1935, 1931, 1927, 1923, 1920, 1916, 1912, 1908, 1904, 1901,
-  1897, 1894, 1890, 1886, 1883, 1880, 1876, 1873, 1870, 1867, 1863, 1860,
-  1857, 1854, 1851, 1849, 1846, 1843, 1840, 1838, 1835, 1833, 1831, 1828,
-  1826, 1824, 1822, 1820, 1818, 1816, 1814, 1812, 1810, 1809, 1807, 1806,
-  1804, 1803, 1802, 1800, 1799, 1798, 1797, 1796, 1796, 1795, 1794, 1794,
-  1793, 1793, 1792, 1792, 1792, 1792, 1792, 1792, 1792, 1792, 1792, 1793,
-  1793, 1794, 1794, 1795, 1796, 1796, 1797, 1798, 1799, 1800, 1802, 1803,
-  1804, 1806, 1807, 1809, 1810, 1812, 1814, 1816, 1818, 1820, 1822, 1824,
-  1826, 1828, 1831, 1833, 1835, 1838, 1840, 1843, 1846, 1849, 1851, 1854,
-  1857, 1860, 1863, 1867, 1870, 1873, 1876, 1880, 1883, 1886, 1890, 1894,
-  1897, 1901, 1904, 1908, 1912, 1916, 1920, 1923, 1927, 1931, 1935, 1939,
-  1943, 1948, 1952, 1956, 1960, 1964, 1968, 1973, 1977, 1981, 1986, 1990,
-  1994, 1999, 2003, 2007, 2012, 2016, 2021, 2025, 2030, 2034, 2039, 2043
-};
+static uint16_t dac_buffer[2 * AUDIO_HALF_SAMPLES];
 
 static DACConversionGroup dac_conversion;
 
-static uint8_t dac_state = STATE_STOPPED;
+static mixer_t mixer;
+static MUTEX_DECL(mixer_lock);
+static CONDVAR_DECL(voice_stopped);
+static BSEMAPHORE_DECL(half_free, true);
+
+static bool dac_running = false;
+static volatile uint8_t half_to_fill = 0;
+static volatile bool half_pending = false;
+static uint8_t idle_halves = 0;
+static uint8_t active_voices = 0;
+static volatile uint32_t late_halves = 0;
+
+/*
+ * Buffer of dac_play_buffer. Its callback is called from the DAC interrupt as it used to be, so the
+ * samples are copied in a ring by the interrupt, before the half they are needed for is mixed, and
+ * the mixer thread interpolates them to AUDIO_MIXER_FREQ.
+ */
+static struct {
+  const uint16_t *buf;            // NULL once stopped.
+  uint32_t size;
+  uint32_t pos;                   // Next sample to copy.
+  uint32_t step;                  // Samples of the buffer per sample of the mixer, in Q16.
+  daccallback_t end_cb;
+  bool half_cb_pending;           // Middle of the buffer passed before playing, reported by the interrupt.
+  int16_t ring[LEGACY_RING_SIZE];
+  volatile uint32_t head;         // Written by the interrupt.
+  uint32_t tail;                  // Read by the mixer thread.
+  uint32_t phase;                 // Position between ring[tail] and ring[tail + 1], in Q16.
+} legacy;
 
 /***************************INTERNAL FUNCTIONS************************************/
 
+/*
+ * Samples of the legacy buffer consumed by the mixing of a half, plus the one used for the interpolation.
+ */
+static uint32_t legacy_needed(void) {
+  return ((AUDIO_HALF_SAMPLES * legacy.step + 0xFFFF) >> 16) + 1;
+}
+
+/*
+ * Copies the legacy buffer in the ring until it holds "needed" samples. The end callback is called
+ * when the copy passes the middle and the end of the buffer, it may then change or stop the buffer.
+ * Outside of the DAC interrupt, the copy stops before the end and the middle is reported later.
+ * Must be called from the DAC interrupt or with the system locked.
+ */
+static void legacy_fill(uint32_t needed, bool from_isr) {
+  if(from_isr && legacy.half_cb_pending) {
+    legacy.half_cb_pending = false;
+    if(legacy.end_cb != NULL) {
+      legacy.end_cb(&DAC_USED, legacy.buf, legacy.size / 2);
+    }
+  }
+  while(legacy.buf != NULL && legacy.head - legacy.tail < needed) {
+    const uint16_t *buf = legacy.buf;
+    uint32_t half = legacy.size / 2;
+
+    if(!from_isr && legacy.pos + 1 == legacy.size) {
+      break;
+    }
+    legacy.ring[legacy.head % LEGACY_RING_SIZE] = ((int32_t)buf[legacy.pos] - MIXER_DAC_ZERO) * 16;
+    legacy.head++;
+    legacy.pos++;
+    if(legacy.pos == half) {
+      if(!from_isr) {
+        legacy.half_cb_pending = true;
+      } else if(legacy.end_cb != NULL) {
+        legacy.end_cb(&DAC_USED, buf, half);
+      }
+    } else if(legacy.pos == legacy.size) {
+      //circular buffer unless the callback changes it
+      legacy.pos = 0;
+      if(legacy.end_cb != NULL) {
+        legacy.end_cb(&DAC_USED, &buf[half], legacy.size - half);
+      }
+    }
+  }
+}
+
+/*
+ * Source of the legacy buffer, interpolates the samples copied to AUDIO_MIXER_FREQ.
+ */
+static int32_t legacy_source(int16_t *buf, uint16_t n, void *arg) {
+  uint32_t head = legacy.head;
+  uint32_t step = legacy.step;
+  uint16_t i;
+
+  (void)arg;
+
+  for(i = 0 ; i < n && head - legacy.tail >= 2 ; i++) {
+    int32_t a = legacy.ring[legacy.tail % LEGACY_RING_SIZE];
+    int32_t b = legacy.ring[(legacy.tail + 1) % LEGACY_RING_SIZE];
+    buf[i] = a + (((b - a) * (int32_t)(legacy.phase >> 4)) >> 12);
+    legacy.phase += step;
+    legacy.tail += legacy.phase >> 16;
+    legacy.phase &= 0xFFFF;
+  }
+  if(i == 0 && legacy.buf == NULL) {
+    return MIXER_SOURCE_END;
+  }
+  return i;
+}
+
+/*
+ * DAC end callback.
+ * Called when the dac is at the middle of the buffer and at the end, the buffer given is the half
+ * that has just been played.
+ */
+static void dac_cb(DACDriver *dacp, const dacsample_t *buffer, size_t n) {
+
+  (void)dacp;
+  (void)n;
+
+  //the mixer thread didn't fill the previous half in time
+  if(half_pending) {
+    late_halves++;
+  }
+  half_to_fill = (buffer == dac_buffer) ? 0 : 1;
+  half_pending = true;
+
+  legacy_fill(legacy_needed(), true);
+
+  chSysLockFromISR();
+  chBSemSignalI(&half_free);
+  chSysUnlockFromISR();
+}
+
 /*
  * DAC error callback.
  */
@@ -73,14 +160,77 @@ static void error_cb(DACDriver *dacp, dacerror_t err) {
   chSysHalt("DAC failure");
 }
 
+/*
+ * Mixes the voices in a half of the buffer and wakes the threads waiting for the voices that ended.
+ * Must be called with mixer_lock locked.
+ */
+static void mix_half(uint8_t half) {
+  uint8_t active = mixer_mix(&mixer, &dac_buffer[half * AUDIO_HALF_SAMPLES], AUDIO_HALF_SAMPLES);
+
+  if(active_voices & ~active) {
+    chCondBroadcast(&voice_stopped);
+  }
+  active_voices = active;
+}
+
+/*
+ * Starts the DAC if a voice has been started while it was stopped.
+ * Must be called with mixer_lock locked.
+ */
+static void start_dac_if_needed(void) {
+  idle_halves = 0;
+  if(dac_running) {
+    active_voices = mixer_active_voices(&mixer);
+    return;
+  }
+  dac_running = true;
+  half_pending = false;
+  chBSemReset(&half_free, true);
+  mix_half(0);
+  mix_half(1);
+  dac_power_speaker(true); // Turn on audio.
+  dacStartConversion(&DAC_USED, &dac_conversion, dac_buffer, 2 * AUDIO_HALF_SAMPLES);
+  gptStartContinuous(&TIMER_DAC, STM32_TIMCLK1 / AUDIO_MIXER_FREQ);
+}
+
+static THD_WORKING_AREA(audio_mixer_thd_wa, 512);
+static THD_FUNCTION(audio_mixer_thd, arg) {
+
+  chRegSetThreadName(__FUNCTION__);
+
+  (void)arg;
+
+  while(1) {
+    chBSemWait(&half_free);
+
+    chMtxLock(&mixer_lock);
+    if(dac_running) {
+      mix_half(half_to_fill);
+      half_pending = false;
+      //stops the DAC once the voices are silent and their last samples played
+      if(active_voices) {
+        idle_halves = 0;
+      } else if(++idle_halves >= IDLE_HALVES) {
+        dac_power_speaker(false); // Turn off audio.
+        gptStopTimer(&TIMER_DAC);
+        dacStopConversion(&DAC_USED);
+        dac_running = false;
+      }
+    }
+    chMtxUnlock(&mixer_lock);
+  }
+}
+
 /*************************END INTERNAL FUNCTIONS**********************************/
 
 
 /****************************PUBLIC FUNCTIONS*************************************/
 
 void dac_start(void)  {
+    mixer_init(&mixer, AUDIO_MIXER_FREQ);
+
     dac_conversion.num_channels = 1U;
-    dac_conversion.end_cb = NULL;
+    dac_conversion.end_cb = dac_cb;
     dac_conversion.error_cb = error_cb;
     dac_conversion.trigger = DAC_TRG(0); // Timer 6 TRGO event.
 
@@ -100,55 +250,97 @@ void dac_start(void)  {
     gptStart(&TIMER_DAC, &config);
 
     //because when we do nothing, the speaker produces noise due to noise on the alimentation
-    dac_stop();
+    dac_power_speaker(false);
 
+    chThdCreateStatic(audio_mixer_thd_wa, sizeof(audio_mixer_thd_wa), NORMALPRIO + 2, audio_mixer_thd, NULL);
 }
 
 void dac_play(uint16_t freq) {
-	if(dac_state == STATE_STOPPED) {
-		dac_state = STATE_PLAYING;
-		dac_conversion.end_cb = NULL;
-		dac_power_speaker(true); // Turn on audio.
-		dacStartConversion(&DAC_USED, &dac_conversion, sinus_buffer, SINUS_BUFFER_SIZE);
-		gptStartContinuous(&TIMER_DAC, STM32_TIMCLK1 / (freq*SINUS_BUFFER_SIZE));
-	} else {
-		gptChangeInterval(&TIMER_DAC, STM32_TIMCLK1 / (freq*SINUS_BUFFER_SIZE));
-	}
+  audio_voice_tone(AUDIO_VOICE_TONE, freq);
+}
+
+void dac_stop(void) {
+  audio_voice_stop(AUDIO_VOICE_TONE);
 }
 
 void dac_play_buffer(uint16_t * buf, uint32_t size, uint32_t sampling_frequency, daccallback_t end_cb) {
-  if(dac_state == STATE_STOPPED) {
-    dac_state = STATE_PLAYING;
-    dac_conversion.end_cb = end_cb;
-    dac_power_speaker(true); // Turn on audio.
-    dacStartConversion(&DAC_USED, &dac_conversion, buf, size);
-    gptStartContinuous(&TIMER_DAC, STM32_TIMCLK1 / sampling_frequency);
-  } else {
-    gptChangeInterval(&TIMER_DAC, STM32_TIMCLK1 / sampling_frequency);
+  chMtxLock(&mixer_lock);
+  chSysLock();
+  legacy.end_cb = end_cb;
+  legacy.half_cb_pending = false;
+  legacy.head = 0;
+  legacy.tail = 0;
+  legacy.phase = 0;
+  dac_change_bufferI(buf, size, sampling_frequency);
+  //the two halves are mixed at once if the DAC is stopped
+  legacy_fill(2 * legacy_needed(), false);
+  chSysUnlock();
+  mixer_set_stream(&mixer, AUDIO_VOICE_SOUND_FILE, legacy_source, NULL);
+  start_dac_if_needed();
+  chMtxUnlock(&mixer_lock);
+}
+
+void dac_change_bufferI(uint16_t* buf, uint32_t size, uint32_t sampling_frequency) {
+  if(sampling_frequency > AUDIO_MIXER_FREQ) {
+    sampling_frequency = AUDIO_MIXER_FREQ;
+  }
+  legacy.buf = size ? buf : NULL;
+  legacy.size = size;
+  legacy.pos = 0;
+  legacy.half_cb_pending = false;
+  legacy.step = (sampling_frequency << 16) / AUDIO_MIXER_FREQ;
+}
+
+void dac_stopI(void) {
+  //the voice ends once the samples already copied are played
+  legacy.buf = NULL;
+  legacy.half_cb_pending = false;
+}
+
+void audio_voice_tone(audio_voice_t voice, uint16_t freq) {
+  chMtxLock(&mixer_lock);
+  mixer_set_tone(&mixer, voice, freq);
+  if(freq) {
+    start_dac_if_needed();
   }
+  chMtxUnlock(&mixer_lock);
 }
 
-void dac_change_bufferI(uint16_t* buf, uint32_t size, uint32_t sampling_frequency){
-  gptStopTimerI(&TIMER_DAC);
-  dacStopConversionI(&DAC_USED);
+void audio_voice_stream(audio_voice_t voice, mixer_source_t source, void *arg) {
+  chMtxLock(&mixer_lock);
+  mixer_set_stream(&mixer, voice, source, arg);
+  start_dac_if_needed();
+  chMtxUnlock(&mixer_lock);
+}
 
-  dacStartConversionI(&DAC_USED, &dac_conversion, buf, size);
-  gptStartContinuousI(&TIMER_DAC, STM32_TIMCLK1 / sampling_frequency);
+void audio_voice_stop(audio_voice_t voice) {
+  chMtxLock(&mixer_lock);
+  mixer_stop(&mixer, voice);
+  chMtxUnlock(&mixer_lock);
+}
 
+void audio_voice_set_gain(audio_voice_t voice, uint16_t gain) {
+  chMtxLock(&mixer_lock);
+  mixer_set_gain(&mixer, voice, gain);
+  chMtxUnlock(&mixer_lock);
 }
 
-void dac_stopI(void) {
-  dac_power_speaker(false); // Turn off audio.
-  gptStopTimerI(&TIMER_DAC);
-  dacStopConversionI(&DAC_USED);
-  dac_state = STATE_STOPPED;
+void audio_voice_wait(audio_voice_t voice) {
+  chMtxLock(&mixer_lock);
+  //the voice is stopped by the mixer thread once its source has ended
+  while(mixer_active_voices(&mixer) & (1 << voice)) {
+    chCondWait(&voice_stopped);
+  }
+  chMtxUnlock(&mixer_lock);
 }
 
-void dac_stop(void) {
-	dac_power_speaker(false); // Turn off audio.
-  gptStopTimer(&TIMER_DAC);
-  dacStopConversion(&DAC_USED);
-	dac_state = STATE_STOPPED;
+void audio_get_stats(audio_stats_t *stats) {
+  chMtxLock(&mixer_lock);
+  stats->late_halves = late_halves;
+  for(uint8_t i = 0 ; i < AUDIO_VOICES ; i++) {
+    stats->underruns[i] = mixer.voices[i].underruns;
+  }
+  chMtxUnlock(&mixer_lock);
 }
 
 void dac_power_speaker(bool on_off){
@@ -6,48 +6,117 @@ extern "C" {
 #endif
 
 #include <hal.h>
+#include "mixer.h"
+
+#define AUDIO_MIXER_FREQ    32000 // Rate of the DAC.
+#define AUDIO_HALF_SAMPLES  512   // Samples mixed at once (16 ms), the DAC plays a half while the other is mixed.
+
+/* Voices of the mixer, they are summed so they can be played at the same time. */
+typedef enum {
+	AUDIO_VOICE_TONE = 0,	// Tone of dac_play.
+	AUDIO_VOICE_MELODY,		// Notes of play_melody.
+	AUDIO_VOICE_SOUND_FILE,	// Stream of play_sound_file or of dac_play_buffer.
+	AUDIO_VOICE_USER,		// Free for the application, for example feedback beeps over the other voices.
+	AUDIO_VOICES,
+} audio_voice_t;
+
+typedef struct {
+	uint32_t late_halves;				// Halves played again because the mixer thread was late.
+	uint32_t underruns[AUDIO_VOICES];	// Halves a stream voice could not fill completely.
+} audio_stats_t;
 
  /**
- * @brief   Starts the DAC module. Power of the audio amplifier and DAC peripheral
+ * @brief   Starts the DAC module and the mixer thread. The DAC and the speaker are powered only
+ * 			while a voice plays.
  */
 void dac_start(void);
 
  /**
- * @brief   Plays the specified frequence on the speaker
+ * @brief   Plays the specified frequence on the speaker (AUDIO_VOICE_TONE)
  */
 void dac_play(uint16_t freq);
 
 /**
- * @brief Plays the buffer to play with the DAC module. Needs to already have started it using dac_start()
+ * @brief   Stops the tone played by dac_play(). The other voices continue.
+ */
+void dac_stop(void);
+
+/**
+ * @brief   Plays a buffer of DAC values (12 bits, 2048 being the silence) in a circular manner on
+ * 			AUDIO_VOICE_SOUND_FILE, as the DAC did before the mixer.
+ * 			end_cb is called from the DAC interrupt with the half of the buffer that has been used, once
+ * 			at the middle and once at the end of the buffer. The samples are then copied so the half can
+ * 			be refilled, or the buffer changed with dac_change_bufferI() or stopped with dac_stopI().
+ * 			Replaces the buffer if one is already played.
+ * 
+ * @deprecated Kept for the existing code, use audio_voice_stream() instead.
  * 
- * @param buf 	buffer to send with the DAC
- * @param size 	size of the buffer in elements
- * @param sampling_frequency frequency at which read the samples contained in the buffer
+ * @param buf 					buffer to play
+ * @param size 					number of samples in the buffer
+ * @param sampling_frequency 	rate of the samples in Hz, up to AUDIO_MIXER_FREQ
+ * @param end_cb 				callback called at the middle and at the end of the buffer, can be NULL
  */
 void dac_play_buffer(uint16_t * buf, uint32_t size, uint32_t sampling_frequency, daccallback_t end_cb);
 
 /**
- * @brief 	Changes the buffer to play with the DAC module. The DAC should already be playing something
- * 			using dac_play() or dac_play_buffer() before calling this function
- * 			
- * 			Called from an interrupt context 
+ * @brief   Continues with another buffer once the current one has been used. I-class function,
+ * 			usually called from the end_cb given to dac_play_buffer().
  * 
- * @param buf 					buffer to send with the DAC
- * @param size 					size of the buffer in elements
- * @param sampling_frequency 	frequency at which read the samples contained in the buffer
+ * @deprecated Kept for the existing code, use audio_voice_stream() instead.
+ * 
+ * @param buf 					buffer to play
+ * @param size 					number of samples in the buffer
+ * @param sampling_frequency 	rate of the samples in Hz, up to AUDIO_MIXER_FREQ
  */
 void dac_change_bufferI(uint16_t* buf, uint32_t size, uint32_t sampling_frequency);
 
 /**
- * @brief   Stops the sound being played on the speaker (if any).
- * 			Called from an interrupt context
+ * @brief   Stops the buffer of dac_play_buffer() once the samples already used have been played.
+ * 			I-class function, usually called from the end_cb given to dac_play_buffer().
+ * 
+ * @deprecated Kept for the existing code, use audio_voice_stream() instead.
  */
 void dac_stopI(void);
 
 /**
- * @brief   Stops the sound being played on the speaker (if any)
+ * @brief   Plays a sine tone on a voice, or changes its frequency if it already plays one.
+ * 
+ * @param voice 	voice to use
+ * @param freq 		frequency in Hz, below AUDIO_MIXER_FREQ / 2. 0 stops the voice.
  */
-void dac_stop(void);
+void audio_voice_tone(audio_voice_t voice, uint16_t freq);
+
+/**
+ * @brief   Plays a stream on a voice. The source is called by the mixer thread, at AUDIO_MIXER_FREQ
+ * 			by blocks of AUDIO_HALF_SAMPLES, until it returns MIXER_SOURCE_END. It must not block.
+ * 
+ * @param voice 	voice to use
+ * @param source 	function giving the samples (signed 16 bits, mono, at AUDIO_MIXER_FREQ)
+ * @param arg 		argument given to the source
+ */
+void audio_voice_stream(audio_voice_t voice, mixer_source_t source, void *arg);
+
+/**
+ * @brief   Stops a voice.
+ */
+void audio_voice_stop(audio_voice_t voice);
+
+/**
+ * @brief   Sets the gain of a voice. MIXER_GAIN_UNITY (256) by default. At this gain a full scale
+ * 			stream uses the full range of the DAC.
+ */
+void audio_voice_set_gain(audio_voice_t voice, uint16_t gain);
+
+/**
+ * @brief   Waits until a voice is stopped. Immediatly returns if it is not playing.
+ */
+void audio_voice_wait(audio_voice_t voice);
+
+/**
+ * @brief   Copies the counters of the late halves and of the underruns of each voice.
+ */
+void audio_get_stats(audio_stats_t *stats);
+
 /**
  * @brief Powers ON or OFF the alimentation of the speaker
  * 
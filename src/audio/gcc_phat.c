@@ -0,0 +1,110 @@
+#include <string.h>
+#include <math.h>
+#include "gcc_phat.h"
+
+// Bins of both signals weaker than this (amplitude relative to a full scale sine) only carry noise
+// and are not whitened.
+#define PHAT_EPSILON	1e-3f
+
+ /**
+ * @brief   Copies one signal in the FFT input buffer, removes its mean and pads it with zeros.
+ */
+static void load_signal(float32_t *dst, const int16_t *src, uint16_t len, uint8_t stride, uint16_t size) {
+	int32_t sum = 0;
+
+	for(uint16_t i=0; i<len; i++) {
+		sum += src[i*stride];
+	}
+	float32_t mean = (float32_t)sum / len;
+	for(uint16_t i=0; i<len; i++) {
+		dst[i] = src[i*stride] - mean;
+	}
+	memset(&dst[len], 0, (size - len) * sizeof(float32_t));
+}
+
+int8_t gcc_phat_init(gcc_phat_t *gcc, uint16_t fft_size, float32_t *work) {
+	if(arm_rfft_fast_init_f32(&gcc->rfft, fft_size) != ARM_MATH_SUCCESS) {
+		return -1;
+	}
+	gcc->size = fft_size;
+	gcc->work = work;
+	return 0;
+}
+
+float gcc_phat_delay(gcc_phat_t *gcc, const int16_t *a, const int16_t *b, uint16_t len, uint8_t stride,
+						uint16_t max_lag, float *peak) {
+	const uint16_t size = gcc->size;
+	float32_t *spectrum_a = &gcc->work[0];
+	float32_t *spectrum_b = &gcc->work[size];
+	float32_t *buffer = &gcc->work[2*size];
+	// The inverse transform divides by size/2 and only size/2 - 1 bins have a unit magnitude.
+	const float32_t scale = (float32_t)(size/2) / (size/2 - 1);
+
+	if(len + max_lag > size) {
+		len = size - max_lag;
+	}
+
+	// The real FFT destroys its input, the input buffer is the third part of the working buffer.
+	load_signal(buffer, a, len, stride, size);
+	arm_rfft_fast_f32(&gcc->rfft, buffer, spectrum_a, 0);
+	load_signal(buffer, b, len, stride, size);
+	arm_rfft_fast_f32(&gcc->rfft, buffer, spectrum_b, 0);
+
+	// Cross spectrum A.conj(B) normalized to unit magnitude. The DC and Nyquist bins (packed in
+	// the first complex value) carry no delay information and are dropped.
+	buffer[0] = 0;
+	buffer[1] = 0;
+	// A full scale sine gives a bin of len * INT16_MAX / 2, the threshold is compared to the product of two bins.
+	const float32_t bin_epsilon = PHAT_EPSILON * len * INT16_MAX / 2;
+	const float32_t epsilon = bin_epsilon * bin_epsilon;
+	for(uint16_t k=2; k<size; k+=2) {
+		float32_t re = spectrum_a[k] * spectrum_b[k] + spectrum_a[k+1] * spectrum_b[k+1];
+		float32_t im = spectrum_a[k+1] * spectrum_b[k] - spectrum_a[k] * spectrum_b[k+1];
+		float32_t mag;
+		arm_sqrt_f32(re*re + im*im, &mag);
+		if(mag < epsilon) {
+			re = 0;
+			im = 0;
+		} else {
+			re /= mag;
+			im /= mag;
+		}
+		buffer[k] = re;
+		buffer[k+1] = im;
+	}
+
+	// Inverse transform, spectrum_a is reused for the correlation: r[k] = sum(a[n+k].b[n]).
+	float32_t *corr = spectrum_a;
+	arm_rfft_fast_f32(&gcc->rfft, buffer, corr, 1);
+
+	// Search the peak, negative lags are at the end of the buffer.
+	int16_t best_lag = 0;
+	float32_t best = corr[0];
+	for(int16_t lag=1; lag<=max_lag; lag++) {
+		if(corr[lag] > best) {
+			best = corr[lag];
+			best_lag = lag;
+		}
+		if(corr[size-lag] > best) {
+			best = corr[size-lag];
+			best_lag = -lag;
+		}
+	}
+
+	// Parabolic interpolation around the peak.
+	float32_t before = corr[(best_lag - 1 + size) % size];
+	float32_t after = corr[(best_lag + 1 + size) % size];
+	float32_t denominator = before - 2*best + after;
+	float delay = best_lag;
+	if(denominator < 0) {
+		float offset = 0.5f * (before - after) / denominator;
+		if(offset > -1 && offset < 1) {
+			delay += offset;
+		}
+	}
+
+	if(peak != NULL) {
+		*peak = best * scale;
+	}
+	return delay;
+}
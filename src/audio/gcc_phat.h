@@ -0,0 +1,60 @@
+#ifndef GCC_PHAT_H
+#define GCC_PHAT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <arm_math.h>
+
+/**
+ * Time difference of arrival between two microphones with the generalized cross correlation
+ * weighted by the phase transform (GCC-PHAT), using the CMSIS-DSP real FFT.
+ *
+ * The FFT size must be at least the number of samples per microphone plus the maximum lag,
+ * the zero padding then ensures that the circular correlation equals the linear one for all the
+ * lags searched.
+ */
+
+typedef struct {
+	arm_rfft_fast_instance_f32 rfft;
+	uint16_t size;			// FFT size.
+	float32_t *work;		// 3 x size floats given by the user.
+} gcc_phat_t;
+
+/**
+ * @brief   Initializes the estimator.
+ *
+ * @param gcc		estimator to initialize
+ * @param fft_size	32, 64, 128, 256, 512, 1024, 2048 or 4096
+ * @param work		working buffer of 3 x fft_size floats, owned by the estimator
+ *
+ * @return			0 on success, -1 if the size is not supported
+ */
+int8_t gcc_phat_init(gcc_phat_t *gcc, uint16_t fft_size, float32_t *work);
+
+/**
+ * @brief   Computes the delay of the signal a with respect to the signal b.
+ *
+ * @param gcc			estimator
+ * @param a				first signal
+ * @param b				second signal
+ * @param len			number of samples of each signal (at most fft_size - max_lag)
+ * @param stride		distance in samples between two consecutive samples of a signal, this lets
+ * 						the signals be read directly from an interleaved multi-microphones buffer
+ * @param max_lag		the delay is searched between -max_lag and max_lag samples
+ * @param peak			returns the height of the correlation peak, about 1 for a single source
+ * 						without noise, close to 0 for uncorrelated signals and 0 when no frequency is above
+ * 						the noise threshold in both signals. Can be NULL.
+ *
+ * @return				delay in samples, with sub-sample resolution (positive when a lags b)
+ */
+float gcc_phat_delay(gcc_phat_t *gcc, const int16_t *a, const int16_t *b, uint16_t len, uint8_t stride,
+						uint16_t max_lag, float *peak);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GCC_PHAT_H */
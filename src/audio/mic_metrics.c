@@ -0,0 +1,109 @@
+#include <string.h>
+#include <math.h>
+#include "mic_metrics.h"
+
+#if defined(__ARM_FEATURE_DSP)
+// Packed maximum and minimum of two 16 bits values: SEL picks each half depending on the GE flags set by SSUB16,
+// both instructions are kept in the same asm statement so that nothing can modify the flags in between.
+static inline uint32_t max16x2(uint32_t x, uint32_t y) {
+	uint32_t result;
+	__asm__ ("ssub16 %0, %1, %2\n\tsel %0, %1, %2" : "=&r" (result) : "r" (x), "r" (y));
+	return result;
+}
+
+static inline uint32_t min16x2(uint32_t x, uint32_t y) {
+	uint32_t result;
+	__asm__ ("ssub16 %0, %1, %2\n\tsel %0, %2, %1" : "=&r" (result) : "r" (x), "r" (y));
+	return result;
+}
+
+// 64 bits accumulation of the square of the bottom (resp. top) half.
+static inline int64_t smlalbb(int64_t acc, uint32_t x) {
+	__asm__ ("smlalbb %Q0, %R0, %1, %1" : "+r" (acc) : "r" (x));
+	return acc;
+}
+
+static inline int64_t smlaltt(int64_t acc, uint32_t x) {
+	__asm__ ("smlaltt %Q0, %R0, %1, %1" : "+r" (acc) : "r" (x));
+	return acc;
+}
+#endif
+
+void mic_metrics_compute(const int16_t *data, uint16_t num_samples, mic_metrics_t *metrics) {
+	int16_t max[MIC_METRICS_CHANNELS], min[MIC_METRICS_CHANNELS];
+	int32_t sum[MIC_METRICS_CHANNELS] = {0};
+	int64_t sum_sq[MIC_METRICS_CHANNELS] = {0};
+	uint16_t zero_crossings[MIC_METRICS_CHANNELS] = {0};
+	uint16_t frames = num_samples / MIC_METRICS_CHANNELS;
+
+	if(frames == 0) {
+		memset(metrics, 0, MIC_METRICS_CHANNELS * sizeof(mic_metrics_t));
+		return;
+	}
+
+#if defined(__ARM_FEATURE_DSP)
+	// Microphones 0 and 1 are in the first word, 2 and 3 in the second one.
+	uint32_t words[2], max_w[2], min_w[2], prev_w[2];
+
+	memcpy(prev_w, data, sizeof(prev_w));
+	memcpy(max_w, data, sizeof(max_w));
+	memcpy(min_w, data, sizeof(min_w));
+	for(uint16_t i=0; i<num_samples; i+=MIC_METRICS_CHANNELS) {
+		memcpy(words, &data[i], sizeof(words));
+		for(uint8_t w=0; w<2; w++) {
+			uint32_t x = words[w];
+			max_w[w] = max16x2(x, max_w[w]);
+			min_w[w] = min16x2(x, min_w[w]);
+			sum[2*w] += (int16_t)x;
+			sum[2*w+1] += (int16_t)(x >> 16);
+			sum_sq[2*w] = smlalbb(sum_sq[2*w], x);
+			sum_sq[2*w+1] = smlaltt(sum_sq[2*w+1], x);
+			// The sign bit of each half tells whether the sign changed.
+			uint32_t changed = x ^ prev_w[w];
+			zero_crossings[2*w] += (changed >> 15) & 1;
+			zero_crossings[2*w+1] += changed >> 31;
+			prev_w[w] = x;
+		}
+	}
+	for(uint8_t w=0; w<2; w++) {
+		max[2*w] = (int16_t)max_w[w];
+		max[2*w+1] = (int16_t)(max_w[w] >> 16);
+		min[2*w] = (int16_t)min_w[w];
+		min[2*w+1] = (int16_t)(min_w[w] >> 16);
+	}
+#else
+	for(uint8_t ch=0; ch<MIC_METRICS_CHANNELS; ch++) {
+		int16_t prev = data[ch];
+		max[ch] = data[ch];
+		min[ch] = data[ch];
+		for(uint16_t i=ch; i<num_samples; i+=MIC_METRICS_CHANNELS) {
+			int16_t x = data[i];
+			if(x > max[ch]) {
+				max[ch] = x;
+			}
+			if(x < min[ch]) {
+				min[ch] = x;
+			}
+			sum[ch] += x;
+			sum_sq[ch] += (int32_t)x * x;
+			if((x ^ prev) < 0) {
+				zero_crossings[ch]++;
+			}
+			prev = x;
+		}
+	}
+#endif
+
+	for(uint8_t ch=0; ch<MIC_METRICS_CHANNELS; ch++) {
+		int32_t mean = sum[ch] / frames;
+		// Variance = E[x^2] - E[x]^2.
+		int64_t variance = sum_sq[ch] / frames - (int64_t)mean * mean;
+		int32_t peak = max[ch] > -min[ch] ? max[ch] : -min[ch];
+
+		metrics[ch].peak_to_peak = max[ch] - min[ch];
+		metrics[ch].peak = peak > UINT16_MAX ? UINT16_MAX : peak;
+		metrics[ch].rms = variance > 0 ? (uint16_t)sqrtf((float)variance) : 0;
+		metrics[ch].zero_crossings = zero_crossings[ch];
+		metrics[ch].dc_offset = mean;
+	}
+}
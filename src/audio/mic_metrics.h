@@ -0,0 +1,39 @@
+#ifndef MIC_METRICS_H
+#define MIC_METRICS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/**
+ * Per microphone metrics computed on a frame of interleaved samples (mic0, mic1, mic2, mic3, mic0, ...).
+ * The Cortex-M4 packed 16 bits instructions are used when available: two microphones are handled
+ * by each instruction.
+ */
+
+#define MIC_METRICS_CHANNELS 4
+
+typedef struct {
+	uint16_t peak_to_peak;	// Maximum - minimum.
+	uint16_t peak;			// Maximum absolute value.
+	uint16_t rms;			// Root mean square of the signal without the DC offset.
+	uint16_t zero_crossings;// Number of sign changes in the frame.
+	int16_t dc_offset;		// Mean value.
+} mic_metrics_t;
+
+/**
+ * @brief   Computes the metrics of each microphone.
+ *
+ * @param data			interleaved samples of the MIC_METRICS_CHANNELS microphones
+ * @param num_samples	total number of samples in the buffer (multiple of MIC_METRICS_CHANNELS)
+ * @param metrics		array of MIC_METRICS_CHANNELS results
+ */
+void mic_metrics_compute(const int16_t *data, uint16_t num_samples, mic_metrics_t *metrics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MIC_METRICS_H */
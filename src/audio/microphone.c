@@ -3,9 +3,11 @@
 #include <hal.h>
 #include "microphone.h"
 #include "mp45dt02_processing.h"
+#include "mic_metrics.h"
 
 
 static uint16_t mic_volume[4];
+static mic_metrics_t mic_metrics[4];
 static int16_t mic_last[4];
 static bool mic_buffer_ready = false;
 
@@ -27,50 +29,54 @@ uint16_t mic_get_volume(uint8_t mic) {
 	}
 }
 
-// This function is called every 10 ms of recorded audio data.
-// For each microphone there are 160 samples, that is 640 samples in total for the 4 microphones.
-// The function compute the volume for each microphone.
-static void handlePCMdata(int16_t *data, uint16_t num_samples) {
-	int16_t max_value[4]={INT16_MIN}, min_value[4]={INT16_MAX};
+// Return the RMS value (without DC offset) computed for the given microphone.
+uint16_t mic_get_rms(uint8_t mic) {
+	if(mic < 4) {
+		return mic_metrics[mic].rms;
+	} else {
+		return 0;
+	}
+}
 
-	mic_buffer_ready = true;
+// Return the highest absolute sample value of the given microphone.
+uint16_t mic_get_peak(uint8_t mic) {
+	if(mic < 4) {
+		return mic_metrics[mic].peak;
+	} else {
+		return 0;
+	}
+}
 
-	for(uint16_t i=0; i<num_samples; i+=4) {
+// Return the number of zero crossings of the given microphone.
+uint16_t mic_get_zero_crossings(uint8_t mic) {
+	if(mic < 4) {
+		return mic_metrics[mic].zero_crossings;
+	} else {
+		return 0;
+	}
+}
 
-		if(data[i + MIC_LEFT] > max_value[MIC_LEFT]) {
-			max_value[MIC_LEFT] = data[i + MIC_LEFT];
-		}
-		if(data[i + MIC_LEFT] < min_value[MIC_LEFT]) {
-			min_value[MIC_LEFT] = data[i + MIC_LEFT];
-		}
+// Return the DC offset (mean value) of the given microphone.
+int16_t mic_get_dc_offset(uint8_t mic) {
+	if(mic < 4) {
+		return mic_metrics[mic].dc_offset;
+	} else {
+		return 0;
+	}
+}
 
-		if(data[i + MIC_RIGHT] > max_value[MIC_RIGHT]) {
-			max_value[MIC_RIGHT] = data[i + MIC_RIGHT];
-		}
-		if(data[i + MIC_RIGHT] < min_value[MIC_RIGHT]) {
-			min_value[MIC_RIGHT] = data[i + MIC_RIGHT];
-		}
+// This function is called every 10 ms of recorded audio data.
+// For each microphone there are 160 samples at 16 KHz, that is 640 samples in total for the 4 microphones.
+// The function compute the volume, RMS, zero crossings and DC offset for each microphone.
+static void handlePCMdata(int16_t *data, uint16_t num_samples) {
 
-		if(data[i + MIC_FRONT] > max_value[MIC_FRONT]) {
-			max_value[MIC_FRONT] = data[i + MIC_FRONT];
-		}
-		if(data[i + MIC_FRONT] < min_value[MIC_FRONT]) {
-			min_value[MIC_FRONT] = data[i + MIC_FRONT];
-		}
-		
-		if(data[i + MIC_BACK] > max_value[MIC_BACK]) {
-			max_value[MIC_BACK] = data[i + MIC_BACK];
-		}
-		if(data[i + MIC_BACK] < min_value[MIC_BACK]) {
-			min_value[MIC_BACK] = data[i + MIC_BACK];
-		}
-		
+	mic_buffer_ready = true;
+
+	mic_metrics_compute(data, num_samples, mic_metrics);
+	for(uint8_t i=0; i<4; i++) {
+		mic_volume[i] = mic_metrics[i].peak_to_peak;
 	}
 
-	mic_volume[MIC_RIGHT] = max_value[MIC_RIGHT] - min_value[MIC_RIGHT];
-	mic_volume[MIC_LEFT] = max_value[MIC_LEFT] - min_value[MIC_LEFT];
-	mic_volume[MIC_BACK] = max_value[MIC_BACK] - min_value[MIC_BACK];
-	mic_volume[MIC_FRONT] = max_value[MIC_FRONT] - min_value[MIC_FRONT];
 	mic_last[MIC_RIGHT] = data[MIC_BUFFER_LEN-(4-MIC_RIGHT)];
 	mic_last[MIC_LEFT] = data[MIC_BUFFER_LEN-(4-MIC_LEFT)];
 	mic_last[MIC_BACK] = data[MIC_BUFFER_LEN-(4-MIC_BACK)];
@@ -158,3 +164,53 @@ void mic_buffer_ready_reset(void) {
 uint16_t mic_buffer_get_size(void) {
 	return MIC_BUFFER_LEN*2;
 }
+
+void mic_reader_init(mic_reader_t *reader) {
+	reader->next = mp45dt02FrameCount();
+	reader->overruns = 0;
+	chEvtRegisterMask(&mp45dt02FrameEvent, &reader->listener, MIC_READER_EVENT);
+}
+
+void mic_reader_stop(mic_reader_t *reader) {
+	chEvtUnregister(&mp45dt02FrameEvent, &reader->listener);
+}
+
+int16_t* mic_reader_get(mic_reader_t *reader) {
+	uint32_t available = mp45dt02FrameCount() - reader->next;
+
+	if(available == 0) {
+		return NULL;
+	}
+	// The slot of the oldest frames could be already reused, jump to the oldest readable one.
+	if(available > MP45DT02_RING_SLOTS-1) {
+		reader->overruns += available - (MP45DT02_RING_SLOTS-1);
+		reader->next += available - (MP45DT02_RING_SLOTS-1);
+	}
+	return mp45dt02FramePtr(reader->next);
+}
+
+int16_t* mic_reader_wait(mic_reader_t *reader, systime_t timeout) {
+	int16_t *frame;
+
+	while((frame = mic_reader_get(reader)) == NULL) {
+		if(chEvtWaitAnyTimeout(MIC_READER_EVENT, timeout) == 0) {
+			return NULL;
+		}
+	}
+	return frame;
+}
+
+systime_t mic_reader_time(const mic_reader_t *reader) {
+	return mp45dt02FrameTime(reader->next);
+}
+
+bool mic_reader_release(mic_reader_t *reader) {
+	// The slot is reused as soon as the producer starts filling the frame next + MP45DT02_RING_SLOTS.
+	bool valid = (mp45dt02FrameCount() - reader->next) < MP45DT02_RING_SLOTS;
+
+	if(!valid) {
+		reader->overruns++;
+	}
+	reader->next++;
+	return valid;
+}
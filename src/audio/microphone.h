@@ -38,12 +38,93 @@ extern "C" {
  */
 void mic_start(mp45dt02FullBufferCb customFullbufferCb);
 uint16_t mic_get_volume(uint8_t mic);
+
+/**
+ * @brief 	The following metrics are computed on the last 10 ms of data, together with the volume
+ * 			(peak to peak), only when no custom callback is given to mic_start.
+ *
+ * @param mic	MIC_LEFT, MIC_RIGHT, MIC_FRONT or MIC_BACK
+ */
+uint16_t mic_get_rms(uint8_t mic);
+uint16_t mic_get_peak(uint8_t mic);
+uint16_t mic_get_zero_crossings(uint8_t mic);
+int16_t mic_get_dc_offset(uint8_t mic);
 int16_t mic_get_last(uint8_t mic);
 int16_t* mic_get_buffer_ptr(void);
 bool mic_buffer_is_ready(void);
 void mic_buffer_ready_reset(void);
 uint16_t mic_buffer_get_size(void);
 
+/**
+ * Reader of the microphones frames ring. Any number of readers can follow the 10 ms frames
+ * independently of the callback given to mic_start, the samples are never copied.
+ * A reader must be initialized and used by the same thread.
+ */
+#define MIC_READER_EVENT EVENT_MASK(8) // Event used to wake up the thread waiting in mic_reader_wait.
+
+typedef struct {
+	uint32_t next;			// Number of the next frame to read.
+	uint32_t overruns;		// Number of frames lost because the reader was too slow.
+	event_listener_t listener;
+} mic_reader_t;
+
+/**
+ * @brief 	Registers a reader, the first frame returned will be the next completed one.
+ *
+ * @param reader	reader to initialize
+ */
+void mic_reader_init(mic_reader_t *reader);
+
+/**
+ * @brief 	Unregisters a reader.
+ *
+ * @param reader	reader to stop
+ */
+void mic_reader_stop(mic_reader_t *reader);
+
+/**
+ * @brief 	Returns the oldest frame not yet read, frames already overwritten are skipped and
+ * 			counted in the overruns counter.
+ * 			The frame must be given back with mic_reader_release once processed.
+ *
+ * @param reader	reader
+ *
+ * @return			pointer to MIC_BUFFER_LEN samples (mic0, mic1, mic2, mic3, mic0, ...) or
+ * 					NULL if no new frame is available
+ */
+int16_t* mic_reader_get(mic_reader_t *reader);
+
+/**
+ * @brief 	Same as mic_reader_get but waits for a frame if none is available.
+ *
+ * @param reader	reader
+ * @param timeout	maximum time to wait (TIME_INFINITE to wait forever)
+ *
+ * @return			pointer to the frame or NULL in case of timeout
+ */
+int16_t* mic_reader_wait(mic_reader_t *reader, systime_t timeout);
+
+/**
+ * @brief 	Returns the capture time of the frame returned by mic_reader_get or mic_reader_wait,
+ * 			that is the system time at which its last sample was converted. Only valid if the frame
+ * 			is then released without overrun.
+ *
+ * @param reader	reader
+ *
+ * @return			capture time of the frame
+ */
+systime_t mic_reader_time(const mic_reader_t *reader);
+
+/**
+ * @brief 	Releases the frame returned by mic_reader_get or mic_reader_wait.
+ *
+ * @param reader	reader
+ *
+ * @return			true if the frame was not overwritten while it was processed,
+ * 					false otherwise (the frame is counted as an overrun)
+ */
+bool mic_reader_release(mic_reader_t *reader);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,112 @@
+#include <math.h>
+#include <string.h>
+#include "mixer.h"
+
+#define SINE_SIZE	(1 << MIXER_SINE_BITS)
+#define DAC_SHIFT	(MIXER_GAIN_SHIFT + 4) // 16 bits samples to the 12 bits of the DAC.
+
+static int16_t sine_table[SINE_SIZE];
+static uint8_t sine_table_ready = 0;
+
+static void sine_table_init(void) {
+	for(uint16_t i=0; i<SINE_SIZE; i++) {
+		sine_table[i] = lroundf(MIXER_TONE_AMPLITUDE * sinf(2*M_PI*i/SINE_SIZE));
+	}
+	sine_table_ready = 1;
+}
+
+void mixer_init(mixer_t *mixer, uint32_t freq) {
+	if(!sine_table_ready) {
+		sine_table_init();
+	}
+	memset(mixer, 0, sizeof(mixer_t));
+	mixer->freq = freq;
+	for(uint8_t i=0; i<MIXER_VOICES; i++) {
+		mixer->voices[i].gain = MIXER_GAIN_UNITY;
+	}
+}
+
+void mixer_set_tone(mixer_t *mixer, uint8_t voice, uint16_t freq) {
+	mixer_voice_t *v = &mixer->voices[voice];
+
+	if(freq == 0) {
+		v->type = MIXER_VOICE_OFF;
+		return;
+	}
+	if(v->type != MIXER_VOICE_TONE) {
+		v->phase = 0;
+	}
+	v->phase_step = ((uint64_t)freq << 32) / mixer->freq;
+	v->type = MIXER_VOICE_TONE;
+}
+
+void mixer_set_stream(mixer_t *mixer, uint8_t voice, mixer_source_t source, void *arg) {
+	mixer_voice_t *v = &mixer->voices[voice];
+
+	v->source = source;
+	v->arg = arg;
+	v->type = MIXER_VOICE_STREAM;
+}
+
+void mixer_stop(mixer_t *mixer, uint8_t voice) {
+	mixer->voices[voice].type = MIXER_VOICE_OFF;
+}
+
+void mixer_set_gain(mixer_t *mixer, uint8_t voice, uint16_t gain) {
+	mixer->voices[voice].gain = gain;
+}
+
+uint8_t mixer_active_voices(const mixer_t *mixer) {
+	uint8_t mask = 0;
+
+	for(uint8_t i=0; i<MIXER_VOICES; i++) {
+		if(mixer->voices[i].type != MIXER_VOICE_OFF) {
+			mask |= (1 << i);
+		}
+	}
+	return mask;
+}
+
+uint8_t mixer_mix(mixer_t *mixer, uint16_t *out, uint16_t n) {
+	int32_t *acc = mixer->acc;
+
+	memset(acc, 0, n * sizeof(int32_t));
+
+	for(uint8_t i=0; i<MIXER_VOICES; i++) {
+		mixer_voice_t *v = &mixer->voices[i];
+		int32_t gain = v->gain;
+
+		if(v->type == MIXER_VOICE_TONE) {
+			uint32_t phase = v->phase;
+			for(uint16_t k=0; k<n; k++) {
+				acc[k] += sine_table[phase >> (32 - MIXER_SINE_BITS)] * gain;
+				phase += v->phase_step;
+			}
+			v->phase = phase;
+		} else if(v->type == MIXER_VOICE_STREAM) {
+			int32_t count = v->source(mixer->block, n, v->arg);
+			if(count == MIXER_SOURCE_END) {
+				v->type = MIXER_VOICE_OFF;
+				continue;
+			}
+			if(count < n) {
+				v->underruns++;
+			}
+			for(int32_t k=0; k<count; k++) {
+				acc[k] += mixer->block[k] * gain;
+			}
+		}
+	}
+
+	for(uint16_t k=0; k<n; k++) {
+		int32_t value = (acc[k] >> DAC_SHIFT) + MIXER_DAC_ZERO;
+		if(value > MIXER_DAC_MAX) {
+			value = MIXER_DAC_MAX;
+		} else if(value < 0) {
+			value = 0;
+		}
+		out[k] = value;
+	}
+
+	return mixer_active_voices(mixer);
+}
@@ -0,0 +1,116 @@
+#ifndef MIXER_H
+#define MIXER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Multi-voice mixer producing the samples of the DAC.
+ *
+ * Each voice is either a sine tone (phase accumulator on a lookup table) or a stream of signed 16 bits
+ * samples pulled from a source function. The voices are weighted by their gain (MIXER_GAIN_UNITY = 1)
+ * and summed in 32 bits, then the sum is saturated to the 12 bits range of the DAC: a full scale 16 bits
+ * stream at unity gain uses the full range of the DAC.
+ */
+
+#define MIXER_VOICES			4
+#define MIXER_MAX_BLOCK			512		// Maximum number of samples mixed at once.
+#define MIXER_GAIN_SHIFT		8
+#define MIXER_GAIN_UNITY		(1 << MIXER_GAIN_SHIFT)
+#define MIXER_TONE_AMPLITUDE	4096	// Amplitude of the tones at unity gain, louder tones distort on the speaker.
+#define MIXER_SINE_BITS			8		// The sine table has 2^MIXER_SINE_BITS entries.
+#define MIXER_DAC_ZERO			2048
+#define MIXER_DAC_MAX			4095
+#define MIXER_SOURCE_END		(-1)
+
+/**
+ * @brief   Source of a stream voice, called by mixer_mix.
+ *
+ * @param buf	buffer to fill with the next samples
+ * @param n		number of samples wanted
+ * @param arg	argument given to mixer_set_stream
+ *
+ * @return		number of samples written (less than n is an underrun, the missing samples are silent)
+ * 				or MIXER_SOURCE_END once the stream has ended, which stops the voice
+ */
+typedef int32_t (*mixer_source_t)(int16_t *buf, uint16_t n, void *arg);
+
+typedef enum {
+	MIXER_VOICE_OFF = 0,
+	MIXER_VOICE_TONE,
+	MIXER_VOICE_STREAM,
+} mixer_voice_type_t;
+
+typedef struct {
+	uint8_t type;			// mixer_voice_type_t
+	uint16_t gain;			// Q8
+	uint32_t phase;			// Phase of the tone, a full turn is 2^32.
+	uint32_t phase_step;
+	mixer_source_t source;
+	void *arg;
+	uint32_t underruns;		// Blocks the source could not fill completely.
+} mixer_voice_t;
+
+typedef struct {
+	uint32_t freq;			// Output frequency.
+	mixer_voice_t voices[MIXER_VOICES];
+	int32_t acc[MIXER_MAX_BLOCK];
+	int16_t block[MIXER_MAX_BLOCK];
+} mixer_t;
+
+/**
+ * @brief   Initializes the mixer with all the voices stopped and at unity gain.
+ *
+ * @param mixer		mixer to initialize
+ * @param freq		output frequency in Hz
+ */
+void mixer_init(mixer_t *mixer, uint32_t freq);
+
+/**
+ * @brief   Plays a sine tone on a voice, or changes its frequency without phase jump if it already plays a tone.
+ *
+ * @param voice		0 to MIXER_VOICES - 1
+ * @param freq		frequency in Hz, 0 stops the voice. Frequencies above the Nyquist frequency are aliased.
+ */
+void mixer_set_tone(mixer_t *mixer, uint8_t voice, uint16_t freq);
+
+/**
+ * @brief   Plays a stream on a voice. The source is called from mixer_mix until it returns MIXER_SOURCE_END.
+ */
+void mixer_set_stream(mixer_t *mixer, uint8_t voice, mixer_source_t source, void *arg);
+
+/**
+ * @brief   Stops a voice.
+ */
+void mixer_stop(mixer_t *mixer, uint8_t voice);
+
+/**
+ * @brief   Sets the gain of a voice, MIXER_GAIN_UNITY (256) is 1.
+ */
+void mixer_set_gain(mixer_t *mixer, uint8_t voice, uint16_t gain);
+
+/**
+ * @brief   Returns the mask of the voices playing (bit i for the voice i).
+ */
+uint8_t mixer_active_voices(const mixer_t *mixer);
+
+/**
+ * @brief   Mixes the next block of samples of all the voices.
+ *
+ * @param mixer		mixer
+ * @param out		output buffer, samples in the format of the DAC (unsigned 12 bits)
+ * @param n			number of samples to produce, at most MIXER_MAX_BLOCK
+ *
+ * @return			mask of the voices still playing after this block
+ */
+uint8_t mixer_mix(mixer_t *mixer, uint16_t *out, uint16_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MIXER_H */
@@ -31,7 +31,8 @@
 //#include "autogen_fir_coeffs.h"
 //#include "debug.h"
 #include "mp45dt02_processing.h"
-#include "pdm_filter.h"
+#include "pdm_decimator.h"
+#include "pdm_demux.h"
 
 /******************************************************************************/
 /* Hardware configuration */
@@ -74,7 +75,10 @@
 // The number of samples required to get 1 ms of data is:
 // 2.048 Mbs / 32 bits = 64000 32bit_samples/sec, 32000 32bit_samples/sec for left channel and 32000 32bit_samples/sec for right channel.
 // 0.001 x 64000 = 64 32bit_samples in 1 ms, 32 32bit_samples (128 bytes) for left and 32 32bit_samples (128 bytes) for right.
-// This value is needed to set the number of samples to acquire for DMA, since the PDM to PCM library works with 1 ms of data.
+// This value is needed to set the number of samples to acquire for DMA, since the PDM to PCM conversion works with 1 ms of data.
+//
+// The I2S clock doesn't depend on MP45DT02_PCM_FREQ, the decimation factor of the PDM to PCM conversion (see pdm_decimator.c)
+// is adapted instead: 128 for 8 KHz, 64 for 16 KHz and 32 for 32 KHz.
 #define MP45DT02_I2SDIV                     8
 #define MP45DT02_I2SODD                     0
 #define I2SPR_I2SODD_SHIFT                  8
@@ -82,26 +86,6 @@
 /* Debugging - check for buffer overflows */
 #define MEMORY_GUARD                        0xDEADBEEF
 
-// Decode matrix: from 8 bits to 4 bits.
-uint8_t Channel_Demux[128] = {
-  0x00, 0x01, 0x00, 0x01, 0x02, 0x03, 0x02, 0x03,
-  0x00, 0x01, 0x00, 0x01, 0x02, 0x03, 0x02, 0x03,
-  0x04, 0x05, 0x04, 0x05, 0x06, 0x07, 0x06, 0x07,
-  0x04, 0x05, 0x04, 0x05, 0x06, 0x07, 0x06, 0x07,
-  0x00, 0x01, 0x00, 0x01, 0x02, 0x03, 0x02, 0x03,
-  0x00, 0x01, 0x00, 0x01, 0x02, 0x03, 0x02, 0x03,
-  0x04, 0x05, 0x04, 0x05, 0x06, 0x07, 0x06, 0x07,
-  0x04, 0x05, 0x04, 0x05, 0x06, 0x07, 0x06, 0x07,
-  0x08, 0x09, 0x08, 0x09, 0x0a, 0x0b, 0x0a, 0x0b,
-  0x08, 0x09, 0x08, 0x09, 0x0a, 0x0b, 0x0a, 0x0b,
-  0x0c, 0x0d, 0x0c, 0x0d, 0x0e, 0x0f, 0x0e, 0x0f,
-  0x0c, 0x0d, 0x0c, 0x0d, 0x0e, 0x0f, 0x0e, 0x0f,
-  0x08, 0x09, 0x08, 0x09, 0x0a, 0x0b, 0x0a, 0x0b,
-  0x08, 0x09, 0x08, 0x09, 0x0a, 0x0b, 0x0a, 0x0b,
-  0x0c, 0x0d, 0x0c, 0x0d, 0x0e, 0x0f, 0x0e, 0x0f,
-  0x0c, 0x0d, 0x0c, 0x0d, 0x0e, 0x0f, 0x0e, 0x0f
-};
-
 static struct {
     uint32_t offset;
     uint32_t number;
@@ -124,14 +108,14 @@ static struct {
 //} cmsisDsp;
 
 static uint16_t I2S_PDM_samples[MP45DT02_BUFFER_SIZE_2B/2] = {0};
-static uint16_t I2S_PCM_samples[MP45DT02_DECIMATED_BUFFER_SIZE] = {0};
 static uint16_t SPI_PDM_samples[MP45DT02_BUFFER_SIZE_2B/2] = {0};
-static uint16_t SPI_PCM_samples[MP45DT02_DECIMATED_BUFFER_SIZE] = {0};
-static int16_t PCM_buffer1[MIC_BUFFER_LEN] = {0};
-static int16_t PCM_buffer2[MIC_BUFFER_LEN] = {0};
+// Ring of 10 ms frames: the frame number PCM_frame_count is being filled, the previous MP45DT02_RING_SLOTS-1 frames
+// can be read. The samples are never copied, the readers get a pointer to the slot.
+static int16_t PCM_ring[MP45DT02_RING_SLOTS][MIC_BUFFER_LEN] = {{0}};
 static uint8_t PCM_buffer_index = 0;
-static int16_t *PCM_buffer_ptr_curr = PCM_buffer1;
-static int16_t *PCM_buffer_ptr_last = PCM_buffer2;
+static volatile uint32_t PCM_frame_count = 0;
+static systime_t PCM_frame_time[MP45DT02_RING_SLOTS]; // System time at which each frame was completed.
+EVENTSOURCE_DECL(mp45dt02FrameEvent);
 
 static thread_t *DataProcessingThd;
 static THD_WORKING_AREA(DataProcessingThdWA, 1024);
@@ -145,30 +129,15 @@ static SPISlaveConfig mp45dt02SPIConfig;
 
 static mp45dt02Config initConfig;
 
-PDMFilter_InitStruct PDM_filter_I2S[MP45DT02_NUM_CHANNELS];
-PDMFilter_InitStruct PDM_filter_SPI[MP45DT02_NUM_CHANNELS];
+static pdm_decimator_t PDM_decimator_I2S[MP45DT02_NUM_CHANNELS];
+static pdm_decimator_t PDM_decimator_SPI[MP45DT02_NUM_CHANNELS];
 
 static void PDMDecoder_Init(void) {
 	uint8_t i = 0;
 
-	// Enable CRC peripheral to unlock the PDM library.
-	rccEnableAHB1(RCC_AHB1ENR_CRCEN, FALSE);
-
 	for(i=0; i<MP45DT02_NUM_CHANNELS; i++) {
-		// Filter LP and HP Init.
-		PDM_filter_I2S[i].LP_HZ = I2S_AUDIOFREQ_16K/2;
-		PDM_filter_I2S[i].HP_HZ = 10;
-		PDM_filter_I2S[i].Fs = I2S_AUDIOFREQ_16K;
-		PDM_filter_I2S[i].Out_MicChannels = 2;
-		PDM_filter_I2S[i].In_MicChannels = 2;
-		PDM_Filter_Init((PDMFilter_InitStruct *)&PDM_filter_I2S[i]);
-
-		PDM_filter_SPI[i].LP_HZ = I2S_AUDIOFREQ_16K/2;
-		PDM_filter_SPI[i].HP_HZ = 10;
-		PDM_filter_SPI[i].Fs = I2S_AUDIOFREQ_16K;
-		PDM_filter_SPI[i].Out_MicChannels = 2;
-		PDM_filter_SPI[i].In_MicChannels = 2;
-		PDM_Filter_Init((PDMFilter_InitStruct *)&PDM_filter_SPI[i]);
+		pdm_decimator_init(&PDM_decimator_I2S[i], MP45DT02_PCM_FREQ, AUDIO_IN_VOLUME);
+		pdm_decimator_init(&PDM_decimator_SPI[i], MP45DT02_PCM_FREQ, AUDIO_IN_VOLUME);
 	}
 
 }
@@ -218,10 +187,9 @@ static THD_FUNCTION(DataProcessing, arg)
 
     chRegSetThreadName(__FUNCTION__);
 
-	uint32_t index = 0;
 	uint16_t * DataTempI2S;
 	uint16_t * DataTempSPI;
-	uint8_t a,b=0;
+	int16_t * PCM_curr;
 
     while (chThdShouldTerminateX() == false)
     {
@@ -244,17 +212,8 @@ static THD_FUNCTION(DataProcessing, arg)
         // The samples are interleaved left and right, this means that the first bit is left, the second is right, ...
         // Extract the bits sequence and transform it in order to have 1 byte left, 1 byte right, ...
         // This is needed by the library functions that convert PDM in PCM samples.
-        for(index=0; index < mp45dt02I2sData.number*2; index++) { // We take in consideration 16 bits at a time, thus we loop twice as the number of samples.
-			a = ((uint8_t *)(DataTempI2S))[(index*2)]; // MSByte.
-			b = ((uint8_t *)(DataTempI2S))[(index*2)+1]; // LSByte.
-			((uint8_t *)I2S_PDM_samples)[(index*2)] = Channel_Demux[a & CHANNEL_DEMUX_MASK] | Channel_Demux[b & CHANNEL_DEMUX_MASK] << 4; // Extract left and swap bytes.
-			((uint8_t *)I2S_PDM_samples)[(index*2)+1] = Channel_Demux[(a>>1) & CHANNEL_DEMUX_MASK] |Channel_Demux[(b>>1) & CHANNEL_DEMUX_MASK] << 4; // Extract right and swap bytes.
-
-			a = ((uint8_t *)(DataTempSPI))[(index*2)]; // MSByte.
-			b = ((uint8_t *)(DataTempSPI))[(index*2)+1]; // LSByte.
-			((uint8_t *)SPI_PDM_samples)[(index*2)] = Channel_Demux[a & CHANNEL_DEMUX_MASK] | Channel_Demux[b & CHANNEL_DEMUX_MASK] << 4; // Extract left and swap bytes.
-			((uint8_t *)SPI_PDM_samples)[(index*2)+1] = Channel_Demux[(a>>1) & CHANNEL_DEMUX_MASK] |Channel_Demux[(b>>1) & CHANNEL_DEMUX_MASK] << 4; // Extract right and swap bytes.
-		}
+        // Both streams are handled in a single pass, 32 bits at a time.
+        pdm_demux_dual(DataTempI2S, DataTempSPI, I2S_PDM_samples, SPI_PDM_samples, mp45dt02I2sData.number*2); // Length in 16 bits words, thus twice the number of samples.
 
         // Test PDM samples to get a 4 KHz triangular wave (128/32=4 => 16KHz/4=4KHz).
         // Beware that the PDM to PCM filter takes 64 bits at a time.
@@ -296,33 +255,24 @@ static THD_FUNCTION(DataProcessing, arg)
 //        	I2S_PDM_samples[index+31] = 0x0000;
 //        }
 
-        // Using a decimator factor of 64, we get 2048/64 = 32 PCM samples of 16 bits, 16 PCM for left channel and 16 PCM for right channel.
-        for(index = 0; index < MP45DT02_NUM_CHANNELS; index++) {
-        	/* PDM to PCM filter */
-        	PDM_Filter_64_LSB(&((uint8_t*)(I2S_PDM_samples))[index], (uint16_t*)&(I2S_PCM_samples[index]), AUDIO_IN_VOLUME , (PDMFilter_InitStruct *)&PDM_filter_I2S[index]);
-        //	a+=(b*index);
-        	PDM_Filter_64_LSB(&((uint8_t*)(SPI_PDM_samples))[index], (uint16_t*)&(SPI_PCM_samples[index]), AUDIO_IN_VOLUME , (PDMFilter_InitStruct *)&PDM_filter_SPI[index]);
-        }
-
-        // Arrange the buffer in order to have the microphones data in sequence: mic0, mic1, mic2, mic3, mic0, mic1, mic2, mic3, ...
-        for(index=0; index<MP45DT02_DECIMATED_BUFFER_SIZE/2; index++) {
-        	PCM_buffer_ptr_curr[(PCM_buffer_index*2*MP45DT02_DECIMATED_BUFFER_SIZE)+(index*4)] = I2S_PCM_samples[index*2]; // Right microphone is MIC0
-        	PCM_buffer_ptr_curr[(PCM_buffer_index*2*MP45DT02_DECIMATED_BUFFER_SIZE)+(index*4)+1] = I2S_PCM_samples[index*2+1]; // Left microphone is MIC1
-        	PCM_buffer_ptr_curr[(PCM_buffer_index*2*MP45DT02_DECIMATED_BUFFER_SIZE)+(index*4)+2] = SPI_PCM_samples[index*2+1]; // Back microphone is MIC2
-        	PCM_buffer_ptr_curr[(PCM_buffer_index*2*MP45DT02_DECIMATED_BUFFER_SIZE)+(index*4)+3] = SPI_PCM_samples[index*2]; // Front microphone is MIC3
-        }
+        // Convert 1 ms of PDM samples to PCM (MP45DT02_DECIMATED_BUFFER_SIZE/2 samples per microphone) and arrange the buffer
+        // in order to have the microphones data in sequence: mic0, mic1, mic2, mic3, mic0, mic1, mic2, mic3, ...
+        // The PDM bytes of the two microphones on the same line are interleaved: left, right, left, right, ...
+        PCM_curr = &PCM_ring[PCM_frame_count % MP45DT02_RING_SLOTS][PCM_buffer_index*2*MP45DT02_DECIMATED_BUFFER_SIZE];
+        pdm_decimator_process(&PDM_decimator_I2S[0], &((uint8_t*)I2S_PDM_samples)[0], mp45dt02I2sData.number*2, 2, &PCM_curr[0], 4); // Right microphone is MIC0
+        pdm_decimator_process(&PDM_decimator_I2S[1], &((uint8_t*)I2S_PDM_samples)[1], mp45dt02I2sData.number*2, 2, &PCM_curr[1], 4); // Left microphone is MIC1
+        pdm_decimator_process(&PDM_decimator_SPI[1], &((uint8_t*)SPI_PDM_samples)[1], mp45dt02I2sData.number*2, 2, &PCM_curr[2], 4); // Back microphone is MIC2
+        pdm_decimator_process(&PDM_decimator_SPI[0], &((uint8_t*)SPI_PDM_samples)[0], mp45dt02I2sData.number*2, 2, &PCM_curr[3], 4); // Front microphone is MIC3
 
         if(PCM_buffer_index == 9) {
         	PCM_buffer_index = 0;
 
-        	initConfig.fullbufferCb((int16_t *)PCM_buffer_ptr_curr, MIC_BUFFER_LEN);
+        	initConfig.fullbufferCb(PCM_ring[PCM_frame_count % MP45DT02_RING_SLOTS], MIC_BUFFER_LEN);
 
-        	PCM_buffer_ptr_last = PCM_buffer_ptr_curr;
-        	if(PCM_buffer_ptr_curr == PCM_buffer1) {
-        		PCM_buffer_ptr_curr = PCM_buffer2;
-        	} else {
-        		PCM_buffer_ptr_curr = PCM_buffer1;
-        	}
+        	// Publish the frame, from now on the next slot is filled.
+        	PCM_frame_time[PCM_frame_count % MP45DT02_RING_SLOTS] = chVTGetSystemTime();
+        	PCM_frame_count++;
+        	chEvtBroadcastFlags(&mp45dt02FrameEvent, MP45DT02_EVENT_FRAME);
         } else {
         	PCM_buffer_index++;
         }
@@ -441,7 +391,19 @@ void mp45dt02Shutdown(void)
 }
 
 int16_t* mp45dt02BufferPtr(void) {
-	return PCM_buffer_ptr_last;
+	return PCM_ring[(PCM_frame_count - 1) % MP45DT02_RING_SLOTS];
+}
+
+uint32_t mp45dt02FrameCount(void) {
+	return PCM_frame_count;
+}
+
+int16_t* mp45dt02FramePtr(uint32_t frame) {
+	return PCM_ring[frame % MP45DT02_RING_SLOTS];
+}
+
+systime_t mp45dt02FrameTime(uint32_t frame) {
+	return PCM_frame_time[frame % MP45DT02_RING_SLOTS];
 }
 
 
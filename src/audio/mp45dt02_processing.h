@@ -30,11 +30,21 @@
 #define I2S_PERIPHERAL 0
 #define SPI_PERIPHERAL 1
 
+#define I2S_AUDIOFREQ_8K					((uint32_t)8000U)
 #define I2S_AUDIOFREQ_16K					((uint32_t)16000U)
 #define I2S_AUDIOFREQ_32K					((uint32_t)32000U)
-#define AUDIO_IN_VOLUME						4 //64
-
-#define CHANNEL_DEMUX_MASK					0x55
+/* Linear gain of the decimators, 1 means that a full scale PDM signal gives a full scale PCM signal.
+ * The MP45DT02 reaches its full scale at 120 dB SPL (sensitivity of -26 dBFS at 94 dB SPL). A gain of 4 (+12 dB)
+ * brings the clipping point down to 108 dB SPL, above the sounds met by the robot, and gives to a voice at 1 m
+ * (about 60 dB SPL) an amplitude of about 130, above SOUND_DIRECTION_MIN_RMS. The PCM samples saturate when the
+ * PDM signal exceeds 1/4 of its full scale. */
+#define AUDIO_IN_VOLUME						4
+
+/* Frequency of the PCM samples: I2S_AUDIOFREQ_8K, I2S_AUDIOFREQ_16K or I2S_AUDIOFREQ_32K.
+ * The microphones are always sampled at MP45DT02_RAW_FREQ_KHZ, only the decimation changes. */
+#ifndef MP45DT02_PCM_FREQ
+#define MP45DT02_PCM_FREQ					I2S_AUDIOFREQ_16K
+#endif
 
 /* Number of times interrupts are called when filling the buffer.
  * ChibiOS fires twice half full / full */
@@ -87,14 +97,22 @@
 /******************************************************************************/
 
 /* Desired decimation factor */
-#define MP45DT02_FIR_DECIMATION_FACTOR      64
+#define MP45DT02_FIR_DECIMATION_FACTOR      (MP45DT02_RAW_FREQ_KHZ * 1000 / MP45DT02_PCM_FREQ)
 
 /* Buffer size of the decimated sample (16 bits per sample)*/
-#define MP45DT02_DECIMATED_BUFFER_SIZE      (I2S_AUDIOFREQ_16K / 1000) * MP45DT02_NUM_CHANNELS // Number of samples in 1 ms for each channel x number of channels
+#define MP45DT02_DECIMATED_BUFFER_SIZE      (MP45DT02_PCM_FREQ / 1000) * MP45DT02_NUM_CHANNELS // Number of samples in 1 ms for each channel x number of channels
 											//(MP45DT02_I2S_SAMPLE_SIZE_BITS / MP45DT02_FIR_DECIMATION_FACTOR) * MP45DT02_NUM_CHANNEL
 
 #define MIC_BUFFER_LEN MP45DT02_DECIMATED_BUFFER_SIZE * 10 * 2 // 10 ms of data for all 4 microphones
 
+/* Number of 10 ms frames kept in memory, one of them is always being filled. */
+#define MP45DT02_RING_SLOTS					4
+
+/* Flag broadcast on mp45dt02FrameEvent each time a new frame is available. */
+#define MP45DT02_EVENT_FRAME				1
+
+extern event_source_t mp45dt02FrameEvent;
+
 typedef void (*mp45dt02FullBufferCb) (int16_t *data, uint16_t length);
 
 typedef struct {
@@ -106,4 +124,13 @@ void mp45dt02Init(mp45dt02Config *config);
 void mp45dt02Shutdown(void);
 int16_t* mp45dt02BufferPtr(void);
 
+/* Number of frames completed since the start, the frame with this number is the one being filled. */
+uint32_t mp45dt02FrameCount(void);
+
+/* Slot of the given frame, valid as long as mp45dt02FrameCount() - frame < MP45DT02_RING_SLOTS. */
+int16_t* mp45dt02FramePtr(uint32_t frame);
+
+/* System time at which the given frame was completed, that is shortly after its last sample. Same validity. */
+systime_t mp45dt02FrameTime(uint32_t frame);
+
 #endif
@@ -0,0 +1,172 @@
+#include <string.h>
+#include "pdm_decimator.h"
+
+#define FIRST_STAGE_DECIMATION	8
+#define FIRST_STAGE_BYTES		4 // The sinc^4 impulse response spans 29 bits, thus 4 bytes.
+#define HP_HZ					10 // Cut-off frequency of the DC removal filter.
+#define TWO_PI_Q15				205887
+
+// Impulse response of the sinc^4 filter decimating by 8 (sum = 8^4).
+static const int16_t first_stage_coeffs[FIRST_STAGE_BYTES*FIRST_STAGE_DECIMATION] = {
+	1, 4, 10, 20, 35, 56, 84, 120, 161, 204, 246, 284, 315, 336, 344, 336,
+	315, 284, 246, 204, 161, 120, 84, 56, 35, 20, 10, 4, 1, 0, 0, 0
+};
+
+// Even taps of the half-band filter (Kaiser window, beta = 7, Q15), the odd taps are zero except the
+// center one that is 0.5. Stopband attenuation is about 70 dB above 0.35 x input frequency.
+static const int16_t hb_coeffs[2*PDM_DECIMATOR_HB_HALF_TAPS] __attribute__((aligned(4))) = {
+	-4, 35, -124, 321, -708, 1441, -3050, 10281, 10281, -3050, 1441, -708, 321, -124, 35, -4
+};
+#define HB_CENTER_COEFF 16384
+
+// first_stage_lut[k][byte] is the contribution of a byte received k bytes ago to the current output.
+static int16_t first_stage_lut[FIRST_STAGE_BYTES][256];
+static uint8_t first_stage_lut_ready = 0;
+
+static void first_stage_lut_init(void) {
+	for(uint8_t k=0; k<FIRST_STAGE_BYTES; k++) {
+		for(uint16_t value=0; value<256; value++) {
+			int16_t sum = 0;
+			// The last bit in time (LSB) is multiplied by the first coefficient.
+			for(uint8_t bit=0; bit<8; bit++) {
+				if(value & (1<<bit)) {
+					sum += first_stage_coeffs[k*FIRST_STAGE_DECIMATION + bit];
+				} else {
+					sum -= first_stage_coeffs[k*FIRST_STAGE_DECIMATION + bit];
+				}
+			}
+			first_stage_lut[k][value] = sum;
+		}
+	}
+	first_stage_lut_ready = 1;
+}
+
+static inline int16_t saturate16(int32_t value) {
+	if(value > INT16_MAX) {
+		return INT16_MAX;
+	} else if(value < INT16_MIN) {
+		return INT16_MIN;
+	}
+	return value;
+}
+
+#if defined(__ARM_FEATURE_DSP)
+static inline int32_t smlad(uint32_t x, uint32_t y, int32_t acc) {
+	int32_t result;
+	__asm__ ("smlad %0, %1, %2, %3" : "=r" (result) : "r" (x), "r" (y), "r" (acc));
+	return result;
+}
+#endif
+
+ /**
+ * @brief   Computes one output of the half-band filter.
+ *
+ * @param window	the last 2*PDM_DECIMATOR_HB_HALF_TAPS even samples, the most recent last
+ * @param center	odd sample aligned with the center of the filter
+ */
+static inline int16_t half_band(const int16_t *window, int16_t center) {
+	int32_t acc = (int32_t)center * HB_CENTER_COEFF + (1<<14);
+#if defined(__ARM_FEATURE_DSP)
+	// Two taps per instruction.
+	uint32_t samples, coeffs;
+	for(uint8_t i=0; i<2*PDM_DECIMATOR_HB_HALF_TAPS; i+=2) {
+		memcpy(&samples, &window[i], sizeof(samples));
+		memcpy(&coeffs, &hb_coeffs[i], sizeof(coeffs));
+		acc = smlad(samples, coeffs, acc);
+	}
+#else
+	for(uint8_t i=0; i<2*PDM_DECIMATOR_HB_HALF_TAPS; i++) {
+		acc += (int32_t)window[i] * hb_coeffs[i];
+	}
+#endif
+	return saturate16(acc >> 15);
+}
+
+int8_t pdm_decimator_init(pdm_decimator_t *dec, uint32_t freq, int16_t volume) {
+	uint8_t cic_shift;
+
+	// The CIC gain is (8 x cic_decimation)^4, the shift brings a full scale PDM signal to 16 bits.
+	switch(freq) {
+		case 8000:
+			cic_shift = 9;
+			break;
+		case 16000:
+			cic_shift = 5;
+			break;
+		case 32000:
+			cic_shift = 1;
+			break;
+		default:
+			return -1;
+	}
+
+	if(!first_stage_lut_ready) {
+		first_stage_lut_init();
+	}
+
+	memset(dec, 0, sizeof(pdm_decimator_t));
+	dec->freq = freq;
+	dec->cic_decimation = PDM_DECIMATOR_PDM_FREQ / FIRST_STAGE_DECIMATION / (2 * freq);
+	dec->cic_shift = cic_shift;
+	dec->volume = volume;
+	// A PDM stream of zeros is a full scale negative signal, start from silence instead (alternate bits).
+	memset(dec->bytes, 0x55, sizeof(dec->bytes));
+
+	return 0;
+}
+
+uint16_t pdm_decimator_process(pdm_decimator_t *dec, const uint8_t *in, uint16_t in_len, uint8_t in_stride,
+								int16_t *out, uint8_t out_stride) {
+	uint16_t count = 0;
+	// DC removal filter coefficient (Q15): 1 - 2*pi*fc/fs.
+	const int32_t hp_coeff = 32768 - (TWO_PI_Q15 * HP_HZ) / (2 * dec->freq);
+
+	for(uint16_t i=0; i<in_len; i++) {
+		uint8_t value = in[i*in_stride];
+
+		// First stage: sinc^4, one output per byte.
+		uint32_t acc = (int32_t)first_stage_lut[0][value] + first_stage_lut[1][dec->bytes[0]] +
+						first_stage_lut[2][dec->bytes[1]] + first_stage_lut[3][dec->bytes[2]];
+		dec->bytes[2] = dec->bytes[1];
+		dec->bytes[1] = dec->bytes[0];
+		dec->bytes[0] = value;
+
+		// Second stage: CIC, the integrators are allowed to wrap around.
+		for(uint8_t k=0; k<PDM_DECIMATOR_CIC_ORDER; k++) {
+			dec->integrator[k] += acc;
+			acc = dec->integrator[k];
+		}
+		if(++dec->cic_phase < dec->cic_decimation) {
+			continue;
+		}
+		dec->cic_phase = 0;
+		for(uint8_t k=0; k<PDM_DECIMATOR_CIC_ORDER; k++) {
+			uint32_t prev = dec->comb[k];
+			dec->comb[k] = acc;
+			acc -= prev;
+		}
+
+		// DC removal, the output is kept with 8 fractional bits.
+		int32_t sample = (int32_t)acc >> dec->cic_shift;
+		dec->hp_out = (sample - dec->hp_in) * 256 + (int32_t)(((int64_t)hp_coeff * dec->hp_out) >> 15);
+		dec->hp_in = sample;
+		int16_t pcm = saturate16((int32_t)(((int64_t)dec->hp_out * dec->volume) >> 8));
+
+		// Third stage: half-band filter, one output every two samples.
+		if(dec->hb_phase == 0) {
+			dec->hb_odd[dec->hb_odd_pos] = pcm;
+			dec->hb_odd_pos = (dec->hb_odd_pos + 1) % PDM_DECIMATOR_HB_HALF_TAPS;
+			dec->hb_phase = 1;
+		} else {
+			dec->hb_even_pos = (dec->hb_even_pos + 1) % (2*PDM_DECIMATOR_HB_HALF_TAPS);
+			dec->hb_even[dec->hb_even_pos] = pcm;
+			dec->hb_even[dec->hb_even_pos + 2*PDM_DECIMATOR_HB_HALF_TAPS] = pcm;
+			// The oldest odd sample is the one aligned with the center of the filter.
+			out[count*out_stride] = half_band(&dec->hb_even[dec->hb_even_pos + 1], dec->hb_odd[dec->hb_odd_pos]);
+			count++;
+			dec->hb_phase = 0;
+		}
+	}
+
+	return count;
+}
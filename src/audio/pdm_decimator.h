@@ -0,0 +1,77 @@
+#ifndef PDM_DECIMATOR_H
+#define PDM_DECIMATOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/**
+ * PDM to PCM conversion for a single microphone (replaces the ST binary PDM library).
+ *
+ * The 1.024 MHz bitstream is decimated in three stages:
+ * - sinc^4 filter decimating by 8, computed one byte (8 PDM bits) at a time with lookup tables
+ * - 4th order CIC decimating to twice the output frequency, followed by a DC removal filter
+ * - half-band FIR decimating by 2, using the Cortex-M4 SMLAD instruction when available
+ *
+ * The CIC droop is not compensated: about -1 dB at a quarter of the output frequency and -3.6 dB
+ * at the Nyquist frequency.
+ */
+
+#define PDM_DECIMATOR_PDM_FREQ		1024000 // Bitstream frequency of each microphone.
+#define PDM_DECIMATOR_CIC_ORDER		4
+#define PDM_DECIMATOR_HB_HALF_TAPS	8 // The half-band filter has 4*PDM_DECIMATOR_HB_HALF_TAPS-1 taps.
+
+typedef struct {
+	uint32_t freq;			// Output frequency.
+	uint8_t cic_decimation;	// Decimation factor of the CIC stage.
+	uint8_t cic_shift;		// Shift to bring the CIC output to the 16 bits range.
+	uint8_t cic_phase;
+	uint8_t hb_phase;
+	int16_t volume;
+	uint8_t bytes[3];		// Last PDM bytes received, needed by the first stage.
+	uint32_t integrator[PDM_DECIMATOR_CIC_ORDER];
+	uint32_t comb[PDM_DECIMATOR_CIC_ORDER];
+	int32_t hp_in;			// DC removal filter state.
+	int32_t hp_out;
+	uint8_t hb_even_pos;
+	uint8_t hb_odd_pos;
+	int16_t hb_even[4*PDM_DECIMATOR_HB_HALF_TAPS]; // Even samples history, stored twice to always have a contiguous window.
+	int16_t hb_odd[PDM_DECIMATOR_HB_HALF_TAPS];
+} pdm_decimator_t;
+
+/**
+ * @brief   Initializes the decimator of one microphone.
+ *
+ * @param dec		decimator to initialize
+ * @param freq		output frequency: 8000, 16000 or 32000 Hz
+ * @param volume	linear gain applied to the PCM signal, 1 means that a full scale PDM signal
+ * 					gives a full scale 16 bits signal
+ *
+ * @return			0 on success, -1 if the frequency is not supported
+ */
+int8_t pdm_decimator_init(pdm_decimator_t *dec, uint32_t freq, int16_t volume);
+
+/**
+ * @brief   Converts a block of PDM data to PCM samples.
+ *
+ * @param dec		decimator of the microphone
+ * @param in		PDM bytes of the microphone, the first bit in time is the MSB of each byte
+ * @param in_len	number of PDM bytes to process
+ * @param in_stride	distance in bytes between two consecutive bytes of the microphone (2 when two
+ * 					microphones are interleaved byte by byte)
+ * @param out		PCM samples output
+ * @param out_stride distance in samples between two consecutive output samples, this lets the
+ * 					samples be written directly in an interleaved multi-microphones buffer
+ *
+ * @return			number of PCM samples written (in_len * 8 * freq / PDM_DECIMATOR_PDM_FREQ)
+ */
+uint16_t pdm_decimator_process(pdm_decimator_t *dec, const uint8_t *in, uint16_t in_len, uint8_t in_stride,
+								int16_t *out, uint8_t out_stride);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PDM_DECIMATOR_H */
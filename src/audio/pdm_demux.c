@@ -0,0 +1,52 @@
+#include <string.h>
+#include "pdm_demux.h"
+
+ /**
+ * @brief   Separates the even and odd bits of each 16 bits half of a word: even bits go to the
+ * 			low byte and odd bits to the high byte of the same half.
+ * 			This is the inverse perfect shuffle (Hacker's Delight, 7-2) without the last step that
+ * 			would mix the two halves.
+ */
+static inline uint32_t unzip16x2(uint32_t x) {
+	uint32_t t;
+	t = (x ^ (x >> 1)) & 0x22222222;
+	x = x ^ t ^ (t << 1);
+	t = (x ^ (x >> 2)) & 0x0C0C0C0C;
+	x = x ^ t ^ (t << 2);
+	t = (x ^ (x >> 4)) & 0x00F000F0;
+	x = x ^ t ^ (t << 4);
+	return x;
+}
+
+void pdm_demux(const uint16_t *in, uint16_t *out, uint32_t len) {
+	uint32_t word;
+	uint32_t index = 0;
+
+	// Two 16 bits samples at a time.
+	for(; index+1<len; index+=2) {
+		memcpy(&word, &in[index], sizeof(word));
+		word = unzip16x2(word);
+		memcpy(&out[index], &word, sizeof(word));
+	}
+	if(index < len) {
+		out[index] = unzip16x2(in[index]);
+	}
+}
+
+void pdm_demux_dual(const uint16_t *in_a, const uint16_t *in_b, uint16_t *out_a, uint16_t *out_b, uint32_t len) {
+	uint32_t word_a, word_b;
+	uint32_t index = 0;
+
+	for(; index+1<len; index+=2) {
+		memcpy(&word_a, &in_a[index], sizeof(word_a));
+		memcpy(&word_b, &in_b[index], sizeof(word_b));
+		word_a = unzip16x2(word_a);
+		word_b = unzip16x2(word_b);
+		memcpy(&out_a[index], &word_a, sizeof(word_a));
+		memcpy(&out_b[index], &word_b, sizeof(word_b));
+	}
+	if(index < len) {
+		out_a[index] = unzip16x2(in_a[index]);
+		out_b[index] = unzip16x2(in_b[index]);
+	}
+}
@@ -0,0 +1,40 @@
+#ifndef PDM_DEMUX_H
+#define PDM_DEMUX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/**
+ * @brief   Separates the two microphones sharing the same PDM line.
+ * 			The input is the raw stream received by the I2S (or SPI) peripheral in which the bits of the
+ * 			two microphones are interleaved: the first bit is left, the second is right, ...
+ * 			The output contains one byte of left bits followed by one byte of right bits, ... as required
+ * 			by the PDM to PCM filter.
+ * 			The bits are separated two 16 bits words at a time with shifts and masks, no lookup table.
+ *
+ * @param in		raw interleaved PDM stream (16 bits words as written by the DMA)
+ * @param out		demultiplexed PDM stream, same size as the input
+ * @param len		number of 16 bits words to process
+ */
+void pdm_demux(const uint16_t *in, uint16_t *out, uint32_t len);
+
+/**
+ * @brief   Same as pdm_demux but for two independent streams at once (I2S and SPI microphones),
+ * 			this is the version used by the acquisition thread.
+ *
+ * @param in_a		first raw interleaved PDM stream
+ * @param in_b		second raw interleaved PDM stream
+ * @param out_a		demultiplexed first stream
+ * @param out_b		demultiplexed second stream
+ * @param len		number of 16 bits words to process in each stream
+ */
+void pdm_demux_dual(const uint16_t *in_a, const uint16_t *in_b, uint16_t *out_a, uint16_t *out_b, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PDM_DEMUX_H */
@@ -723,10 +723,10 @@ static const melody_t melody[NB_SONGS] = {
 void playNote(uint16_t note, uint16_t duration_ms) {
 
 	if(note != 0){
-		dac_play(note);
+		audio_voice_tone(AUDIO_VOICE_MELODY, note);
 	}
 	chThdSleepMilliseconds(duration_ms);
-	dac_stop();
+	audio_voice_stop(AUDIO_VOICE_MELODY);
 }
 
 static THD_WORKING_AREA(waPlayMelodyThd, 128);
@@ -3,34 +3,53 @@
 File    : play_sound_file.c
 Authors : Eliot Ferragni, Stefano Morgani
 Date    : 4 October 2018
-REV 1.1
+REV 1.2
 
-Functions and defines to play sounds from the sd card in the uncompressed WAV format in signed 16bits 44,1kHz mono
+Functions and defines to play sounds from the sd card in the uncompressed WAV format (PCM 8 or 16 bits, mono or stereo)
 
 */
 
 
+#include <string.h>
 #include <fat.h>
 #include <audio/play_sound_file.h>
 #include <audio/audio_thread.h>
-#include <stdlib.h>
-
-#define SIZE_SOUND_BUFFER_16bits    256
-#define SIZE_WAV_HEADER_BYTES       44
-
-#define SAMPLING_44100HZ            44100
-
-//buffers to handle the data to play
-static uint16_t sound_buffer1[SIZE_SOUND_BUFFER_16bits];
-static uint16_t sound_buffer2[SIZE_SOUND_BUFFER_16bits];
+#include <audio/resampler.h>
+
+#define SF_READ_CHUNK           2048    // Bytes read at once from the card (4 sectors).
+#define SF_RING_SIZE            16384   // Bytes of the file read ahead (about 190 ms of 44.1 kHz stereo), multiple of SF_READ_CHUNK.
+#define SF_PREFILL              (SF_RING_SIZE / 2) // Bytes read before starting the voice.
+#define SF_SPACE_TIMEOUT        MS2ST(20)
+
+#define WAV_FORMAT_PCM          1
+#define WAV_MIN_FREQ            8000
+#define WAV_MAX_FREQ            48000
+
+//description of the samples found in the header of the file
+typedef struct {
+    uint16_t channels;
+    uint16_t bits;
+    uint32_t freq;
+    uint32_t data_start;    //offset in the file of the first sample
+    uint32_t data_end;      //offset in the file after the last sample
+} wav_format_t;
+
+//data of the file read ahead. The byte at the offset x of the file is stored at ring[x % SF_RING_SIZE],
+//so the reads of SF_READ_CHUNK bytes are aligned on the sectors and go directly from the card to the ring.
+static uint8_t ring[SF_RING_SIZE] __attribute__((aligned(4)));
+static volatile uint32_t ring_write = 0;    //offset in the file of the next byte to read from the card
+static volatile uint32_t ring_read = 0;     //offset in the file of the next byte to play
+static volatile bool reading_done = false;
+
+static wav_format_t wav;
+static resampler_t resampler;
 
 //conditional variable
 static MUTEX_DECL(play_sound_file_lock);
 static CONDVAR_DECL(play_sound_file_condvar);
 
-//semaphore to swap the buffer at the good time
-static BSEMAPHORE_DECL(change_buffer, true);
-static BSEMAPHORE_DECL(dac_stopped, true);
+//semaphore signaled by the mixer thread when it has consumed data of the ring
+static BSEMAPHORE_DECL(ring_space, true);
 
 //reference to play a music
 static thread_reference_t play_sound_file_ref = NULL;
@@ -38,79 +57,158 @@ static thread_reference_t play_sound_file_ref = NULL;
 //variable to handle the playing
 static bool play = false;
 static uint8_t sound_file_volume = DEFAULT_VOLUME;
-static uint32_t samp_freq = SAMPLING_44100HZ;
-static uint16_t wav_max_value = 0;
-static int32_t sample_conv_temp = 0;
-
-//variables to handle the buffers
-static uint16_t* buffer_to_read = NULL;
-static uint32_t size_buffer_to_read = 0;
+static uint32_t samp_freq = 0;
 
 //////////////////////////////////////////INTERNAL FUNCTIONS////////////////////////////////////
 
 /*
- * DAC end callback.
- * Called when the dac is at the middle of the output buffer and at the end
- * Used to swap the buffer to output
+ * Takes the next frame of the file from the ring and mixes its channels.
+ * Returns false if the ring doesn't contain a complete frame.
  */
-static void end_cb(DACDriver *dacp, const dacsample_t *buffer, size_t n) {
+static bool read_frame(int16_t *sample){
+    uint32_t pos = ring_read;
+    int32_t sum = 0;
 
-    (void)dacp;
-    (void)buffer;
-    (void)n;
+    if(ring_write - pos < wav.channels * (wav.bits / 8)){
+        return false;
+    }
 
-    //to quit the callback and do nothing if we are here because of the half transfer interrupt
-    //we only want the transfer finished interrupt
-    if(buffer == sound_buffer1 || buffer == sound_buffer2){
-        return;
+    for(uint8_t ch = 0 ; ch < wav.channels ; ch++){
+        if(wav.bits == 8){
+            //8 bits samples are unsigned
+            sum += ((int16_t)ring[pos % SF_RING_SIZE] - 128) << 8;
+            pos += 1;
+        }else{
+            sum += (int16_t)(ring[pos % SF_RING_SIZE] | (ring[(pos + 1) % SF_RING_SIZE] << 8));
+            pos += 2;
+        }
+    }
+    ring_read = pos;
+
+    *sample = sum / wav.channels;
+    return true;
+}
+
+/*
+ * Source of the sound file voice, called by the mixer thread.
+ * Gives the resampled data of the ring, less samples than asked if the card is late.
+ */
+static int32_t sound_file_source(int16_t *buf, uint16_t n, void *arg){
+    uint16_t i = 0;
+    int16_t sample = 0;
+    bool done = reading_done;
+
+    (void)arg;
+
+    //stops immediately if asked
+    if(!play){
+        return MIXER_SOURCE_END;
     }
 
-    //swaps the buffers to read
-    if(buffer_to_read == sound_buffer1){
-        buffer_to_read = sound_buffer2;
-    }else{
-        buffer_to_read = sound_buffer1;
+    for(i = 0 ; i < n ; i++){
+        while(resampler_needs_input(&resampler) && read_frame(&sample)){
+            resampler_push(&resampler, sample);
+        }
+        if(resampler_needs_input(&resampler)){
+            break;
+        }
+        buf[i] = resampler_output(&resampler);
+    }
+    chBSemSignal(&ring_space);
+
+    //end of the file if reading_done was set before the last data were consumed
+    if(i < n && done){
+        if(i == 0){
+            return MIXER_SOURCE_END;
+        }
+        for(; i < n ; i++){
+            buf[i] = 0;
+        }
+    }
+    return i;
+}
+
+/*
+ * Reads the RIFF header of the file and finds the format and the data chunks.
+ */
+static uint8_t read_wav_header(FIL *file, wav_format_t *format){
+    uint8_t header[16];
+    uint32_t chunk_size = 0;
+    UINT bytesRead = 0;
+    bool fmt_found = false;
+
+    if(f_read(file, header, 12, &bytesRead) != FR_OK || bytesRead != 12 ||
+        memcmp(header, "RIFF", 4) || memcmp(&header[8], "WAVE", 4)){
+        return SF_ERROR;
     }
 
-    //changes the buffer only if we have remaining data to send
-    chSysLockFromISR();
-    if(size_buffer_to_read){
-        //we need to be sure the number of sample is 1 or even. BUT NOT ODD !
-        //so in case of we simply remove 1
-        if(size_buffer_to_read > 1 && size_buffer_to_read%2){
-            size_buffer_to_read -= 1;
+    while(1){
+        if(f_read(file, header, 8, &bytesRead) != FR_OK || bytesRead != 8){
+            return SF_ERROR;
+        }
+        chunk_size = header[4] | (header[5] << 8) | (header[6] << 16) | ((uint32_t)header[7] << 24);
+
+        if(!memcmp(header, "fmt ", 4) && chunk_size >= 16){
+            if(f_read(file, header, 16, &bytesRead) != FR_OK || bytesRead != 16){
+                return SF_ERROR;
+            }
+            if((header[0] | (header[1] << 8)) != WAV_FORMAT_PCM){
+                return SF_ERROR;
+            }
+            format->channels = header[2] | (header[3] << 8);
+            format->freq = header[4] | (header[5] << 8) | (header[6] << 16) | ((uint32_t)header[7] << 24);
+            format->bits = header[14] | (header[15] << 8);
+            chunk_size -= 16;
+            fmt_found = true;
+        }else if(!memcmp(header, "data", 4)){
+            if(!fmt_found){
+                return SF_ERROR;
+            }
+            format->data_start = f_tell(file);
+            format->data_end = format->data_start + chunk_size;
+            //the size can be wrong if the recording was interrupted
+            if(format->data_end > f_size(file) || format->data_end < format->data_start){
+                format->data_end = f_size(file);
+            }
+            break;
         }
-        dac_change_bufferI(buffer_to_read, size_buffer_to_read, samp_freq);
-        //if we have less than the specified amount of data, it means we are at the end of the file
-        //thus we set the size to 0 to stop the dac at the next iteration.
-        if(size_buffer_to_read<SIZE_SOUND_BUFFER_16bits){
-            size_buffer_to_read = 0;
+
+        //skips the chunk, the chunks are aligned on 16 bits
+        if(f_lseek(file, f_tell(file) + chunk_size + (chunk_size & 1)) != FR_OK){
+            return SF_ERROR;
         }
-        ///tell the thread PlaySoundFileThd it can begin to fill the other buffer
-        chBSemSignalI(&change_buffer);
-    }else{
-        dac_stopI();
-        chBSemSignalI(&dac_stopped);
     }
-    chSysUnlockFromISR();
+
+    if(format->channels < 1 || format->channels > 2 || (format->bits != 8 && format->bits != 16) ||
+        format->freq < WAV_MIN_FREQ || format->freq > WAV_MAX_FREQ){
+        return SF_ERROR;
+    }
+    return SF_OK;
+}
+
+/*
+ * Starts the voice of the mixer playing the data read ahead.
+ */
+static void start_voice(void){
+    audio_voice_set_gain(AUDIO_VOICE_SOUND_FILE, (uint16_t)sound_file_volume * MIXER_GAIN_UNITY / VOLUME_MAX);
+    audio_voice_stream(AUDIO_VOICE_SOUND_FILE, sound_file_source, NULL);
 }
 
 /**
- * @brief Function to read a wav file stored on the sd card
+ * @brief Function to play a wav file stored on the sd card. Reads the file ahead in the ring
+ *        while the mixer thread converts it for the DAC.
  * 
  * @param pathToFile Path to the file to read.
- * @return [description]
+ * @return SF_OK if the voice has been started (it stops at the end of the file), SF_ERROR otherwise
  */
 uint8_t playWAVFile(char *pathToFile){
     FIL file;   /* file object */
     FRESULT err;
 
     UINT bytesRead = 0;
-    uint8_t first_time = 1;
-    uint16_t* buffer_to_fill = NULL;
-    uint16_t i = 0;
+    uint32_t size = 0;
+    bool started = false;
 
-    
     //Attempt to mount the drive.
     if(!mountSDCard()){
         return SF_ERROR;
@@ -122,93 +220,54 @@ uint8_t playWAVFile(char *pathToFile){
         return SF_ERROR;
     }
 
-    //initializes the pointers to the first buffer
-    buffer_to_read = sound_buffer1;
-    buffer_to_fill = sound_buffer1;
-
-    //flushes the header
-    //for now we don't care to read the header.
-    err = f_read(&file, buffer_to_fill, SIZE_WAV_HEADER_BYTES, &bytesRead);
-    if (err != FR_OK) {
+    if(read_wav_header(&file, &wav) != SF_OK ||
+        resampler_init(&resampler, samp_freq ? samp_freq : wav.freq, AUDIO_MIXER_FREQ)){
         f_close(&file);
         return SF_ERROR;
     }
 
-    // Find the max sample value (positive or negative) that will be used after to scale the sample to 12 bits for the DAC.
-    wav_max_value = 0;
-    do {
-        err = f_read(&file, buffer_to_fill, SIZE_SOUND_BUFFER_16bits*2, &bytesRead);
-        if (err != FR_OK) {
-            f_close(&file);
-            return SF_ERROR;
-        }
-        // "bytesRead" counts the bytes. We need to have the number of uint16 now.
-        size_buffer_to_read = bytesRead/2;
-        for(i = 0 ; i < size_buffer_to_read ; i++){
-        	if(abs((int16_t)buffer_to_fill[i]) > wav_max_value) {
-        		wav_max_value = abs((int16_t)buffer_to_fill[i]);
-        	}
-        }
-    } while(size_buffer_to_read >= SIZE_SOUND_BUFFER_16bits);
-    f_lseek(&file, SIZE_WAV_HEADER_BYTES); // Restart reading the wav data from the beginning, just after the header.
+    reading_done = false;
+    ring_read = wav.data_start;
+    ring_write = wav.data_start;
 
     //loop to read the file until we have no more data to read
-    do{
-        //to stop the reading
-        if(!play){
-            //stops the reading immediately
-            dac_stop();
-            break;
-        }
-
-        //reads the data from the sd card and store them in the correct buffer
-        err = f_read(&file, buffer_to_fill, SIZE_SOUND_BUFFER_16bits*2, &bytesRead);
-        if (err != FR_OK) {
-            f_close(&file);
-            return SF_ERROR;
+    while(play && ring_write < wav.data_end){
+        //reads until the next chunk boundary, thus aligned with the sectors once the first read is done
+        size = SF_READ_CHUNK - (ring_write % SF_READ_CHUNK);
+        if(size > wav.data_end - ring_write){
+            size = wav.data_end - ring_write;
         }
 
-        //bytesRead counts the bytes. We need to have the number of uint16 now
-        size_buffer_to_read = bytesRead/2;
-
-        // Converts the numbers read into the format needed by the DAC (=> signed 16bits to unsigned 12bits with volume control).
-        // The values are converted in such a way to exploit the full range of the DAC (100% volume), moreover it is applied the user volume.
-        // Beware that the audio will be multiplied by 5 in hardware before going to the speaker so with higher volumes there could be audio distortion.
-        for(i = 0 ; i < size_buffer_to_read ; i++){
-        	sample_conv_temp = (int16_t)buffer_to_fill[i]<<11;
-        	sample_conv_temp = (sample_conv_temp * sound_file_volume)/(wav_max_value*100) + 2048; // When volume is 100 then range is [0..4095].
-        	buffer_to_fill[i] = (uint16_t)(sample_conv_temp);
+        //waits the mixer consumes data if the ring is full
+        if(SF_RING_SIZE - (ring_write - ring_read) < size){
+            chBSemWaitTimeout(&ring_space, SF_SPACE_TIMEOUT);
+            continue;
         }
 
-        //wait the reading of a buffer is complete before filling it
-        //special case is at the beginning. Because we need to start the DAC and we already know
-        //we can fill the other buffer
-        if(first_time){
-            dac_play_buffer(buffer_to_read, size_buffer_to_read, samp_freq, end_cb);
-            // If the file is smaller than the available buffer then tell the callback to terminate the playing the first time
-            // is raised by setting "size_buffer_to_read" to zero.
-            if(size_buffer_to_read < SIZE_SOUND_BUFFER_16bits) {
-            	size_buffer_to_read = 0;
-            }
-            first_time = 0;
-        }else{
-            chBSemWait(&change_buffer);
+        err = f_read(&file, &ring[ring_write % SF_RING_SIZE], size, &bytesRead);
+        if (err != FR_OK || bytesRead == 0) {
+            //plays what has been read
+            break;
         }
+        ring_write += bytesRead;
 
-        //swaps the buffers to fill
-        if(buffer_to_fill == sound_buffer1){
-            buffer_to_fill = sound_buffer2;
-        }else{
-            buffer_to_fill = sound_buffer1;
+        if(!started && ring_write - wav.data_start >= SF_PREFILL){
+            start_voice();
+            started = true;
         }
+    }
+    reading_done = true;
 
-    }while(size_buffer_to_read >= SIZE_SOUND_BUFFER_16bits);
+    //short file
+    if(play && !started && ring_write > wav.data_start){
+        start_voice();
+        started = true;
+    }
 
     //closes the file.
     f_close(&file);
 
-    return SF_OK;
-
+    return started ? SF_OK : SF_ERROR;
 }
 
 static THD_WORKING_AREA(waPlaySoundFileThd, 1536);
@@ -227,7 +286,7 @@ static THD_FUNCTION(PlaySoundFileThd, arg) {
         chSysUnlock();
 
         if(playWAVFile(pathToFile) == SF_OK) {
-        	chBSemWait(&dac_stopped);
+        	audio_voice_wait(AUDIO_VOICE_SOUND_FILE);
         }
         play = false;
         //little delay otherwise there is a playback error sometime resulting in a disgracefull noise
@@ -308,6 +367,7 @@ void setSoundFileVolume(uint8_t volume){
 //    }
     
     sound_file_volume = volume;
+    audio_voice_set_gain(AUDIO_VOICE_SOUND_FILE, (uint16_t)volume * MIXER_GAIN_UNITY / VOLUME_MAX);
 }
 
 
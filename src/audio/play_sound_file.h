@@ -3,9 +3,9 @@
 File    : play_sound_file.h
 Author  : Eliot Ferragni, Stefano Morgani
 Date    : 4 October 2018
-REV 1.1
+REV 1.2
 
-Functions and defines to play sounds from the sd card in the uncompressed WAV format in signed 16bits 44,1kHz mono
+Functions and defines to play sounds from the sd card in the uncompressed WAV format (PCM 8 or 16 bits, mono or stereo)
 
 */
 
@@ -42,7 +42,8 @@ void playSoundFileStart(void);
  * 
  * @param pathToFile 	Path to the file on the sd card
  * @param option 		Behavior to change the sound file playing. (see play_melody_option_t)
- * @param freq			Playback frequency in Hz (e.g. 44100).
+ * @param freq			Sampling rate in Hz of the file, 0 to use the rate given in its header.
+ * 						The files are resampled to the rate of the mixer and the stereo files are mixed down to mono.
  */
 void playSoundFile(char* pathToFile, playSoundFileOption_t option, uint32_t freq);
 
@@ -0,0 +1,75 @@
+#include <math.h>
+#include <string.h>
+#include "resampler.h"
+
+#define COEFF_SHIFT		14
+#define CUTOFF_MARGIN	0.9f
+#define PHASE_SHIFT		10 // 16 - log2(RESAMPLER_PHASES)
+
+static inline int16_t saturate16(int32_t value) {
+	if(value > INT16_MAX) {
+		return INT16_MAX;
+	} else if(value < INT16_MIN) {
+		return INT16_MIN;
+	}
+	return value;
+}
+
+int8_t resampler_init(resampler_t *r, uint32_t in_freq, uint32_t out_freq) {
+	float cutoff;
+
+	if(in_freq == 0 || out_freq == 0 || in_freq > RESAMPLER_MAX_RATIO * out_freq) {
+		return -1;
+	}
+
+	memset(r, 0, sizeof(resampler_t));
+	r->step = ((uint64_t)in_freq << 16) / out_freq;
+	r->position = RESAMPLER_ONE; // Starts by asking for an input sample.
+
+	// Cut-off relative to the input Nyquist frequency, 1 gives a pure delay at phase 0.
+	if(in_freq == out_freq) {
+		cutoff = 1.0f;
+	} else if(in_freq > out_freq) {
+		cutoff = CUTOFF_MARGIN * out_freq / in_freq;
+	} else {
+		cutoff = CUTOFF_MARGIN;
+	}
+
+	for(uint8_t phase=0; phase<RESAMPLER_PHASES; phase++) {
+		float taps[RESAMPLER_TAPS];
+		float sum = 0;
+		for(uint8_t k=0; k<RESAMPLER_TAPS; k++) {
+			// Distance between the output sample and the input sample of the tap k (oldest first).
+			float x = RESAMPLER_TAPS/2 - 1 - k + (float)phase / RESAMPLER_PHASES;
+			float window = 0.42f + 0.5f*cosf(2*M_PI*x/RESAMPLER_TAPS) + 0.08f*cosf(4*M_PI*x/RESAMPLER_TAPS);
+			float sinc = (x == 0) ? 1.0f : sinf(M_PI*cutoff*x) / (M_PI*cutoff*x);
+			taps[k] = cutoff * sinc * window;
+			sum += taps[k];
+		}
+		// Unity gain at DC for every phase.
+		for(uint8_t k=0; k<RESAMPLER_TAPS; k++) {
+			r->coeffs[phase][k] = lroundf(taps[k] / sum * (1 << COEFF_SHIFT));
+		}
+	}
+	return 0;
+}
+
+void resampler_push(resampler_t *r, int16_t sample) {
+	r->history[r->pos] = sample;
+	r->history[r->pos + RESAMPLER_TAPS] = sample;
+	r->pos = (r->pos + 1) % RESAMPLER_TAPS;
+	r->position -= RESAMPLER_ONE;
+}
+
+int16_t resampler_output(resampler_t *r) {
+	const int16_t *window = &r->history[r->pos]; // Oldest sample first.
+	const int16_t *coeffs = r->coeffs[r->position >> PHASE_SHIFT];
+	int32_t acc = 1 << (COEFF_SHIFT - 1);
+
+	// The sum of the absolute values of the coefficients is below 2, no overflow possible.
+	for(uint8_t k=0; k<RESAMPLER_TAPS; k++) {
+		acc += window[k] * coeffs[k];
+	}
+	r->position += r->step;
+	return saturate16(acc >> COEFF_SHIFT);
+}
@@ -0,0 +1,67 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Sampling rate converter for a mono 16 bits stream, used to play the sound files at the DAC rate.
+ *
+ * Polyphase FIR: a windowed sinc (Blackman window) of RESAMPLER_TAPS taps is precomputed for
+ * RESAMPLER_PHASES fractional delays, each output sample uses the phase of its position between two input
+ * samples rounded down to 1/RESAMPLER_PHASES. The cut-off frequency is 0.9 x the lowest of the two Nyquist frequencies,
+ * so the filter is both the interpolation and the anti-aliasing filter. When the two rates are equal the
+ * filter is a pure delay of RESAMPLER_TAPS / 2 samples.
+ */
+
+#define RESAMPLER_TAPS			16
+#define RESAMPLER_PHASES		64
+#define RESAMPLER_MAX_RATIO		4	// The input rate can be at most 4 times the output rate.
+#define RESAMPLER_ONE			(1UL << 16)	// Distance between two input samples (Q16).
+
+typedef struct {
+	uint32_t step;			// Input samples per output sample (Q16).
+	uint32_t position;		// Position of the next output sample after the middle of the window (Q16).
+	uint8_t pos;			// Next slot of the history.
+	int16_t history[2*RESAMPLER_TAPS]; // Last input samples, stored twice to always have a contiguous window.
+	int16_t coeffs[RESAMPLER_PHASES][RESAMPLER_TAPS]; // Q14
+} resampler_t;
+
+/**
+ * @brief   Initializes the converter and computes its filter.
+ *
+ * @param r			converter to initialize
+ * @param in_freq	sampling rate of the input in Hz
+ * @param out_freq	sampling rate of the output in Hz
+ *
+ * @return			0 on success, -1 if the rates are not supported (see RESAMPLER_MAX_RATIO)
+ */
+int8_t resampler_init(resampler_t *r, uint32_t in_freq, uint32_t out_freq);
+
+/**
+ * @brief   Returns true if an input sample must be given with resampler_push before the next output
+ * 			sample can be computed.
+ */
+static inline bool resampler_needs_input(const resampler_t *r) {
+	return r->position >= RESAMPLER_ONE;
+}
+
+/**
+ * @brief   Adds an input sample.
+ */
+void resampler_push(resampler_t *r, int16_t sample);
+
+/**
+ * @brief   Computes the next output sample. resampler_needs_input must be false.
+ */
+int16_t resampler_output(resampler_t *r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RESAMPLER_H */
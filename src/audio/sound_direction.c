@@ -0,0 +1,137 @@
+#include <math.h>
+#include "ch.h"
+#include "hal.h"
+#include <main.h>
+#include "sound_direction.h"
+#include "microphone.h"
+#include "mic_metrics.h"
+#include "gcc_phat.h"
+
+#define SAMPLES_PER_MIC		(MIC_BUFFER_LEN / 4)
+// The zero padding must cover the maximum lag (a few samples).
+#define FFT_SIZE			(MP45DT02_PCM_FREQ <= 8000 ? 128 : (MP45DT02_PCM_FREQ <= 16000 ? 256 : 512))
+#define RAD_TO_DEG			(180.0f / 3.14159265f)
+
+static sound_direction_msg_t sound_direction_values;
+static bool sound_direction_configured = false;
+static thread_t *soundDirectionThd;
+
+static messagebus_topic_t sound_direction_topic;
+static MUTEX_DECL(sound_direction_topic_lock);
+static CONDVAR_DECL(sound_direction_topic_condvar);
+static bool sound_direction_topic_advertised = false;
+
+static gcc_phat_t gcc;
+static float32_t gcc_work[3*FFT_SIZE];
+
+/***************************INTERNAL FUNCTIONS************************************/
+
+static float clamp_unit(float value) {
+	if(value > 1) {
+		return 1;
+	} else if(value < -1) {
+		return -1;
+	}
+	return value;
+}
+
+ /**
+ * @brief   Thread which estimates the direction for each frame and publishes it
+ */
+static THD_WORKING_AREA(sound_direction_thd_wa, 1024);
+static THD_FUNCTION(sound_direction_thd, arg)
+{
+    (void) arg;
+    chRegSetThreadName(__FUNCTION__);
+
+    // The topic stays in the bus after a stop, it is advertised only once.
+    if(!sound_direction_topic_advertised) {
+    	messagebus_topic_init(&sound_direction_topic, &sound_direction_topic_lock, &sound_direction_topic_condvar, &sound_direction_values, sizeof(sound_direction_values));
+    	messagebus_advertise_topic(&bus, &sound_direction_topic, "/sound_direction");
+    	sound_direction_topic_advertised = true;
+    }
+
+    // Maximum delays in samples, one more sample is searched to let the interpolation find the border.
+    const float max_lr = SOUND_DIRECTION_LEFT_RIGHT_DIST / SOUND_DIRECTION_SPEED_OF_SOUND * MP45DT02_PCM_FREQ;
+    const float max_fb = SOUND_DIRECTION_FRONT_BACK_DIST / SOUND_DIRECTION_SPEED_OF_SOUND * MP45DT02_PCM_FREQ;
+    const uint16_t max_lag = (uint16_t)ceilf(max_lr > max_fb ? max_lr : max_fb) + 1;
+
+    mic_reader_t reader;
+    mic_metrics_t metrics[MIC_METRICS_CHANNELS];
+    mic_reader_init(&reader);
+
+    while (chThdShouldTerminateX() == false) {
+    	int16_t *frame = mic_reader_wait(&reader, MS2ST(100));
+    	if(frame == NULL) {
+    		continue;
+    	}
+
+    	mic_metrics_compute(frame, MIC_BUFFER_LEN, metrics);
+    	uint16_t min_rms = metrics[0].rms;
+    	for(uint8_t i=1; i<MIC_METRICS_CHANNELS; i++) {
+    		if(metrics[i].rms < min_rms) {
+    			min_rms = metrics[i].rms;
+    		}
+    	}
+
+    	if(min_rms < SOUND_DIRECTION_MIN_RMS) {
+    		sound_direction_values.valid = 0;
+    		sound_direction_values.confidence = 0;
+    	} else {
+    		float peak_lr, peak_fb;
+    		// Positive when the sound reaches the left (resp. front) microphone first.
+    		float delay_lr = gcc_phat_delay(&gcc, &frame[MIC_RIGHT], &frame[MIC_LEFT], SAMPLES_PER_MIC, 4, max_lag, &peak_lr);
+    		float delay_fb = gcc_phat_delay(&gcc, &frame[MIC_BACK], &frame[MIC_FRONT], SAMPLES_PER_MIC, 4, max_lag, &peak_fb);
+
+    		float y = clamp_unit(delay_lr / max_lr);
+    		float x = clamp_unit(delay_fb / max_fb);
+    		sound_direction_values.bearing = atan2f(y, x) * RAD_TO_DEG;
+    		sound_direction_values.confidence = clamp_unit(peak_lr < peak_fb ? peak_lr : peak_fb);
+    		if(sound_direction_values.confidence < 0) {
+    			sound_direction_values.confidence = 0;
+    		}
+    		sound_direction_values.valid = 1;
+    	}
+
+    	// The frame may have been overwritten during the computation, the result is then discarded.
+    	if(mic_reader_release(&reader)) {
+    		messagebus_topic_publish(&sound_direction_topic, &sound_direction_values, sizeof(sound_direction_values));
+    	}
+    }
+
+    mic_reader_stop(&reader);
+}
+
+/*************************END INTERNAL FUNCTIONS**********************************/
+
+
+/****************************PUBLIC FUNCTIONS*************************************/
+
+void sound_direction_start(void)
+{
+	if(sound_direction_configured) {
+		return;
+	}
+
+	if(gcc_phat_init(&gcc, FFT_SIZE, gcc_work) != 0) {
+		return;
+	}
+
+	sound_direction_values.bearing = 0;
+	sound_direction_values.confidence = 0;
+	sound_direction_values.valid = 0;
+
+	sound_direction_configured = true;
+	soundDirectionThd = chThdCreateStatic(sound_direction_thd_wa, sizeof(sound_direction_thd_wa), NORMALPRIO, sound_direction_thd, NULL);
+}
+
+void sound_direction_stop(void) {
+	if(sound_direction_configured) {
+		chThdTerminate(soundDirectionThd);
+		chThdWait(soundDirectionThd);
+		soundDirectionThd = NULL;
+		sound_direction_configured = false;
+	}
+}
+
+/**************************END PUBLIC FUNCTIONS***********************************/
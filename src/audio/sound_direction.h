@@ -0,0 +1,51 @@
+#ifndef SOUND_DIRECTION_H
+#define SOUND_DIRECTION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/**
+ * Direction of the dominant sound source, estimated every 10 ms frame from the time difference of
+ * arrival between the left/right and the back/front microphones (see gcc_phat.h).
+ * The microphones must be started with mic_start beforehand.
+ */
+
+/* Distances between the microphones in meters (measured on the PCB, approximate). */
+#define SOUND_DIRECTION_LEFT_RIGHT_DIST		0.060f
+#define SOUND_DIRECTION_FRONT_BACK_DIST		0.050f
+#define SOUND_DIRECTION_SPEED_OF_SOUND		343.0f
+
+/* Frames quieter than this RMS value on one of the microphones are reported as not valid. */
+#define SOUND_DIRECTION_MIN_RMS				50
+
+/** Struct containing a sound direction message. */
+typedef struct {
+	/** Bearing of the source in degrees: 0 = front, 90 = left, -90 = right, +-180 = back. */
+	float bearing;
+
+	/** Quality of the estimation between 0 (no correlation) and 1 (single source, no noise). */
+	float confidence;
+
+	/** 0 if the frame was too quiet to estimate a direction, 1 otherwise. */
+	uint8_t valid;
+} sound_direction_msg_t;
+
+ /**
+ * @brief   Starts the estimation thread.
+ * 			It broadcasts a sound_direction_msg_t message on the /sound_direction topic for every frame.
+ */
+void sound_direction_start(void);
+
+/**
+* @brief   Stops the estimation thread.
+*/
+void sound_direction_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SOUND_DIRECTION_H */
@@ -8,6 +8,7 @@
 #include "po6030.h"
 #include "ov7670.h"
 #include "dcmi_camera.h"
+#include "pixel_convert.h"
 
 #define CAM_PO8030 0
 #define CAM_PO6030 1
@@ -123,6 +124,30 @@ uint32_t cam_get_mem_required(void) {
 	}
 }
 
+uint16_t cam_get_image_width(void) {
+	if(curr_cam == CAM_PO8030) {
+		return po8030_get_image_width();
+	} else if(curr_cam == CAM_PO6030) {
+		return po6030_get_image_width();
+	} else if(curr_cam == CAM_OV7670) {
+		return ov7670_get_image_width();
+	} else {
+		return 0;
+	}
+}
+
+uint16_t cam_get_image_height(void) {
+	if(curr_cam == CAM_PO8030) {
+		return po8030_get_image_height();
+	} else if(curr_cam == CAM_PO6030) {
+		return po6030_get_image_height();
+	} else if(curr_cam == CAM_OV7670) {
+		return ov7670_get_image_height();
+	} else {
+		return 0;
+	}
+}
+
 int8_t cam_advanced_config(format_t fmt, unsigned int x1, unsigned int y1,
                                 unsigned int width, unsigned int height,
 								subsampling_t subsampling_x, subsampling_t subsampling_y) {
@@ -256,14 +281,10 @@ uint16_t cam_get_id(void) {
 
 uint8_t* cam_get_last_image_ptr(void) {
 	uint8_t *last_img_ptr = dcmi_get_last_image_ptr();
-	uint16_t i = 0, j = 0;
-	if((curr_cam == CAM_OV7670) && (curr_format==FORMAT_GREYSCALE)) {
-		// Manually perform RGB565 to greyscale conversion because the OV7670 camera doesn't support this format.
-		// It is actually kind of a hack, not an actual conversion, it simply takes 1 byte out of 2, that is only R5G3 are used for
-		// greyscale representation.
-		for(i=0, j=0; i<cam_get_mem_required(); i+=2, j++) {
-			last_img_ptr[j] = last_img_ptr[i];
-		}
+	if((last_img_ptr != NULL) && (curr_cam == CAM_OV7670) && (curr_format==FORMAT_GREYSCALE)) {
+		// The OV7670 camera doesn't support the greyscale format, the RGB565 image is converted in place:
+		// the greyscale image uses the first half of the buffer.
+		pixel_rgb565_to_grey(last_img_ptr, last_img_ptr, cam_get_image_size());
 	}
 	return last_img_ptr;
 }
@@ -26,6 +26,8 @@ void cam_start(void);
 int8_t cam_config(format_t fmt, image_size_t imgsize);
 uint32_t cam_get_image_size(void);
 uint32_t cam_get_mem_required(void);
+uint16_t cam_get_image_width(void);
+uint16_t cam_get_image_height(void);
 int8_t cam_advanced_config(format_t fmt, unsigned int x1, unsigned int y1,
                                 unsigned int width, unsigned int height,
 								subsampling_t subsampling_x, subsampling_t subsampling_y);
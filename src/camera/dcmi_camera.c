@@ -28,6 +28,20 @@ static uint8_t half_transfer_complete = 0;
 static uint8_t buff0_busy = 0;
 static uint8_t buff1_busy = 0;
 
+//strip mode: the DMA fills image_buff in a circular manner with two strips of strip_lines lines
+static dcmi_strip_cb_t strip_cb = NULL;
+static void *strip_arg = NULL;
+static uint16_t strip_lines = 0;
+static uint16_t strips_per_frame = 0;
+static uint32_t strip_bytes = 0;
+static volatile uint32_t strips_received = 0;
+static volatile uint32_t strip_overruns = 0;
+static thread_t *stripThd = NULL;
+
+//mailbox of the strips to process, each message is (strip number << 1) | half of the buffer
+static msg_t strip_mb_buf[DCMI_STRIP_QUEUE];
+static MAILBOX_DECL(strip_mb, strip_mb_buf, DCMI_STRIP_QUEUE);
+
 //conditional variable
 static MUTEX_DECL(dcmi_lock);
 static CONDVAR_DECL(dcmi_condvar);
@@ -43,9 +57,28 @@ void frameEndCb(DCMIDriver* dcmip) {
 	chSysUnlockFromISR();
 }
 
+/*
+ * Called by the DMA callbacks in strip mode when a half of the buffer has been filled.
+ * The strip is given to the strip thread.
+ */
+static void strip_completeI(uint8_t half) {
+	msg_t msg = (msg_t)((strips_received << 1) | half);
+
+	strips_received++;
+	chSysLockFromISR();
+	if(chMBPostI(&strip_mb, msg) != MSG_OK) {
+		strip_overruns++; // The strip thread is late by more than a strip, this one is lost.
+	}
+	chSysUnlockFromISR();
+}
+
 // This is called at each DMA transfer completion that correspond to a frame end.
 void dmaTransferEndCb(DCMIDriver* dcmip) {
    (void) dcmip;
+   if(strip_cb != NULL) {
+	   strip_completeI(1);
+	   return;
+   }
     //palTogglePad(GPIOD, 15); // Blue.
 	//osalEventBroadcastFlagsI(&ss_event, 0);
    half_transfer_complete = 0;
@@ -54,6 +87,11 @@ void dmaTransferEndCb(DCMIDriver* dcmip) {
 void dmaHalfTransferEndCb(DCMIDriver* dcmip) {
 	(void) dcmip;
 
+	if(strip_cb != NULL) {
+		strip_completeI(0);
+		return;
+	}
+
 	half_transfer_complete = 1;
 
 	// At the "half transfer callback" we can change the destination memory for the next frame based on the current state.
@@ -118,6 +156,36 @@ void dcmiErrorCb(DCMIDriver* dcmip, dcmierror_t err) {
 	chSysUnlockFromISR();
 }
 
+/*
+ * Thread calling the strip callback for each strip filled by the DMA.
+ */
+static THD_WORKING_AREA(dcmi_strip_thd_wa, 1024);
+static THD_FUNCTION(dcmi_strip_thd, arg) {
+
+	chRegSetThreadName(__FUNCTION__);
+	(void)arg;
+
+	msg_t msg;
+
+	while(1) {
+		chMBFetch(&strip_mb, &msg, TIME_INFINITE);
+
+		uint32_t strip = (uint32_t)msg >> 1;
+		uint8_t half = msg & 1;
+		dcmi_strip_cb_t cb = strip_cb;
+		if(cb == NULL) {
+			continue;
+		}
+
+		cb(image_buff0 + half * strip_bytes, (strip % strips_per_frame) * strip_lines, strip_lines, strip_arg);
+
+		// The DMA already writes again in this half if the next strip has also been received.
+		if(strips_received - strip >= 2) {
+			strip_overruns++;
+		}
+	}
+}
+
 /**
 * @brief   Captures a single frame from the DCMI.
 * @details This asynchronous function starts a single shot receive operation.
@@ -183,6 +251,7 @@ int8_t dcmi_prepare(void) {
 	if(dcmi_prepared == 1) {
 		dcmiUnprepare(&DCMID);
 	}
+	strip_cb = NULL;
 	// Check if image size fit in the available memory.
 	uint32_t image_size = cam_get_mem_required();
 	if(double_buffering == 0) {
@@ -204,6 +273,46 @@ int8_t dcmi_prepare(void) {
 	return 0;
 }
 
+int8_t dcmi_prepare_strips(uint16_t lines, dcmi_strip_cb_t cb, void *arg) {
+	uint16_t height = cam_get_image_height();
+
+	if(cb == NULL || lines == 0 || height == 0 || (height % lines) != 0) {
+		return -1;
+	}
+	// Both strips must fit in the memory and the half transfer must fall between the strips.
+	uint32_t bytes = (cam_get_mem_required() / height) * lines;
+	if(2 * bytes > MAX_BUFF_SIZE || (bytes % 4) != 0) {
+		return -1;
+	}
+
+	if(dcmi_prepared == 1) {
+		dcmiUnprepare(&DCMID);
+	}
+
+	strip_cb = cb;
+	strip_arg = arg;
+	strip_lines = lines;
+	strips_per_frame = height / lines;
+	strip_bytes = bytes;
+	strip_overruns = 0;
+	chMBReset(&strip_mb);
+
+	if(stripThd == NULL) {
+		stripThd = chThdCreateStatic(dcmi_strip_thd_wa, sizeof(dcmi_strip_thd_wa), NORMALPRIO + 3, dcmi_strip_thd, NULL);
+	}
+
+	// Single buffer in circular mode, the half and full transfers delimit the strips.
+	dcmiPrepare(&DCMID, &dcmicfg, 2 * bytes, (uint32_t*)image_buff0, NULL);
+
+	dcmi_prepared = 1;
+
+	return 0;
+}
+
+uint32_t dcmi_get_strip_overruns(void) {
+	return strip_overruns;
+}
+
 void dcmi_unprepare(void) {
 	if(dcmi_prepared == 1) {
 		dcmiUnprepare(&DCMID);
@@ -361,6 +470,7 @@ void dcmi_capture_start(void) {
 
 	buff0_busy = 0;
 	buff1_busy = 0;
+	strips_received = 0;
 
 	if(capture_mode == CAPTURE_ONE_SHOT) {
 		dcmi_start_one_shot(&DCMID);
@@ -395,7 +505,11 @@ void dcmi_release(void) {
 
 void dcmi_restart(void) {
 	dcmi_release();
-	dcmi_prepare();
+	if(strip_cb != NULL) {
+		dcmi_prepare_strips(strip_lines, strip_cb, strip_arg);
+	} else {
+		dcmi_prepare();
+	}
 }
 
 void dcmi_reset_error(void) {
@@ -9,11 +9,23 @@
 #define MAX_BUFF_SIZE 38400 // Single buffer mode supporting up to a QQVGA color image.
 //#define MAX_BUFF_SIZE 76800 // When using double-buffering: this means 2 color QQVGA images: (160x120x2)x2; or a single greyscale QVGA image: 320x240.
 
+#define DCMI_STRIP_QUEUE 2 // Strips waiting to be processed, more would be overwritten by the DMA anyway.
+
 typedef enum {
 	CAPTURE_ONE_SHOT = 0,
 	CAPTURE_CONTINUOUS = 1
 } capture_mode_t;
 
+/**
+ * @brief 		Function processing a strip of the image in strip mode (see dcmi_prepare_strips).
+ *
+ * @param strip			first byte of the strip, the lines follow each other in the format of the camera
+ * @param first_line	number in the frame of the first line of the strip
+ * @param lines			number of lines of the strip
+ * @param arg			argument given to dcmi_prepare_strips
+ */
+typedef void (*dcmi_strip_cb_t)(const uint8_t *strip, uint16_t first_line, uint16_t lines, void *arg);
+
 /**
  * @brief 		DCMI Driver initialization and image memory allocation.
  *
@@ -39,6 +51,35 @@ int8_t dcmi_start(void);
  */
 int8_t dcmi_prepare(void);
 
+/**
+ * @brief   Configures the DCMI peripheral in strip mode.
+ * @details Instead of whole frames, the DMA fills in a circular manner a buffer of two strips of "lines"
+ *          lines. Each time a strip is complete (half and full transfer), the callback is called by a
+ *          high priority thread while the DMA fills the other strip. This lets the images larger than
+ *          MAX_BUFF_SIZE (up to VGA) be processed line by line in constant memory, without storing them.
+ *          The callback must return before the DMA comes back to its strip, that is within the time of
+ *          "lines" lines, otherwise the strip is counted as an overrun (see dcmi_get_strip_overruns).
+ *          The capture is then started and stopped with dcmi_capture_start and dcmi_capture_stop as for
+ *          the frames, and dcmi_prepare goes back to the frame mode.
+ * @note    Double buffering is not used in this mode. The buffer of dcmi_get_first_buffer_ptr holds the strips.
+ *
+ * @param lines		lines of each strip, the image height must be a multiple of it
+ * @param cb		function processing the strips
+ * @param arg		argument given to the callback
+ *
+ * @return		The operation status.
+ * @retval 0	if the function succeeded.
+ * @retval -1	if the strips cannot fit in memory (2 strips of MAX_BUFF_SIZE/2 bytes at most, each a multiple
+ * 				of 4 bytes) or the height isn't a multiple of the lines.
+ */
+int8_t dcmi_prepare_strips(uint16_t lines, dcmi_strip_cb_t cb, void *arg);
+
+/**
+ * @brief 		Returns the number of strips not processed in time since dcmi_prepare_strips.
+ *
+ */
+uint32_t dcmi_get_strip_overruns(void);
+
 /**
  * @brief Deactivates the DCMI peripheral.
  * @details This function disables the DCMI and related interrupts; also the DMA is released.
@@ -0,0 +1,258 @@
+#include <stdbool.h>
+#include <string.h>
+#include "image_codec.h"
+
+#define QOI_INDEX		0x00
+#define QOI_DIFF		0x40
+#define QOI_LUMA		0x80
+#define QOI_RUN			0xC0
+#define QOI_PIXEL		0xFE
+#define QOI_MAX_RUN		62
+
+#define GREY_SINGLE		0x00
+#define GREY_RUN		0x40
+#define GREY_PAIR		0x80
+#define GREY_ESCAPE		0xC0
+#define GREY_MAX_RUN	64
+#define GREY_NO_PENDING	0x7F	// Not a residual of a pair.
+
+static void emit(image_codec_t *c, uint8_t byte) {
+	c->size++;
+	if(c->write == NULL) {
+		return;
+	}
+	c->out[c->out_len++] = byte;
+	if(c->out_len == IMAGE_CODEC_CHUNK) {
+		c->write(c->out, c->out_len, c->arg);
+		c->out_len = 0;
+	}
+}
+
+static void flush(image_codec_t *c) {
+	if(c->write != NULL && c->out_len > 0) {
+		c->write(c->out, c->out_len, c->arg);
+		c->out_len = 0;
+	}
+}
+
+/* Signed difference of two components of "bits" bits, modulo 2^bits. */
+static inline int8_t wrap_diff(uint8_t a, uint8_t b, uint8_t bits) {
+	int8_t d = (a - b) & ((1 << bits) - 1);
+	return d >= (1 << (bits - 1)) ? d - (1 << bits) : d;
+}
+
+static void encode_qoi565(image_codec_t *c, const uint8_t *image, uint32_t pixels) {
+	uint16_t prev = 0;
+	uint8_t run = 0;
+
+	memset(c->index, 0, sizeof(c->index));
+	for(uint32_t i=0; i<pixels; i++) {
+		uint16_t px = ((uint16_t)image[2*i] << 8) | image[2*i+1];
+
+		if(px == prev) {
+			if(++run == QOI_MAX_RUN) {
+				emit(c, QOI_RUN | (run - 1));
+				run = 0;
+			}
+			continue;
+		}
+		if(run > 0) {
+			emit(c, QOI_RUN | (run - 1));
+			run = 0;
+		}
+
+		uint8_t r = px >> 11, g = (px >> 5) & 0x3F, b = px & 0x1F;
+		uint8_t hash = (3*r + 5*g + 7*b) & 0x3F;
+		if(c->index[hash] == px) {
+			emit(c, QOI_INDEX | hash);
+		} else {
+			c->index[hash] = px;
+			int8_t dr = wrap_diff(r, prev >> 11, 5);
+			int8_t dg = wrap_diff(g, (prev >> 5) & 0x3F, 6);
+			int8_t db = wrap_diff(b, prev & 0x1F, 5);
+			int8_t dr_dg = dr - (dg >> 1);
+			int8_t db_dg = db - (dg >> 1);
+
+			if(dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+				emit(c, QOI_DIFF | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2));
+			} else if(dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+				emit(c, QOI_LUMA | (dg + 32));
+				emit(c, ((dr_dg + 8) << 4) | (db_dg + 8));
+			} else {
+				emit(c, QOI_PIXEL);
+				emit(c, px >> 8);
+				emit(c, px & 0xFF);
+			}
+		}
+		prev = px;
+	}
+	if(run > 0) {
+		emit(c, QOI_RUN | (run - 1));
+	}
+}
+
+/* Median predictor of LOCO-I. */
+static inline uint8_t predict(uint8_t a, uint8_t b, uint8_t c) {
+	uint8_t max = a > b ? a : b;
+	uint8_t min = a > b ? b : a;
+	if(c >= max) {
+		return min;
+	}
+	if(c <= min) {
+		return max;
+	}
+	return a + b - c;
+}
+
+static void emit_grey_single(image_codec_t *c, int8_t e) {
+	if(e >= -32 && e <= 31) {
+		emit(c, GREY_SINGLE | (e & 0x3F));
+	} else {
+		emit(c, GREY_ESCAPE);
+		emit(c, (uint8_t)e);
+	}
+}
+
+static void encode_grey_delta(image_codec_t *c, const uint8_t *image, uint16_t width, uint16_t height, uint8_t near) {
+	int16_t step = 2 * near + 1;
+	int8_t pending = GREY_NO_PENDING;
+	uint8_t run = 0;
+
+	for(uint16_t y=0; y<height; y++) {
+		uint8_t *cur = c->lines[y & 1];
+		const uint8_t *prev = c->lines[(y & 1) ^ 1];
+
+		for(uint16_t x=0; x<width; x++) {
+			uint8_t pred;
+			if(y == 0) {
+				pred = x == 0 ? 128 : cur[x-1];
+			} else if(x == 0) {
+				pred = prev[0];
+			} else {
+				pred = predict(cur[x-1], prev[x], prev[x-1]);
+			}
+
+			int16_t err = (int16_t)image[(uint32_t)y * width + x] - pred;
+			int8_t e;
+			if(near == 0) {
+				e = (int8_t)(uint8_t)err;
+				cur[x] = image[(uint32_t)y * width + x];
+			} else {
+				int16_t q = err > 0 ? (near + err) / step : -((near - err) / step);
+				int16_t value = pred + q * step;
+				e = q;
+				cur[x] = value < 0 ? 0 : (value > 255 ? 255 : value);
+			}
+
+			// Runs of zeros, pairs of small residuals, single residuals.
+			if(e == 0 && pending == GREY_NO_PENDING) {
+				if(++run == GREY_MAX_RUN) {
+					emit(c, GREY_RUN | (run - 1));
+					run = 0;
+				}
+				continue;
+			}
+			if(run > 0) {
+				emit(c, GREY_RUN | (run - 1));
+				run = 0;
+			}
+			bool small = e >= -4 && e <= 3;
+			if(pending != GREY_NO_PENDING) {
+				if(small) {
+					emit(c, GREY_PAIR | ((pending + 4) << 3) | (e + 4));
+					pending = GREY_NO_PENDING;
+					continue;
+				}
+				emit_grey_single(c, pending);
+				pending = GREY_NO_PENDING;
+			}
+			if(small) {
+				pending = e;
+			} else {
+				emit_grey_single(c, e);
+			}
+		}
+	}
+	if(run > 0) {
+		emit(c, GREY_RUN | (run - 1));
+	}
+	if(pending != GREY_NO_PENDING) {
+		emit_grey_single(c, pending);
+	}
+}
+
+/*
+ * Encodes the payload, only counts its size when write is NULL.
+ */
+static void encode(image_codec_t *c, const image_codec_header_t *header, const uint8_t *image,
+					image_codec_write_t write, void *arg) {
+	c->write = write;
+	c->arg = arg;
+	c->out_len = 0;
+	c->size = 0;
+
+	switch(header->codec) {
+		case IMAGE_CODEC_QOI565:
+			encode_qoi565(c, image, (uint32_t)header->width * header->height);
+			break;
+		case IMAGE_CODEC_GREY_DELTA:
+			encode_grey_delta(c, image, header->width, header->height, header->near);
+			break;
+		default:
+			c->size = (uint32_t)header->width * header->height * header->format;
+			if(write != NULL) {
+				write(image, c->size, arg);
+			}
+			break;
+	}
+	flush(c);
+}
+
+/****************************PUBLIC FUNCTIONS*************************************/
+
+uint8_t image_codec_select(uint8_t accepted, pixel_format_t format) {
+	if(format == PIXEL_FORMAT_RGB565 && (accepted & IMAGE_CODEC_MASK(IMAGE_CODEC_QOI565))) {
+		return IMAGE_CODEC_QOI565;
+	}
+	if(format == PIXEL_FORMAT_GREYSCALE && (accepted & IMAGE_CODEC_MASK(IMAGE_CODEC_GREY_DELTA))) {
+		return IMAGE_CODEC_GREY_DELTA;
+	}
+	return IMAGE_CODEC_RAW;
+}
+
+void image_codec_prepare(image_codec_t *c, image_codec_header_t *header, const uint8_t *image,
+						uint16_t width, uint16_t height, pixel_format_t format,
+						uint8_t codec, uint8_t near, uint16_t frame) {
+	uint32_t raw_size = (uint32_t)width * height * format;
+
+	memcpy(header->magic, IMAGE_CODEC_MAGIC, sizeof(header->magic));
+	header->format = format;
+	header->width = width;
+	header->height = height;
+	header->reserved = 0;
+	header->frame = frame;
+	header->near = 0;
+
+	if((codec == IMAGE_CODEC_QOI565 && format == PIXEL_FORMAT_RGB565) ||
+			(codec == IMAGE_CODEC_GREY_DELTA && format == PIXEL_FORMAT_GREYSCALE && width <= IMAGE_CODEC_MAX_WIDTH)) {
+		header->codec = codec;
+		if(codec == IMAGE_CODEC_GREY_DELTA) {
+			header->near = near > IMAGE_CODEC_MAX_NEAR ? IMAGE_CODEC_MAX_NEAR : near;
+		}
+		encode(c, header, image, NULL, NULL);
+		if(c->size < raw_size) {
+			header->size = c->size;
+			return;
+		}
+	}
+	header->codec = IMAGE_CODEC_RAW;
+	header->near = 0;
+	header->size = raw_size;
+}
+
+void image_codec_encode(image_codec_t *c, const image_codec_header_t *header, const uint8_t *image,
+						image_codec_write_t write, void *arg) {
+	encode(c, header, image, write, arg);
+}
+
+/**************************END PUBLIC FUNCTIONS***********************************/
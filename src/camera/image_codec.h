@@ -0,0 +1,133 @@
+#ifndef IMAGE_CODEC_H
+#define IMAGE_CODEC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "pixel_convert.h"
+
+/**
+ * Compression of the camera images sent to the ESP32 (SPI) and through Asercom2.
+ *
+ * A frame is a image_codec_header_t followed by "size" bytes of payload. The codec is chosen for each link
+ * among the ones accepted by the receiver (see image_codec_select), the raw codec is always accepted and
+ * is used instead of the others when they don't reduce the size of the image.
+ *
+ * IMAGE_CODEC_RAW: the pixels as sent by the camera.
+ *
+ * IMAGE_CODEC_QOI565: lossless codec for RGB565, adapted from QOI ("Quite OK Image" format) to the
+ * 5/6/5 bits components. The pixels are coded in raster order from a previous pixel starting at 0,
+ * with an index of 64 pixels seen (hash = (3 R + 5 G + 7 B) % 64, starting with zeros):
+ * 	00iiiiii				pixel of the index i
+ * 	01rrggbb				dr, dg and db in -2..1 (+2), differences with the previous pixel modulo 32/64/32
+ * 	10gggggg rrrrbbbb		dg in -32..31 (+32), dr - dg/2 and db - dg/2 in -8..7 (+8), dg/2 rounded down
+ * 	11rrrrrr				run of r + 1 previous pixels, 1..62
+ * 	11111110 hhhhhhhh llllllll	pixel (big endian)
+ *
+ * IMAGE_CODEC_GREY_DELTA: lossless or near-lossless codec for greyscale. Each pixel is predicted from its
+ * left (a), upper (b) and upper left (c) neighbours with the median predictor of LOCO-I:
+ * min(a, b) if c >= max(a, b), max(a, b) if c <= min(a, b), a + b - c otherwise. On the first line
+ * b = c = a, on the first column a = b of the previous line and c = b, and the first pixel is predicted as 128.
+ * When near is 0 the residual e is the pixel minus the prediction modulo 256 (seen as a signed byte). Otherwise
+ * e is the error quantized by steps of 2 near + 1 and the pixel is rebuilt as the prediction plus e x (2 near + 1),
+ * saturated to 0..255, so each pixel differs from the original one by near at most. The prediction uses
+ * the rebuilt pixels. The residuals are coded in raster order:
+ * 	00eeeeee				e in -32..31 (two's complement)
+ * 	01rrrrrr				run of r + 1 residuals equal to 0, 1..64
+ * 	10aaabbb				two residuals a and b in -4..3 (+4)
+ * 	11000000 eeeeeeee		any residual
+ *
+ * See python_scripts/decode_image.py for a decoder.
+ */
+
+#define IMAGE_CODEC_RAW			0
+#define IMAGE_CODEC_QOI565		1
+#define IMAGE_CODEC_GREY_DELTA	2
+#define IMAGE_CODEC_MASK(codec)	(1 << (codec))
+
+#define IMAGE_CODEC_MAGIC		"EI"
+#define IMAGE_CODEC_HEADER_SIZE	16
+#define IMAGE_CODEC_MAX_WIDTH	640
+#define IMAGE_CODEC_MAX_NEAR	16
+#define IMAGE_CODEC_CHUNK		64		// Bytes of payload given at once to the write function.
+
+/** Header of each frame (little endian). */
+typedef struct __attribute__((packed)) {
+	char magic[2];			// IMAGE_CODEC_MAGIC
+	uint8_t codec;			// IMAGE_CODEC_RAW, IMAGE_CODEC_QOI565 or IMAGE_CODEC_GREY_DELTA
+	uint8_t format;			// pixel_format_t, also the bytes per pixel
+	uint16_t width;
+	uint16_t height;
+	uint8_t near;			// Largest error of a pixel, 0 when lossless.
+	uint8_t reserved;
+	uint16_t frame;			// Incremented at each frame by the sender, to detect the frames lost.
+	uint32_t size;			// Bytes of payload following the header.
+} image_codec_header_t;
+
+ /**
+ * @brief   Function receiving the encoded bytes.
+ *
+ * @param data	bytes of the payload, the raw pixels can be given at once
+ * @param len	number of bytes
+ * @param arg	argument given to image_codec_encode
+ */
+typedef void (*image_codec_write_t)(const uint8_t *data, uint32_t len, void *arg);
+
+typedef struct {
+	uint8_t lines[2][IMAGE_CODEC_MAX_WIDTH];	// Rebuilt pixels of the current and previous lines (greyscale).
+	uint16_t index[64];						// Pixels seen (QOI565).
+	uint8_t out[IMAGE_CODEC_CHUNK];
+	uint8_t out_len;
+	uint32_t size;
+	image_codec_write_t write;
+	void *arg;
+} image_codec_t;
+
+ /**
+ * @brief   Returns the best codec for the format among the accepted ones.
+ *
+ * @param accepted	mask of the codecs accepted by the receiver (IMAGE_CODEC_MASK)
+ * @param format	format of the images
+ *
+ * @return			codec to give to image_codec_prepare, IMAGE_CODEC_RAW if none is accepted
+ */
+uint8_t image_codec_select(uint8_t accepted, pixel_format_t format);
+
+ /**
+ * @brief   Fills the header of a frame, the size of the payload is computed by encoding the image once
+ * 			without output. The raw codec is used instead of the one given if the payload isn't smaller.
+ *
+ * @param c			state of the encoder
+ * @param header	header to fill
+ * @param image		pixels of the image
+ * @param width		pixels per line, at most IMAGE_CODEC_MAX_WIDTH
+ * @param height	number of lines
+ * @param format	format of the pixels
+ * @param codec		codec wanted, it must support the format
+ * @param near		largest error of a pixel for IMAGE_CODEC_GREY_DELTA (0 for lossless, at most IMAGE_CODEC_MAX_NEAR)
+ * @param frame		number of the frame
+ */
+void image_codec_prepare(image_codec_t *c, image_codec_header_t *header, const uint8_t *image,
+						uint16_t width, uint16_t height, pixel_format_t format,
+						uint8_t codec, uint8_t near, uint16_t frame);
+
+ /**
+ * @brief   Encodes the payload of a frame prepared with image_codec_prepare, the header isn't written.
+ *
+ * @param c			state of the encoder
+ * @param header	header of the frame
+ * @param image		pixels of the image, the same as given to image_codec_prepare
+ * @param write		function receiving the payload in chunks of IMAGE_CODEC_CHUNK bytes at most
+ * 					(the raw pixels are given at once)
+ * @param arg		argument given to the write function
+ */
+void image_codec_encode(image_codec_t *c, const image_codec_header_t *header, const uint8_t *image,
+						image_codec_write_t write, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IMAGE_CODEC_H */
@@ -168,55 +168,23 @@ static bool cam_configured = false;
 
 int16_t ov7670_write_reg(uint8_t addr, uint8_t reg, uint8_t value) {
 	uint8_t txbuf[2] = {reg, value};
+	i2c_transaction_t t;
 
-	i2cAcquireBus(&I2CD1);
-	if(I2CD1.state != I2C_STOP) {
-		msg_t status = i2cMasterTransmitTimeout(&I2CD1, addr, txbuf, 2, 0, 0, MS2ST(50));
-		if (status != MSG_OK){
-			i2c_update_last_error();
-			if(I2CD1.state == I2C_LOCKED){
-				i2c_stop();
-				i2c_start();
-			}
-			i2cReleaseBus(&I2CD1);
-			return status;
-		}
-	}
-	i2cReleaseBus(&I2CD1);
-
-    return MSG_OK;
+	i2c_transaction_init(&t, addr, txbuf, 2, NULL, 0);
+	t.timeout = MS2ST(50);
+	return i2c_transfer(&t);
 }
 
 int8_t ov7670_read_reg(uint8_t addr, uint8_t reg, uint8_t *value) {
 
 	uint8_t txbuf[1] = {reg};
+	i2c_transaction_t t;
 
-	i2cAcquireBus(&I2CD1);
-	if(I2CD1.state != I2C_STOP) {
-		msg_t status = i2cMasterTransmitTimeout(&I2CD1, addr, txbuf, 1, 0, 0, MS2ST(50));
-		if (status != MSG_OK){
-			i2c_update_last_error();
-			if(I2CD1.state == I2C_LOCKED) {
-				i2c_stop();
-				i2c_start();
-			}
-			i2cReleaseBus(&I2CD1);
-			return status;
-		}
-		status = i2cMasterReceiveTimeout(&I2CD1, addr, value, sizeof(*value), MS2ST(50));
-		if (status != MSG_OK){
-			i2c_update_last_error();
-			if(I2CD1.state == I2C_LOCKED) {
-				i2c_stop();
-				i2c_start();
-			}
-			i2cReleaseBus(&I2CD1);
-			return status;
-		}
-	}
-	i2cReleaseBus(&I2CD1);
-
-    return MSG_OK;
+	// SCCB: the read must be a separate transfer.
+	i2c_transaction_init(&t, addr, txbuf, 1, value, sizeof(*value));
+	t.flags = I2C_FLAG_SEPARATE_READ;
+	t.timeout = MS2ST(50);
+	return i2c_transfer(&t);
 }
 
  /**
@@ -690,6 +658,14 @@ uint32_t ov7670_get_image_size(void) {
     }
 }
 
+uint16_t ov7670_get_image_width(void) {
+    return ov7670_conf.width;
+}
+
+uint16_t ov7670_get_image_height(void) {
+    return ov7670_conf.height;
+}
+
 uint8_t ov7670_is_connected(void) {
 	uint16_t id = 0;
 	int8_t res = ov7670_read_id(&id);
@@ -164,6 +164,22 @@ int8_t ov7670_set_exposure(uint16_t integral);
  */
 uint32_t ov7670_get_image_size(void);
 
+ /**
+ * @brief   Returns the current image width in pixels.
+ *
+ * @return              The image width
+ *
+ */
+uint16_t ov7670_get_image_width(void);
+
+ /**
+ * @brief   Returns the current image height in lines.
+ *
+ * @return              The image height
+ *
+ */
+uint16_t ov7670_get_image_height(void);
+
 /**
 * @brief	Check whether the ov7670 camera is connected.
 *
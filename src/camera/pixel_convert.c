@@ -0,0 +1,304 @@
+#include <string.h>
+#include <stdbool.h>
+#include "pixel_convert.h"
+
+/* Coefficients of the luminance (Q8) for the 5, 6 and 5 bits components, 0.299 x 255 / 31 x 256, ... */
+#define GREY_R			633
+#define GREY_G			607
+#define GREY_B			239
+#define GREY_ROUND		0x00800080
+/* Coefficients of the chrominances (Q8) for the sum of the differences of a pair of pixels. */
+#define CHROMA_U		0x00480048	// 0.564 / 2 x 256 = 72
+#define CHROMA_V		0x005B005B	// 0.713 / 2 x 256 = 91
+#define CHROMA_OFFSET	(128 * 256 + 128)
+
+#define MASK_5			0x001F001F
+#define MASK_6			0x003F003F
+#define FIELD(p, shift, mask)	(((p) >> (shift)) & (mask))
+
+/*
+ * Packed halfword instructions of the Cortex-M4 and their portable versions.
+ */
+#if defined(__ARM_FEATURE_DSP)
+
+static inline uint32_t rev16(uint32_t x) {
+	uint32_t r;
+	__asm__ ("rev16 %0, %1" : "=r" (r) : "r" (x));
+	return r;
+}
+
+static inline uint32_t uhadd8(uint32_t a, uint32_t b) {
+	uint32_t r;
+	__asm__ ("uhadd8 %0, %1, %2" : "=r" (r) : "r" (a), "r" (b));
+	return r;
+}
+
+static inline uint32_t ssub16(uint32_t a, uint32_t b) {
+	uint32_t r;
+	__asm__ ("ssub16 %0, %1, %2" : "=r" (r) : "r" (a), "r" (b));
+	return r;
+}
+
+static inline int32_t smuad(uint32_t a, uint32_t b) {
+	int32_t r;
+	__asm__ ("smuad %0, %1, %2" : "=r" (r) : "r" (a), "r" (b));
+	return r;
+}
+
+static inline uint32_t pkhbt(uint32_t a, uint32_t b) {
+	uint32_t r;
+	__asm__ ("pkhbt %0, %1, %2, lsl #16" : "=r" (r) : "r" (a), "r" (b));
+	return r;
+}
+
+static inline uint32_t pkhtb(uint32_t a, uint32_t b) {
+	uint32_t r;
+	__asm__ ("pkhtb %0, %1, %2, asr #16" : "=r" (r) : "r" (a), "r" (b));
+	return r;
+}
+
+static inline uint32_t usat8(int32_t x) {
+	uint32_t r;
+	__asm__ ("usat %0, #8, %1" : "=r" (r) : "r" (x));
+	return r;
+}
+
+#else
+
+// Swaps the bytes of each halfword.
+static inline uint32_t rev16(uint32_t x) {
+	return ((x & 0x00FF00FF) << 8) | ((x >> 8) & 0x00FF00FF);
+}
+
+// Mean of each byte, rounded down.
+static inline uint32_t uhadd8(uint32_t a, uint32_t b) {
+	return (a & b) + (((a ^ b) >> 1) & 0x7F7F7F7F);
+}
+
+// Difference of each signed halfword.
+static inline uint32_t ssub16(uint32_t a, uint32_t b) {
+	uint16_t lo = (uint16_t)((int16_t)a - (int16_t)b);
+	uint16_t hi = (uint16_t)((int16_t)(a >> 16) - (int16_t)(b >> 16));
+	return lo | ((uint32_t)hi << 16);
+}
+
+// Sum of the products of the signed halfwords.
+static inline int32_t smuad(uint32_t a, uint32_t b) {
+	return (int32_t)(int16_t)a * (int16_t)b + (int32_t)(int16_t)(a >> 16) * (int16_t)(b >> 16);
+}
+
+// Low halfword of a, low halfword of b in the high halfword.
+static inline uint32_t pkhbt(uint32_t a, uint32_t b) {
+	return (a & 0xFFFF) | (b << 16);
+}
+
+// High halfword of a, high halfword of b in the low halfword.
+static inline uint32_t pkhtb(uint32_t a, uint32_t b) {
+	return (a & 0xFFFF0000) | (b >> 16);
+}
+
+static inline uint32_t usat8(int32_t x) {
+	return x < 0 ? 0 : (x > 255 ? 255 : x);
+}
+
+#endif
+
+static inline uint32_t load32(const uint8_t *p) {
+	uint32_t w;
+	memcpy(&w, p, sizeof(w));
+	return w;
+}
+
+static inline void store32(uint8_t *p, uint32_t w) {
+	memcpy(p, &w, sizeof(w));
+}
+
+static inline uint16_t load_rgb565(const uint8_t *p) {
+	return ((uint16_t)p[0] << 8) | p[1];
+}
+
+static inline uint8_t luma(uint16_t p) {
+	return (GREY_R * (p >> 11) + GREY_G * ((p >> 5) & 0x3F) + GREY_B * (p & 0x1F) + 128) >> 8;
+}
+
+ /**
+ * @brief   Luminance of two RGB565 pixels (one per halfword), shifted by 8 bits in each halfword.
+ * 			The sums stay below 65536, so the halfwords are computed with 32 bits multiplications.
+ */
+static inline uint32_t luma2(uint32_t p) {
+	return FIELD(p, 11, MASK_5) * GREY_R + FIELD(p, 5, MASK_6) * GREY_G + FIELD(p, 0, MASK_5) * GREY_B + GREY_ROUND;
+}
+
+ /**
+ * @brief   Extends 5 bits components to 8 bits (one per halfword).
+ */
+static inline uint32_t expand5(uint32_t c) {
+	return (c << 3) | ((c >> 2) & 0x00070007);
+}
+
+ /**
+ * @brief   Sums a component of the 2x2 blocks of two pairs of pixels of two lines (a and b on the first line,
+ * 			c and d on the second line), one block per halfword of the result.
+ */
+static inline uint32_t sum_blocks(uint32_t a, uint32_t b, uint32_t c, uint32_t d, uint8_t shift, uint32_t mask) {
+	uint32_t ac = FIELD(a, shift, mask) + FIELD(c, shift, mask);
+	uint32_t bd = FIELD(b, shift, mask) + FIELD(d, shift, mask);
+	return pkhbt(ac, bd) + pkhtb(bd, ac);
+}
+
+static void downscale2_line_ref(const uint8_t *line0, const uint8_t *line1, uint8_t *out,
+								uint16_t first, uint16_t last, pixel_format_t format) {
+	for(uint16_t x=first; x<last; x++) {
+		if(format == PIXEL_FORMAT_GREYSCALE) {
+			uint8_t left = (line0[2*x] + line1[2*x]) >> 1;
+			uint8_t right = (line0[2*x+1] + line1[2*x+1]) >> 1;
+			out[x] = (left + right) >> 1;
+		} else {
+			uint16_t p[4] = {load_rgb565(&line0[4*x]), load_rgb565(&line0[4*x+2]),
+								load_rgb565(&line1[4*x]), load_rgb565(&line1[4*x+2])};
+			uint16_t r = 0, g = 0, b = 0;
+			for(uint8_t i=0; i<4; i++) {
+				r += p[i] >> 11;
+				g += (p[i] >> 5) & 0x3F;
+				b += p[i] & 0x1F;
+			}
+			uint16_t mean = ((r >> 2) << 11) | ((g >> 2) << 5) | (b >> 2);
+			out[2*x] = mean >> 8;
+			out[2*x+1] = mean & 0xFF;
+		}
+	}
+}
+
+static void downscale2_line(const uint8_t *line0, const uint8_t *line1, uint8_t *out,
+							uint16_t out_width, pixel_format_t format) {
+	uint16_t x = 0;
+
+	if(format == PIXEL_FORMAT_GREYSCALE) {
+		// 8 pixels of each line give 4 pixels.
+		for(; x+4<=out_width; x+=4) {
+			uint32_t v0 = uhadd8(load32(&line0[2*x]), load32(&line1[2*x]));
+			uint32_t v1 = uhadd8(load32(&line0[2*x+4]), load32(&line1[2*x+4]));
+			uint32_t h0 = uhadd8(v0, v0 >> 8) & 0x00FF00FF;
+			uint32_t h1 = uhadd8(v1, v1 >> 8) & 0x00FF00FF;
+			store32(&out[x], pkhbt(h0 | (h0 >> 8), h1 | (h1 >> 8)));
+		}
+	} else {
+		// 4 pixels of each line give 2 pixels.
+		for(; x+2<=out_width; x+=2) {
+			uint32_t a = rev16(load32(&line0[4*x]));
+			uint32_t b = rev16(load32(&line0[4*x+4]));
+			uint32_t c = rev16(load32(&line1[4*x]));
+			uint32_t d = rev16(load32(&line1[4*x+4]));
+			uint32_t r = (sum_blocks(a, b, c, d, 11, MASK_5) >> 2) & MASK_5;
+			uint32_t g = (sum_blocks(a, b, c, d, 5, MASK_6) >> 2) & MASK_6;
+			uint32_t bl = (sum_blocks(a, b, c, d, 0, MASK_5) >> 2) & MASK_5;
+			store32(&out[2*x], rev16((r << 11) | (g << 5) | bl));
+		}
+	}
+	downscale2_line_ref(line0, line1, out, x, out_width, format);
+}
+
+ /**
+ * @brief   Halves the size of an image, with the kernel or with the reference.
+ */
+static void downscale2(const uint8_t *src, uint8_t *dst, uint16_t width, uint16_t height,
+						pixel_format_t format, bool ref) {
+	uint32_t line_bytes = (uint32_t)width * format;
+
+	for(uint16_t y=0; y<height/2; y++) {
+		const uint8_t *line0 = &src[2 * y * line_bytes];
+		uint8_t *out = &dst[y * line_bytes / 2];
+		if(ref) {
+			downscale2_line_ref(line0, line0 + line_bytes, out, 0, width / 2, format);
+		} else {
+			downscale2_line(line0, line0 + line_bytes, out, width / 2, format);
+		}
+	}
+}
+
+static int8_t downscale(const uint8_t *src, uint8_t *dst, uint16_t width, uint16_t height,
+						pixel_format_t format, uint8_t factor, bool ref) {
+	if((factor != 1 && factor != 2 && factor != 4) || (width % factor) != 0 || (height % factor) != 0) {
+		return -1;
+	}
+	if(factor == 1) {
+		memmove(dst, src, (uint32_t)width * height * format);
+		return 0;
+	}
+	downscale2(src, dst, width, height, format, ref);
+	if(factor == 4) {
+		downscale2(dst, dst, width / 2, height / 2, format, ref);
+	}
+	return 0;
+}
+
+/****************************PUBLIC FUNCTIONS*************************************/
+
+void pixel_rgb565_to_grey(const uint8_t *src, uint8_t *dst, uint32_t pixels) {
+	uint32_t i = 0;
+
+	for(; i+4<=pixels; i+=4) {
+		uint32_t y01 = (luma2(rev16(load32(&src[2*i]))) >> 8) & 0x00FF00FF;
+		uint32_t y23 = (luma2(rev16(load32(&src[2*i+4]))) >> 8) & 0x00FF00FF;
+		store32(&dst[i], pkhbt(y01 | (y01 >> 8), y23 | (y23 >> 8)));
+	}
+	pixel_rgb565_to_grey_ref(&src[2*i], &dst[i], pixels - i);
+}
+
+void pixel_rgb565_to_grey_ref(const uint8_t *src, uint8_t *dst, uint32_t pixels) {
+	for(uint32_t i=0; i<pixels; i++) {
+		dst[i] = luma(load_rgb565(&src[2*i]));
+	}
+}
+
+void pixel_rgb565_to_yuv422(const uint8_t *src, uint8_t *dst, uint32_t pixels) {
+	for(uint32_t i=0; i+2<=pixels; i+=2) {
+		uint32_t p = rev16(load32(&src[2*i]));
+		uint32_t y = (luma2(p) >> 8) & 0x00FF00FF;
+		uint32_t u = usat8((smuad(ssub16(expand5(FIELD(p, 0, MASK_5)), y), CHROMA_U) + CHROMA_OFFSET) >> 8);
+		uint32_t v = usat8((smuad(ssub16(expand5(FIELD(p, 11, MASK_5)), y), CHROMA_V) + CHROMA_OFFSET) >> 8);
+		store32(&dst[2*i], y | (u << 8) | (v << 24));
+	}
+}
+
+void pixel_rgb565_to_yuv422_ref(const uint8_t *src, uint8_t *dst, uint32_t pixels) {
+	for(uint32_t i=0; i+2<=pixels; i+=2) {
+		uint16_t p0 = load_rgb565(&src[2*i]);
+		uint16_t p1 = load_rgb565(&src[2*i+2]);
+		int32_t y0 = luma(p0);
+		int32_t y1 = luma(p1);
+		int32_t b = (int32_t)expand5(p0 & 0x1F) - y0 + (int32_t)expand5(p1 & 0x1F) - y1;
+		int32_t r = (int32_t)expand5(p0 >> 11) - y0 + (int32_t)expand5(p1 >> 11) - y1;
+		int32_t u = ((int32_t)(CHROMA_U & 0xFFFF) * b + CHROMA_OFFSET) >> 8;
+		int32_t v = ((int32_t)(CHROMA_V & 0xFFFF) * r + CHROMA_OFFSET) >> 8;
+		dst[2*i] = y0;
+		dst[2*i+1] = u < 0 ? 0 : (u > 255 ? 255 : u);
+		dst[2*i+2] = y1;
+		dst[2*i+3] = v < 0 ? 0 : (v > 255 ? 255 : v);
+	}
+}
+
+int8_t pixel_downscale(const uint8_t *src, uint8_t *dst, uint16_t width, uint16_t height,
+						pixel_format_t format, uint8_t factor) {
+	return downscale(src, dst, width, height, format, factor, false);
+}
+
+int8_t pixel_downscale_ref(const uint8_t *src, uint8_t *dst, uint16_t width, uint16_t height,
+						pixel_format_t format, uint8_t factor) {
+	return downscale(src, dst, width, height, format, factor, true);
+}
+
+int8_t pixel_crop(const uint8_t *src, uint8_t *dst, uint16_t width, uint16_t height, pixel_format_t format,
+					uint16_t x, uint16_t y, uint16_t crop_width, uint16_t crop_height) {
+	if((uint32_t)x + crop_width > width || (uint32_t)y + crop_height > height) {
+		return -1;
+	}
+	// The lines move towards the start of the buffer, so they can be copied in order in place.
+	for(uint16_t i=0; i<crop_height; i++) {
+		memmove(&dst[(uint32_t)i * crop_width * format],
+				&src[((uint32_t)(y + i) * width + x) * format], (uint32_t)crop_width * format);
+	}
+	return 0;
+}
+
+/**************************END PUBLIC FUNCTIONS***********************************/
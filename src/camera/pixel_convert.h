@@ -0,0 +1,103 @@
+#ifndef PIXEL_CONVERT_H
+#define PIXEL_CONVERT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/**
+ * Conversion kernels for the images of the camera: RGB565 to greyscale, RGB565 to YUV 4:2:2, downscale
+ * and crop.
+ *
+ * The RGB565 pixels are big endian as sent by the camera (RRRRRGGG GGGBBBBB). All the kernels can work in
+ * place (dst = src) and only need the lines they convert, so they can be applied to a whole frame or to
+ * the strips of dcmi_prepare_strips.
+ *
+ * Each kernel processes two pixels per 32 bits word with the packed halfword instructions of the
+ * Cortex-M4 (REV16, UHADD8, SSUB16, SMUAD, PKHBT, USAT). On the other targets the same code runs with
+ * portable versions of these instructions, so the results are identical everywhere. The *_ref functions
+ * are the per-pixel scalar references of the kernels, giving exactly the same results, to check and
+ * benchmark them.
+ *
+ * Greyscale:	Y = (633 R5 + 607 G6 + 239 B5 + 128) >> 8, that is 0.299 R + 0.587 G + 0.114 B on 8 bits.
+ * YUV 4:2:2:	Y0 U Y1 V for each pair of pixels, U = 128 + 0.564 (B - Y) and V = 128 + 0.713 (R - Y) on the
+ * 				means of the pair, saturated to 0..255.
+ * Downscale:	mean of each 2x2 block (truncated means of the columns then of the rows), 4x is two 2x passes.
+ */
+
+typedef enum {
+	PIXEL_FORMAT_GREYSCALE = 1,		// The value is the number of bytes per pixel.
+	PIXEL_FORMAT_RGB565 = 2
+} pixel_format_t;
+
+ /**
+ * @brief   Gives the 8 bits components of a RGB565 pixel, the low bits of each component are zero.
+ */
+static inline void pixel_rgb565_unpack(const uint8_t *p, uint8_t *r, uint8_t *g, uint8_t *b) {
+	*r = p[0] & 0xF8;
+	*g = ((p[0] & 0x07) << 5) | ((p[1] & 0xE0) >> 3);
+	*b = (p[1] & 0x1F) << 3;
+}
+
+ /**
+ * @brief   Converts RGB565 pixels to greyscale (1 byte per pixel).
+ *
+ * @param src		RGB565 pixels
+ * @param dst		greyscale pixels, can be src
+ * @param pixels	number of pixels
+ */
+void pixel_rgb565_to_grey(const uint8_t *src, uint8_t *dst, uint32_t pixels);
+void pixel_rgb565_to_grey_ref(const uint8_t *src, uint8_t *dst, uint32_t pixels);
+
+ /**
+ * @brief   Converts RGB565 pixels to YUV 4:2:2 (Y0 U Y1 V, 2 bytes per pixel).
+ *
+ * @param src		RGB565 pixels
+ * @param dst		YUV pixels, can be src
+ * @param pixels	number of pixels, even (a last odd pixel is not converted)
+ */
+void pixel_rgb565_to_yuv422(const uint8_t *src, uint8_t *dst, uint32_t pixels);
+void pixel_rgb565_to_yuv422_ref(const uint8_t *src, uint8_t *dst, uint32_t pixels);
+
+ /**
+ * @brief   Reduces the size of an image by averaging the blocks of factor x factor pixels.
+ *
+ * @param src		image of width x height pixels
+ * @param dst		image of (width / factor) x (height / factor) pixels, can be src
+ * @param width		pixels per line, multiple of the factor
+ * @param height	number of lines, multiple of the factor
+ * @param format	format of the pixels
+ * @param factor	1, 2 or 4
+ *
+ * @return			0 on success, -1 if the factor or the size is not supported
+ */
+int8_t pixel_downscale(const uint8_t *src, uint8_t *dst, uint16_t width, uint16_t height,
+						pixel_format_t format, uint8_t factor);
+int8_t pixel_downscale_ref(const uint8_t *src, uint8_t *dst, uint16_t width, uint16_t height,
+						pixel_format_t format, uint8_t factor);
+
+ /**
+ * @brief   Copies a rectangle of an image.
+ *
+ * @param src			image of width x height pixels
+ * @param dst			image of crop_width x crop_height pixels, can be src
+ * @param width			pixels per line of the source
+ * @param height		number of lines of the source
+ * @param format		format of the pixels
+ * @param x				first column of the rectangle
+ * @param y				first line of the rectangle
+ * @param crop_width	pixels per line of the rectangle
+ * @param crop_height	number of lines of the rectangle
+ *
+ * @return				0 on success, -1 if the rectangle is not inside the image
+ */
+int8_t pixel_crop(const uint8_t *src, uint8_t *dst, uint16_t width, uint16_t height, pixel_format_t format,
+					uint16_t x, uint16_t y, uint16_t crop_width, uint16_t crop_height);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PIXEL_CONVERT_H */
@@ -1051,6 +1051,14 @@ uint32_t po6030_get_image_size(void) {
     }
 }
 
+uint16_t po6030_get_image_width(void) {
+    return po6030_conf.width;
+}
+
+uint16_t po6030_get_image_height(void) {
+    return po6030_conf.height;
+}
+
 uint8_t po6030_is_connected(void) {
 	uint16_t id = 0;
 	int8_t res = po6030_read_id(&id);
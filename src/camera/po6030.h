@@ -179,6 +179,22 @@ int8_t po6030_set_exposure(uint16_t integral, uint8_t fractional);
  */
 uint32_t po6030_get_image_size(void);
 
+ /**
+ * @brief   Returns the current image width in pixels.
+ *
+ * @return              The image width
+ *
+ */
+uint16_t po6030_get_image_width(void);
+
+ /**
+ * @brief   Returns the current image height in lines.
+ *
+ * @return              The image height
+ *
+ */
+uint16_t po6030_get_image_height(void);
+
 /**
 * @brief	Check whether the po6030 camera is connected.
 *
@@ -996,6 +996,14 @@ uint32_t po8030_get_image_size(void) {
     }
 }
 
+uint16_t po8030_get_image_width(void) {
+    return po8030_conf.width;
+}
+
+uint16_t po8030_get_image_height(void) {
+    return po8030_conf.height;
+}
+
 uint8_t po8030_is_connected(void) {
 	uint16_t id = 0;
 	int8_t res = po8030_read_id(&id);
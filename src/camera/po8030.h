@@ -182,6 +182,22 @@ int8_t po8030_set_exposure(uint16_t integral, uint8_t fractional);
  */
 uint32_t po8030_get_image_size(void);
 
+ /**
+ * @brief   Returns the current image width in pixels.
+ *
+ * @return              The image width
+ *
+ */
+uint16_t po8030_get_image_width(void);
+
+ /**
+ * @brief   Returns the current image height in lines.
+ *
+ * @return              The image height
+ *
+ */
+uint16_t po8030_get_image_height(void);
+
 /**
 * @brief	Check whether the po8030 camera is connected.
 *
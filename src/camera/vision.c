@@ -0,0 +1,99 @@
+#include "ch.h"
+#include "hal.h"
+#include <main.h>
+#include "camera.h"
+#include "dcmi_camera.h"
+#include "vision.h"
+
+static vision_t vision;
+static vision_msg_t vision_msg;
+static bool vision_running = false;
+
+static messagebus_topic_t vision_topic;
+static MUTEX_DECL(vision_topic_lock);
+static CONDVAR_DECL(vision_topic_condvar);
+static bool vision_topic_advertised = false;
+
+/***************************INTERNAL FUNCTIONS************************************/
+
+static uint32_t read_cycles(void) {
+	return chSysGetRealtimeCounterX();
+}
+
+ /**
+ * @brief   Called by the strip thread of the DCMI for each strip, publishes the result at the end of the image.
+ */
+static void vision_strip_cb(const uint8_t *strip, uint16_t first_line, uint16_t lines, void *arg) {
+	(void) arg;
+
+	if(vision_process_lines(&vision, strip, first_line, lines)) {
+		vision_get_result(&vision, &vision_msg.result);
+		sensor_header_stamp(&vision_msg.header, chVTGetSystemTime(), 0);
+		messagebus_topic_publish(&vision_topic, &vision_msg, sizeof(vision_msg));
+	}
+}
+
+ /**
+ * @brief   Returns the largest number of lines per strip supported by dcmi_prepare_strips, 0 if none.
+ * 			The larger the strips, the more time the processing of a strip can take.
+ */
+static uint16_t select_strip_lines(uint16_t width, uint16_t height, uint8_t bytes_per_pixel) {
+	for(uint16_t lines=height; lines>0; lines--) {
+		uint32_t bytes = (uint32_t)lines * width * bytes_per_pixel;
+		if((height % lines) == 0 && 2 * bytes <= MAX_BUFF_SIZE && (bytes % 4) == 0) {
+			return lines;
+		}
+	}
+	return 0;
+}
+
+/*************************END INTERNAL FUNCTIONS**********************************/
+
+
+/****************************PUBLIC FUNCTIONS*************************************/
+
+int8_t vision_start(const vision_config_t *config) {
+	uint16_t width = cam_get_image_width();
+	uint16_t height = cam_get_image_height();
+
+	if(vision_running || width == 0 || height == 0) {
+		return -1;
+	}
+	// The OV7670 sends colour images even when greyscale is asked, the memory required tells the format.
+	uint8_t bytes_per_pixel = cam_get_mem_required() / ((uint32_t)width * height);
+	vision_format_t format = bytes_per_pixel == 1 ? VISION_FORMAT_GREYSCALE : VISION_FORMAT_RGB565;
+
+	uint16_t lines = select_strip_lines(width, height, bytes_per_pixel);
+	if(lines == 0 || vision_init(&vision, config, format, width, height, read_cycles) != 0) {
+		return -1;
+	}
+
+	if(!vision_topic_advertised) {
+		messagebus_topic_init(&vision_topic, &vision_topic_lock, &vision_topic_condvar, &vision_msg, sizeof(vision_msg));
+		messagebus_advertise_topic(&bus, &vision_topic, "/vision");
+		vision_topic_advertised = true;
+	}
+
+	if(dcmi_prepare_strips(lines, vision_strip_cb, NULL) != 0) {
+		return -1;
+	}
+	dcmi_set_capture_mode(CAPTURE_CONTINUOUS);
+	dcmi_capture_start();
+	vision_running = true;
+
+	return 0;
+}
+
+void vision_stop(void) {
+	if(vision_running) {
+		dcmi_capture_stop();
+		dcmi_unprepare();
+		vision_running = false;
+	}
+}
+
+bool vision_is_running(void) {
+	return vision_running;
+}
+
+/**************************END PUBLIC FUNCTIONS***********************************/
@@ -0,0 +1,49 @@
+#ifndef VISION_H
+#define VISION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sensors/sensor_sample.h"
+#include "vision_processing.h"
+
+/** Struct containing the result of an image, published on the /vision topic. */
+typedef struct {
+    /** Time at which the last line of the image was received, the rate is 0 (it depends on the camera). */
+    sensor_header_t header;
+
+    /** Blobs and line found, the cycles are in cycles of the CPU (STM32_SYSCLK). */
+    vision_result_t result;
+} vision_msg_t;
+
+ /**
+ * @brief   Starts the detection on the images of the camera, with its current configuration
+ * 			(cam_config or cam_advanced_config, greyscale or colour, up to VGA).
+ * 			The images are captured continuously in strips (see dcmi_prepare_strips) and processed
+ * 			while they are received, a vision_msg_t message is broadcast on the /vision topic at the end
+ * 			of each image. The camera can't be used for anything else until vision_stop.
+ *
+ * @param config	colour classes and line parameters, copied
+ *
+ * @return			0 on success, -1 if the detection is already running or the image is not supported
+ */
+int8_t vision_start(const vision_config_t *config);
+
+ /**
+ * @brief   Stops the capture and the detection. dcmi_prepare must be called before capturing frames again.
+ */
+void vision_stop(void);
+
+ /**
+ * @brief   Returns true if the detection is running.
+ */
+bool vision_is_running(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VISION_H */
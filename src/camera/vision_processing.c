@@ -0,0 +1,347 @@
+#include <string.h>
+#include "vision_processing.h"
+
+#define NO_CLASS	0xFF
+#define NO_LABEL	0xFF
+
+static uint32_t no_clock(void) {
+	return 0;
+}
+
+static void frame_start(vision_t *v) {
+	v->next_line = 0;
+	v->incomplete = 0;
+	v->nb_runs[0] = 0;
+	v->nb_runs[1] = 0;
+	v->nb_labels = 0;
+	v->profile_rows = 0;
+	memset(v->profile, 0, sizeof(v->profile));
+	memset(v->cycles, 0, sizeof(v->cycles));
+}
+
+/**
+ * @brief   Converts a line to luminance and colour classes.
+ */
+static void classify_line(vision_t *v, const uint8_t *p, uint8_t *cls) {
+	uint8_t mask;
+
+	if(v->format == VISION_FORMAT_RGB565) {
+		for(uint16_t x=0; x<v->width; x++) {
+			// RGB565 big endian: RRRRRGGG GGGBBBBB
+			int32_t r = p[0] & 0xF8;
+			int32_t g = ((p[0] & 0x07) << 5) | ((p[1] & 0xE0) >> 3);
+			int32_t b = (p[1] & 0x1F) << 3;
+			p += 2;
+			// BT.601 in 8 bits fixed point, the offset of 128 of U and V keeps the sums positive.
+			uint8_t y = (77*r + 150*g + 29*b) >> 8;
+			uint8_t u = (32768 - 43*r - 85*g + 128*b) >> 8;
+			uint8_t vv = (32768 + 128*r - 107*g - 21*b) >> 8;
+			v->luma[x] = y;
+			mask = v->y_mask[y] & v->u_mask[u] & v->v_mask[vv];
+			cls[x] = mask ? __builtin_ctz(mask) : NO_CLASS;
+		}
+	} else {
+		uint8_t uv_mask = v->u_mask[128] & v->v_mask[128];
+		for(uint16_t x=0; x<v->width; x++) {
+			uint8_t y = p[x];
+			v->luma[x] = y;
+			mask = v->y_mask[y] & uv_mask;
+			cls[x] = mask ? __builtin_ctz(mask) : NO_CLASS;
+		}
+	}
+}
+
+/**
+ * @brief   Run-length encodes the classes of a line in the current runs.
+ */
+static void encode_line(vision_t *v, const uint8_t *cls) {
+	vision_run_t *runs = v->runs[v->cur];
+	uint8_t nb = 0;
+	uint16_t start = 0;
+
+	for(uint16_t x=1; x<=v->width; x++) {
+		if(x < v->width && cls[x] == cls[start]) {
+			continue;
+		}
+		if(cls[start] != NO_CLASS) {
+			if(nb < VISION_MAX_RUNS) {
+				runs[nb].start = start;
+				runs[nb].end = x;
+				runs[nb].cls = cls[start];
+				runs[nb].label = NO_LABEL;
+				nb++;
+			} else {
+				v->incomplete |= VISION_RUNS_OVERFLOW;
+			}
+		}
+		start = x;
+	}
+	v->nb_runs[v->cur] = nb;
+}
+
+static uint8_t find_root(vision_label_t *labels, uint8_t l) {
+	while(labels[l].parent != l) {
+		labels[l].parent = labels[labels[l].parent].parent; // Path halving.
+		l = labels[l].parent;
+	}
+	return l;
+}
+
+/**
+ * @brief   Merges two blobs, the oldest label stays the root.
+ *
+ * @return	root of the merged blob
+ */
+static uint8_t merge_labels(vision_label_t *labels, uint8_t a, uint8_t b) {
+	uint8_t root = a < b ? a : b;
+	uint8_t other = a < b ? b : a;
+	vision_label_t *r = &labels[root];
+	vision_label_t *o = &labels[other];
+
+	r->area += o->area;
+	r->sum_x += o->sum_x;
+	r->sum_y += o->sum_y;
+	if(o->x_min < r->x_min) r->x_min = o->x_min;
+	if(o->x_max > r->x_max) r->x_max = o->x_max;
+	if(o->y_min < r->y_min) r->y_min = o->y_min;
+	if(o->y_max > r->y_max) r->y_max = o->y_max;
+	o->parent = root;
+	return root;
+}
+
+static void add_run(vision_label_t *l, const vision_run_t *run, uint16_t y) {
+	uint32_t len = run->end - run->start;
+
+	l->area += len;
+	l->sum_x += len * (run->start + run->end - 1) / 2;
+	l->sum_y += len * y;
+	if(run->start < l->x_min) l->x_min = run->start;
+	if(run->end - 1 > l->x_max) l->x_max = run->end - 1;
+	if(y > l->y_max) l->y_max = y;
+}
+
+/**
+ * @brief   Connects the runs of the current line to the ones of the previous line.
+ */
+static void label_line(vision_t *v, uint16_t y) {
+	vision_run_t *runs = v->runs[v->cur];
+	const vision_run_t *prev = v->runs[v->cur ^ 1];
+	uint8_t nb_prev = v->nb_runs[v->cur ^ 1];
+	uint8_t first = 0;
+
+	for(uint8_t i=0; i<v->nb_runs[v->cur]; i++) {
+		vision_run_t *run = &runs[i];
+		uint8_t label = NO_LABEL;
+
+		// The runs are ordered, the previous runs ending before this one can't touch the next ones either.
+		while(first < nb_prev && prev[first].end <= run->start) {
+			first++;
+		}
+		for(uint8_t k=first; k<nb_prev && prev[k].start < run->end; k++) {
+			if(prev[k].cls != run->cls || prev[k].label == NO_LABEL) {
+				continue;
+			}
+			uint8_t root = find_root(v->labels, prev[k].label);
+			if(label == NO_LABEL) {
+				label = root;
+			} else if(root != label) {
+				label = merge_labels(v->labels, label, root);
+			}
+		}
+
+		if(label == NO_LABEL) {
+			if(v->nb_labels >= VISION_MAX_LABELS) {
+				v->incomplete |= VISION_LABELS_OVERFLOW;
+				continue;
+			}
+			label = v->nb_labels++;
+			vision_label_t *l = &v->labels[label];
+			l->parent = label;
+			l->cls = run->cls;
+			l->x_min = run->start;
+			l->x_max = run->start;
+			l->y_min = y;
+			l->y_max = y;
+			l->area = 0;
+			l->sum_x = 0;
+			l->sum_y = 0;
+		}
+		run->label = label;
+		add_run(&v->labels[label], run, y);
+	}
+}
+
+/**
+ * @brief   Adds the luminance of the current line to the column profile if it is in the band.
+ */
+static void profile_line(vision_t *v, uint16_t y) {
+	if(v->config.line_rows == 0 || y < v->config.line_first_row ||
+			y >= v->config.line_first_row + v->config.line_rows) {
+		return;
+	}
+	for(uint16_t x=0; x<v->width; x++) {
+		v->profile[x] += v->luma[x];
+	}
+	v->profile_rows++;
+}
+
+static void find_line(vision_t *v, vision_line_t *line) {
+	int16_t in_pos = VISION_NO_LINE;
+	int16_t out_pos = VISION_NO_LINE;
+	int32_t in_step = v->config.edge_threshold;
+	int32_t out_step = v->config.edge_threshold;
+
+	line->position = VISION_NO_LINE;
+	line->width = 0;
+	line->contrast = 0;
+	if(v->profile_rows == 0 || v->width < 3) {
+		return;
+	}
+
+	for(uint16_t x=0; x<v->width; x++) {
+		v->profile[x] /= v->profile_rows;
+	}
+	// Step of the mean luminance towards the line (positive when entering it from the left).
+	int32_t sign = v->config.line_dark ? -1 : 1;
+	for(uint16_t x=1; x<v->width-1; x++) {
+		int32_t step = sign * ((int32_t)v->profile[x+1] - (int32_t)v->profile[x-1]);
+		if(step >= in_step) {
+			in_step = step;
+			in_pos = x;
+		}
+	}
+	if(in_pos == VISION_NO_LINE) {
+		return;
+	}
+	for(uint16_t x=in_pos+1; x<v->width-1; x++) {
+		int32_t step = sign * ((int32_t)v->profile[x-1] - (int32_t)v->profile[x+1]);
+		if(step >= out_step) {
+			out_step = step;
+			out_pos = x;
+		}
+	}
+	if(out_pos == VISION_NO_LINE) {
+		return;
+	}
+	line->position = (in_pos + out_pos) / 2;
+	line->width = out_pos - in_pos;
+	line->contrast = in_step < out_step ? in_step : out_step;
+}
+
+/**
+ * @brief   Keeps the largest blobs, sorted by decreasing area.
+ */
+static void extract_blobs(vision_t *v, vision_result_t *result) {
+	uint32_t min_area = v->config.min_area > 0 ? v->config.min_area : 1;
+
+	result->nb_blobs = 0;
+	for(uint8_t i=0; i<v->nb_labels; i++) {
+		const vision_label_t *l = &v->labels[i];
+		if(l->parent != i || l->area < min_area) {
+			continue;
+		}
+		uint8_t pos = result->nb_blobs;
+		while(pos > 0 && result->blobs[pos-1].area < l->area) {
+			if(pos < VISION_MAX_BLOBS) {
+				result->blobs[pos] = result->blobs[pos-1];
+			}
+			pos--;
+		}
+		if(pos >= VISION_MAX_BLOBS) {
+			continue;
+		}
+		vision_blob_t *b = &result->blobs[pos];
+		b->area = l->area;
+		b->x_min = l->x_min;
+		b->y_min = l->y_min;
+		b->x_max = l->x_max;
+		b->y_max = l->y_max;
+		b->x = l->sum_x / l->area;
+		b->y = l->sum_y / l->area;
+		b->cls = l->cls;
+		if(result->nb_blobs < VISION_MAX_BLOBS) {
+			result->nb_blobs++;
+		}
+	}
+}
+
+int8_t vision_init(vision_t *v, const vision_config_t *config, vision_format_t format,
+					uint16_t width, uint16_t height, vision_clock_t clock) {
+	if(width == 0 || width > VISION_MAX_WIDTH || height == 0 || config->nb_classes > VISION_MAX_CLASSES) {
+		return -1;
+	}
+
+	memset(v, 0, sizeof(vision_t));
+	v->config = *config;
+	v->format = format;
+	v->width = width;
+	v->height = height;
+	v->clock = clock != NULL ? clock : no_clock;
+
+	for(uint8_t i=0; i<config->nb_classes; i++) {
+		const vision_class_t *c = &config->classes[i];
+		for(uint16_t j=c->y_min; j<=c->y_max; j++) {
+			v->y_mask[j] |= 1 << i;
+		}
+		for(uint16_t j=c->u_min; j<=c->u_max; j++) {
+			v->u_mask[j] |= 1 << i;
+		}
+		for(uint16_t j=c->v_min; j<=c->v_max; j++) {
+			v->v_mask[j] |= 1 << i;
+		}
+	}
+	frame_start(v);
+	return 0;
+}
+
+bool vision_process_lines(vision_t *v, const uint8_t *data, uint16_t first_line, uint16_t lines) {
+	uint16_t bytes_per_line = v->format == VISION_FORMAT_RGB565 ? 2 * v->width : v->width;
+
+	if(first_line == 0 || first_line < v->next_line) {
+		frame_start(v);
+	}
+	if(first_line != v->next_line) {
+		// The blobs can't be connected across the missing lines.
+		v->incomplete |= VISION_LINES_MISSING;
+		v->nb_runs[v->cur] = 0;
+	}
+	if(first_line >= v->height) {
+		return false;
+	}
+	if(lines > v->height - first_line) {
+		lines = v->height - first_line;
+	}
+
+	for(uint16_t y=first_line; y<first_line+lines; y++) {
+		uint32_t t0 = v->clock();
+		v->cur ^= 1;
+		classify_line(v, data, v->cls);
+		encode_line(v, v->cls);
+		uint32_t t1 = v->clock();
+		label_line(v, y);
+		uint32_t t2 = v->clock();
+		profile_line(v, y);
+		uint32_t t3 = v->clock();
+
+		v->cycles[VISION_STAGE_SEGMENT] += t1 - t0;
+		v->cycles[VISION_STAGE_LABEL] += t2 - t1;
+		v->cycles[VISION_STAGE_LINE] += t3 - t2;
+		data += bytes_per_line;
+	}
+	v->next_line = first_line + lines;
+
+	return v->next_line == v->height;
+}
+
+void vision_get_result(vision_t *v, vision_result_t *result) {
+	uint32_t t0 = v->clock();
+	find_line(v, &result->line);
+	uint32_t t1 = v->clock();
+	extract_blobs(v, result);
+	uint32_t t2 = v->clock();
+
+	v->cycles[VISION_STAGE_LINE] += t1 - t0;
+	v->cycles[VISION_STAGE_EXTRACT] += t2 - t1;
+	result->incomplete = v->incomplete;
+	memcpy(result->cycles, v->cycles, sizeof(result->cycles));
+}
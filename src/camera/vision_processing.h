@@ -0,0 +1,175 @@
+#ifndef VISION_PROCESSING_H
+#define VISION_PROCESSING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Colour blob and line detection on the images of the camera.
+ *
+ * The image is given line by line (any number of lines at once, in order), so that it can be processed
+ * from a whole frame as well as from the strips of dcmi_prepare_strips, without storing it:
+ * - segmentation: each pixel is converted to YUV and classified against up to VISION_MAX_CLASSES colour
+ *   classes (min/max on each component, looked up in three tables of bit masks), the line is then
+ *   run-length encoded in runs of pixels of the same class.
+ * - labelling: each run is connected to the overlapping runs of the same class on the previous line
+ *   (4-connectivity) with a union-find on the labels of the frame. The area, bounding box and sums of
+ *   the coordinates are merged on the fly, so nothing has to be revisited at the end of the frame.
+ * - line: the luminance of a band of rows is summed per column, at the end of the frame the strongest
+ *   edge towards the line followed by the strongest edge back to the ground give its position and width.
+ * - extraction: the VISION_MAX_BLOBS largest blobs above the minimum area are kept.
+ * The time spent in each stage is measured with the clock given to vision_init.
+ */
+
+#define VISION_MAX_WIDTH		640
+#define VISION_MAX_CLASSES		4
+#define VISION_MAX_RUNS			64		// Runs kept per line, the next ones are ignored.
+#define VISION_MAX_LABELS		128		// Labels per frame, the runs which can't get one are ignored.
+#define VISION_MAX_BLOBS		8
+#define VISION_NO_LINE			(-1)
+
+/* Flags of vision_result_t.incomplete. */
+#define VISION_LINES_MISSING	(1 << 0)	// Lines were not given (lost strip), the blobs across them are split.
+#define VISION_RUNS_OVERFLOW	(1 << 1)	// More than VISION_MAX_RUNS runs on a line.
+#define VISION_LABELS_OVERFLOW	(1 << 2)	// More than VISION_MAX_LABELS labels in the frame.
+
+typedef enum {
+	VISION_FORMAT_GREYSCALE = 0,	// 1 byte per pixel, luminance only (U = V = 128).
+	VISION_FORMAT_RGB565 = 1		// 2 bytes per pixel, big endian as sent by the camera.
+} vision_format_t;
+
+typedef enum {
+	VISION_STAGE_SEGMENT = 0,		// Colour conversion, classification and run-length encoding.
+	VISION_STAGE_LABEL,				// Connection of the runs and merge of the blobs.
+	VISION_STAGE_LINE,				// Column profile and edge search.
+	VISION_STAGE_EXTRACT,			// Selection of the largest blobs.
+	VISION_STAGES
+} vision_stage_t;
+
+/** Colour class, a pixel belongs to it if its three components are within the limits (included). */
+typedef struct {
+	uint8_t y_min, y_max;
+	uint8_t u_min, u_max;			// U and V are offset by 128.
+	uint8_t v_min, v_max;
+} vision_class_t;
+
+typedef struct {
+	vision_class_t classes[VISION_MAX_CLASSES]; // When a pixel matches several classes, the first one wins.
+	uint8_t nb_classes;
+	uint16_t min_area;				// Smallest blob reported, in pixels.
+	uint16_t line_first_row;		// First row of the band used for the line detection.
+	uint16_t line_rows;				// Rows of the band, 0 disables the line detection.
+	uint8_t line_dark;				// 1 for a dark line on a light ground, 0 for a light line on a dark ground.
+	uint8_t edge_threshold;			// Smallest step of mean luminance accepted as an edge.
+} vision_config_t;
+
+typedef struct {
+	uint32_t area;					// Pixels.
+	uint16_t x_min, y_min;			// Bounding box (included).
+	uint16_t x_max, y_max;
+	uint16_t x, y;					// Centroid.
+	uint8_t cls;					// Colour class.
+} vision_blob_t;
+
+typedef struct {
+	int16_t position;				// Column of the middle of the line, VISION_NO_LINE if not found.
+	uint16_t width;					// Pixels between the two edges.
+	uint8_t contrast;				// Step of mean luminance of the weaker edge.
+} vision_line_t;
+
+typedef struct {
+	uint8_t nb_blobs;
+	uint8_t incomplete;				// VISION_LINES_MISSING | VISION_RUNS_OVERFLOW | VISION_LABELS_OVERFLOW
+	vision_blob_t blobs[VISION_MAX_BLOBS]; // Largest first.
+	vision_line_t line;
+	uint32_t cycles[VISION_STAGES];	// Clock ticks spent in each stage for the frame.
+} vision_result_t;
+
+/**
+ * @brief   Clock used to measure the stages, typically a cycle counter.
+ */
+typedef uint32_t (*vision_clock_t)(void);
+
+typedef struct {
+	uint16_t start;					// First pixel of the run.
+	uint16_t end;					// Pixel following the run.
+	uint8_t cls;
+	uint8_t label;
+} vision_run_t;
+
+typedef struct {
+	uint8_t parent;					// Itself for the root of a blob.
+	uint8_t cls;
+	uint16_t x_min, y_min, x_max, y_max;
+	uint32_t area;
+	uint32_t sum_x, sum_y;
+} vision_label_t;
+
+typedef struct {
+	vision_config_t config;
+	vision_format_t format;
+	uint16_t width;
+	uint16_t height;
+	vision_clock_t clock;
+	uint8_t y_mask[256];			// Classes accepting each value of the components (bit i = class i).
+	uint8_t u_mask[256];
+	uint8_t v_mask[256];
+	uint16_t next_line;
+	uint8_t incomplete;
+	uint8_t cur;					// Runs of the current line, the other ones are the previous line.
+	uint8_t nb_runs[2];
+	vision_run_t runs[2][VISION_MAX_RUNS];
+	uint8_t nb_labels;
+	vision_label_t labels[VISION_MAX_LABELS];
+	uint8_t luma[VISION_MAX_WIDTH];	// Luminance of the line being processed.
+	uint8_t cls[VISION_MAX_WIDTH];	// Colour classes of the line being processed.
+	uint32_t profile[VISION_MAX_WIDTH];
+	uint16_t profile_rows;
+	uint32_t cycles[VISION_STAGES];
+} vision_t;
+
+/**
+ * @brief   Initializes the detection for images of the given format and size.
+ *
+ * @param v			state to initialize
+ * @param config	classes and parameters, copied
+ * @param format	format of the pixels
+ * @param width		pixels per line, at most VISION_MAX_WIDTH
+ * @param height	lines per image
+ * @param clock		clock measuring the stages, NULL to not measure them
+ *
+ * @return			0 on success, -1 if the image or the configuration is not supported
+ */
+int8_t vision_init(vision_t *v, const vision_config_t *config, vision_format_t format,
+					uint16_t width, uint16_t height, vision_clock_t clock);
+
+/**
+ * @brief   Processes the next lines of the image. The line 0 starts a new image, the lines not given
+ * 			since the previous call are reported as missing.
+ *
+ * @param v				state of the detection
+ * @param data			first byte of the lines, following each other
+ * @param first_line	number of the first line in the image
+ * @param lines			number of lines
+ *
+ * @return				true if the last line of the image was processed, vision_get_result can then be called
+ */
+bool vision_process_lines(vision_t *v, const uint8_t *data, uint16_t first_line, uint16_t lines);
+
+/**
+ * @brief   Computes the result of the image whose last line has just been processed.
+ *
+ * @param v			state of the detection
+ * @param result	blobs, line and time spent in each stage
+ */
+void vision_get_result(vision_t *v, vision_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VISION_PROCESSING_H */
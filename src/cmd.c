@@ -1,6 +1,7 @@
 #include <math.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "hal.h"
 #include "test.h"
@@ -14,6 +15,8 @@
 #include "audio/microphone.h"
 #include "camera/camera.h"
 #include "camera/dcmi_camera.h"
+#include "camera/pixel_convert.h"
+#include "camera/vision.h"
 #include "sensors/battery_level.h"
 #include "config_flash_storage.h"
 #include "leds.h"
@@ -23,6 +26,10 @@
 #include <audio/play_sound_file.h>
 #include <audio/play_melody.h>
 #include "spi_comm.h"
+#include "i2c_bus.h"
+#include "cycle_counter.h"
+#include "sd_logger.h"
+#include "sdio.h"
 
 #define TEST_WA_SIZE        THD_WORKING_AREA_SIZE(256)
 #define SHELL_WA_SIZE   THD_WORKING_AREA_SIZE(2048)
@@ -291,7 +298,7 @@ static void cmd_sound_file_play(BaseSequentialStream *chp, int argc, char *argv[
         return;
     }
     
-    playSoundFile(argv[0],SF_FORCE_CHANGE, 44100);
+    playSoundFile(argv[0],SF_FORCE_CHANGE, 0);
 
 }
 
@@ -940,6 +947,141 @@ static void cmd_cam_send(BaseSequentialStream *chp, int argc, char **argv)
     }
 }
 
+/*
+ * Pixel conversion benchmark: each kernel and its scalar reference run on a random RGB565 image
+ * of CONVERT_BENCH_WIDTH x CONVERT_BENCH_HEIGHT pixels stored in the image buffer.
+ */
+#define CONVERT_BENCH_WIDTH     80
+#define CONVERT_BENCH_HEIGHT    60
+#define CONVERT_BENCH_PIXELS    (CONVERT_BENCH_WIDTH * CONVERT_BENCH_HEIGHT)
+#define CONVERT_BENCH_RUNS      3
+
+typedef void (*convert_bench_fn_t)(const uint8_t *src, uint8_t *dst, bool ref);
+
+static void bench_grey(const uint8_t *src, uint8_t *dst, bool ref) {
+    (ref ? pixel_rgb565_to_grey_ref : pixel_rgb565_to_grey)(src, dst, CONVERT_BENCH_PIXELS);
+}
+
+static void bench_yuv422(const uint8_t *src, uint8_t *dst, bool ref) {
+    (ref ? pixel_rgb565_to_yuv422_ref : pixel_rgb565_to_yuv422)(src, dst, CONVERT_BENCH_PIXELS);
+}
+
+static void bench_downscale2(const uint8_t *src, uint8_t *dst, bool ref) {
+    (ref ? pixel_downscale_ref : pixel_downscale)(src, dst, CONVERT_BENCH_WIDTH, CONVERT_BENCH_HEIGHT,
+                                                  PIXEL_FORMAT_RGB565, 2);
+}
+
+static void bench_downscale4(const uint8_t *src, uint8_t *dst, bool ref) {
+    (ref ? pixel_downscale_ref : pixel_downscale)(src, dst, CONVERT_BENCH_WIDTH, CONVERT_BENCH_HEIGHT,
+                                                  PIXEL_FORMAT_RGB565, 4);
+}
+
+/* Returns the lowest number of cycles of CONVERT_BENCH_RUNS runs. */
+static uint32_t bench_convert(convert_bench_fn_t fn, const uint8_t *src, uint8_t *dst, bool ref)
+{
+    uint32_t best = UINT32_MAX;
+
+    for (uint8_t i = 0; i < CONVERT_BENCH_RUNS; i++) {
+        chSysLock();
+        rtcnt_t start = chSysGetRealtimeCounterX();
+        fn(src, dst, ref);
+        uint32_t cycles = chSysGetRealtimeCounterX() - start;
+        chSysUnlock();
+        if (cycles < best) {
+            best = cycles;
+        }
+    }
+    return best;
+}
+
+static void cmd_cam_convert_bench(BaseSequentialStream *chp, int argc, char **argv)
+{
+    static const struct {
+        const char *name;
+        convert_bench_fn_t fn;
+        uint32_t out_bytes;
+    } kernels[] = {
+        {"grey", bench_grey, CONVERT_BENCH_PIXELS},
+        {"yuv422", bench_yuv422, CONVERT_BENCH_PIXELS * 2},
+        {"down2", bench_downscale2, CONVERT_BENCH_PIXELS / 2},
+        {"down4", bench_downscale4, CONVERT_BENCH_PIXELS / 8},
+    };
+    (void) argc;
+    (void) argv;
+    uint8_t *src = dcmi_get_first_buffer_ptr();
+    uint8_t *dst = src + CONVERT_BENCH_PIXELS * 2;
+    uint8_t *dst_ref = dst + CONVERT_BENCH_PIXELS * 2;
+
+    // The image buffer is overwritten, the images can't be sent meanwhile.
+    spi_comm_suspend();
+    for (uint32_t i = 0; i < CONVERT_BENCH_PIXELS * 2; i++) {
+        src[i] = rand();
+    }
+
+    chprintf(chp, "kernel   cycles/pixel   ref   match\r\n");
+    for (uint8_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        uint32_t fast = bench_convert(kernels[k].fn, src, dst, false);
+        uint32_t ref = bench_convert(kernels[k].fn, src, dst_ref, true);
+        fast = fast * 100 / CONVERT_BENCH_PIXELS;
+        ref = ref * 100 / CONVERT_BENCH_PIXELS;
+        chprintf(chp, "%-8s %6lu.%02lu %6lu.%02lu   %s\r\n", kernels[k].name, fast / 100, fast % 100,
+                 ref / 100, ref % 100, memcmp(dst, dst_ref, kernels[k].out_bytes) == 0 ? "yes" : "NO");
+    }
+    spi_comm_resume();
+}
+
+static void cmd_vision(BaseSequentialStream *chp, int argc, char **argv)
+{
+    // Red objects and a dark line at the bottom of a QQVGA image.
+    static const vision_config_t config = {
+        .classes = {{.y_min = 30, .y_max = 255, .u_min = 0, .u_max = 127, .v_min = 160, .v_max = 255}},
+        .nb_classes = 1,
+        .min_area = 20,
+        .line_first_row = 100,
+        .line_rows = 20,
+        .line_dark = 1,
+        .edge_threshold = 30,
+    };
+    static const char *stages[VISION_STAGES] = {"segment", "label", "line", "extract"};
+    messagebus_topic_t *topic;
+    vision_msg_t msg;
+
+    if (argc == 1 && !strcmp(argv[0], "start")) {
+        spi_comm_suspend();
+        if (cam_config(FORMAT_COLOR, SIZE_QQVGA) < 0 || vision_start(&config) != 0) {
+            chprintf(chp, "Cannot start the detection\r\n");
+            spi_comm_resume();
+        }
+    } else if (argc == 1 && !strcmp(argv[0], "stop")) {
+        vision_stop();
+        spi_comm_resume();
+    } else if (argc == 0) {
+        topic = messagebus_find_topic(&bus, "/vision");
+        if (topic == NULL || !messagebus_topic_read(topic, &msg, sizeof(msg))) {
+            chprintf(chp, "No image processed\r\n");
+            return;
+        }
+        chprintf(chp, "image %lu, incomplete: %d, strip overruns: %lu\r\n", msg.header.sequence,
+                 msg.result.incomplete, dcmi_get_strip_overruns());
+        for (uint8_t i = 0; i < msg.result.nb_blobs; i++) {
+            vision_blob_t *b = &msg.result.blobs[i];
+            chprintf(chp, "blob %d: class %d, area %lu, center (%d, %d), box (%d, %d)-(%d, %d)\r\n",
+                     i, b->cls, b->area, b->x, b->y, b->x_min, b->y_min, b->x_max, b->y_max);
+        }
+        if (msg.result.line.position != VISION_NO_LINE) {
+            chprintf(chp, "line: position %d, width %d, contrast %d\r\n", msg.result.line.position,
+                     msg.result.line.width, msg.result.line.contrast);
+        } else {
+            chprintf(chp, "line: not found\r\n");
+        }
+        for (uint8_t i = 0; i < VISION_STAGES; i++) {
+            chprintf(chp, "%-8s %8lu cycles\r\n", stages[i], msg.result.cycles[i]);
+        }
+    } else {
+        chprintf(chp, "Usage: vision [start|stop]\r\n");
+    }
+}
+
 static void cmd_set_led(BaseSequentialStream *chp, int argc, char **argv)
 {
     uint8_t led_num = 0;
@@ -985,12 +1127,87 @@ static void cmd_get_battery(BaseSequentialStream *chp, int argc, char **argv)
     chprintf(chp, "Battery raw value = %d\r\n", get_battery_raw());
 }
 
+static void cmd_i2c_stats(BaseSequentialStream *chp, int argc, char *argv[])
+{
+    i2c_client_stats_t stats;
+
+    if (argc == 1 && strcmp(argv[0], "reset") == 0) {
+        i2c_reset_stats();
+        return;
+    } else if (argc > 0) {
+        chprintf(chp, "Usage: i2c_stats [reset]\r\ntimes in us\r\n");
+        return;
+    }
+    chprintf(chp, "addr prio   trans   bytes  merged dropped timeout  recov    bus_time bus_max  queue_time queue_max\r\n");
+    for (uint8_t i = 0; i < I2C_MAX_CLIENTS; i++) {
+        if (i2c_get_client_stats(i, &stats) != 0) {
+            continue;
+        }
+        chprintf(chp, "0x%02x %4u %7lu %7lu %7lu %7lu %7lu %6lu %11lu %7lu %11lu %9lu\r\n",
+                 stats.addr, stats.priority, stats.transactions, stats.bytes, stats.merged,
+                 stats.dropped, stats.timeouts, stats.recoveries, stats.bus_time, stats.bus_time_max,
+                 stats.queue_time, stats.queue_time_max);
+    }
+    chprintf(chp, "last error flags: 0x%02lx\r\n", get_last_i2c_error());
+}
+
+static void cmd_spi_stats(BaseSequentialStream *chp, int argc, char *argv[])
+{
+    spi_stats_t stats;
+
+    if (argc == 1 && strcmp(argv[0], "reset") == 0) {
+        spi_reset_stats();
+        return;
+    } else if (argc == 2 && strcmp(argv[0], "flow") == 0 && strcmp(argv[1], "on") == 0) {
+        spi_flow_control_enable();
+        return;
+    } else if (argc == 2 && strcmp(argv[0], "flow") == 0 && strcmp(argv[1], "off") == 0) {
+        spi_flow_control_disable();
+        return;
+    } else if (argc > 0) {
+        chprintf(chp, "Usage: spi_stats [reset | flow on | flow off]\r\ntimes in us\r\n");
+        return;
+    }
+    spi_get_stats(&stats);
+    chprintf(chp, "frames: %lu, aborted: %lu, packets: %lu, bytes: %lu, retries: %lu\r\n",
+             stats.frames, stats.aborted, stats.packets, stats.bytes, stats.retries);
+    chprintf(chp, "frame time: %lu (max %lu)", stats.frame_time, stats.frame_time_max);
+    if (stats.frame_time > 0) {
+        uint32_t fps = 100000000 / stats.frame_time; // In hundredths.
+        chprintf(chp, ", %lu.%02lu frames/s", fps / 100, fps % 100);
+    }
+    chprintf(chp, "\r\n");
+}
+
+static void cmd_sd_log(BaseSequentialStream *chp, int argc, char *argv[])
+{
+    sd_logger_stats_t stats;
+
+    if ((argc == 2 || argc == 3) && strcmp(argv[0], "start") == 0) {
+        uint8_t sources = (argc == 3) ? (uint8_t) atoi(argv[2]) : SD_LOG_ALL;
+        if (sd_logger_start(argv[1], sources) != 0) {
+            chprintf(chp, "Cannot start the logger\r\n");
+        }
+        return;
+    } else if (argc == 1 && strcmp(argv[0], "stop") == 0) {
+        sd_logger_stop();
+    } else if (argc > 0) {
+        chprintf(chp, "Usage: sd_log [start file [sources] | stop]\r\n"
+                 "sources: mask of 1=proximity, 2=imu, 4=ground, 8=distance, 16=mic, 32=motors (default all)\r\n");
+        return;
+    }
+    sd_logger_get_stats(&stats);
+    chprintf(chp, "%s: records %lu, dropped %lu, blocks %lu, write max %lu ms%s\r\n",
+             sd_logger_is_running() ? "running" : "stopped", stats.records, stats.dropped,
+             stats.blocks, stats.write_time_max, stats.error ? ", write error" : "");
+}
+
 static void cmd_audio_play(BaseSequentialStream *chp, int argc, char *argv[])
 {
     uint16_t freq;
     if (argc != 1) {
         chprintf(chp,
-                 "Usage: audio_play freq\r\nfreq=100..20000 Hz\r\n");
+                 "Usage: audio_play freq\r\nfreq=100..16000 Hz\r\n");
     } else {
     	freq = (uint16_t) atoi(argv[0]);
         dac_play(freq);
@@ -1005,6 +1222,20 @@ static void cmd_audio_stop(BaseSequentialStream *chp, int argc, char **argv)
     dac_stop();
 }
 
+static void cmd_audio_stats(BaseSequentialStream *chp, int argc, char **argv)
+{
+    static const char *voices[AUDIO_VOICES] = {"tone", "melody", "sound file", "user"};
+    audio_stats_t stats;
+    (void) argc;
+    (void) argv;
+
+    audio_get_stats(&stats);
+    chprintf(chp, "late halves: %lu\r\n", stats.late_halves);
+    for (uint8_t i = 0; i < AUDIO_VOICES; i++) {
+        chprintf(chp, "%-10s underruns: %lu\r\n", voices[i], stats.underruns[i]);
+    }
+}
+
 static void cmd_volume(BaseSequentialStream *chp, int argc, char *argv[])
 {
     uint8_t mic;
@@ -1032,6 +1263,136 @@ static void cmd_mic_data(BaseSequentialStream *chp, int argc, char *argv[])
 	chnWrite((BaseSequentialStream *)&SDU1, (uint8_t*)mic_data, data_len);
 }
 
+/*
+ * SD card benchmark through FatFs: sequential and random transfers of a fixed size.
+ */
+#define BENCH_FILE          "BENCH.DAT"
+#define BENCH_MAX_OPS       256
+#define BENCH_DEFAULT_KB    1024
+#define BENCH_DEFAULT_CHUNK 4096
+static uint32_t bench_latencies[BENCH_MAX_OPS];
+
+static int compare_latencies(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void bench_report(BaseSequentialStream *chp, const char *name, uint32_t ops, uint32_t chunk) {
+    sdio_stats_t stats;
+    uint64_t total_us = 0;
+
+    for (uint32_t i = 0; i < ops; i++) {
+        total_us += bench_latencies[i];
+    }
+    qsort(bench_latencies, ops, sizeof(bench_latencies[0]), compare_latencies);
+    sdio_get_stats(&stats);
+    chprintf(chp, "%-10s %6lu KB/s %7lu %7lu %7lu %7lu %7lu %7lu %5lu %7lu\r\n", name,
+             total_us ? (uint32_t)((uint64_t)ops * chunk * 1000000 / 1024 / total_us) : 0,
+             bench_latencies[ops / 2], bench_latencies[ops * 9 / 10], bench_latencies[ops * 99 / 100],
+             bench_latencies[ops - 1], stats.read_cmds + stats.write_cmds,
+             stats.read_blocks + stats.write_blocks, stats.cache_hits, stats.bounced);
+}
+
+static bool bench_transfer(FIL *file, uint8_t *data, uint32_t chunk, bool write, uint32_t *latency) {
+    UINT done = 0;
+    FRESULT err;
+    rtcnt_t start = chSysGetRealtimeCounterX();
+
+    if (write) {
+        err = f_write(file, data, chunk, &done);
+    } else {
+        err = f_read(file, data, chunk, &done);
+    }
+    *latency = CYCLES_TO_US(chSysGetRealtimeCounterX() - start);
+    return err == FR_OK && done == chunk;
+}
+
+static void cmd_sd_bench(BaseSequentialStream *chp, int argc, char *argv[])
+{
+    FIL file;
+    uint32_t size_kb = (argc > 0) ? (uint32_t) atoi(argv[0]) : BENCH_DEFAULT_KB;
+    uint32_t chunk = (argc > 1) ? (uint32_t) atoi(argv[1]) : BENCH_DEFAULT_CHUNK;
+    bool unaligned = (argc > 2) && strcmp(argv[2], "unaligned") == 0;
+    // buf has 4 spare bytes to be aligned (or misaligned on purpose to test the bounce buffer).
+    uint8_t *data = (uint8_t *)(((uint32_t)buf + 3) & ~3U) + (unaligned ? 1 : 0);
+    uint32_t ops, sync_us, rng = 12345;
+    rtcnt_t start;
+    bool ok = true;
+
+    if (argc > 3 || size_kb == 0 || chunk == 0 || chunk % MMCSD_BLOCK_SIZE || chunk > MMCSD_BLOCK_SIZE * SDC_BURST_SIZE) {
+        chprintf(chp, "Usage: sd_bench [size_kb [chunk_bytes [unaligned]]]\r\n"
+                 "chunk multiple of 512 up to %u (default %u), at most %u transfers\r\n",
+                 MMCSD_BLOCK_SIZE * SDC_BURST_SIZE, BENCH_DEFAULT_CHUNK, BENCH_MAX_OPS);
+        return;
+    }
+    ops = size_kb * 1024 / chunk;
+    if (ops > BENCH_MAX_OPS) {
+        ops = BENCH_MAX_OPS;
+    } else if (ops == 0) {
+        ops = 1;
+    }
+
+    if (!mountSDCard()) {
+        chprintf(chp, "FS: f_mount() failed. Is the SD card inserted?\r\n");
+        return;
+    }
+    if (f_open(&file, BENCH_FILE, FA_READ | FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) {
+        chprintf(chp, "FS: f_open(%s) failed\r\n", BENCH_FILE);
+        return;
+    }
+    for (uint32_t i = 0; i < chunk; i++) {
+        data[i] = i;
+    }
+
+    chprintf(chp, "%lu x %lu bytes%s, latencies in us\r\n", ops, chunk, unaligned ? ", unaligned buffer" : "");
+    chprintf(chp, "test       throughput     p50     p90     p99     max    cmds  blocks  hits bounced\r\n");
+
+    sdio_reset_stats();
+    for (uint32_t i = 0; ok && i < ops; i++) {
+        ok = bench_transfer(&file, data, chunk, true, &bench_latencies[i]);
+    }
+    start = chSysGetRealtimeCounterX();
+    ok = ok && f_sync(&file) == FR_OK;
+    sync_us = CYCLES_TO_US(chSysGetRealtimeCounterX() - start);
+    if (ok) {
+        bench_report(chp, "seq write", ops, chunk);
+    }
+
+    sdio_reset_stats();
+    ok = ok && f_lseek(&file, 0) == FR_OK;
+    for (uint32_t i = 0; ok && i < ops; i++) {
+        ok = bench_transfer(&file, data, chunk, false, &bench_latencies[i]);
+    }
+    if (ok) {
+        bench_report(chp, "seq read", ops, chunk);
+    }
+
+    // Random transfers at chunk aligned offsets in the file, the seek is included.
+    for (uint8_t write = 0; write < 2; write++) {
+        sdio_reset_stats();
+        for (uint32_t i = 0; ok && i < ops; i++) {
+            rng = rng * 1103515245 + 12345;
+            uint32_t offset = ((rng >> 8) % ops) * chunk;
+            start = chSysGetRealtimeCounterX();
+            ok = f_lseek(&file, offset) == FR_OK && bench_transfer(&file, data, chunk, write, &bench_latencies[i]);
+            bench_latencies[i] = CYCLES_TO_US(chSysGetRealtimeCounterX() - start);
+        }
+        if (ok) {
+            bench_report(chp, write ? "rand write" : "rand read", ops, chunk);
+        }
+    }
+    ok = ok && f_sync(&file) == FR_OK;
+
+    if (!ok) {
+        chprintf(chp, "FS: transfer failed\r\n");
+    } else {
+        chprintf(chp, "sync after the sequential write: %lu us\r\n", sync_us);
+    }
+    f_close(&file);
+    f_unlink(BENCH_FILE);
+}
+
 void cmd_sdc(BaseSequentialStream *chp, int argc, char *argv[]) {
   static const char *mode[] = {"SDV11", "SDV20", "MMC", NULL};
   systime_t start, end;
@@ -1285,14 +1646,21 @@ const ShellCommand shell_commands[] = {
     {"cam_dcmi_unprepare", cmd_cam_dcmi_unprepare},
 	{"cam_capture", cmd_cam_capture},
 	{"cam_send", cmd_cam_send},
+	{"cam_convert_bench", cmd_cam_convert_bench},
+	{"vision", cmd_vision},
 	{"set_led", cmd_set_led},
 	{"set_speed", cmd_set_speed},
 	{"batt", cmd_get_battery},
+	{"i2c_stats", cmd_i2c_stats},
+	{"spi_stats", cmd_spi_stats},
+	{"sd_log", cmd_sd_log},
 	{"audio_play", cmd_audio_play},
 	{"audio_stop", cmd_audio_stop},
+	{"audio_stats", cmd_audio_stats},
 	{"volume", cmd_volume},
 	{"mic_data", cmd_mic_data},
 	{"sdc", cmd_sdc},
+	{"sd_bench", cmd_sd_bench},
     {NULL, NULL}
 };
 
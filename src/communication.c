@@ -106,7 +106,8 @@ static int send_battery_voltage(cmp_ctx_t *cmp)
 static int send_imu(cmp_ctx_t *cmp, imu_msg_t* imu_values)
 {
     
-    float t = (float)chVTGetSystemTimeX() / CH_CFG_ST_FREQUENCY;
+    // Capture time of the measure, not the time at which it is sent.
+    float t = (float)imu_values->header.timestamp / CH_CFG_ST_FREQUENCY;
 
     //imu_get_gyro(gyro);
     //imu_get_acc(acc);
@@ -0,0 +1,12 @@
+#ifndef CYCLE_COUNTER_H
+#define CYCLE_COUNTER_H
+
+#include <hal.h>
+
+/**
+ * Converts a number of cycles of the realtime counter (chSysGetRealtimeCounterX) to microseconds,
+ * truncated. RTC2US rounds up and can't be used with 0.
+ */
+#define CYCLES_TO_US(n)		((uint32_t)(n) / (STM32_SYSCLK / 1000000))
+
+#endif /* CYCLE_COUNTER_H */
@@ -6,13 +6,14 @@
 #define IR_RECEIVER
 
 #define IMAGE_HEADER_SIZE 3 // mode, width, height
-#define IMAGE_MAX_SIZE (BUFFER_SIZE-IMAGE_HEADER_SIZE)
+#define IMAGE_MAX_SIZE (BUFFER_SIZE-IMAGE_HEADER_SIZE-IMAGE_CODEC_HEADER_SIZE) // Room for the header of a compressed image.
 
 #include <hal.h>
 #include "../usbcfg.h"
 
 #include <main.h>
 #include "camera/dcmi_camera.h"
+#include "camera/image_codec.h"
 #include "sensors/VL53L0X/VL53L0X.h"
 #include "sensors/ground.h"
 #include "sensors/imu.h"
@@ -68,6 +69,40 @@ extern char c;
 //extern int e_ambient_ir[10];						// ambient light measurement
 //extern int e_ambient_and_reflected_ir[10];		// light when led is on
 
+static image_codec_t image_codec;
+static uint8_t image_codec_accepted = 0;	// Codecs accepted by the receiver, raw images when 0.
+static uint8_t image_codec_near = 0;
+static uint16_t image_frame = 0;
+static uint16_t image_write_index = 0;
+
+static void image_write(const uint8_t *data, uint32_t len, void *arg) {
+	(void)arg;
+	memcpy(&buffer[image_write_index], data, len);
+	image_write_index += len;
+}
+
+/*
+ * Writes the last image as a frame of image_codec.h at "start", where cam_size + IMAGE_CODEC_HEADER_SIZE
+ * bytes were reserved, and moves the answers following the image right after it.
+ *
+ * Returns the new size of the answer.
+ */
+static int write_compressed_image(uint16_t start, int end, int cam_mode, int cam_width, int cam_heigth, int cam_size) {
+	image_codec_header_t header;
+	pixel_format_t format = cam_mode == GREY_SCALE_MODE ? PIXEL_FORMAT_GREYSCALE : PIXEL_FORMAT_RGB565;
+	uint8_t *img = cam_get_last_image_ptr();
+	uint16_t reserved_end = start + IMAGE_CODEC_HEADER_SIZE + cam_size;
+
+	image_codec_prepare(&image_codec, &header, img, cam_width, cam_heigth, format,
+						image_codec_select(image_codec_accepted, format), image_codec_near, image_frame++);
+	memcpy(&buffer[start], &header, IMAGE_CODEC_HEADER_SIZE);
+	image_write_index = start + IMAGE_CODEC_HEADER_SIZE;
+	image_codec_encode(&image_codec, &header, img, image_write, NULL);
+
+	memmove(&buffer[image_write_index], &buffer[reserved_end], end - reserved_end);
+	return end - (reserved_end - image_write_index);
+}
+
 #define uart1_send_static_text(msg) do { e_send_uart1_char(msg,sizeof(msg)-1); while(e_uart1_sending()); } while(0)
 #define uart1_send_text(msg) do { e_send_uart1_char(msg,strlen(msg)); while(e_uart1_sending()); } while(0)
 #define uart2_send_static_text(msg) do { e_send_uart2_char(msg,sizeof(msg)-1); while(e_uart2_sending()); } while(0)
@@ -720,6 +755,32 @@ int run_asercom2(void) {
                         	VL53L0X_start();
                         }
 
+                        buffer[i++] = 0; // success
+
+						break;
+
+					case 0x12: // Set image compression (mask of accepted codecs, 0=raw images; largest error of a pixel for greyscale, 0=lossless)
+                        if(gumstix_connected) { // Communicate with gumstix (i2c).
+
+                        } else if (use_bt) { // Communicate with ESP32 (uart) => BT.
+                        	chSequentialStreamRead(&SD3, (uint8_t*)rx_buff, 2);
+                        } else { // Communicate with the pc (usb).
+                        	if (SDU1.config->usbp->state == USB_ACTIVE) {
+                        		chSequentialStreamRead(&SDU1, (uint8_t*)rx_buff, 2);
+                        	}
+                        	//otherwise there is no wait state, this means the other threads can not be processed
+                        	chThdSleepMilliseconds(10);
+                        }
+
+                        // In case of errors, skip the packet.
+                        if(serial_get_last_errors() != 0) {
+                        	serial_clear_last_errors();
+                        	break;
+                        }
+
+                        image_codec_accepted = rx_buff[0];
+                        image_codec_near = rx_buff[1];
+
                         buffer[i++] = 0; // success
 
 						break;
@@ -847,6 +908,9 @@ int run_asercom2(void) {
                             buffer[i++] = (char) cam_heigth & 0xff;
                             cam_start_index = i;
                             i += cam_size;
+                            if (image_codec_accepted != 0) {
+                            	i += IMAGE_CODEC_HEADER_SIZE;
+                            }
                         }
                         break;
                     case 'L': // set LED
@@ -1045,7 +1109,11 @@ int run_asercom2(void) {
                     if (wait_cam) {
                         wait_cam = 0;
                         e_poxxxx_wait_img_ready();
-                        memcpy(&buffer[cam_start_index], cam_get_last_image_ptr(), cam_size);
+                        if (image_codec_accepted != 0) {
+                        	i = write_compressed_image(cam_start_index, i, cam_mode, cam_width, cam_heigth, cam_size);
+                        } else {
+                        	memcpy(&buffer[cam_start_index], cam_get_last_image_ptr(), cam_size);
+                        }
                     }
                 }
 
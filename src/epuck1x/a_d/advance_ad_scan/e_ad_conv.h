@@ -5,7 +5,7 @@
 extern "C" {
 #endif
 
-#define MIC_SAMP_NB 160 // (MIC_BUFFER_LEN/4) = 160 samples for each microphone
+#define MIC_SAMP_NB (MIC_BUFFER_LEN/4) // 160 samples for each microphone at 16 KHz (10 ms)
 
 #define MICRO_ONLY 1
 #define ALL_ADC 0
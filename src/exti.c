@@ -21,6 +21,10 @@ static void gpio_exti_callback(EXTDriver *extp, expchannel_t channel)
         chSysLockFromISR();
         chEvtBroadcastFlagsI(&exti_events, EXTI_EVENT_IMU_INT);
         chSysUnlockFromISR();
+    } else if(channel == GPIOA_DIST_INT) {
+        chSysLockFromISR();
+        chEvtBroadcastFlagsI(&exti_events, EXTI_EVENT_TOF_INT);
+        chSysUnlockFromISR();
     }
 }
 
@@ -37,7 +41,7 @@ static const EXTConfig extcfg = {
         {EXT_CH_MODE_DISABLED, NULL},
         {EXT_CH_MODE_DISABLED, NULL},
         {EXT_CH_MODE_DISABLED, NULL},
-        {EXT_CH_MODE_DISABLED, NULL},
+        {EXT_CH_MODE_FALLING_EDGE | EXT_CH_MODE_AUTOSTART | EXT_MODE_GPIOA, gpio_exti_callback}, // Distance sensor data ready (GPIO1, active low)
         {EXT_CH_MODE_DISABLED, NULL},
         {EXT_CH_MODE_DISABLED, NULL},
         {EXT_CH_MODE_DISABLED, NULL},
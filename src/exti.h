@@ -8,6 +8,7 @@ extern "C" {
 //available flags for the exti_events
 #define EXTI_EVENT_IMU_INT 1
 #define EXTI_EVENT_IR_REMOTE_INT 2
+#define EXTI_EVENT_TOF_INT 4
 
 extern event_source_t exti_events;
 
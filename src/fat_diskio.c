@@ -0,0 +1,100 @@
+/*
+
+File    : fat_diskio.c
+
+Low level disk interface of FatFs for the micro sd card, replaces the ChibiOS bindings (fatfs_diskio.c)
+so that the transfers go through sdio_read and sdio_write (multi-block transfers and sector cache).
+
+*/
+
+#include <hal.h>
+#include <ff.h>
+#include <diskio.h>
+#include "sdio.h"
+
+#define SD_DRIVE			0
+#define SD_ERASE_BLOCK		256	// Erase block size in sectors reported to f_mkfs, as the ChibiOS bindings.
+
+DSTATUS disk_initialize(BYTE pdrv) {
+	return disk_status(pdrv);
+}
+
+DSTATUS disk_status(BYTE pdrv) {
+	DSTATUS stat = 0;
+
+	if(pdrv != SD_DRIVE) {
+		return STA_NOINIT;
+	}
+	// The card is connected by mountSDCard.
+	if(blkGetDriverState(&SDCD1) != BLK_READY) {
+		stat |= STA_NOINIT;
+	}
+	if(sdcIsWriteProtected(&SDCD1)) {
+		stat |= STA_PROTECT;
+	}
+	return stat;
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count) {
+	if(pdrv != SD_DRIVE) {
+		return RES_PARERR;
+	}
+	if(blkGetDriverState(&SDCD1) != BLK_READY) {
+		return RES_NOTRDY;
+	}
+	if(sdio_read(sector, buff, count) != HAL_SUCCESS) {
+		return RES_ERROR;
+	}
+	return RES_OK;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count) {
+	if(pdrv != SD_DRIVE) {
+		return RES_PARERR;
+	}
+	if(blkGetDriverState(&SDCD1) != BLK_READY) {
+		return RES_NOTRDY;
+	}
+	if(sdcIsWriteProtected(&SDCD1)) {
+		return RES_WRPRT;
+	}
+	if(sdio_write(sector, buff, count) != HAL_SUCCESS) {
+		return RES_ERROR;
+	}
+	return RES_OK;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff) {
+	if(pdrv != SD_DRIVE) {
+		return RES_PARERR;
+	}
+
+	switch(cmd) {
+		case CTRL_SYNC:
+			sdcSync(&SDCD1);
+			return RES_OK;
+		case GET_SECTOR_COUNT:
+			*((DWORD *)buff) = mmcsdGetCardCapacity(&SDCD1);
+			return RES_OK;
+		case GET_SECTOR_SIZE:
+			*((WORD *)buff) = MMCSD_BLOCK_SIZE;
+			return RES_OK;
+		case GET_BLOCK_SIZE:
+			*((DWORD *)buff) = SD_ERASE_BLOCK;
+			return RES_OK;
+#if _USE_ERASE
+		case CTRL_ERASE_SECTOR:
+			if(sdcErase(&SDCD1, ((DWORD *)buff)[0], ((DWORD *)buff)[1]) != HAL_SUCCESS) {
+				return RES_ERROR;
+			}
+			return RES_OK;
+#endif
+		default:
+			return RES_PARERR;
+	}
+}
+
+DWORD get_fattime(void) {
+	// No RTC, fixed date: 1 January 2018 00:00.
+	return ((DWORD)(2018 - 1980) << 25) | ((DWORD)1 << 21) | ((DWORD)1 << 16);
+}
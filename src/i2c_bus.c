@@ -1,17 +1,47 @@
 #include <string.h>
 #include <hal.h>
 #include <ch.h>
+#include <main.h>
 #include "i2c_bus.h"
+#include "cycle_counter.h"
 
 static i2cflags_t errors = 0;
 static systime_t timeout = MS2ST(4); // 4 ms
 
-void i2c_start(void) {
+// What happened to a transaction, for the statistics.
+#define TRANSACTION_MERGED		0x01
+#define TRANSACTION_DROPPED		0x02
+#define TRANSACTION_RECOVERED	0x04
 
-	if(I2CD1.state != I2C_STOP) {
-		return;
-	}
+typedef struct {
+	i2c_client_stats_t stats;
+	bool used;
+} i2c_client_t;
+
+// Default priorities: the IMU is read at a fixed rate, the cameras are only configured.
+static const struct {
+	uint8_t addr;
+	uint8_t priority;
+} default_priorities[] = {
+	{0x68, I2C_PRIORITY_HIGH},		// MPU9250 / ICM20948 (AD0 low), set again by imu_start
+	{0x69, I2C_PRIORITY_HIGH},		// MPU9250 / ICM20948 (AD0 high)
+	{0x29, I2C_PRIORITY_NORMAL},	// VL53L0X
+	{0x60, I2C_PRIORITY_LOW},		// Ground sensors extension
+	{0x6E, I2C_PRIORITY_LOW},		// PO8030 / PO6030
+	{0x21, I2C_PRIORITY_LOW},		// OV7670
+	{0x30, I2C_PRIORITY_LOW},		// OV2640
+};
+
+static i2c_client_t clients[I2C_MAX_CLIENTS];
+static i2c_transaction_t *queue = NULL;
+static BSEMAPHORE_DECL(queue_sem, true);
+static thread_t *i2cThd = NULL;
+static i2c_stats_msg_t stats_msg;
+static uint32_t busy_time = 0; // Since the last publication, in us.
 
+/***************************INTERNAL FUNCTIONS************************************/
+
+static void i2c_hw_start(void) {
     /*
      * I2C configuration structure for camera, IMU and distance sensor.
      * Set it to 400kHz fast mode
@@ -37,109 +67,534 @@ void i2c_start(void) {
     i2cStart(&I2CD1, &i2c_cfg1);
 }
 
-void i2c_stop(void) {
-	i2cStop(&I2CD1);
+ /**
+ * @brief   Returns the client of a device address, creating it if needed. Must be called in a locked state.
+ *
+ * @return  The client or NULL if the table is full
+ */
+static i2c_client_t *get_client(uint8_t addr) {
+	i2c_client_t *free_client = NULL;
+
+	for(uint8_t i=0; i<I2C_MAX_CLIENTS; i++) {
+		if(clients[i].used) {
+			if(clients[i].stats.addr == addr) {
+				return &clients[i];
+			}
+		} else if(free_client == NULL) {
+			free_client = &clients[i];
+		}
+	}
+
+	if(free_client != NULL) {
+		memset(free_client, 0, sizeof(i2c_client_t));
+		free_client->used = true;
+		free_client->stats.addr = addr;
+		free_client->stats.priority = I2C_PRIORITY_NORMAL;
+		for(uint8_t i=0; i<sizeof(default_priorities)/sizeof(default_priorities[0]); i++) {
+			if(default_priorities[i].addr == addr) {
+				free_client->stats.priority = default_priorities[i].priority;
+			}
+		}
+	}
+	return free_client;
 }
 
-void i2c_update_last_error(void) {
-	errors = i2cGetErrors(&I2CD1);
+ /**
+ * @brief   Time left before the deadline of a queued transaction, negative if it is already passed.
+ */
+static int32_t time_left(const i2c_transaction_t *t) {
+	return (int32_t)t->deadline - (int32_t)chVTTimeElapsedSinceX(t->submit_tick);
 }
 
-i2cflags_t get_last_i2c_error(void) {
-    return errors;
+ /**
+ * @brief   Inserts a transaction in the queue, sorted by priority, then by deadline, then by submission.
+ * 			Must be called in a locked state.
+ */
+static void enqueue(i2c_transaction_t *t) {
+	i2c_transaction_t **prev = &queue;
+
+	while(*prev != NULL) {
+		i2c_transaction_t *x = *prev;
+		if(x->priority < t->priority) {
+			break;
+		}
+		if(x->priority == t->priority && t->deadline != TIME_INFINITE &&
+				(x->deadline == TIME_INFINITE || time_left(x) > (int32_t)t->deadline)) {
+			break;
+		}
+		prev = &x->next;
+	}
+	t->next = *prev;
+	*prev = t;
 }
 
-int8_t read_reg(uint8_t addr, uint8_t reg, uint8_t *value) {
-	
-	uint8_t txbuf[1] = {reg};
-	uint8_t rxbuf[1] = {0};
+ /**
+ * @brief   Tells whether a transaction is a read of registers which can be merged with others.
+ */
+static bool is_mergeable_read(const i2c_transaction_t *t) {
+	return (t->flags & I2C_FLAG_MERGEABLE) && !(t->flags & I2C_FLAG_SEPARATE_READ) &&
+			t->txlen == 1 && t->rxlen > 0;
+}
+
+ /**
+ * @brief   Removes the next transaction from the queue, with the queued reads of the following
+ * 			registers of the same device if it can be merged.
+ *
+ * @param group		array of I2C_MERGE_MAX_LEN transactions to fill
+ *
+ * @return			number of transactions removed, 0 if the queue is empty
+ */
+static uint8_t dequeue(i2c_transaction_t **group) {
+	uint8_t count = 0;
+
+	chSysLock();
+	if(queue != NULL) {
+		group[count++] = queue;
+		queue = queue->next;
+
+		if(is_mergeable_read(group[0])) {
+			uint8_t addr = group[0]->addr;
+			size_t len = group[0]->rxlen;
+			bool found = true;
+			// Each merge can make another queued read contiguous, the queue is scanned again until nothing is found.
+			while(found) {
+				found = false;
+				for(i2c_transaction_t **prev = &queue; *prev != NULL; prev = &(*prev)->next) {
+					i2c_transaction_t *x = *prev;
+					if(x->addr != addr) {
+						continue;
+					}
+					// A read can't be moved before another transaction on the same device.
+					if(!is_mergeable_read(x)) {
+						break;
+					}
+					if(x->txbuf[0] == (uint8_t)(group[0]->txbuf[0] + len) && len + x->rxlen <= I2C_MERGE_MAX_LEN) {
+						*prev = x->next;
+						group[count++] = x;
+						len += x->rxlen;
+						found = true;
+						break;
+					}
+				}
+			}
+		}
+	}
+	chSysUnlock();
 
+	return count;
+}
+
+ /**
+ * @brief   Executes a transfer on the bus. Resets the bus if it is locked.
+ *
+ * @param recovered		set to true if the bus was reset
+ *
+ * @return				The status of the transfer, MSG_RESET if the bus is stopped
+ */
+static msg_t execute(uint8_t addr, const uint8_t *txbuf, size_t txlen, uint8_t *rxbuf, size_t rxlen,
+						uint8_t flags, systime_t tmo, bool *recovered) {
+	msg_t status = MSG_RESET;
+
+	*recovered = false;
 	i2cAcquireBus(&I2CD1);
 	if(I2CD1.state != I2C_STOP) {
-		msg_t status = i2cMasterTransmitTimeout(&I2CD1, addr, txbuf, 1, rxbuf, 1, timeout);
+		if(txlen == 0) {
+			status = i2cMasterReceiveTimeout(&I2CD1, addr, rxbuf, rxlen, tmo);
+		} else if(flags & I2C_FLAG_SEPARATE_READ) {
+			status = i2cMasterTransmitTimeout(&I2CD1, addr, txbuf, txlen, NULL, 0, tmo);
+			if(status == MSG_OK && rxlen > 0) {
+				status = i2cMasterReceiveTimeout(&I2CD1, addr, rxbuf, rxlen, tmo);
+			}
+		} else {
+			status = i2cMasterTransmitTimeout(&I2CD1, addr, txbuf, txlen, rxbuf, rxlen, tmo);
+		}
 		if (status != MSG_OK){
 			errors = i2cGetErrors(&I2CD1);
 			if(I2CD1.state == I2C_LOCKED){
-				i2c_stop();
-				i2c_start();
+				i2cStop(&I2CD1);
+				i2c_hw_start();
+				*recovered = true;
 			}
-			i2cReleaseBus(&I2CD1);
-			return status;
 		}
 	}
 	i2cReleaseBus(&I2CD1);
 
-	*value = rxbuf[0];
+	return status;
+}
 
-    return MSG_OK;
+ /**
+ * @brief   Updates the statistics of the client and signals the completion of a transaction.
+ */
+static void complete(i2c_transaction_t *t, msg_t status, rtcnt_t start, rtcnt_t bus_cycles, uint8_t events) {
+	uint32_t queue_time = CYCLES_TO_US(start - t->submit_time);
+	uint32_t bus_time = CYCLES_TO_US(bus_cycles);
+
+	chSysLock();
+	busy_time += bus_time;
+	i2c_client_t *client = get_client(t->addr);
+	if(client != NULL) {
+		client->stats.transactions++;
+		if(events & TRANSACTION_MERGED) {
+			client->stats.merged++;
+		}
+		if(events & TRANSACTION_DROPPED) {
+			client->stats.dropped++;
+		} else {
+			client->stats.bytes += t->txlen + t->rxlen;
+			if(status == MSG_TIMEOUT) {
+				client->stats.timeouts++;
+			}
+		}
+		if(events & TRANSACTION_RECOVERED) {
+			client->stats.recoveries++;
+		}
+		client->stats.bus_time += bus_time;
+		if(bus_time > client->stats.bus_time_max) {
+			client->stats.bus_time_max = bus_time;
+		}
+		client->stats.queue_time += queue_time;
+		if(queue_time > client->stats.queue_time_max) {
+			client->stats.queue_time_max = queue_time;
+		}
+	}
+	chSysUnlock();
+
+	t->status = status;
+	if(t->callback != NULL) {
+		t->callback(t);
+	} else {
+		chBSemSignal(&t->done);
+	}
 }
 
+ /**
+ * @brief   Copies the statistics of all the clients and computes the bus utilization since the last call.
+ */
+static void fill_stats_msg(i2c_stats_msg_t *msg) {
+	uint8_t count = 0;
 
-int8_t write_reg(uint8_t addr, uint8_t reg, uint8_t value) {
+	chSysLock();
+	for(uint8_t i=0; i<I2C_MAX_CLIENTS; i++) {
+		if(clients[i].used) {
+			msg->clients[count++] = clients[i].stats;
+		}
+	}
+	msg->count = count;
+	msg->utilization = busy_time / I2C_STATS_PERIOD; // us per ms = per thousand
+	busy_time = 0;
+	chSysUnlock();
+}
 
-	uint8_t txbuf[2] = {reg, value};
-	uint8_t rxbuf[1] = {0};
+ /**
+ * @brief   Thread which owns the bus, serves the queued transactions and publishes the statistics.
+ */
+static THD_WORKING_AREA(i2c_thd_wa, 1024);
+static THD_FUNCTION(i2c_thd, arg)
+{
+    (void) arg;
+    chRegSetThreadName(__FUNCTION__);
+
+    messagebus_topic_t i2c_stats_topic;
+    MUTEX_DECL(i2c_stats_topic_lock);
+    CONDVAR_DECL(i2c_stats_topic_condvar);
+    messagebus_topic_init(&i2c_stats_topic, &i2c_stats_topic_lock, &i2c_stats_topic_condvar, &stats_msg, sizeof(stats_msg));
+    messagebus_advertise_topic(&bus, &i2c_stats_topic, "/i2c_stats");
+
+    static uint8_t burst[I2C_MERGE_MAX_LEN];
+    i2c_transaction_t *group[I2C_MERGE_MAX_LEN];
+    uint8_t count;
+    bool recovered;
+    systime_t last_publish = chVTGetSystemTime();
+
+    while (true) {
+    	systime_t elapsed = chVTTimeElapsedSinceX(last_publish);
+    	if(elapsed >= MS2ST(I2C_STATS_PERIOD)) {
+    		last_publish += MS2ST(I2C_STATS_PERIOD);
+    		fill_stats_msg(&stats_msg);
+    		messagebus_topic_publish(&i2c_stats_topic, &stats_msg, sizeof(stats_msg));
+    		continue;
+    	}
+    	chBSemWaitTimeout(&queue_sem, MS2ST(I2C_STATS_PERIOD) - elapsed);
+
+    	while((count = dequeue(group)) > 0) {
+    		i2c_transaction_t *t = group[0];
+    		rtcnt_t start = chSysGetRealtimeCounterX();
+
+    		if(t->deadline != TIME_INFINITE && time_left(t) < 0) {
+    			complete(t, MSG_TIMEOUT, start, 0, TRANSACTION_DROPPED);
+    			// The reads merged with it are still served.
+    			if(--count == 0) {
+    				continue;
+    			}
+    			memmove(&group[0], &group[1], count * sizeof(group[0]));
+    			t = group[0];
+    		}
+
+    		if(count == 1) {
+    			msg_t status = execute(t->addr, t->txbuf, t->txlen, t->rxbuf, t->rxlen, t->flags, t->timeout, &recovered);
+    			complete(t, status, start, chSysGetRealtimeCounterX() - start, recovered ? TRANSACTION_RECOVERED : 0);
+    			continue;
+    		}
+
+    		// One burst for all the reads, starting at the register of the first one.
+    		size_t len = 0;
+    		systime_t tmo = 0;
+    		for(uint8_t i=0; i<count; i++) {
+    			len += group[i]->rxlen;
+    			if(group[i]->timeout > tmo) {
+    				tmo = group[i]->timeout;
+    			}
+    		}
+    		msg_t status = execute(t->addr, t->txbuf, 1, burst, len, 0, tmo, &recovered);
+    		// The bus time is shared between the merged transactions.
+    		rtcnt_t share = (chSysGetRealtimeCounterX() - start) / count;
+    		size_t offset = 0;
+    		for(uint8_t i=0; i<count; i++) {
+    			memcpy(group[i]->rxbuf, &burst[offset], group[i]->rxlen);
+    			offset += group[i]->rxlen;
+    			// The recovery is only counted once.
+    			complete(group[i], status, start, share, TRANSACTION_MERGED | ((recovered && i == 0) ? TRANSACTION_RECOVERED : 0));
+    		}
+    	}
+    }
+}
+
+/*************************END INTERNAL FUNCTIONS**********************************/
+
+
+/****************************PUBLIC FUNCTIONS*************************************/
+
+void i2c_start(void) {
 
-	i2cAcquireBus(&I2CD1);
 	if(I2CD1.state != I2C_STOP) {
-		msg_t status = i2cMasterTransmitTimeout(&I2CD1, addr, txbuf, 2, rxbuf, 0, timeout);
-		if (status != MSG_OK){
-			errors = i2cGetErrors(&I2CD1);
-			if(I2CD1.state == I2C_LOCKED){
-				i2c_stop();
-				i2c_start();
+		return;
+	}
+
+	i2c_hw_start();
+
+	if(i2cThd == NULL) {
+		// Above the clients so that the queue is served as soon as the bus is free.
+		i2cThd = chThdCreateStatic(i2c_thd_wa, sizeof(i2c_thd_wa), NORMALPRIO + 1, i2c_thd, NULL);
+	}
+}
+
+void i2c_stop(void) {
+	// Waits for the end of the transfer in progress.
+	i2cAcquireBus(&I2CD1);
+	i2cStop(&I2CD1);
+	i2cReleaseBus(&I2CD1);
+}
+
+void i2c_update_last_error(void) {
+	errors = i2cGetErrors(&I2CD1);
+}
+
+i2cflags_t get_last_i2c_error(void) {
+    return errors;
+}
+
+void i2c_transaction_init(i2c_transaction_t *t, uint8_t addr, const uint8_t *txbuf, size_t txlen,
+							uint8_t *rxbuf, size_t rxlen) {
+	memset(t, 0, sizeof(i2c_transaction_t));
+	t->addr = addr;
+	t->txbuf = txbuf;
+	t->txlen = txlen;
+	t->rxbuf = rxbuf;
+	t->rxlen = rxlen;
+	t->deadline = TIME_INFINITE;
+	t->timeout = timeout;
+}
+
+void i2c_submit(i2c_transaction_t *t) {
+	i2c_submit_multi(t, 1);
+}
+
+void i2c_submit_multi(i2c_transaction_t *t, uint8_t count) {
+	// Nothing can be transferred before i2c_start, the transactions are completed at once.
+	if(i2cThd == NULL) {
+		for(uint8_t i=0; i<count; i++) {
+			t[i].status = MSG_RESET;
+			chBSemObjectInit(&t[i].done, false);
+			if(t[i].callback != NULL) {
+				t[i].callback(&t[i]);
 			}
-			i2cReleaseBus(&I2CD1);
-			return status;
 		}
+		return;
 	}
-	i2cReleaseBus(&I2CD1);
+
+	for(uint8_t i=0; i<count; i++) {
+		chBSemObjectInit(&t[i].done, true);
+		t[i].status = MSG_OK;
+	}
+
+	chSysLock();
+	for(uint8_t i=0; i<count; i++) {
+		i2c_client_t *client = get_client(t[i].addr);
+		t[i].priority = (client != NULL) ? client->stats.priority : I2C_PRIORITY_NORMAL;
+		t[i].submit_time = chSysGetRealtimeCounterX();
+		t[i].submit_tick = chVTGetSystemTimeX();
+		enqueue(&t[i]);
+	}
+	chBSemSignalI(&queue_sem);
+	chSchRescheduleS();
+	chSysUnlock();
+}
+
+msg_t i2c_wait(i2c_transaction_t *t) {
+	chBSemWait(&t->done);
+	return t->status;
+}
+
+msg_t i2c_transfer(i2c_transaction_t *t) {
+	i2c_submit(t);
+	return i2c_wait(t);
+}
+
+int8_t i2c_set_priority(uint8_t addr, uint8_t priority) {
+	int8_t ret = -1;
+
+	chSysLock();
+	i2c_client_t *client = get_client(addr);
+	if(client != NULL) {
+		client->stats.priority = priority;
+		ret = 0;
+	}
+	chSysUnlock();
+
+	return ret;
+}
+
+int8_t i2c_get_client_stats(uint8_t index, i2c_client_stats_t *stats) {
+	int8_t ret = -1;
+
+	if(index >= I2C_MAX_CLIENTS) {
+		return -1;
+	}
+
+	chSysLock();
+	if(clients[index].used) {
+		*stats = clients[index].stats;
+		ret = 0;
+	}
+	chSysUnlock();
+
+	return ret;
+}
+
+void i2c_reset_stats(void) {
+	chSysLock();
+	for(uint8_t i=0; i<I2C_MAX_CLIENTS; i++) {
+		if(clients[i].used) {
+			uint8_t addr = clients[i].stats.addr;
+			uint8_t priority = clients[i].stats.priority;
+			memset(&clients[i].stats, 0, sizeof(i2c_client_stats_t));
+			clients[i].stats.addr = addr;
+			clients[i].stats.priority = priority;
+		}
+	}
+	chSysUnlock();
+}
+
+int8_t read_reg(uint8_t addr, uint8_t reg, uint8_t *value) {
+
+	uint8_t txbuf[1] = {reg};
+	uint8_t rxbuf[1] = {0};
+	i2c_transaction_t t;
+
+	i2c_transaction_init(&t, addr, txbuf, 1, rxbuf, 1);
+	msg_t status = i2c_transfer(&t);
+	if (status != MSG_OK){
+		return status;
+	}
+
+	*value = rxbuf[0];
 
     return MSG_OK;
 }
 
+
+int8_t write_reg(uint8_t addr, uint8_t reg, uint8_t value) {
+
+	uint8_t txbuf[2] = {reg, value};
+	i2c_transaction_t t;
+
+	i2c_transaction_init(&t, addr, txbuf, 2, NULL, 0);
+	return i2c_transfer(&t);
+}
+
 int8_t read_reg_multi(uint8_t addr, uint8_t reg, uint8_t *buf, int8_t len) {
 
-	i2cAcquireBus(&I2CD1);
-	if(I2CD1.state != I2C_STOP) {
-		msg_t status = i2cMasterTransmitTimeout(&I2CD1, addr, &reg, 1, buf, len, timeout);
-		if (status != MSG_OK){
-			errors = i2cGetErrors(&I2CD1);
-			if(I2CD1.state == I2C_LOCKED){
-				i2c_stop();
-				i2c_start();
+	i2c_transaction_t t;
+
+	i2c_transaction_init(&t, addr, &reg, 1, buf, len);
+	return i2c_transfer(&t);
+}
+
+typedef struct {
+	binary_semaphore_t done;
+	systime_t time;
+} timed_read_t;
+
+static void timed_read_cb(i2c_transaction_t *t) {
+	timed_read_t *read = t->arg;
+
+	read->time = chVTGetSystemTime();
+	chBSemSignal(&read->done);
+}
+
+int8_t read_reg_multi_time(uint8_t addr, uint8_t reg, uint8_t *buf, int8_t len, systime_t *time) {
+
+	i2c_transaction_t t;
+	timed_read_t read;
+
+	chBSemObjectInit(&read.done, true);
+	i2c_transaction_init(&t, addr, &reg, 1, buf, len);
+	t.callback = timed_read_cb;
+	t.arg = &read;
+	i2c_submit(&t);
+	chBSemWait(&read.done);
+	*time = read.time;
+	return t.status;
+}
+
+int8_t read_reg_fifo(uint8_t addr, uint8_t reg, uint8_t *buf, uint16_t len, uint8_t chunk) {
+
+	i2c_transaction_t t[I2C_FIFO_MAX_CHUNKS];
+	msg_t status = MSG_OK;
+
+	while(len > 0) {
+		uint8_t count = 0;
+		while(len > 0 && count < I2C_FIFO_MAX_CHUNKS) {
+			uint8_t n = (len > chunk) ? chunk : len;
+			i2c_transaction_init(&t[count++], addr, &reg, 1, buf, n);
+			buf += n;
+			len -= n;
+		}
+		// All the transactions are queued at once, the scheduler then serves them back to back
+		// and the clients of lower priority can't come in between.
+		i2c_submit_multi(t, count);
+		for(uint8_t i=0; i<count; i++) {
+			msg_t err = i2c_wait(&t[i]);
+			if(status == MSG_OK) {
+				status = err;
 			}
-			i2cReleaseBus(&I2CD1);
+		}
+		if(status != MSG_OK) {
 			return status;
 		}
 	}
-	i2cReleaseBus(&I2CD1);
-
 	return MSG_OK;
 }
 
 int8_t write_reg_multi(uint8_t addr, uint8_t reg, uint8_t *buf, int8_t len) {
 
     uint8_t txbuf[len + 1]; 		// Create a buffer for transmission
-    uint8_t rxbuf[1] = {0};
     txbuf[0] = reg;         		// First byte is the register address
     memcpy(&txbuf[1], buf, len);	// Copy data into txbuf
+	i2c_transaction_t t;
 
-	i2cAcquireBus(&I2CD1);
-	if(I2CD1.state != I2C_STOP) {
-		msg_t status = i2cMasterTransmitTimeout(&I2CD1, addr, txbuf, len+1, rxbuf, 0, timeout);
-		if (status != MSG_OK){
-			errors = i2cGetErrors(&I2CD1);
-			if(I2CD1.state == I2C_LOCKED){
-				i2c_stop();
-				i2c_start();
-			}
-			i2cReleaseBus(&I2CD1);
-			return status;
-		}
-	}
-	i2cReleaseBus(&I2CD1);
-
-	return MSG_OK;
+	i2c_transaction_init(&t, addr, txbuf, len+1, NULL, 0);
+	return i2c_transfer(&t);
 }
 
+/**************************END PUBLIC FUNCTIONS***********************************/
@@ -7,8 +7,100 @@ extern "C" {
 
 #include <hal.h>
 
+/**
+ * All the transfers on I2CD1 go through a transaction queue served by a single scheduler thread.
+ * The pending transactions are served by priority (the priority is set per client, i.e. per
+ * device address, and can be changed with i2c_set_priority), then by deadline, then in submission order. A transfer in progress is never
+ * interrupted, so a high priority client waits at most for the end of the current transaction.
+ *
+ * The blocking functions (read_reg, write_reg, ...) submit a transaction and wait for it, the
+ * i2c_submit function lets a client queue several transactions before waiting for them, or be
+ * notified of their completion by a callback. Queued reads of consecutive registers of a device can
+ * be merged in a single burst. A transaction with a deadline is dropped if it could not be started
+ * in time, so that a client never works on stale data when the bus is congested.
+ */
+
+/* Client priorities, the highest value is served first. */
+#define I2C_PRIORITY_LOW		0
+#define I2C_PRIORITY_NORMAL		1
+#define I2C_PRIORITY_HIGH		2
+
+/* Maximum number of clients (device addresses) for which a priority and statistics are kept. */
+#define I2C_MAX_CLIENTS			8
+
+/* Maximum length of a burst obtained by merging several register reads. */
+#define I2C_MERGE_MAX_LEN		32
+
+/* Maximum number of transactions queued at once by read_reg_fifo. */
+#define I2C_FIFO_MAX_CHUNKS		8
+
+/* Transaction flags. */
+/* The read can be merged with the queued reads of the following registers of the same device.
+ * Only set it for registers which can be read in burst (auto increment of the register address). */
+#define I2C_FLAG_MERGEABLE		0x01
+/* The register address and the read are sent as two transfers separated by a stop condition (SCCB). */
+#define I2C_FLAG_SEPARATE_READ	0x02
+
+typedef struct i2c_transaction i2c_transaction_t;
+
+/**
+ * Completion callback, called from the scheduler thread. It must not block.
+ * It replaces the semaphore: a transaction with a callback can't be waited with i2c_wait.
+ * The transaction can be submitted again from its callback.
+ */
+typedef void (*i2c_callback_t)(i2c_transaction_t *t);
+
+/** I2C transaction. It must stay valid (not on a stack which is freed) until its completion. */
+struct i2c_transaction {
+	uint8_t addr;				// 7bits address of the device
+	const uint8_t *txbuf;		// bytes to send, the first one is the register address for a read
+	size_t txlen;				// 0 for a receive only transaction
+	uint8_t *rxbuf;
+	size_t rxlen;				// 0 for a write
+	uint8_t flags;				// I2C_FLAG_xxx
+	systime_t deadline;			// maximum time in the queue, TIME_INFINITE for no limit
+	systime_t timeout;			// timeout of the transfer on the bus
+	i2c_callback_t callback;	// can be NULL
+	void *arg;					// free for the user of the callback
+
+	/* Filled by the scheduler. */
+	msg_t status;				// MSG_OK, MSG_TIMEOUT (transfer or deadline) or MSG_RESET (bus error or stopped)
+	rtcnt_t submit_time;
+	systime_t submit_tick;
+	binary_semaphore_t done;
+	i2c_transaction_t *next;
+	uint8_t priority;
+};
+
+/** Statistics of a client, the times are in microseconds. */
+typedef struct {
+	uint8_t addr;
+	uint8_t priority;
+	uint32_t transactions;		// completed transactions (with or without error)
+	uint32_t bytes;				// bytes sent and received, register addresses included
+	uint32_t merged;			// transactions served in a burst with another one
+	uint32_t dropped;			// transactions removed from the queue because of their deadline
+	uint32_t timeouts;			// transfers which timed out on the bus
+	uint32_t recoveries;		// resets of the bus after a transfer left it in the I2C_LOCKED state
+	uint32_t bus_time;			// total time the bus was held
+	uint32_t bus_time_max;
+	uint32_t queue_time;		// total time spent waiting in the queue
+	uint32_t queue_time_max;
+} i2c_client_stats_t;
+
+/* Period of publication of the statistics on the /i2c_stats topic, in ms. */
+#define I2C_STATS_PERIOD		1000
+
+/** Struct containing the statistics message. */
+typedef struct {
+	i2c_client_stats_t clients[I2C_MAX_CLIENTS];
+	uint8_t count;				// number of valid entries in clients
+	uint16_t utilization;		// time the bus was held during the last period, per thousand
+} i2c_stats_msg_t;
+
 /**
  * @brief Starts the I2C interface
+ * 		  The statistics of all the clients are broadcast every I2C_STATS_PERIOD ms on the /i2c_stats topic.
  */
 void i2c_start(void);
 
@@ -72,6 +164,111 @@ int8_t write_reg_multi(uint8_t addr, uint8_t reg, uint8_t *buf, int8_t len);
 
 void i2c_update_last_error(void);
 
+/**
+ * @brief 		Reads a FIFO register (no auto increment of the register address) in several transactions,
+ * 				all queued at once so that they are served back to back.
+ *
+ * @param addr	8bits address of the peripherical to read from
+ * @param reg	8bits address of the FIFO register
+ * @param buf	Pointer to a buffer used to store the values read
+ * @param len	Number of bytes to read
+ * @param chunk	Maximum number of bytes read by each transaction
+ *
+ * @return		The error code. msg_t format
+ */
+int8_t read_reg_fifo(uint8_t addr, uint8_t reg, uint8_t *buf, uint16_t len, uint8_t chunk);
+
+/**
+ * @brief 		Same as read_reg_multi, also gives the system time at which the transfer ended. The time
+ * 				is taken by the completion callback, before the caller is scheduled again.
+ *
+ * @param addr	8bits address of the peripherical to read from
+ * @param reg	8bits address of the register to read
+ * @param buf	Pointer to a buffer used to store the values read
+ * @param len	Length of the requested read. the buf must be this size or greater
+ * @param time	Pointer to store the time at which the transfer ended
+ *
+ * @return		The error code. msg_t format
+ */
+int8_t read_reg_multi_time(uint8_t addr, uint8_t reg, uint8_t *buf, int8_t len, systime_t *time);
+
+/**
+ * @brief 			Fills a transaction with the default values: same 4 ms bus timeout as the blocking
+ * 					functions, no deadline, no flag and no callback.
+ *
+ * @param t			Transaction to initialize
+ * @param addr		7bits address of the device
+ * @param txbuf		Bytes to send
+ * @param txlen		Number of bytes to send
+ * @param rxbuf		Buffer for the bytes read
+ * @param rxlen		Number of bytes to read
+ */
+void i2c_transaction_init(i2c_transaction_t *t, uint8_t addr, const uint8_t *txbuf, size_t txlen,
+							uint8_t *rxbuf, size_t rxlen);
+
+/**
+ * @brief 			Queues a transaction and returns immediately.
+ * 					The completion can be waited with i2c_wait or notified by the callback of the transaction.
+ * 					Before i2c_start the transaction is completed at once with the MSG_RESET status, its
+ * 					callback is then called by i2c_submit.
+ *
+ * @param t			Transaction to queue
+ */
+void i2c_submit(i2c_transaction_t *t);
+
+/**
+ * @brief 			Queues several transactions at once, as i2c_submit. They are all in the queue before
+ * 					the first one is served, so the mergeable reads among them are served in a single burst.
+ *
+ * @param t			Array of transactions to queue
+ * @param count		Number of transactions
+ */
+void i2c_submit_multi(i2c_transaction_t *t, uint8_t count);
+
+/**
+ * @brief 			Waits for the completion of a submitted transaction.
+ *
+ * @param t			Transaction to wait for
+ *
+ * @return			The status of the transaction. msg_t format
+ */
+msg_t i2c_wait(i2c_transaction_t *t);
+
+/**
+ * @brief 			Submits a transaction and waits for its completion.
+ *
+ * @param t			Transaction to execute
+ *
+ * @return			The status of the transaction. msg_t format
+ */
+msg_t i2c_transfer(i2c_transaction_t *t);
+
+/**
+ * @brief 			Sets the priority of the transactions of a client.
+ * 					It applies to the transactions submitted afterwards.
+ *
+ * @param addr		7bits address of the device
+ * @param priority	I2C_PRIORITY_LOW, I2C_PRIORITY_NORMAL or I2C_PRIORITY_HIGH
+ *
+ * @return			0 on success, -1 if there are already I2C_MAX_CLIENTS clients
+ */
+int8_t i2c_set_priority(uint8_t addr, uint8_t priority);
+
+/**
+ * @brief 			Gets the statistics of a client since the start.
+ *
+ * @param index		Index of the client, between 0 and I2C_MAX_CLIENTS-1
+ * @param stats		Pointer to store the statistics
+ *
+ * @return			0 on success, -1 if there is no client at this index
+ */
+int8_t i2c_get_client_stats(uint8_t index, i2c_client_stats_t *stats);
+
+/**
+ * @brief 			Clears the statistics of all the clients. The priorities are kept.
+ */
+void i2c_reset_stats(void);
+
 #ifdef __cplusplus
 }
 #endif
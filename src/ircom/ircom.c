@@ -45,6 +45,7 @@
 #define EXTSEL_TIM2_CH2 0x03
 
 #define IRCOM_PROX_TRIGGER 2460 // Trigger proximity sampling procedure every 81.3 usec * IRCOM_PROX_TRIGGER
+#define IRCOM_PROX_RATE (PWM_FREQUENCY / IRCOM_PROX_TRIGGER) // Complete scans of the sensors per second (5 Hz).
 
 volatile unsigned int ircom_last_ir_scan_id = 0;
 volatile int ircom_samples_to_skip = 0;
@@ -56,6 +57,7 @@ volatile IrcomSend ircomSendData;
 static BSEMAPHORE_DECL(adc2_ready, true);
 static adcsample_t adc2_proximity_samples[PROXIMITY_NB_CHANNELS * DMA_BUFFER_SIZE];
 static proximity_msg_t prox_values;
+static systime_t adc2_capture_time = 0; // End of the last measure.
 int16_t adc_buffer1[PROXIMITY_NB_CHANNELS * IRCOM_SAMPLING_WINDOW];
 int16_t adc_buffer2[PROXIMITY_NB_CHANNELS * IRCOM_SAMPLING_WINDOW];
 int16_t *window_sampling;
@@ -212,6 +214,7 @@ void proximity_interrupt(adcsample_t *samples) {
 
     /* Signal the proximity thread that the ADC measurements are done. */
     chSysLockFromISR();
+    adc2_capture_time = chVTGetSystemTimeX();
     chBSemSignalI(sem);
     chSysUnlockFromISR();
 }
@@ -341,6 +344,8 @@ static THD_FUNCTION(proximity_thd, arg)
 
     	chBSemWait(&adc2_ready);
 
+    	// Same header as the measures of proximity.c, the sd logger relies on the sequence.
+    	sensor_header_stamp(&prox_values.header, adc2_capture_time, IRCOM_PROX_RATE);
         messagebus_topic_publish(&proximity_topic, &prox_values, sizeof(prox_values));
 
         if(calibrationInProgress) {
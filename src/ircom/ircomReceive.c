@@ -148,118 +148,23 @@ void ircomReceiveWord(void) {
 }
 
 int8_t ircomReceiveGetMaxSensor(void) {
-    //find the ir sensor with most interesting signal
-    int i;
-
-    int maxDiff = 0;
-    int maxSensor = -1;
-
-    for (i = 0; i < PROXIMITY_NB_CHANNELS; i++) {
-		int index = i, j = 0, min = 4096, max = 0;
-		for (j = 0; j < IRCOM_SAMPLING_WINDOW; j++)
-		{
-		    int v = window_data[index];
-		    if (v < min)
-		    {
-				min = v;
-		    }
-		    else if (v > max)
-		    {
-				max = v;
-		    }
-		    index += PROXIMITY_NB_CHANNELS;
-		}
-
-		if (max - min > maxDiff)
-		{
-		    maxDiff = max - min;
-		    maxSensor = i;
-		}
-    }
-
-    if (maxDiff < IRCOM_DETECTION_THRESHOLD_AMPLITUDE)
-	return -1;
-
-    return maxSensor;
+    return ircomWindowMaxSensor(window_data);
 }
 
 int16_t ircomReceiveDemodulate(uint8_t rawOutput) {
-    int maxSensor = ircomReceiveData.receivingSensor;
+    int amplitude;
 
-    // demodulate signal
-    //now we have the threshold and can normalize the signal if needed
-    static int rs[IRCOM_SAMPLING_WINDOW];
-    int i, u;
-    for (i = 0, u = maxSensor; i < IRCOM_SAMPLING_WINDOW; i++, u += PROXIMITY_NB_CHANNELS)
-    {
-		rs[i] = window_data[u];
-    }
-
-    // find max amplitude of signal
-    int min = 4096, max = 0;
-    for (i = 0; i < IRCOM_SAMPLING_WINDOW; i++)
-    {
-		if (rs[i] < min)
-		{
-		    min = rs[i];
-		}
-		else if (rs[i] > max)
-		{
-		    max = rs[i];
-		}
-    }
-    if (max - min < IRCOM_DETECTION_THRESHOLD_AMPLITUDE)
+    // demodulate signal: count number of switch around mean signal
+    int switchCount = ircomWindowSwitchCount(window_data, ircomReceiveData.receivingSensor, &amplitude);
+    if (switchCount < 0)
 	return -1;
 
-    // compute mean signal
-    long int tmp = 0;
-    for (i = 0; i < IRCOM_SAMPLING_WINDOW; i++)
-    {
-		tmp += rs[i];
-    }
-    int mean = (int)(tmp / IRCOM_SAMPLING_WINDOW);
-
-    // substract mean from signal
-    for (i = 0; i < IRCOM_SAMPLING_WINDOW; i++)
-    {
-		rs[i] -= mean;
-    }
-
-    // start counting number of switch around mean signal
-    int signalState;
-    if (rs[0] > 0)
-    	signalState = 1;
-    else
-    	signalState = -1;
-
-    int switchCount = 0;
-
-    for (i = 1; i < IRCOM_SAMPLING_WINDOW; i++)
-    {
-		if(rs[i] > 0)
-		{
-		    if (signalState < 0)
-		    {
-				signalState = 1;
-				switchCount++;
-		    }
-		}
-		else
-		{
-		    if (signalState > 0)
-		    {
-				signalState = -1;
-				switchCount++;
-		    }
-		}
-    }
-
     if (rawOutput)
     	return switchCount;
 
     if (switchCount >= IRCOM_MARK_THRESHOLD)	//8
 	{
-		ircomReceiveData.distance = max - min;
+		ircomReceiveData.distance = amplitude;
 		return IRCOM_MARK;
 	}
     else if (switchCount >= IRCOM_SPACE_THRESHOLD) //4
@@ -94,6 +94,99 @@ long int ircomBin2Int(volatile ircomWord w)
     return n;
 }
 
+int8_t ircomWindowMaxSensor(const int16_t *window) {
+    //find the ir sensor with most interesting signal
+    int i;
+
+    int maxDiff = 0;
+    int maxSensor = -1;
+
+    for (i = 0; i < PROXIMITY_NB_CHANNELS; i++) {
+		int index = i, j = 0, min = 4096, max = 0;
+		for (j = 0; j < IRCOM_SAMPLING_WINDOW; j++)
+		{
+		    int v = window[index];
+		    if (v < min)
+		    {
+				min = v;
+		    }
+		    else if (v > max)
+		    {
+				max = v;
+		    }
+		    index += PROXIMITY_NB_CHANNELS;
+		}
+
+		if (max - min > maxDiff)
+		{
+		    maxDiff = max - min;
+		    maxSensor = i;
+		}
+    }
+
+    if (maxDiff < IRCOM_DETECTION_THRESHOLD_AMPLITUDE)
+	return -1;
+
+    return maxSensor;
+}
+
+int16_t ircomWindowSwitchCount(const int16_t *window, int sensor, int *amplitude) {
+    int i, u;
+
+    // find max amplitude and mean of signal
+    int min = 4096, max = 0;
+    long int tmp = 0;
+    for (i = 0, u = sensor; i < IRCOM_SAMPLING_WINDOW; i++, u += PROXIMITY_NB_CHANNELS)
+    {
+		int v = window[u];
+		if (v < min)
+		{
+		    min = v;
+		}
+		else if (v > max)
+		{
+		    max = v;
+		}
+		tmp += v;
+    }
+    *amplitude = max - min;
+    if (max - min < IRCOM_DETECTION_THRESHOLD_AMPLITUDE)
+	return -1;
+
+    int mean = (int)(tmp / IRCOM_SAMPLING_WINDOW);
+
+    // count number of switch around mean signal
+    int signalState;
+    if (window[sensor] - mean > 0)
+    	signalState = 1;
+    else
+    	signalState = -1;
+
+    int switchCount = 0;
+
+    for (i = 1, u = sensor + PROXIMITY_NB_CHANNELS; i < IRCOM_SAMPLING_WINDOW; i++, u += PROXIMITY_NB_CHANNELS)
+    {
+		if(window[u] - mean > 0)
+		{
+		    if (signalState < 0)
+		    {
+				signalState = 1;
+				switchCount++;
+		    }
+		}
+		else
+		{
+		    if (signalState > 0)
+		    {
+				signalState = -1;
+				switchCount++;
+		    }
+		}
+    }
+
+    return switchCount;
+}
+
 long int ircomGetTime( void )
 {
 	return ircomData.time;
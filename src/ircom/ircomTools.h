@@ -55,6 +55,22 @@ void ircomInt2Bin (long int n, ircomWord w);
 */
 long int ircomBin2Int(volatile ircomWord w);
 
+/**
+* @brief Find the sensor perceiving the most significant signal in a sampling window.
+* @param window sampling window: IRCOM_SAMPLING_WINDOW samples of the PROXIMITY_NB_CHANNELS sensors, interleaved.
+* @return sensor id or -1 if no sensor perceives a signal with enough amplitude.
+*/
+int8_t ircomWindowMaxSensor(const int16_t *window);
+
+/**
+* @brief Count how many times the signal of a sensor crosses its mean value in a sampling window.
+* @param window sampling window: IRCOM_SAMPLING_WINDOW samples of the PROXIMITY_NB_CHANNELS sensors, interleaved.
+* @param sensor sensor id.
+* @param amplitude output: peak to peak amplitude of the signal.
+* @return number of switches or -1 if the amplitude of the signal is too low.
+*/
+int16_t ircomWindowSwitchCount(const int16_t *window, int sensor, int *amplitude);
+
 /**
 * @brief 	Get the current time ticks that are increased in the timer14 interrupt.
 *			When in reception mode the interrupt has an interval of 100 us.
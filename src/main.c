@@ -17,6 +17,7 @@
 #include "audio/play_sound_file.h"
 #include "audio/microphone.h"
 #include "camera/camera.h"
+#include "camera/pixel_convert.h"
 #include "epuck1x/Asercom.h"
 #include "epuck1x/Asercom2.h"
 #include "epuck1x/a_d/advance_ad_scan/e_acc.h"
@@ -90,7 +91,7 @@ static THD_FUNCTION(selector_thd, arg)
 
     uint8_t hw_test_state = 0;
     uint8_t *img_buff_ptr;
-    uint16_t r = 0, g = 0, b = 0;
+    uint8_t red = 0, green = 0, blue = 0;
     uint8_t rgb_state = 0, rgb_counter = 0;
     uint16_t melody_state = 0, melody_counter = 0;
     int8_t cam_error = 0;
@@ -498,7 +499,7 @@ static THD_FUNCTION(selector_thd, arg)
 				}
 				break;
 
-			case 7: // Play a wav (mono, 16 KHz) named "example.wav" from the micro sd when pressing the button. At each press the playback volume is also increased by 10%.
+			case 7: // Play a wav (8 to 48 KHz, mono or stereo) named "example.wav" from the micro sd when pressing the button. At each press the playback volume is also increased by 10%.
 				switch(wav_play_state) {
 					case 0:
 						if(mountSDCard()) {
@@ -520,7 +521,7 @@ static THD_FUNCTION(selector_thd, arg)
 						break;
 
 					case 3:
-						playSoundFile("example.wav", SF_FORCE_CHANGE, 16000);
+						playSoundFile("example.wav", SF_FORCE_CHANGE, 0);
 						waitSoundFileHasFinished();
 						if(wav_volume == 100) {
 							wav_volume = 0;
@@ -758,10 +759,8 @@ static THD_FUNCTION(selector_thd, arg)
 							dcmi_capture_start();
 							wait_image_ready();
 							img_buff_ptr = cam_get_last_image_ptr();
-							r = (int)img_buff_ptr[0]&0xF8;
-							g = (int)(img_buff_ptr[0]&0x07)<<5 | (img_buff_ptr[1]&0xE0)>>3;
-							b = (int)(img_buff_ptr[1]&0x1F)<<3;
-							chprintf((BaseSequentialStream *)&SDU1, "R=%3d, G=%3d, B=%3d\r\n", r, g, b);
+							pixel_rgb565_unpack(img_buff_ptr, &red, &green, &blue);
+							chprintf((BaseSequentialStream *)&SDU1, "R=%3d, G=%3d, B=%3d\r\n", red, green, blue);
 							chprintf((BaseSequentialStream *)&SDU1, "DCMI err = %d\r\n\n", dcmi_get_error());
 							dcmi_reset_error();
 							spi_comm_resume();
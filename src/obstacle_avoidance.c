@@ -0,0 +1,44 @@
+#include "obstacle_avoidance.h"
+
+void obstacle_avoidance_compute(int16_t *p, int32_t target_left, int32_t target_right, int32_t *left_speed, int32_t *right_speed) {
+	int32_t sum_sensors_x = 0, sum_sensors_y = 0;
+
+	// Position of the robot sensors:
+	//		forward
+	//
+	//		  7	  0 (15 deg)
+	//		6		1 (45 deg)
+	//	velL	x	 velR
+	//	  |		|	  |
+	//	  5	  y_0	  2
+	//
+	//		 4	   3 (150 deg)
+	//
+	// The following table shows the weights (simplified respect to the trigonometry) of all the proximity sensors for the resulting repulsive force:
+	//  Prox	0		1		2		3		4		5		6		7
+	//	x		-1		-0.5	0		0.75	0.75	0		-0.5	-1
+	//	y		0.5	0.5		1		0.5		-0.5	-1		-0.5	-0.5
+
+	// Consider small values to be noise thus set them to zero in order to not influence the resulting force.
+	for(uint8_t i=0; i<8; i++) {
+		if(p[i] < OA_NOISE_THR) {
+			p[i] = 0;
+		}
+	}
+
+	// Sum the contribution of each sensor (based on the previous weights table).
+	sum_sensors_x = -p[0] - (p[1]>>1) + (p[3]-(p[3]>>2)) + (p[4]-(p[4]>>2)) - (p[6]>>1) - p[7];
+	sum_sensors_y = (p[0]>>1) + (p[1]>>1) + p[2] + (p[3]>>1) - (p[4]>>1) - p[5] - (p[6]>>1) - (p[7]>>1);
+
+	// Modify the velocity components based on sensor values.
+	if(target_left >= 0) {
+		*left_speed = target_left + ((sum_sensors_x>>1) - (sum_sensors_y*4));
+	} else {
+		*left_speed = target_left - ((sum_sensors_x>>1) + (sum_sensors_y*4));
+	}
+	if(target_right >=0) {
+		*right_speed = target_right + ((sum_sensors_x>>1) + (sum_sensors_y*4));
+	} else {
+		*right_speed = target_right - ((sum_sensors_x>>1) - (sum_sensors_y*4));
+	}
+}
@@ -0,0 +1,27 @@
+#ifndef OBSTACLE_AVOIDANCE_H
+#define OBSTACLE_AVOIDANCE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define OA_NOISE_THR 5 // Calibrated proximity values lower than this threshold are considered noise.
+
+/**
+* @brief   Computes the motors speed based on a simplified force field method.
+*
+* @param prox			calibrated proximity values of the 8 sensors, values lower than OA_NOISE_THR are set to zero
+* @param target_left	desired left speed in step/s when no obstacles detected
+* @param target_right	desired right speed in step/s when no obstacles detected
+* @param left_speed		output: left motor speed in step/s
+* @param right_speed	output: right motor speed in step/s
+*/
+void obstacle_avoidance_compute(int16_t *prox, int32_t target_left, int32_t target_right, int32_t *left_speed, int32_t *right_speed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OBSTACLE_AVOIDANCE_H */
@@ -0,0 +1,388 @@
+#include <string.h>
+#include "ch.h"
+#include "hal.h"
+#include <main.h>
+#include <fat.h>
+#include "sd_logger.h"
+#include "motors.h"
+#include "audio/microphone.h"
+#include "sensors/proximity.h"
+#include "sensors/imu.h"
+#include "sensors/ground.h"
+#include "sensors/VL53L0X/VL53L0X.h"
+
+#define NB_TOPICS 4
+
+// Topics polled by the collector, their header is the first member of the message.
+static const uint8_t topic_sources[NB_TOPICS] = {SD_LOG_PROXIMITY, SD_LOG_IMU, SD_LOG_GROUND, SD_LOG_DISTANCE};
+static const uint8_t topic_types[NB_TOPICS] = {SD_LOG_TYPE_PROXIMITY, SD_LOG_TYPE_IMU, SD_LOG_TYPE_GROUND, SD_LOG_TYPE_DISTANCE};
+static const char *topic_names[NB_TOPICS] = {"/proximity", "/imu", "/ground", "/distance"};
+static const uint16_t topic_sizes[NB_TOPICS] = {sizeof(proximity_msg_t), sizeof(imu_msg_t), sizeof(ground_msg_t), sizeof(distance_msg_t)};
+
+// Words for the alignment required by the SDIO DMA.
+static uint32_t blocks[2][SD_LOG_BLOCK_SIZE / 4];
+static uint8_t fill_index = 0;			// Block being filled.
+static uint16_t fill_pos = 0;			// Bytes already in the block being filled.
+static bool block_full[2] = {false, false};
+static uint16_t pending_drops[SD_LOG_MAX_TYPES];
+static int16_t mic_frame[MIC_BUFFER_LEN]; // Copy of the frame being logged, the ring slot can be reused meanwhile.
+static sd_logger_stats_t logger_stats;
+static MUTEX_DECL(blocks_lock);
+static BSEMAPHORE_DECL(block_ready, true);
+
+static FIL log_file;
+static bool logger_running = false;
+static uint8_t log_sources = 0;
+static thread_t *writerThd;
+static thread_t *collectorThd;
+
+/***************************INTERNAL FUNCTIONS************************************/
+
+ /**
+ * @brief   Copies data in the blocks, the space must have been checked. Called with blocks_lock locked.
+ */
+static void append(const uint8_t *data, uint16_t len) {
+	while(len > 0) {
+		uint16_t chunk = SD_LOG_BLOCK_SIZE - fill_pos;
+		if(chunk > len) {
+			chunk = len;
+		}
+		memcpy((uint8_t *)blocks[fill_index] + fill_pos, data, chunk);
+		fill_pos += chunk;
+		data += chunk;
+		len -= chunk;
+
+		if(fill_pos == SD_LOG_BLOCK_SIZE) {
+			block_full[fill_index] = true;
+			chBSemSignal(&block_ready);
+			// If the other block is still being written, the switch is done by the next record.
+			if(!block_full[fill_index ^ 1]) {
+				fill_index ^= 1;
+				fill_pos = 0;
+			}
+		}
+	}
+}
+
+ /**
+ * @brief   Counts records lost before reaching the logger, they are reported in the next record of the type.
+ */
+static void add_drops(uint8_t type, uint32_t count) {
+	chMtxLock(&blocks_lock);
+	if(pending_drops[type] + count > UINT16_MAX) {
+		pending_drops[type] = UINT16_MAX;
+	} else {
+		pending_drops[type] += count;
+	}
+	logger_stats.dropped += count;
+	chMtxUnlock(&blocks_lock);
+}
+
+static void write_block(uint8_t index, uint16_t len) {
+	UINT written = 0;
+
+	if(logger_stats.error) {
+		return;
+	}
+	systime_t start = chVTGetSystemTime();
+	if(f_write(&log_file, blocks[index], len, &written) != FR_OK || written != len) {
+		logger_stats.error = 1;
+		return;
+	}
+	uint32_t elapsed = ST2MS(chVTTimeElapsedSinceX(start));
+	if(elapsed > logger_stats.write_time_max) {
+		logger_stats.write_time_max = elapsed;
+	}
+	logger_stats.blocks++;
+}
+
+ /**
+ * @brief   Thread which writes the full blocks to the card, then the last partial block when terminated.
+ */
+static THD_WORKING_AREA(sd_logger_writer_wa, 1024);
+static THD_FUNCTION(sd_logger_writer_thd, arg)
+{
+    (void) arg;
+    chRegSetThreadName(__FUNCTION__);
+
+    uint8_t write_index = 0;
+    uint16_t unsynced = 0;
+
+    while(true) {
+    	// Read before the blocks, so that the blocks filled before the termination are written.
+    	bool terminate = chThdShouldTerminateX();
+
+    	chMtxLock(&blocks_lock);
+    	bool full = block_full[write_index];
+    	chMtxUnlock(&blocks_lock);
+
+    	if(full) {
+    		write_block(write_index, SD_LOG_BLOCK_SIZE);
+    		chMtxLock(&blocks_lock);
+    		block_full[write_index] = false;
+    		chMtxUnlock(&blocks_lock);
+    		write_index ^= 1;
+
+    		if(++unsynced >= SD_LOG_SYNC_BLOCKS) {
+    			unsynced = 0;
+    			f_sync(&log_file);
+    		}
+    		continue;
+    	}
+    	if(terminate) {
+    		break;
+    	}
+    	chBSemWaitTimeout(&block_ready, MS2ST(100));
+    }
+
+    // The producers are stopped, the block being filled is the next one to write.
+    if(fill_pos > 0 && fill_pos < SD_LOG_BLOCK_SIZE) {
+    	write_block(fill_index, fill_pos);
+    }
+    f_close(&log_file);
+}
+
+static void log_topic(uint8_t i, const void *msg, uint32_t missed) {
+	const sensor_header_t *header = (const sensor_header_t *)msg;
+	union {
+		sd_log_proximity_t prox;
+		sd_log_imu_t imu;
+		sd_log_ground_t ground;
+		sd_log_distance_t distance;
+	} payload;
+	uint16_t len = 0;
+
+	if(missed > 0) {
+		add_drops(topic_types[i], missed);
+	}
+
+	switch(topic_types[i]) {
+		case SD_LOG_TYPE_PROXIMITY: {
+			const proximity_msg_t *prox = msg;
+			for(uint8_t c = 0; c < PROXIMITY_NB_CHANNELS; c++) {
+				payload.prox.ambient[c] = prox->ambient[c];
+				payload.prox.delta[c] = prox->delta[c];
+			}
+			len = sizeof(payload.prox);
+			break;
+		}
+		case SD_LOG_TYPE_IMU: {
+			const imu_msg_t *imu = msg;
+			memcpy(payload.imu.acc_raw, imu->acc_raw, sizeof(payload.imu.acc_raw));
+			memcpy(payload.imu.gyro_raw, imu->gyro_raw, sizeof(payload.imu.gyro_raw));
+			memcpy(payload.imu.magnetometer, imu->magnetometer, sizeof(payload.imu.magnetometer));
+			len = sizeof(payload.imu);
+			break;
+		}
+		case SD_LOG_TYPE_GROUND: {
+			const ground_msg_t *ground = msg;
+			memcpy(payload.ground.ambient, ground->ambient, sizeof(payload.ground.ambient));
+			memcpy(payload.ground.delta, ground->delta, sizeof(payload.ground.delta));
+			len = sizeof(payload.ground);
+			break;
+		}
+		case SD_LOG_TYPE_DISTANCE: {
+			const distance_msg_t *distance = msg;
+			payload.distance.dist_mm = distance->dist_mm;
+			payload.distance.status = distance->status;
+			len = sizeof(payload.distance);
+			break;
+		}
+	}
+	sd_logger_write(topic_types[i], header->timestamp, &payload, len);
+}
+
+ /**
+ * @brief   Thread which polls the sources and copies their new measures in the log
+ */
+static THD_WORKING_AREA(sd_logger_collector_wa, 1024);
+static THD_FUNCTION(sd_logger_collector_thd, arg)
+{
+    (void) arg;
+    chRegSetThreadName(__FUNCTION__);
+
+    messagebus_topic_t *topics[NB_TOPICS] = {NULL};
+    sensor_sequence_t sequences[NB_TOPICS];
+    union {
+    	proximity_msg_t prox;
+    	imu_msg_t imu;
+    	ground_msg_t ground;
+    	distance_msg_t distance;
+    } msg;
+    mic_reader_t mic_reader;
+    uint32_t mic_overruns = 0;
+    uint8_t motors_divider = 0;
+    systime_t time;
+
+    for(uint8_t i = 0; i < NB_TOPICS; i++) {
+    	sensor_sequence_init(&sequences[i]);
+    }
+    if(log_sources & SD_LOG_MIC) {
+    	mic_reader_init(&mic_reader);
+    }
+
+    while(chThdShouldTerminateX() == false) {
+    	time = chVTGetSystemTime();
+
+    	for(uint8_t i = 0; i < NB_TOPICS; i++) {
+    		if(!(log_sources & topic_sources[i])) {
+    			continue;
+    		}
+    		// The sensor may be started after the logger.
+    		if(topics[i] == NULL) {
+    			topics[i] = messagebus_find_topic(&bus, topic_names[i]);
+    			continue;
+    		}
+    		if(!messagebus_topic_read(topics[i], &msg, topic_sizes[i])) {
+    			continue;
+    		}
+    		const sensor_header_t *header = (const sensor_header_t *)&msg;
+    		if(sequences[i].started && header->sequence == sequences[i].last_sequence) {
+    			continue; // Already logged.
+    		}
+    		log_topic(i, &msg, sensor_sequence_update(&sequences[i], header));
+    	}
+
+    	if(log_sources & SD_LOG_MIC) {
+    		int16_t *frame;
+    		while((frame = mic_reader_get(&mic_reader)) != NULL) {
+    			systime_t frame_time = mic_reader_time(&mic_reader);
+    			memcpy(mic_frame, frame, sizeof(mic_frame));
+    			// A frame overwritten during the copy is counted in the overruns and not logged.
+    			bool valid = mic_reader_release(&mic_reader);
+    			if(mic_reader.overruns != mic_overruns) {
+    				add_drops(SD_LOG_TYPE_MIC, mic_reader.overruns - mic_overruns);
+    				mic_overruns = mic_reader.overruns;
+    			}
+    			if(valid) {
+    				sd_logger_write(SD_LOG_TYPE_MIC, frame_time, mic_frame, sizeof(mic_frame));
+    			}
+    		}
+    	}
+
+    	if((log_sources & SD_LOG_MOTORS) && ++motors_divider >= SD_LOG_MOTORS_PERIOD / SD_LOG_POLL_PERIOD) {
+    		sd_log_motors_t motors;
+    		motors_divider = 0;
+    		motors.left_pos = left_motor_get_pos();
+    		motors.right_pos = right_motor_get_pos();
+    		motors.left_speed = left_motor_get_desired_speed();
+    		motors.right_speed = right_motor_get_desired_speed();
+    		sd_logger_write(SD_LOG_TYPE_MOTORS, time, &motors, sizeof(motors));
+    	}
+
+    	chThdSleepUntilWindowed(time, time + MS2ST(SD_LOG_POLL_PERIOD));
+    }
+
+    if(log_sources & SD_LOG_MIC) {
+    	mic_reader_stop(&mic_reader);
+    }
+}
+
+/*************************END INTERNAL FUNCTIONS**********************************/
+
+
+/****************************PUBLIC FUNCTIONS*************************************/
+
+int8_t sd_logger_start(const char *path, uint8_t sources) {
+	sd_log_start_t start;
+
+	if(logger_running) {
+		return -1;
+	}
+	if(!mountSDCard()) {
+		return -1;
+	}
+	if(f_open(&log_file, path, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) {
+		return -1;
+	}
+
+	fill_index = 0;
+	fill_pos = 0;
+	block_full[0] = false;
+	block_full[1] = false;
+	memset(pending_drops, 0, sizeof(pending_drops));
+	memset(&logger_stats, 0, sizeof(logger_stats));
+	log_sources = sources;
+	logger_running = true;
+
+	memcpy(start.magic, SD_LOG_MAGIC, sizeof(start.magic));
+	start.version = SD_LOG_VERSION;
+	start.sources = sources;
+	start.mic_samples = MIC_BUFFER_LEN;
+	start.tick_frequency = CH_CFG_ST_FREQUENCY;
+	sd_logger_write(SD_LOG_TYPE_START, chVTGetSystemTime(), &start, sizeof(start));
+
+	// The writer has a lower priority than the producers, it spends its time waiting for the card.
+	writerThd = chThdCreateStatic(sd_logger_writer_wa, sizeof(sd_logger_writer_wa), NORMALPRIO - 1, sd_logger_writer_thd, NULL);
+	collectorThd = chThdCreateStatic(sd_logger_collector_wa, sizeof(sd_logger_collector_wa), NORMALPRIO, sd_logger_collector_thd, NULL);
+	return 0;
+}
+
+void sd_logger_stop(void) {
+	if(!logger_running) {
+		return;
+	}
+	chThdTerminate(collectorThd);
+	chThdWait(collectorThd);
+	collectorThd = NULL;
+
+	chMtxLock(&blocks_lock);
+	logger_running = false;
+	chMtxUnlock(&blocks_lock);
+
+	chThdTerminate(writerThd);
+	chBSemSignal(&block_ready);
+	chThdWait(writerThd);
+	writerThd = NULL;
+}
+
+bool sd_logger_write(uint8_t type, uint32_t timestamp, const void *payload, uint16_t length) {
+	sd_log_record_t record;
+	bool added = false;
+
+	if(type >= SD_LOG_MAX_TYPES || length > SD_LOG_BLOCK_SIZE) {
+		return false;
+	}
+
+	chMtxLock(&blocks_lock);
+	if(logger_running) {
+		// A full block waiting for the other one to be written is replaced as soon as possible.
+		if(fill_pos == SD_LOG_BLOCK_SIZE && !block_full[fill_index ^ 1]) {
+			fill_index ^= 1;
+			fill_pos = 0;
+		}
+		uint32_t space = (SD_LOG_BLOCK_SIZE - fill_pos) + (block_full[fill_index ^ 1] ? 0 : SD_LOG_BLOCK_SIZE);
+
+		if(!logger_stats.error && sizeof(record) + length <= space) {
+			record.length = length;
+			record.type = type;
+			// Drops beyond UINT8_MAX are reported by the next records of this type.
+			record.dropped = pending_drops[type] > UINT8_MAX ? UINT8_MAX : pending_drops[type];
+			record.timestamp = timestamp;
+			pending_drops[type] -= record.dropped;
+			append((const uint8_t *)&record, sizeof(record));
+			append(payload, length);
+			logger_stats.records++;
+			added = true;
+		} else {
+			if(pending_drops[type] < UINT16_MAX) {
+				pending_drops[type]++;
+			}
+			logger_stats.dropped++;
+		}
+	}
+	chMtxUnlock(&blocks_lock);
+	return added;
+}
+
+bool sd_logger_is_running(void) {
+	return logger_running;
+}
+
+void sd_logger_get_stats(sd_logger_stats_t *stats) {
+	chMtxLock(&blocks_lock);
+	*stats = logger_stats;
+	chMtxUnlock(&blocks_lock);
+}
+
+/**************************END PUBLIC FUNCTIONS***********************************/
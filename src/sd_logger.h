@@ -0,0 +1,151 @@
+#ifndef SD_LOGGER_H
+#define SD_LOGGER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Background logger writing the sensor measures to a file on the micro sd card.
+ *
+ * The records are copied in two blocks of SD_LOG_BLOCK_SIZE bytes: one is filled while the other is
+ * written to the card by a low priority thread, so the producers never wait for the card. When both
+ * blocks are full the new records are dropped and counted in the next record of the same type.
+ * The blocks are written at offsets multiple of their size, so FatFs transfers them directly from the
+ * buffer with multi-block writes.
+ *
+ * A collector thread polls the topics of the selected sources and uses the sequence number of their
+ * header (see sensor_sample.h) to log each publication once and count the ones missed.
+ * Any thread can also add its own records with sd_logger_write.
+ *
+ * File format (little endian): a sequence of records, each made of a sd_log_record_t header followed
+ * by "length" bytes of payload. The first record is a SD_LOG_TYPE_START record. The records can span
+ * two blocks. See python_scripts/decode_sd_log.py for a decoder.
+ */
+
+#define SD_LOG_BLOCK_SIZE		4096	// Multiple of the sector size (512 bytes).
+#define SD_LOG_SYNC_BLOCKS		64		// The file is synchronized every 64 blocks (256 KiB).
+#define SD_LOG_POLL_PERIOD		2		// Period in ms at which the topics are polled.
+#define SD_LOG_MOTORS_PERIOD	10		// Period in ms at which the motors are sampled.
+#define SD_LOG_MAX_TYPES		16
+
+#define SD_LOG_MAGIC			"EPLG"
+#define SD_LOG_VERSION			1
+
+/* Sources, to combine in the mask given to sd_logger_start. */
+#define SD_LOG_PROXIMITY		(1 << 0)	// /proximity topic
+#define SD_LOG_IMU				(1 << 1)	// /imu topic
+#define SD_LOG_GROUND			(1 << 2)	// /ground topic
+#define SD_LOG_DISTANCE			(1 << 3)	// /distance topic
+#define SD_LOG_MIC				(1 << 4)	// microphones frames, mic_start must be called beforehand
+#define SD_LOG_MOTORS			(1 << 5)	// position counters and speeds of the motors
+#define SD_LOG_ALL				0x3F
+
+/* Record types. */
+#define SD_LOG_TYPE_START		0	// sd_log_start_t
+#define SD_LOG_TYPE_PROXIMITY	1	// sd_log_proximity_t
+#define SD_LOG_TYPE_IMU			2	// sd_log_imu_t
+#define SD_LOG_TYPE_GROUND		3	// sd_log_ground_t
+#define SD_LOG_TYPE_DISTANCE	4	// sd_log_distance_t
+#define SD_LOG_TYPE_MIC			5	// MIC_BUFFER_LEN int16_t samples (mic0, mic1, mic2, mic3, mic0, ...)
+#define SD_LOG_TYPE_MOTORS		6	// sd_log_motors_t
+#define SD_LOG_TYPE_USER		8	// First type free for sd_logger_write, up to SD_LOG_MAX_TYPES - 1.
+
+/** Header of each record. */
+typedef struct __attribute__((packed)) {
+	uint16_t length;		// Bytes of payload following the header.
+	uint8_t type;
+	uint8_t dropped;		// Records of this type lost just before this one (saturated at 255).
+	uint32_t timestamp;		// Capture time in system ticks.
+} sd_log_record_t;
+
+typedef struct __attribute__((packed)) {
+	char magic[4];			// SD_LOG_MAGIC
+	uint8_t version;		// SD_LOG_VERSION
+	uint8_t sources;		// Mask of the sources logged.
+	uint16_t mic_samples;	// Samples in a SD_LOG_TYPE_MIC record.
+	uint32_t tick_frequency;// System ticks per second.
+} sd_log_start_t;
+
+typedef struct __attribute__((packed)) {
+	uint16_t ambient[8];
+	uint16_t delta[8];
+} sd_log_proximity_t;
+
+typedef struct __attribute__((packed)) {
+	int16_t acc_raw[3];
+	int16_t gyro_raw[3];
+	float magnetometer[3];	// uT
+} sd_log_imu_t;
+
+typedef struct __attribute__((packed)) {
+	uint16_t ambient[5];
+	uint16_t delta[5];
+} sd_log_ground_t;
+
+typedef struct __attribute__((packed)) {
+	uint16_t dist_mm;
+	uint8_t status;
+} sd_log_distance_t;
+
+typedef struct __attribute__((packed)) {
+	int32_t left_pos;		// steps
+	int32_t right_pos;
+	int16_t left_speed;		// desired speed in steps/s
+	int16_t right_speed;
+} sd_log_motors_t;
+
+/** Counters of the current (or last) logging session. */
+typedef struct {
+	uint32_t records;		// Records written in the blocks.
+	uint32_t dropped;		// Records lost, because the blocks were full or a publication was missed.
+	uint32_t blocks;		// Blocks written to the card.
+	uint32_t write_time_max;// Longest write of a block in ms.
+	uint8_t error;			// 1 if a write failed, the logging is then suspended.
+} sd_logger_stats_t;
+
+ /**
+ * @brief   Mounts the card, creates the file and starts logging the given sources.
+ *
+ * @param path		path of the file, overwritten if it exists
+ * @param sources	mask of SD_LOG_PROXIMITY, SD_LOG_IMU, ... (0 to log only the records of sd_logger_write)
+ *
+ * @return			0 on success, -1 if the logger is already running or the file can't be created
+ */
+int8_t sd_logger_start(const char *path, uint8_t sources);
+
+ /**
+ * @brief   Stops the sources, writes the remaining records and closes the file.
+ */
+void sd_logger_stop(void);
+
+ /**
+ * @brief   Adds a record to the log without waiting for the card. Can be called from any thread.
+ *
+ * @param type		SD_LOG_TYPE_USER to SD_LOG_MAX_TYPES - 1 for the application records
+ * @param timestamp	capture time in system ticks
+ * @param payload	content of the record
+ * @param length	bytes of payload, at most SD_LOG_BLOCK_SIZE
+ *
+ * @return			true if the record was added, false if it was dropped (logger stopped or blocks full)
+ */
+bool sd_logger_write(uint8_t type, uint32_t timestamp, const void *payload, uint16_t length);
+
+ /**
+ * @brief   Returns true if the logger is running.
+ */
+bool sd_logger_is_running(void);
+
+ /**
+ * @brief   Copies the counters of the current (or last) logging session.
+ */
+void sd_logger_get_stats(sd_logger_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SD_LOGGER_H */
@@ -1,8 +1,119 @@
+#include <string.h>
 #include <hal.h>
 #include "sdio.h"
 
+// The DMA can't access the CCM and needs 4 bytes aligned buffers.
+#define CCM_BASE_ADDR		0x10000000
+#define CCM_END_ADDR		0x10010000
+#define DMA_CAPABLE(p)		((((uint32_t)(p)) & 3) == 0 && \
+							((uint32_t)(p) < CCM_BASE_ADDR || (uint32_t)(p) >= CCM_END_ADDR))
+#define BLOCK_WORDS			(MMCSD_BLOCK_SIZE / 4)
+
 static bool sdio_connected = false;
 
+static uint32_t bounce_buf[SDIO_BOUNCE_BLOCKS * BLOCK_WORDS];
+
+typedef struct {
+	uint32_t sector;
+	uint32_t last_use;
+	bool valid;
+} cache_entry_t;
+
+static cache_entry_t cache_entries[SDIO_CACHE_SECTORS];
+static uint32_t cache_data[SDIO_CACHE_SECTORS][BLOCK_WORDS];
+static uint32_t cache_clock = 0;
+static sdio_stats_t sdio_stats;
+static MUTEX_DECL(sdio_lock);
+
+/***************************INTERNAL FUNCTIONS************************************/
+
+static void cache_invalidate(void) {
+	for(uint8_t i = 0; i < SDIO_CACHE_SECTORS; i++) {
+		cache_entries[i].valid = false;
+	}
+}
+
+static int8_t cache_find(uint32_t sector) {
+	for(uint8_t i = 0; i < SDIO_CACHE_SECTORS; i++) {
+		if(cache_entries[i].valid && cache_entries[i].sector == sector) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+ /**
+ * @brief   Returns the entry to use for a new sector: a free one or the least recently used.
+ */
+static uint8_t cache_victim(void) {
+	uint8_t victim = 0;
+	for(uint8_t i = 0; i < SDIO_CACHE_SECTORS; i++) {
+		if(!cache_entries[i].valid) {
+			return i;
+		}
+		if(cache_entries[i].last_use < cache_entries[victim].last_use) {
+			victim = i;
+		}
+	}
+	return victim;
+}
+
+static void cache_store(uint8_t index, uint32_t sector, const uint8_t *data) {
+	memcpy(cache_data[index], data, MMCSD_BLOCK_SIZE);
+	cache_entries[index].sector = sector;
+	cache_entries[index].last_use = ++cache_clock;
+	cache_entries[index].valid = true;
+}
+
+static bool read_blocks(uint32_t startblk, uint8_t *buf, uint32_t n) {
+	if(DMA_CAPABLE(buf)) {
+		sdio_stats.read_cmds++;
+		sdio_stats.read_blocks += n;
+		return sdcRead(&SDCD1, startblk, buf, n);
+	}
+	while(n > 0) {
+		uint32_t chunk = n > SDIO_BOUNCE_BLOCKS ? SDIO_BOUNCE_BLOCKS : n;
+		sdio_stats.read_cmds++;
+		sdio_stats.read_blocks += chunk;
+		sdio_stats.bounced += chunk;
+		if(sdcRead(&SDCD1, startblk, (uint8_t *)bounce_buf, chunk) != HAL_SUCCESS) {
+			return HAL_FAILED;
+		}
+		memcpy(buf, bounce_buf, chunk * MMCSD_BLOCK_SIZE);
+		startblk += chunk;
+		buf += chunk * MMCSD_BLOCK_SIZE;
+		n -= chunk;
+	}
+	return HAL_SUCCESS;
+}
+
+static bool write_blocks(uint32_t startblk, const uint8_t *buf, uint32_t n) {
+	if(DMA_CAPABLE(buf)) {
+		sdio_stats.write_cmds++;
+		sdio_stats.write_blocks += n;
+		return sdcWrite(&SDCD1, startblk, buf, n);
+	}
+	while(n > 0) {
+		uint32_t chunk = n > SDIO_BOUNCE_BLOCKS ? SDIO_BOUNCE_BLOCKS : n;
+		sdio_stats.write_cmds++;
+		sdio_stats.write_blocks += chunk;
+		sdio_stats.bounced += chunk;
+		memcpy(bounce_buf, buf, chunk * MMCSD_BLOCK_SIZE);
+		if(sdcWrite(&SDCD1, startblk, (const uint8_t *)bounce_buf, chunk) != HAL_SUCCESS) {
+			return HAL_FAILED;
+		}
+		startblk += chunk;
+		buf += chunk * MMCSD_BLOCK_SIZE;
+		n -= chunk;
+	}
+	return HAL_SUCCESS;
+}
+
+/*************************END INTERNAL FUNCTIONS**********************************/
+
+
+/****************************PUBLIC FUNCTIONS*************************************/
+
 void sdio_start(void) {
 	static uint8_t sd_scratchpad[512]; // Working area for SDC driver.
 	static const SDCConfig sdccfg = { //  SDIO configuration.
@@ -21,6 +132,10 @@ uint8_t sdio_connect(void) {
 		if(!sdio_connected){
 			if(sdcConnect(&SDCD1) == HAL_SUCCESS){
 				sdio_connected = true;
+				// The card may have been changed.
+				chMtxLock(&sdio_lock);
+				cache_invalidate();
+				chMtxUnlock(&sdio_lock);
 			}else{
 				return HAL_FAILED;
 			}
@@ -46,3 +161,71 @@ uint8_t sdio_disconnect(void) {
 	}
 }
 
+uint8_t sdio_read(uint32_t startblk, uint8_t *buf, uint32_t n) {
+	bool err;
+
+	chMtxLock(&sdio_lock);
+	if(n == 1) {
+		int8_t hit = cache_find(startblk);
+		if(hit >= 0) {
+			memcpy(buf, cache_data[hit], MMCSD_BLOCK_SIZE);
+			cache_entries[hit].last_use = ++cache_clock;
+			sdio_stats.cache_hits++;
+			chMtxUnlock(&sdio_lock);
+			return HAL_SUCCESS;
+		}
+		// Read directly in the cache, which is aligned.
+		uint8_t index = cache_victim();
+		cache_entries[index].valid = false;
+		sdio_stats.read_cmds++;
+		sdio_stats.read_blocks++;
+		err = sdcRead(&SDCD1, startblk, (uint8_t *)cache_data[index], 1);
+		if(err == HAL_SUCCESS) {
+			memcpy(buf, cache_data[index], MMCSD_BLOCK_SIZE);
+			cache_entries[index].sector = startblk;
+			cache_entries[index].last_use = ++cache_clock;
+			cache_entries[index].valid = true;
+		}
+	} else {
+		err = read_blocks(startblk, buf, n);
+	}
+	chMtxUnlock(&sdio_lock);
+	return err;
+}
+
+uint8_t sdio_write(uint32_t startblk, const uint8_t *buf, uint32_t n) {
+	bool err;
+
+	chMtxLock(&sdio_lock);
+	err = write_blocks(startblk, buf, n);
+	// Write-through: the cached copies are updated, or dropped if the write failed.
+	for(uint8_t i = 0; i < SDIO_CACHE_SECTORS; i++) {
+		if(cache_entries[i].valid && cache_entries[i].sector >= startblk && cache_entries[i].sector - startblk < n) {
+			if(err == HAL_SUCCESS) {
+				memcpy(cache_data[i], buf + (cache_entries[i].sector - startblk) * MMCSD_BLOCK_SIZE, MMCSD_BLOCK_SIZE);
+			} else {
+				cache_entries[i].valid = false;
+			}
+		}
+	}
+	// A sector written alone is usually metadata, read again soon.
+	if(err == HAL_SUCCESS && n == 1 && cache_find(startblk) < 0) {
+		cache_store(cache_victim(), startblk, buf);
+	}
+	chMtxUnlock(&sdio_lock);
+	return err;
+}
+
+void sdio_get_stats(sdio_stats_t *stats) {
+	chMtxLock(&sdio_lock);
+	*stats = sdio_stats;
+	chMtxUnlock(&sdio_lock);
+}
+
+void sdio_reset_stats(void) {
+	chMtxLock(&sdio_lock);
+	memset(&sdio_stats, 0, sizeof(sdio_stats));
+	chMtxUnlock(&sdio_lock);
+}
+
+/**************************END PUBLIC FUNCTIONS***********************************/
@@ -5,6 +5,30 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
+
+/**
+ * The transfers of FatFs go through sdio_read and sdio_write (see fat_diskio.c):
+ * - the blocks are transferred with a single multi-block command and DMA when the buffer can be used
+ *   by the DMA (4 bytes aligned, not in the CCM), otherwise through an aligned bounce buffer of
+ *   SDIO_BOUNCE_BLOCKS blocks instead of one command per block;
+ * - the single block transfers (FAT, directories) go through a write-through cache of
+ *   SDIO_CACHE_SECTORS sectors.
+ */
+
+#define SDIO_BOUNCE_BLOCKS	8
+#define SDIO_CACHE_SECTORS	4
+
+/** Counters of the transfers since the start or the last reset. */
+typedef struct {
+	uint32_t read_cmds;		// Read commands sent to the card.
+	uint32_t read_blocks;
+	uint32_t write_cmds;	// Write commands sent to the card.
+	uint32_t write_blocks;
+	uint32_t cache_hits;	// Single block reads served by the cache.
+	uint32_t bounced;		// Blocks copied through the bounce buffer.
+} sdio_stats_t;
+
 /**
  * @brief Start the SDC module (1-bit mode).
  *
@@ -40,6 +64,40 @@ uint8_t sdio_connect(void);
  */
 uint8_t sdio_disconnect(void);
 
+/**
+ * @brief   Reads blocks from the card.
+ *
+ * @param startblk	first block
+ * @param buf		destination buffer, any alignment
+ * @param n			number of blocks
+ *
+ * @return 		The operation status.
+ * @retval 0  	operation succeeded.
+ * @retval 1   	operation failed.
+ */
+uint8_t sdio_read(uint32_t startblk, uint8_t *buf, uint32_t n);
+
+/**
+ * @brief   Writes blocks to the card.
+ *
+ * @param startblk	first block
+ * @param buf		source buffer, any alignment
+ * @param n			number of blocks
+ *
+ * @return 		The operation status (see sdio_read).
+ */
+uint8_t sdio_write(uint32_t startblk, const uint8_t *buf, uint32_t n);
+
+/**
+ * @brief   Copies the transfer counters.
+ */
+void sdio_get_stats(sdio_stats_t *stats);
+
+/**
+ * @brief   Resets the transfer counters.
+ */
+void sdio_reset_stats(void);
+
 
 #ifdef __cplusplus
 }
@@ -88,6 +88,22 @@ int32_t VL53L0X_write_multi(uint8_t address, uint8_t index, uint8_t  *pdata, uin
 
 int32_t VL53L0X_read_multi(uint8_t address,  uint8_t index, uint8_t  *pdata, uint32_t count);
 
+/**
+ * @brief  Reads a status register and the results which follow it in two buffers
+ *
+ * The two reads are queued together as mergeable reads, the I2C scheduler serves them in a
+ * single burst.
+ *
+ * @param  address - uint8_t device address value (8bits)
+ * @param  index - uint8_t register index of the status
+ * @param  status - pointer to store the status
+ * @param  results - pointer to the uint8_t buffer to store the registers from index + 1
+ * @param  count - number of uint8_t's to read in results
+ *
+ * @return status - 0 = ok, 1 = error
+ */
+int32_t VL53L0X_read_status_results(uint8_t address, uint8_t index, uint8_t *status, uint8_t *results, uint32_t count);
+
 
 /**
  * @brief  Writes a single byte to the device
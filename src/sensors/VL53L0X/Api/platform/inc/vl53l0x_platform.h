@@ -60,6 +60,11 @@ typedef uint8_t VL53L0X_AccuracyMode;
 //1.2m, 20ms
 #define VL53L0X_HIGH_SPEED      ((VL53L0X_AccuracyMode) 3)
 
+/** Number of static configuration registers kept in the register shadow (see vl53l0x_platform.c) */
+#define VL53L0X_SHADOW_REGS     20
+/** Length of the read-ahead of the result registers, from 0x14 to 0x1F */
+#define VL53L0X_READ_AHEAD_LEN  12
+
 /**
  * @struct  VL53L0X_Dev_t
  * @brief    Generic PAL device type that does link between API and platform abstraction layer
@@ -72,6 +77,14 @@ typedef struct {
     VL53L0X_DeviceInfo_t  DeviceInfo;
     uint8_t               I2cDevAddr;  /*!< i2c device address (8 bit)    */
 
+    /*!< register access optimizations, see vl53l0x_platform.c */
+    uint32_t              ShadowValid;                        /*!< one bit per shadowed register */
+    uint8_t               Shadow[VL53L0X_SHADOW_REGS];        /*!< last value written to or read from the register */
+    uint8_t               Page;                               /*!< last value written to 0xFF (page select) */
+    uint8_t               PowerForce;                         /*!< last value written to 0x80 */
+    uint8_t               ReadAheadIndex;                     /*!< first register of the read-ahead, 0 if not valid */
+    uint8_t               ReadAhead[VL53L0X_READ_AHEAD_LEN];
+
 } VL53L0X_Dev_t;
 
 
@@ -205,6 +218,12 @@ VL53L0X_Error VL53L0X_RdDWord(VL53L0X_DEV Dev, uint8_t index, uint32_t *data);
  */
 VL53L0X_Error VL53L0X_UpdateByte(VL53L0X_DEV Dev, uint8_t index, uint8_t AndData, uint8_t OrData);
 
+/**
+ * Forgets the register shadow, to call when the device may have been reset
+ * @param   Dev        Device Handle
+ */
+void VL53L0X_ShadowReset(VL53L0X_DEV Dev);
+
 /** @} end of VL53L0X_registerAccess_group */
 
 
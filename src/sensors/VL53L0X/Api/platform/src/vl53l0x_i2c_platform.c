@@ -9,9 +9,9 @@ int32_t VL53L0X_write_multi(uint8_t address, uint8_t index, uint8_t *pdata, uint
 
   systime_t timeout = MS2ST(50); // 50 ms
   msg_t rdymsg = MSG_OK;
+  i2c_transaction_t t;
 
   uint8_t txbuff[32];
-  uint8_t rxbuff[0];
   uint8_t nbDatas = count+1;
 
   txbuff[0] = index;
@@ -20,18 +20,13 @@ int32_t VL53L0X_write_multi(uint8_t address, uint8_t index, uint8_t *pdata, uint
     txbuff[count] = pdata[count-1];
     count--;
   }
-  i2cAcquireBus(&I2CD1);
-  rdymsg = i2cMasterTransmitTimeout(&I2CD1, address>>1, txbuff, nbDatas, rxbuff, 0, timeout);
-  
+  i2c_transaction_init(&t, address>>1, txbuff, nbDatas, NULL, 0);
+  t.timeout = timeout;
+  rdymsg = i2c_transfer(&t);
+
   if (rdymsg != MSG_OK){
-    if(I2CD1.state == I2C_LOCKED){
-      i2c_stop();
-      i2c_start();
-    }
-    i2cReleaseBus(&I2CD1);
     return VL53L0X_ERROR_CONTROL_INTERFACE;
   }
-  i2cReleaseBus(&I2CD1);
   return VL53L0X_ERROR_NONE;
 }
 
@@ -39,21 +34,42 @@ int32_t VL53L0X_read_multi(uint8_t address, uint8_t index, uint8_t *pdata, uint3
 
   systime_t timeout = MS2ST(50); // 50 ms
   msg_t rdymsg = MSG_OK;
+  i2c_transaction_t t;
 
   uint8_t txbuff[1] = {index};
 
-  i2cAcquireBus(&I2CD1);
-  rdymsg = i2cMasterTransmitTimeout(&I2CD1, address>>1, txbuff, 1, pdata, count, timeout);
+  i2c_transaction_init(&t, address>>1, txbuff, 1, pdata, count);
+  t.timeout = timeout;
+  rdymsg = i2c_transfer(&t);
 
   if (rdymsg != MSG_OK){
-    if(I2CD1.state == I2C_LOCKED){
-      i2c_stop();
-      i2c_start();
-    }
-    i2cReleaseBus(&I2CD1);
     return VL53L0X_ERROR_CONTROL_INTERFACE;
   }
-  i2cReleaseBus(&I2CD1);
+  return VL53L0X_ERROR_NONE;
+}
+
+int32_t VL53L0X_read_status_results(uint8_t address, uint8_t index, uint8_t *status, uint8_t *results, uint32_t count) {
+
+  systime_t timeout = MS2ST(50); // 50 ms
+  i2c_transaction_t t[2];
+
+  uint8_t txbuff[2] = {index, index + 1};
+
+  i2c_transaction_init(&t[0], address>>1, &txbuff[0], 1, status, 1);
+  i2c_transaction_init(&t[1], address>>1, &txbuff[1], 1, results, count);
+  for(uint8_t i = 0 ; i < 2 ; i++){
+    t[i].timeout = timeout;
+    t[i].flags = I2C_FLAG_MERGEABLE;
+  }
+  i2c_submit_multi(t, 2);
+
+  // Both are waited, the transactions are on the stack.
+  msg_t status_msg = i2c_wait(&t[0]);
+  msg_t results_msg = i2c_wait(&t[1]);
+
+  if (status_msg != MSG_OK || results_msg != MSG_OK){
+    return VL53L0X_ERROR_CONTROL_INTERFACE;
+  }
   return VL53L0X_ERROR_NONE;
 }
 
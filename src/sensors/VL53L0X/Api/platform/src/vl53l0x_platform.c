@@ -34,6 +34,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  * provide variable word size byte/Word/dword VL6180x register access via i2c
  *
  */
+#include <string.h>
 #include "../inc/vl53l0x_platform.h"
 #include "../inc/vl53l0x_i2c_platform.h"
 #include "../../core/inc/vl53l0x_api.h"
@@ -89,6 +90,102 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 
 
+/*
+ * Register shadow
+ *
+ * The static configuration registers below are only modified by the host. Their last value written
+ * (or read) is kept in the device structure so that reading them again, which the API does a lot
+ * (UpdateByte, timing budget and VCSEL period computations, ...), doesn't need an I2C transaction.
+ * The writes always go to the device (write-through).
+ * The registers of the page 0 are only shadowed when no other page is selected (0xFF) and the
+ * power force register (0x80) is cleared, because the API uses them to access hidden registers.
+ * A soft reset (0xBF) clears the shadow.
+ */
+static const uint8_t shadow_regs[VL53L0X_SHADOW_REGS] = {
+    VL53L0X_REG_SYSTEM_SEQUENCE_CONFIG,
+    VL53L0X_REG_SYSTEM_RANGE_CONFIG,
+    VL53L0X_REG_SYSTEM_INTERRUPT_CONFIG_GPIO,
+    VL53L0X_REG_FINAL_RANGE_CONFIG_MIN_COUNT_RATE_RTN_LIMIT,
+    VL53L0X_REG_FINAL_RANGE_CONFIG_MIN_COUNT_RATE_RTN_LIMIT + 1,
+    VL53L0X_REG_MSRC_CONFIG_TIMEOUT_MACROP,
+    VL53L0X_REG_FINAL_RANGE_CONFIG_VALID_PHASE_LOW,
+    VL53L0X_REG_FINAL_RANGE_CONFIG_VALID_PHASE_HIGH,
+    VL53L0X_REG_PRE_RANGE_CONFIG_VCSEL_PERIOD,
+    VL53L0X_REG_PRE_RANGE_CONFIG_TIMEOUT_MACROP_HI,
+    VL53L0X_REG_PRE_RANGE_CONFIG_TIMEOUT_MACROP_LO,
+    VL53L0X_REG_PRE_RANGE_CONFIG_VALID_PHASE_LOW,
+    VL53L0X_REG_PRE_RANGE_CONFIG_VALID_PHASE_HIGH,
+    VL53L0X_REG_MSRC_CONFIG_CONTROL,
+    VL53L0X_REG_PRE_RANGE_MIN_COUNT_RATE_RTN_LIMIT,
+    VL53L0X_REG_PRE_RANGE_MIN_COUNT_RATE_RTN_LIMIT + 1,
+    VL53L0X_REG_FINAL_RANGE_CONFIG_VCSEL_PERIOD,
+    VL53L0X_REG_FINAL_RANGE_CONFIG_TIMEOUT_MACROP_HI,
+    VL53L0X_REG_FINAL_RANGE_CONFIG_TIMEOUT_MACROP_LO,
+    VL53L0X_REG_GPIO_HV_MUX_ACTIVE_HIGH,
+};
+
+/*
+ * Read-ahead of the results
+ *
+ * Polling the interrupt status (0x13) or the range status (0x14) is always followed by the read of
+ * the results (0x14 to 0x1F) once a measure is ready. When the polled status tells that a measure
+ * is ready, the results are read in the same burst and kept for the next access, if it is their read.
+ * Any other access drops them, so they are never older than the status read with them.
+ */
+#define READ_AHEAD_END      (VL53L0X_REG_RESULT_RANGE_STATUS + VL53L0X_READ_AHEAD_LEN)
+
+static int8_t shadow_index(uint8_t reg){
+    for(uint8_t i = 0 ; i < VL53L0X_SHADOW_REGS ; i++){
+        if(shadow_regs[i] == reg){
+            return i;
+        }
+    }
+    return -1;
+}
+
+static uint8_t shadow_enabled(VL53L0X_DEV Dev){
+    return (Dev->Page == 0) && (Dev->PowerForce == 0);
+}
+
+static void shadow_update(VL53L0X_DEV Dev, uint8_t index, uint8_t *pdata, uint32_t count){
+    for(uint32_t i = 0 ; i < count && index + i <= 0xFF ; i++){
+        int8_t n = shadow_index(index + i);
+        if(n >= 0){
+            Dev->Shadow[n] = pdata[i];
+            Dev->ShadowValid |= (1UL << n);
+        }
+    }
+}
+
+static void shadow_invalidate(VL53L0X_DEV Dev, uint8_t index, uint32_t count){
+    for(uint32_t i = 0 ; i < count && index + i <= 0xFF ; i++){
+        int8_t n = shadow_index(index + i);
+        if(n >= 0){
+            Dev->ShadowValid &= ~(1UL << n);
+        }
+    }
+}
+
+static uint8_t shadow_read(VL53L0X_DEV Dev, uint8_t index, uint8_t *pdata, uint32_t count){
+    for(uint32_t i = 0 ; i < count ; i++){
+        int8_t n = (index + i <= 0xFF) ? shadow_index(index + i) : -1;
+        if(n < 0 || !(Dev->ShadowValid & (1UL << n))){
+            return 0;
+        }
+    }
+    for(uint32_t i = 0 ; i < count ; i++){
+        pdata[i] = Dev->Shadow[shadow_index(index + i)];
+    }
+    return 1;
+}
+
+void VL53L0X_ShadowReset(VL53L0X_DEV Dev){
+    Dev->ShadowValid = 0;
+    Dev->Page = 0;
+    Dev->PowerForce = 0;
+    Dev->ReadAheadIndex = 0;
+}
+
 // the ranging_sensor_comms.dll will take care of the page selection
 VL53L0X_Error VL53L0X_WriteMulti(VL53L0X_DEV Dev, uint8_t index, uint8_t *pdata, uint32_t count){
 
@@ -101,11 +198,32 @@ VL53L0X_Error VL53L0X_WriteMulti(VL53L0X_DEV Dev, uint8_t index, uint8_t *pdata,
     }
 
 	deviceAddress = Dev->I2cDevAddr;
+	Dev->ReadAheadIndex = 0;
 
 	status_int = VL53L0X_write_multi(deviceAddress, index, pdata, count);
 
-	if (status_int != 0)
+	if (status_int != 0){
 		Status = VL53L0X_ERROR_CONTROL_INTERFACE;
+		// The value in the device is unknown.
+		shadow_invalidate(Dev, index, count);
+	} else if (shadow_enabled(Dev)){
+		shadow_update(Dev, index, pdata, count);
+	}
+
+	// Registers which change the meaning of the others.
+	for(uint32_t i = 0 ; i < count && index + i <= 0xFF ; i++){
+		switch(index + i){
+			case 0xFF:
+				Dev->Page = pdata[i];
+				break;
+			case VL53L0X_REG_POWER_MANAGEMENT_GO1_POWER_FORCE:
+				Dev->PowerForce = pdata[i];
+				break;
+			case VL53L0X_REG_SOFT_RESET_GO2_SOFT_RESET_N:
+				Dev->ShadowValid = 0;
+				break;
+		}
+	}
 
     return Status;
 }
@@ -116,14 +234,47 @@ VL53L0X_Error VL53L0X_ReadMulti(VL53L0X_DEV Dev, uint8_t index, uint8_t *pdata,
     VL53L0X_Error Status = VL53L0X_ERROR_NONE;
     int32_t status_int;
 	uint8_t deviceAddress;
+	uint8_t readAheadIndex = Dev->ReadAheadIndex;
 
     if (count>=VL53L0X_MAX_I2C_XFER_SIZE){
         Status = VL53L0X_ERROR_INVALID_PARAMS;
     }
 
     deviceAddress = Dev->I2cDevAddr;
+    Dev->ReadAheadIndex = 0;
+
+    if (readAheadIndex != 0 && index >= readAheadIndex && index + count <= READ_AHEAD_END){
+    	memcpy(pdata, &Dev->ReadAhead[index - VL53L0X_REG_RESULT_RANGE_STATUS], count);
+    	return Status;
+    }
 
-	status_int = VL53L0X_read_multi(deviceAddress, index, pdata, count);
+    if (shadow_enabled(Dev) && shadow_read(Dev, index, pdata, count)){
+    	return Status;
+    }
+
+    if (shadow_enabled(Dev) && count == 1 && index == VL53L0X_REG_RESULT_INTERRUPT_STATUS){
+    	// The status and the results are two reads merged in one burst by the I2C scheduler, the
+    	// results go straight to the read-ahead buffer.
+    	status_int = VL53L0X_read_status_results(deviceAddress, index, pdata, Dev->ReadAhead, VL53L0X_READ_AHEAD_LEN);
+    	// New sample ready.
+    	if (status_int == 0 && (*pdata & 0x07) != 0){
+    		Dev->ReadAheadIndex = VL53L0X_REG_RESULT_RANGE_STATUS;
+    	}
+    } else if (shadow_enabled(Dev) && count == 1 && index == VL53L0X_REG_RESULT_RANGE_STATUS){
+    	status_int = VL53L0X_read_multi(deviceAddress, index, Dev->ReadAhead, VL53L0X_READ_AHEAD_LEN);
+    	if (status_int == 0){
+    		*pdata = Dev->ReadAhead[0];
+    		// Device ready.
+    		if ((*pdata & 0x01) != 0){
+    			Dev->ReadAheadIndex = VL53L0X_REG_RESULT_RANGE_STATUS;
+    		}
+    	}
+    } else {
+    	status_int = VL53L0X_read_multi(deviceAddress, index, pdata, count);
+    	if (status_int == 0 && shadow_enabled(Dev)){
+    		shadow_update(Dev, index, pdata, count);
+    	}
+    }
 
 	if (status_int != 0)
 		Status = VL53L0X_ERROR_CONTROL_INTERFACE;
@@ -133,115 +284,68 @@ VL53L0X_Error VL53L0X_ReadMulti(VL53L0X_DEV Dev, uint8_t index, uint8_t *pdata,
 
 
 VL53L0X_Error VL53L0X_WrByte(VL53L0X_DEV Dev, uint8_t index, uint8_t data){
-    VL53L0X_Error Status = VL53L0X_ERROR_NONE;
-    int32_t status_int;
-	uint8_t deviceAddress;
-
-    deviceAddress = Dev->I2cDevAddr;
-
-	status_int = VL53L0X_write_byte(deviceAddress, index, data);
-
-	if (status_int != 0)
-		Status = VL53L0X_ERROR_CONTROL_INTERFACE;
-
-    return Status;
+    return VL53L0X_WriteMulti(Dev, index, &data, 1);
 }
 
 VL53L0X_Error VL53L0X_WrWord(VL53L0X_DEV Dev, uint8_t index, uint16_t data){
-    VL53L0X_Error Status = VL53L0X_ERROR_NONE;
-    int32_t status_int;
-	uint8_t deviceAddress;
-
-    deviceAddress = Dev->I2cDevAddr;
+    uint8_t buff[2];
 
-	status_int = VL53L0X_write_word(deviceAddress, index, data);
+    buff[1] = data & 0xFF;
+    buff[0] = data >> 8;
 
-	if (status_int != 0)
-		Status = VL53L0X_ERROR_CONTROL_INTERFACE;
-
-    return Status;
+    return VL53L0X_WriteMulti(Dev, index, buff, 2);
 }
 
 VL53L0X_Error VL53L0X_WrDWord(VL53L0X_DEV Dev, uint8_t index, uint32_t data){
-    VL53L0X_Error Status = VL53L0X_ERROR_NONE;
-    int32_t status_int;
-	uint8_t deviceAddress;
-
-    deviceAddress = Dev->I2cDevAddr;
-
-	status_int = VL53L0X_write_dword(deviceAddress, index, data);
+    uint8_t buff[4];
 
-	if (status_int != 0)
-		Status = VL53L0X_ERROR_CONTROL_INTERFACE;
+    buff[3] = data & 0xFF;
+    buff[2] = data >> 8;
+    buff[1] = data >> 16;
+    buff[0] = data >> 24;
 
-    return Status;
+    return VL53L0X_WriteMulti(Dev, index, buff, 4);
 }
 
 VL53L0X_Error VL53L0X_UpdateByte(VL53L0X_DEV Dev, uint8_t index, uint8_t AndData, uint8_t OrData){
     VL53L0X_Error Status = VL53L0X_ERROR_NONE;
-    int32_t status_int;
-    uint8_t deviceAddress;
     uint8_t data;
 
-    deviceAddress = Dev->I2cDevAddr;
-
-    status_int = VL53L0X_read_byte(deviceAddress, index, &data);
-
-    if (status_int != 0)
-        Status = VL53L0X_ERROR_CONTROL_INTERFACE;
+    // The read is served by the shadow for the static registers.
+    Status = VL53L0X_ReadMulti(Dev, index, &data, 1);
 
     if (Status == VL53L0X_ERROR_NONE) {
         data = (data & AndData) | OrData;
-        status_int = VL53L0X_write_byte(deviceAddress, index, data);
-
-        if (status_int != 0)
-            Status = VL53L0X_ERROR_CONTROL_INTERFACE;
+        Status = VL53L0X_WriteMulti(Dev, index, &data, 1);
     }
 
     return Status;
 }
 
 VL53L0X_Error VL53L0X_RdByte(VL53L0X_DEV Dev, uint8_t index, uint8_t *data){
-    VL53L0X_Error Status = VL53L0X_ERROR_NONE;
-    int32_t status_int;
-    uint8_t deviceAddress;
-
-    deviceAddress = Dev->I2cDevAddr;
-
-    status_int = VL53L0X_read_byte(deviceAddress, index, data);
-
-    if (status_int != 0)
-        Status = VL53L0X_ERROR_CONTROL_INTERFACE;
-
-    return Status;
+    return VL53L0X_ReadMulti(Dev, index, data, 1);
 }
 
 VL53L0X_Error VL53L0X_RdWord(VL53L0X_DEV Dev, uint8_t index, uint16_t *data){
-    VL53L0X_Error Status = VL53L0X_ERROR_NONE;
-    int32_t status_int;
-    uint8_t deviceAddress;
-
-    deviceAddress = Dev->I2cDevAddr;
+    VL53L0X_Error Status;
+    uint8_t buff[2];
 
-    status_int = VL53L0X_read_word(deviceAddress, index, data);
+    Status = VL53L0X_ReadMulti(Dev, index, buff, 2);
 
-    if (status_int != 0)
-        Status = VL53L0X_ERROR_CONTROL_INTERFACE;
+    if (Status == VL53L0X_ERROR_NONE)
+        *data = ((uint16_t)buff[0] << 8) | buff[1];
 
     return Status;
 }
 
 VL53L0X_Error  VL53L0X_RdDWord(VL53L0X_DEV Dev, uint8_t index, uint32_t *data){
-    VL53L0X_Error Status = VL53L0X_ERROR_NONE;
-    int32_t status_int;
-    uint8_t deviceAddress;
-
-    deviceAddress = Dev->I2cDevAddr;
+    VL53L0X_Error Status;
+    uint8_t buff[4];
 
-    status_int = VL53L0X_read_dword(deviceAddress, index, data);
+    Status = VL53L0X_ReadMulti(Dev, index, buff, 4);
 
-    if (status_int != 0)
-        Status = VL53L0X_ERROR_CONTROL_INTERFACE;
+    if (Status == VL53L0X_ERROR_NONE)
+        *data = ((uint32_t)buff[0] << 24) | ((uint32_t)buff[1] << 16) | ((uint32_t)buff[2] << 8) | buff[3];
 
     return Status;
 }
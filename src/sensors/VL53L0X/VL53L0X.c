@@ -13,13 +13,70 @@
 #include "chprintf.h"
 #include "i2c_bus.h"
 #include "usbcfg.h"
+#include "exti.h"
+#include <main.h>
 
 static uint16_t dist_mm = 0;
 static thread_t *distThd;
 static bool VL53L0X_configured = false;
+static uint32_t timing_budget = VL53L0X_TIMING_BUDGET_DEFAULT;
+static uint32_t requested_timing_budget = VL53L0X_TIMING_BUDGET_DEFAULT;
+static distance_msg_t distance_values;
 
-//////////////////// PUBLIC FUNCTIONS /////////////////////////
-static THD_WORKING_AREA(waVL53L0XThd, 512);
+static messagebus_topic_t distance_topic;
+static MUTEX_DECL(distance_topic_lock);
+static CONDVAR_DECL(distance_topic_condvar);
+static bool distance_topic_advertised = false;
+
+//////////////////// INTERNAL FUNCTIONS /////////////////////////
+
+/**
+ * @brief 			Sets the timing budget of the sensor. The measures must be stopped.
+ */
+static VL53L0X_Error VL53L0X_applyTimingBudget(VL53L0X_Dev_t* device, uint32_t budget_us){
+
+	VL53L0X_Error status = VL53L0X_ERROR_NONE;
+	// The long range VCSEL periods (see VL53L0X_configAccuracy) don't leave enough time
+	// for the final range under 33 ms, the periods of the high speed mode are used instead.
+	uint8_t pre_range = (budget_us < VL53L0X_LONG_RANGE_MIN_BUDGET) ? 14 : 18;
+	uint8_t final_range = (budget_us < VL53L0X_LONG_RANGE_MIN_BUDGET) ? 10 : 14;
+
+	if (status == VL53L0X_ERROR_NONE) {
+		status = VL53L0X_SetVcselPulsePeriod(device,
+				VL53L0X_VCSEL_PERIOD_PRE_RANGE, pre_range);
+	}
+	if (status == VL53L0X_ERROR_NONE) {
+		status = VL53L0X_SetVcselPulsePeriod(device,
+				VL53L0X_VCSEL_PERIOD_FINAL_RANGE, final_range);
+	}
+	if (status == VL53L0X_ERROR_NONE) {
+		status = VL53L0X_SetMeasurementTimingBudgetMicroSeconds(device,
+				budget_us);
+	}
+
+	return status;
+}
+
+/**
+ * @brief 			Stops the measures and waits until the sensor is idle.
+ */
+static void VL53L0X_stopAndWait(VL53L0X_Dev_t* device){
+	uint32_t stop_status = 1;
+
+	VL53L0X_stopMeasure(device);
+	// The current measure is completed first.
+	for(uint8_t i = 0 ; i < 50 && stop_status != 0 ; i++){
+		if(VL53L0X_GetStopCompletedStatus(device, &stop_status) != VL53L0X_ERROR_NONE){
+			break;
+		}
+		if(stop_status != 0){
+			chThdSleepMilliseconds(5);
+		}
+	}
+	VL53L0X_ClearInterruptMask(device, 0);
+}
+
+static THD_WORKING_AREA(waVL53L0XThd, 1024);
 static THD_FUNCTION(VL53L0XThd, arg) {
 
 	chRegSetThreadName("VL53L0x Thd");
@@ -28,6 +85,18 @@ static THD_FUNCTION(VL53L0XThd, arg) {
 	(void)arg;
 	static VL53L0X_Dev_t device;
 
+	event_listener_t tof_int;
+	chEvtRegisterMaskWithFlags(&exti_events, &tof_int,
+							   (eventmask_t)EXTI_EVENT_TOF_INT,
+							   (eventflags_t)EXTI_EVENT_TOF_INT);
+
+	// The topic stays in the bus after a stop, it is advertised only once.
+	if(!distance_topic_advertised) {
+		messagebus_topic_init(&distance_topic, &distance_topic_lock, &distance_topic_condvar, &distance_values, sizeof(distance_values));
+		messagebus_advertise_topic(&bus, &distance_topic, "/distance");
+		distance_topic_advertised = true;
+	}
+
 	device.I2cDevAddr = VL53L0X_ADDR;
 	
 	status = VL53L0X_init(&device);
@@ -36,6 +105,16 @@ static THD_FUNCTION(VL53L0XThd, arg) {
 		VL53L0X_configAccuracy(&device, VL53L0X_LONG_RANGE);
 	}
 	if(status == VL53L0X_ERROR_NONE){
+		timing_budget = requested_timing_budget;
+		status = VL53L0X_applyTimingBudget(&device, timing_budget);
+	}
+	if(status == VL53L0X_ERROR_NONE){
+		// GPIO1 goes low when a new measure is ready, until the interrupt is cleared.
+		status = VL53L0X_SetGpioConfig(&device, 0, VL53L0X_DEVICEMODE_CONTINUOUS_RANGING,
+				VL53L0X_GPIOFUNCTIONALITY_NEW_MEASURE_READY, VL53L0X_INTERRUPTPOLARITY_LOW);
+	}
+	if(status == VL53L0X_ERROR_NONE){
+		VL53L0X_ClearInterruptMask(&device, 0);
 		VL53L0X_startMeasure(&device, VL53L0X_DEVICEMODE_CONTINUOUS_RANGING);
 	}
 	if(status == VL53L0X_ERROR_NONE){
@@ -45,15 +124,49 @@ static THD_FUNCTION(VL53L0XThd, arg) {
     /* Reader thread loop.*/
     while (chThdShouldTerminateX() == false) {
     	if(VL53L0X_configured){
-    		VL53L0X_getLastMeasure(&device);
-   			dist_mm = device.Data.LastRangeMeasure.RangeMilliMeter;
+    		if(requested_timing_budget != timing_budget){
+    			VL53L0X_stopAndWait(&device);
+    			if(VL53L0X_applyTimingBudget(&device, requested_timing_budget) == VL53L0X_ERROR_NONE){
+    				timing_budget = requested_timing_budget;
+    			} else {
+    				// Keeps the previous budget.
+    				requested_timing_budget = timing_budget;
+    				VL53L0X_applyTimingBudget(&device, timing_budget);
+    			}
+    			VL53L0X_startMeasure(&device, VL53L0X_DEVICEMODE_CONTINUOUS_RANGING);
+    		}
+
+    		// Waits for the data ready interrupt. If an edge is missed (the line stays low until
+    		// the interrupt is cleared), the data ready status is read after twice the timing budget.
+    		eventmask_t evt = chEvtWaitAnyTimeout(EXTI_EVENT_TOF_INT, US2ST(2 * timing_budget));
+    		chEvtGetAndClearFlags(&tof_int);
+    		if(evt == 0){
+    			uint8_t ready = 0;
+    			VL53L0X_GetMeasurementDataReady(&device, &ready);
+    			if(!ready){
+    				continue;
+    			}
+    		}
+    		systime_t capture = chVTGetSystemTime();
+
+    		if(VL53L0X_getLastMeasure(&device) == VL53L0X_ERROR_NONE){
+    			dist_mm = device.Data.LastRangeMeasure.RangeMilliMeter;
+    			sensor_header_stamp(&distance_values.header, capture, 1000000 / timing_budget);
+    			distance_values.dist_mm = dist_mm;
+    			distance_values.status = device.Data.LastRangeMeasure.RangeStatus;
+    			messagebus_topic_publish(&distance_topic, &distance_values, sizeof(distance_values));
+    		}
+    		VL53L0X_ClearInterruptMask(&device, 0);
+    	} else {
+    		chThdSleepMilliseconds(100);
     	}
-		chThdSleepMilliseconds(100);
     }
 
-    VL53L0X_stopMeasure(&device);
+    VL53L0X_stopAndWait(&device);
+    chEvtUnregister(&exti_events, &tof_int);
 }
 
+//////////////////// PUBLIC FUNCTIONS /////////////////////////
 
 VL53L0X_Error VL53L0X_init(VL53L0X_Dev_t* device){
 
@@ -65,6 +178,9 @@ VL53L0X_Error VL53L0X_init(VL53L0X_Dev_t* device){
     uint8_t isApertureSpads;
 
 //init
+	// The sensor may have been reset since the last init.
+	VL53L0X_ShadowReset(device);
+
 	if(status == VL53L0X_ERROR_NONE)
     {
     	// Structure and device initialisation
@@ -250,3 +366,16 @@ uint16_t VL53L0X_get_dist_mm(void) {
 	return dist_mm;
 }
 
+void VL53L0X_set_timing_budget(uint32_t budget_us) {
+	if(budget_us < VL53L0X_TIMING_BUDGET_MIN) {
+		budget_us = VL53L0X_TIMING_BUDGET_MIN;
+	} else if(budget_us > VL53L0X_TIMING_BUDGET_MAX) {
+		budget_us = VL53L0X_TIMING_BUDGET_MAX;
+	}
+	requested_timing_budget = budget_us;
+}
+
+uint32_t VL53L0X_get_timing_budget(void) {
+	return timing_budget;
+}
+
@@ -9,12 +9,33 @@
 #ifndef VL53L0X_H
 #define VL53L0X_H
 
+#include <hal.h>
 #include "Api/core/inc/vl53l0x_api.h"
+#include "sensors/sensor_sample.h"
 
 #define USE_I2C_2V8
 
 #define VL53L0X_ADDR 0x52
 
+/* Limits of the timing budget in us. A measure takes about the timing budget, 20 ms gives 50 Hz ranging. */
+#define VL53L0X_TIMING_BUDGET_MIN		20000
+#define VL53L0X_TIMING_BUDGET_MAX		200000
+#define VL53L0X_TIMING_BUDGET_DEFAULT	33000
+/* Under this timing budget the default VCSEL periods replace the long range ones. */
+#define VL53L0X_LONG_RANGE_MIN_BUDGET	33000
+
+/** Struct containing a distance measurement message. */
+typedef struct {
+	/** Time at which the sensor signaled the measure, the rate follows the timing budget. */
+	sensor_header_t header;
+
+	/** Distance in mm. */
+	uint16_t dist_mm;
+
+	/** RangeStatus of the ST API, 0 if the measure is valid. */
+	uint8_t status;
+} distance_msg_t;
+
 //////////////////// PROTOTYPES PUBLIC FUNCTIONS /////////////////////
 
 /**
@@ -64,6 +85,8 @@ VL53L0X_Error VL53L0X_stopMeasure(VL53L0X_Dev_t* device);
 /**
  * @brief Init a thread which uses the distance sensor to
  * continuoulsy measure the distance.
+ * Each measure is read when the sensor signals it on its GPIO1 line and is
+ * broadcast as a distance_msg_t message on the /distance topic.
  */
 void VL53L0X_start(void);
 
@@ -80,4 +103,20 @@ void VL53L0X_stop(void);
  */	
 uint16_t VL53L0X_get_dist_mm(void);
 
+/**
+ * @brief 			Changes the timing budget of the measures. It is applied by the
+ * 					measurement thread before the next measure.
+ *
+ * @param budget_us	Timing budget in us, between VL53L0X_TIMING_BUDGET_MIN (high speed)
+ * 					and VL53L0X_TIMING_BUDGET_MAX (high accuracy)
+ */
+void VL53L0X_set_timing_budget(uint32_t budget_us);
+
+/**
+ * @brief 			Returns the timing budget currently used by the sensor
+ *
+ * @return 			Timing budget in us
+ */
+uint32_t VL53L0X_get_timing_budget(void);
+
 #endif /* VL53L0X_H*/
@@ -11,6 +11,7 @@
 // - [sampling (480 cycles) + conversion (12 cycles)] x 1'000'000/10'500'000 = about 46.9 us
 
 #define DMA_BUFFER_SIZE (32)
+#define BATTERY_RATE 2 // Hz, the last measure is published every 500 ms.
 
 #define VOLTAGE_DIVIDER         (1.0f * RESISTOR_R2 / (RESISTOR_R1 + RESISTOR_R2))
 
@@ -103,12 +104,13 @@ static THD_FUNCTION(battery_thd, arg)
         battery_value.percentage =  (battery_value.voltage - MIN_VOLTAGE) * 
                                     (MAX_PERCENTAGE - MIN_PERCENTAGE) / 
                                     (MAX_VOLTAGE - MIN_VOLTAGE) + MIN_PERCENTAGE;
+        sensor_header_stamp(&battery_value.header, chVTGetSystemTime(), BATTERY_RATE);
         messagebus_topic_publish(&battery_topic, &battery_value, sizeof(battery_value));
 
         //battery_check();
 
         /* Sleep for some time. */
-        chThdSleepMilliseconds(500);
+        chThdSleepMilliseconds(1000 / BATTERY_RATE);
     }
 }
 
@@ -2,6 +2,7 @@
 #define BATTERY_LEVEL_H
 
 #include <hal.h>
+#include "sensors/sensor_sample.h"
 
 /* BATTERY---[ R1 ]--*--- measure
                      |
@@ -24,6 +25,7 @@
 
 /** Message reprensenting a measurement of the battery level. */
 typedef struct {
+    sensor_header_t header;
     float voltage;
     float percentage;
     uint16_t raw_value;
@@ -1,23 +1,97 @@
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include "ch.h"
 #include "hal.h"
 #include "ground.h"
 #include <main.h>
 #include "i2c_bus.h"
+#include "motors.h"
 #include "usbcfg.h"
 #include "chprintf.h"
 
 static ground_msg_t ground_values;
+static ground_msg_t ground_published;
 static bool ground_configured = false;
 static thread_t *groundThd;
+static uint16_t ground_period = GROUND_PERIOD_NORMAL;
+static uint16_t cliff_threshold = GROUND_CLIFF_NEAR_DEFAULT;
 
 #define GROUND_ADDR 0x60
 
 /***************************INTERNAL FUNCTIONS************************************/
 
+static void decode_measures(const uint8_t *data, ground_msg_t *values) {
+	// Ground
+	values->delta[0] = (uint16_t)(data[1] & 0xff) + ((uint16_t)data[0] << 8);
+	values->delta[1] = (uint16_t)(data[3] & 0xff) + ((uint16_t)data[2] << 8);
+	values->delta[2] = (uint16_t)(data[5] & 0xff) + ((uint16_t)data[4] << 8);
+	values->ambient[0] = (uint16_t)(data[7] & 0xff) + ((uint16_t)data[6] << 8);
+	values->ambient[1] = (uint16_t)(data[9] & 0xff) + ((uint16_t)data[8] << 8);
+	values->ambient[2] = (uint16_t)(data[11] & 0xff) + ((uint16_t)data[10] << 8);
+	// Cliff
+	values->delta[3] = (uint16_t)(data[14] & 0xff) + ((uint16_t)data[13] << 8);
+	values->delta[4] = (uint16_t)(data[16] & 0xff) + ((uint16_t)data[15] << 8);
+	values->ambient[3] = (uint16_t)(data[18] & 0xff) + ((uint16_t)data[17] << 8);
+	values->ambient[4] = (uint16_t)(data[20] & 0xff) + ((uint16_t)data[19] << 8);
+}
+
+ /**
+ * @brief   Hysteresis filter: a published value only follows the measure when it moves away by more
+ * 			than the threshold, so that the noise doesn't trigger a publication.
+ *
+ * @return	true if at least one published value changed
+ */
+static bool filter_measures(const ground_msg_t *measure, ground_msg_t *published) {
+	bool changed = false;
+
+	for(uint8_t i=0; i<GROUND_NB_CHANNELS; i++) {
+		if(abs((int32_t)measure->delta[i] - published->delta[i]) > GROUND_DELTA_HYSTERESIS) {
+			published->delta[i] = measure->delta[i];
+			changed = true;
+		}
+		if(abs((int32_t)measure->ambient[i] - published->ambient[i]) > GROUND_AMBIENT_HYSTERESIS) {
+			published->ambient[i] = measure->ambient[i];
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+ /**
+ * @brief   Chooses the period of the next measure from the speed of the motors and the last measure.
+ *
+ * @param now			current system time
+ * @param last_moving	last time the robot was moving, updated by the function
+ *
+ * @return	period in ms
+ */
+static uint16_t select_period(systime_t now, systime_t *last_moving) {
+	int left = abs(left_motor_get_desired_speed());
+	int right = abs(right_motor_get_desired_speed());
+	int speed = left > right ? left : right;
+
+	for(uint8_t i=0; i<GROUND_NB_CHANNELS; i++) {
+		if(ground_values.delta[i] < cliff_threshold) {
+			return GROUND_PERIOD_FAST;
+		}
+	}
+	if(speed >= GROUND_FAST_SPEED) {
+		*last_moving = now;
+		return GROUND_PERIOD_FAST;
+	}
+	if(speed > 0) {
+		*last_moving = now;
+		return GROUND_PERIOD_NORMAL;
+	}
+	if(chVTTimeElapsedSinceX(*last_moving) < MS2ST(GROUND_IDLE_DELAY)) {
+		return GROUND_PERIOD_NORMAL;
+	}
+	return GROUND_PERIOD_IDLE;
+}
+
  /**
- * @brief   Thread which updates the measures and publishes them
+ * @brief   Thread which updates the measures and publishes them when they change
  */
 static THD_WORKING_AREA(ground_thd_wa, 512);
 static THD_FUNCTION(ground_thd, arg)
@@ -28,35 +102,41 @@ static THD_FUNCTION(ground_thd, arg)
     messagebus_topic_t ground_topic;
     MUTEX_DECL(ground_topic_lock);
     CONDVAR_DECL(ground_topic_condvar);
-    messagebus_topic_init(&ground_topic, &ground_topic_lock, &ground_topic_condvar, &ground_values, sizeof(ground_values));
+    messagebus_topic_init(&ground_topic, &ground_topic_lock, &ground_topic_condvar, &ground_published, sizeof(ground_published));
     messagebus_advertise_topic(&bus, &ground_topic, "/ground");
     systime_t time;
+    systime_t last_publish = 0;
+    systime_t last_moving = chVTGetSystemTime();
+    bool first = true;
+    i2c_transaction_t t;
+    uint8_t reg = 0;
 	uint8_t temp[21]; // 3 x ground proximity (6 bytes) + 3 x ground ambient (6 bytes) + software revision (1 byte) + 2 x cliff proximity (4 bytes) + 2 x cliff ambient (4 bytes)
+	ground_published = ground_values;
 
     while (chThdShouldTerminateX() == false) {
     	time = chVTGetSystemTime();
 
-    	read_reg_multi(GROUND_ADDR, 0, temp, 21);
-    	// Ground
-        ground_values.delta[0] = (uint16_t)(temp[1] & 0xff) + ((uint16_t)temp[0] << 8);
-        ground_values.delta[1] = (uint16_t)(temp[3] & 0xff) + ((uint16_t)temp[2] << 8);
-        ground_values.delta[2] = (uint16_t)(temp[5] & 0xff) + ((uint16_t)temp[4] << 8);
-        ground_values.ambient[0] = (uint16_t)(temp[7] & 0xff) + ((uint16_t)temp[6] << 8);
-        ground_values.ambient[1] = (uint16_t)(temp[9] & 0xff) + ((uint16_t)temp[8] << 8);
-        ground_values.ambient[2] = (uint16_t)(temp[11] & 0xff) + ((uint16_t)temp[10] << 8);
-        // Cliff
-        ground_values.delta[3] = (uint16_t)(temp[14] & 0xff) + ((uint16_t)temp[13] << 8);
-        ground_values.delta[4] = (uint16_t)(temp[16] & 0xff) + ((uint16_t)temp[15] << 8);
-        ground_values.ambient[3] = (uint16_t)(temp[18] & 0xff) + ((uint16_t)temp[17] << 8);
-        ground_values.ambient[4] = (uint16_t)(temp[20] & 0xff) + ((uint16_t)temp[19] << 8);
-
-        messagebus_topic_publish(&ground_topic, &ground_values, sizeof(ground_values));
+    	// A measure which could not be read before the next one is due is dropped.
+    	i2c_transaction_init(&t, GROUND_ADDR, &reg, 1, temp, sizeof(temp));
+    	t.deadline = MS2ST(ground_period);
+    	if(i2c_transfer(&t) == MSG_OK) {
+    		decode_measures(temp, &ground_values);
+
+    		// The last values are published at least every GROUND_KEEPALIVE_PERIOD, even without change.
+    		if(filter_measures(&ground_values, &ground_published) || first ||
+    				chVTTimeElapsedSinceX(last_publish) >= MS2ST(GROUND_KEEPALIVE_PERIOD)) {
+    			sensor_header_stamp(&ground_published.header, time, 1000 / ground_period);
+    			messagebus_topic_publish(&ground_topic, &ground_published, sizeof(ground_published));
+    			last_publish = time;
+    			first = false;
+    		}
+    	}
 
     	//chprintf((BaseSequentialStream *)&SDU1, "prox: %d, %d, %d,\r\n", ground_values.delta[0], ground_values.delta[1], ground_values.delta[2]);
     	//chprintf((BaseSequentialStream *)&SDU1, "ambient: %d, %d, %d,\r\n", ground_values.ambient[0], ground_values.ambient[1], ground_values.ambient[2]);
 
-        chThdSleepUntilWindowed(time, time + MS2ST(40)); //reduced the sample rate to 25Hz
-
+    	ground_period = select_period(time, &last_moving);
+        chThdSleepUntilWindowed(time, time + MS2ST(ground_period));
     }
 }
 
@@ -85,18 +165,7 @@ void ground_start(void)
 	if((err=read_reg_multi(GROUND_ADDR, 0, temp, 21)) != MSG_OK) {
 		return;
 	}
-	// Ground
-    ground_values.delta[0] = (uint16_t)(temp[1] & 0xff) + ((uint16_t)temp[0] << 8);
-    ground_values.delta[1] = (uint16_t)(temp[3] & 0xff) + ((uint16_t)temp[2] << 8);
-    ground_values.delta[2] = (uint16_t)(temp[5] & 0xff) + ((uint16_t)temp[4] << 8);
-    ground_values.ambient[0] = (uint16_t)(temp[7] & 0xff) + ((uint16_t)temp[6] << 8);
-    ground_values.ambient[1] = (uint16_t)(temp[9] & 0xff) + ((uint16_t)temp[8] << 8);
-    ground_values.ambient[2] = (uint16_t)(temp[11] & 0xff) + ((uint16_t)temp[10] << 8);
-    // Cliff
-    ground_values.delta[3] = (uint16_t)(temp[14] & 0xff) + ((uint16_t)temp[13] << 8);
-    ground_values.delta[4] = (uint16_t)(temp[16] & 0xff) + ((uint16_t)temp[15] << 8);
-    ground_values.ambient[3] = (uint16_t)(temp[18] & 0xff) + ((uint16_t)temp[17] << 8);
-    ground_values.ambient[4] = (uint16_t)(temp[20] & 0xff) + ((uint16_t)temp[19] << 8);
+	decode_measures(temp, &ground_values);
 
     ground_configured = true;
     groundThd = chThdCreateStatic(ground_thd_wa, sizeof(ground_thd_wa), NORMALPRIO, ground_thd, NULL);
@@ -128,4 +197,15 @@ int get_ground_ambient_light(unsigned int sensor_number) {
 	}
 }
 
+uint16_t get_ground_rate(void) {
+	if(!ground_configured) {
+		return 0;
+	}
+	return 1000 / ground_period;
+}
+
+void ground_set_cliff_threshold(uint16_t threshold) {
+	cliff_threshold = threshold;
+}
+
 /**************************END PUBLIC FUNCTIONS***********************************/
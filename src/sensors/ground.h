@@ -5,10 +5,34 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
+#include "sensor_sample.h"
+
 #define GROUND_NB_CHANNELS 5 // 3 from gound + 2 from cliff
 
+/* Measurement periods in ms. */
+#define GROUND_PERIOD_FAST			10		// 100 Hz, moving fast or close to a cliff
+#define GROUND_PERIOD_NORMAL		40		// 25 Hz, moving slowly
+#define GROUND_PERIOD_IDLE			100		// 10 Hz, stationary
+/* Motor speed (step/s) from which the fast rate is used, about 7 cm/s. */
+#define GROUND_FAST_SPEED			550
+/* Time without motion (ms) after which the idle rate is used. */
+#define GROUND_IDLE_DELAY			1000
+/* A delta under this value means that a cliff (or a dark ground) is near, the fast rate is used. */
+#define GROUND_CLIFF_NEAR_DEFAULT	150
+
+/* Hysteresis of the published values, a new message is only published when a value moves away
+ * from the last one published by more than this. */
+#define GROUND_DELTA_HYSTERESIS		8
+#define GROUND_AMBIENT_HYSTERESIS	16
+/* The values are published at least with this period (ms), even without change. */
+#define GROUND_KEEPALIVE_PERIOD		1000
+
 /** Struct containing a ground measurement message. */
 typedef struct {
+    /** Time of the measure which triggered the publication and current measurement rate. */
+    sensor_header_t header;
+
     /** Ambient light level (LED is OFF). */
     uint16_t ambient[GROUND_NB_CHANNELS];
 
@@ -18,7 +42,9 @@ typedef struct {
 
  /**
  * @brief   Check the presence of the ground sensor and start the publisher.
- * 			It broadcast a ground_msg_t message on the /ground topic.
+ * 			It broadcast a ground_msg_t message on the /ground topic when a value changes
+ * 			(see GROUND_DELTA_HYSTERESIS) and at least every GROUND_KEEPALIVE_PERIOD ms.
+ * 			The measurement rate adapts to the speed of the motors and to the distance to a cliff.
  */
 void ground_start(void);
 
@@ -47,6 +73,20 @@ int get_ground_prox(unsigned int sensor_number);
  */
 int get_ground_ambient_light(unsigned int sensor_number);
 
+ /**
+ * @brief   Returns the current measurement rate
+ *
+ * @return					Rate in Hz, 0 if the sensor is not started
+ */
+uint16_t get_ground_rate(void);
+
+ /**
+ * @brief   Sets the delta under which a cliff is considered near and the fast rate is used
+ *
+ * @param threshold			Delta value, GROUND_CLIFF_NEAR_DEFAULT by default
+ */
+void ground_set_cliff_threshold(uint16_t threshold);
+
 #ifdef __cplusplus
 }
 #endif
@@ -3,6 +3,7 @@
 #include "AK09916_REGISTERS.h"
 #include <math.h>
 #include "../imu.h"
+#include "../imu_fifo.h"
 #include "../leds.h"
 #include "usbcfg.h"
 #include "chprintf.h"
@@ -2736,3 +2737,82 @@ int8_t icm20948_read(ICM_20948_Device_t *pdev, float *gyro, float *acc, float *t
 	return err;
 }
 
+int8_t icm20948_fifo_setup(ICM_20948_Device_t *pdev, uint8_t gyro_div, uint8_t acc_div)
+{
+	ICM_20948_Status_e retval = ICM_20948_Stat_Ok;
+	uint8_t temp;
+
+	ICM_20948_smplrt_t smplrt;
+	smplrt.g = gyro_div; // ODR = 1.1 kHz/(1+gyro_div)
+	smplrt.a = acc_div; // ODR = 1.125 kHz/(1+acc_div)
+	retval |= ICM_20948_set_sample_rate(pdev, (ICM_20948_InternalSensorID_bm)(ICM_20948_Internal_Acc | ICM_20948_Internal_Gyr), smplrt);
+
+	ICM_20948_set_bank(pdev, 0); // Must be in the right bank
+	// The magnetometer is still read by the I2C master but is kept out of the FIFO: read it with icm20948_read_mag.
+	temp = 0x00;
+	retval |= ICM_20948_execute_w(pdev, AGB0_REG_FIFO_EN_1, &temp, 1);
+	temp = 0x1E; // Accelerometer and gyroscope.
+	retval |= ICM_20948_execute_w(pdev, AGB0_REG_FIFO_EN_2, &temp, 1);
+	temp = 0x60; // Enable master i2c and fifo
+	retval |= ICM_20948_execute_w(pdev, AGB0_REG_USER_CTRL, &temp, 1);
+	if(retval != ICM_20948_Stat_Ok) {
+		return -1;
+	}
+	return icm20948_fifo_reset(pdev);
+}
+
+int8_t icm20948_fifo_reset(ICM_20948_Device_t *pdev)
+{
+	ICM_20948_Status_e retval = ICM_20948_Stat_Ok;
+	uint8_t temp;
+
+	ICM_20948_set_bank(pdev, 0); // Must be in the right bank
+	temp = 0x1F;
+	retval |= ICM_20948_execute_w(pdev, AGB0_REG_FIFO_RST, &temp, 1);
+	temp = 0x00;
+	retval |= ICM_20948_execute_w(pdev, AGB0_REG_FIFO_RST, &temp, 1);
+	return (retval == ICM_20948_Stat_Ok) ? MSG_OK : -1;
+}
+
+int8_t icm20948_fifo_count(ICM_20948_Device_t *pdev, uint16_t *count, uint8_t *overflow, systime_t *time)
+{
+	uint8_t count_buf[2];
+
+	*count = 0;
+	ICM_20948_set_bank(pdev, 0); // Must be in the right bank
+	if(read_reg_multi_time(ICM_20948_I2C_ADDR_AD0, AGB0_REG_FIFO_COUNT_H, count_buf, 2, time) != MSG_OK) {
+		return -1;
+	}
+	uint16_t bytes = ((uint16_t)(count_buf[0] & 0x1F) << 8) | count_buf[1];
+
+	// A full FIFO means that samples were lost and that the records may be misaligned.
+	if(bytes > IMU_FIFO_SIZE - IMU_FIFO_RECORD_SIZE) {
+		*overflow = 1;
+		return icm20948_fifo_reset(pdev);
+	}
+	*count = bytes / IMU_FIFO_RECORD_SIZE;
+	return MSG_OK;
+}
+
+int8_t icm20948_fifo_read(ICM_20948_Device_t *pdev, uint8_t *buf, uint16_t len)
+{
+	ICM_20948_set_bank(pdev, 0); // Must be in the right bank
+	if(read_reg_fifo(ICM_20948_I2C_ADDR_AD0, AGB0_REG_FIFO_R_W, buf, len, IMU_FIFO_BURST_LEN) != MSG_OK) {
+		return -1;
+	}
+	return MSG_OK;
+}
+
+int8_t icm20948_read_mag(ICM_20948_Device_t *pdev, float *magnet)
+{
+	uint8_t buf[9]; // From ST1 to ST2, copied by the I2C master.
+
+	ICM_20948_set_bank(pdev, 0); // Must be in the right bank
+	if(ICM_20948_execute_r(pdev, AGB0_REG_EXT_PERIPH_SENS_DATA_00, buf, sizeof(buf)) != ICM_20948_Stat_Ok) {
+		return -1;
+	}
+	magnet[X_AXIS] = ((int16_t)((int8_t)buf[2]) << 8 | buf[1]) * RAW16BITS_TO_TESLA;
+	magnet[Y_AXIS] = ((int16_t)((int8_t)buf[4]) << 8 | buf[3]) * RAW16BITS_TO_TESLA;
+	magnet[Z_AXIS] = ((int16_t)((int8_t)buf[6]) << 8 | buf[5]) * RAW16BITS_TO_TESLA;
+	return MSG_OK;
+}
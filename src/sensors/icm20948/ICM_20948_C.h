@@ -312,6 +312,46 @@ extern int memcmp(const void *, const void *, size_t); // Avoid compiler warning
   int8_t icm20948_read(ICM_20948_Device_t *pdev, float *gyro, float *acc, float *temp, float *magnet, int16_t *gyro_raw,
   					int16_t *acc_raw, int16_t *gyro_offset, int16_t *acc_offset, uint8_t *status);
 
+ /**
+  * @brief   Configures the sample rates and the FIFO to store only the accelerometer and gyroscope samples
+  * 		   (see imu_fifo.h).
+  *
+  * @param gyro_div		the gyroscope rate is 1.1 kHz / (1 + gyro_div)
+  * @param acc_div		the accelerometer rate is 1.125 kHz / (1 + acc_div)
+  */
+  int8_t icm20948_fifo_setup(ICM_20948_Device_t *pdev, uint8_t gyro_div, uint8_t acc_div);
+
+ /**
+  * @brief   Empties the FIFO.
+  */
+  int8_t icm20948_fifo_reset(ICM_20948_Device_t *pdev);
+
+ /**
+  * @brief   Reads the number of complete samples in the FIFO. The FIFO is reset in case of overflow.
+  *
+  * @param count		returns the number of samples, 0 after an overflow
+  * @param overflow		set to 1 if the FIFO overflowed (untouched otherwise)
+  * @param time			returns the system time at which the count was read, the last sample counted
+  * 					was taken just before
+  */
+  int8_t icm20948_fifo_count(ICM_20948_Device_t *pdev, uint16_t *count, uint8_t *overflow, systime_t *time);
+
+ /**
+  * @brief   Reads the oldest samples of the FIFO with burst reads.
+  *
+  * @param buf			buffer to store the FIFO bytes
+  * @param len			number of bytes to read, multiple of IMU_FIFO_RECORD_SIZE and at most the samples
+  * 					given by icm20948_fifo_count
+  */
+  int8_t icm20948_fifo_read(ICM_20948_Device_t *pdev, uint8_t *buf, uint16_t len);
+
+ /**
+  * @brief   Reads the last magnetometer measurement copied by the I2C master of the sensor.
+  *
+  * @param magnet		pointer to a buffer of at least a size of 3 elements to store the magnetometer measurement [uT]
+  */
+  int8_t icm20948_read_mag(ICM_20948_Device_t *pdev, float *magnet);
+
 
 extern ICM_20948_Serif_t icmSerif;
 extern ICM_20948_Device_t icmDevice;
@@ -5,6 +5,7 @@
 #include "chprintf.h"
 #include "i2c_bus.h"
 #include "imu.h"
+#include "imu_fifo.h"
 #include "../leds.h"
 //#include "exti.h"
 #include "icm20948/ICM_20948_REGISTERS.h"
@@ -15,7 +16,13 @@
 #define IMU_MPU9250 0
 #define IMU_ICM20948 1
 
+#define FIFO_DRAIN_PERIOD_MS 4
+#define FIFO_MAG_DIVIDER 25 // The magnetometer is read every 25 drains (100 ms), it is updated at 100 Hz.
+
 static imu_msg_t imu_values;
+static imu_batch_msg_t imu_batch;
+static uint8_t fifo_buf[IMU_BATCH_MAX_SAMPLES * IMU_FIFO_RECORD_SIZE];
+static uint16_t streamingRate = 0; // 0 when the registers are polled.
 
 static uint8_t accAxisFilteringInProgress = 0;
 static uint8_t accAxisFilteringState = 0;
@@ -39,6 +46,109 @@ static int8_t imuModel = IMU_NOT_FOUND;
 
 /***************************INTERNAL FUNCTIONS************************************/
 
+ /**
+ * @brief   Computes the dividers of the ICM-20948 for the streaming rate. The gyroscope rate is 1.1 kHz / (1 + gyro_div)
+ * 			and the accelerometer rate is 1.125 kHz / (1 + acc_div), they share the records of the FIFO so their rates
+ * 			must be equal. It is the case when 1 + gyro_div is a multiple of 44 (rates of 25 Hz / k), used up to 25 Hz.
+ * 			Above no pair of dividers gives the same rate, the accelerometer divider giving the rate closest to the
+ * 			gyroscope one is used (2.3 % of difference at most).
+ *
+ * @param rate		streaming rate requested
+ * @param acc_div	output: accelerometer divider
+ *
+ * @return			gyroscope divider, its rate is at or above the rate requested
+ */
+static uint8_t icm20948_dividers(uint16_t rate, uint8_t *acc_div) {
+	uint16_t gyro_div;
+	if(rate <= 25) {
+		uint16_t k = 25 / rate;
+		gyro_div = 44 * k - 1;
+		*acc_div = 45 * k - 1;
+	} else {
+		gyro_div = 1100 / rate - 1;
+		// Rounded solution of 1125 * (1 + acc_div) = 1100 * (1 + gyro_div).
+		*acc_div = (1125 * (gyro_div + 1) + 550) / 1100 - 1;
+	}
+	return gyro_div;
+}
+
+ /**
+ * @brief   Configures the FIFO of the sensor for the streaming rate requested.
+ */
+static int8_t imu_fifo_setup(void) {
+	uint16_t div;
+	if(imuModel == IMU_MPU9250) {
+		div = 1000 / streamingRate - 1;
+		imu_batch.period_us = 1000 * (div + 1);
+		return mpu9250_fifo_setup(div);
+	} else {
+		uint8_t acc_div;
+		div = icm20948_dividers(streamingRate, &acc_div);
+		imu_batch.period_us = 1000000 * (div + 1) / 1100;
+		return icm20948_fifo_setup(&icmDevice, div, acc_div);
+	}
+}
+
+ /**
+ * @brief   Sets the priority of the IMU on the I2C bus, for both addresses of the sensors (AD0 low or high).
+ */
+static void imu_set_bus_priority(uint8_t priority) {
+	i2c_set_priority(MPU9250_ADDRESS_AD1_0, priority);
+	i2c_set_priority(MPU9250_ADDRESS_AD1_1, priority);
+}
+
+ /**
+ * @brief   Reads all the samples in the FIFO, publishes them by batches and updates the last measure.
+ *
+ * @param batch_topic	topic of the batches
+ *
+ * @return				number of samples read, the last measure is unchanged when it is 0
+ */
+static uint16_t imu_fifo_drain(messagebus_topic_t *batch_topic) {
+	uint16_t count = 0;
+	uint16_t read = 0;
+	systime_t time;
+	int8_t err;
+
+	// The last sample counted is the most recent one, it was taken just before the count was read.
+	if(imuModel == IMU_MPU9250) {
+		err = mpu9250_fifo_count(&count, &imu_batch.overflow, &time);
+	} else {
+		err = icm20948_fifo_count(&icmDevice, &count, &imu_batch.overflow, &time);
+	}
+
+	while(err == MSG_OK && count > 0) {
+		uint8_t samples = (count > IMU_BATCH_MAX_SAMPLES) ? IMU_BATCH_MAX_SAMPLES : count;
+		uint16_t len = samples * IMU_FIFO_RECORD_SIZE;
+		if(imuModel == IMU_MPU9250) {
+			err = mpu9250_fifo_read(fifo_buf, len);
+		} else {
+			err = icm20948_fifo_read(&icmDevice, fifo_buf, len);
+		}
+		if(err != MSG_OK) {
+			return read;
+		}
+		count -= samples;
+		read += samples;
+
+		// The samples still in the FIFO were taken after the last one of this batch.
+		systime_t age = (systime_t)(((uint64_t)count * imu_batch.period_us * CH_CFG_ST_FREQUENCY) / 1000000);
+		sensor_header_stamp(&imu_batch.header, time - age, streamingRate);
+		imu_batch.count = imu_fifo_parse(fifo_buf, len, imu_batch.acc_raw, imu_batch.gyro_raw);
+		messagebus_topic_publish(batch_topic, &imu_batch, sizeof(imu_batch));
+		imu_batch.overflow = 0;
+
+		uint8_t last = imu_batch.count - 1;
+		for(uint8_t axis = 0; axis < 3; axis++) {
+			imu_values.acc_raw[axis] = imu_batch.acc_raw[last][axis];
+			imu_values.gyro_raw[axis] = imu_batch.gyro_raw[last][axis];
+		}
+		imu_fifo_convert(imu_values.acc_raw, imu_values.gyro_raw, imu_values.acc_offset, imu_values.gyro_offset,
+							imu_values.acceleration, imu_values.gyro_rate);
+	}
+	return read;
+}
+
 ICM_20948_Status_e startup_magnetometer(void)
 {
 	ICM_20948_Status_e status = ICM_20948_Stat_Ok;
@@ -140,6 +250,14 @@ static THD_FUNCTION(imu_reader_thd, arg) {
      messagebus_topic_init(&imu_topic, &imu_topic_lock, &imu_topic_condvar, &imu_values, sizeof(imu_values));
      messagebus_advertise_topic(&bus, &imu_topic, "/imu");
 
+     messagebus_topic_t imu_batch_topic;
+     MUTEX_DECL(imu_batch_topic_lock);
+     CONDVAR_DECL(imu_batch_topic_condvar);
+     messagebus_topic_init(&imu_batch_topic, &imu_batch_topic_lock, &imu_batch_topic_condvar, &imu_batch, sizeof(imu_batch));
+     messagebus_advertise_topic(&bus, &imu_batch_topic, "/imu_batch");
+     uint8_t mag_divider = 0;
+     bool new_measure;
+
      uint8_t accCalibrationNumSamples = 0;
      int32_t accCalibrationSum = 0;
      uint8_t gyroCalibrationNumSamples = 0;
@@ -163,13 +281,21 @@ static THD_FUNCTION(imu_reader_thd, arg) {
 
      while (chThdShouldTerminateX() == false) {
     	 time = chVTGetSystemTime();
+    	 new_measure = true;
 
       //    /* Waits for a measurement to come. */
       //    chEvtWaitAny(EXTI_EVENT_IMU_INT);
       //    //Clears the flag. Otherwise the event is always true
     	 // chEvtGetAndClearFlags(&imu_int);
 
-    	if(imu_configured == true){
+    	if(imu_configured == true && streamingRate > 0){
+    		/* Drains the FIFO, the magnetometer is not in the FIFO. */
+    		new_measure = imu_fifo_drain(&imu_batch_topic) > 0;
+    		if(imuModel == IMU_ICM20948 && ++mag_divider >= FIFO_MAG_DIVIDER) {
+    			mag_divider = 0;
+    			icm20948_read_mag(&icmDevice, imu_values.magnetometer);
+    		}
+    	} else if(imu_configured == true){
 	 		/* Reads the incoming measurement. */
     		if(imuModel == IMU_MPU9250)
     		{
@@ -186,10 +312,19 @@ static THD_FUNCTION(imu_reader_thd, arg) {
     	}
 
 
-         /* Publishes it on the bus. */
-         messagebus_topic_publish(&imu_topic, &imu_values, sizeof(imu_values));
+         /* Publishes it on the bus. In streaming mode the measure is the last sample of the FIFO,
+          * nothing is published when the FIFO was empty so that a sequence number isn't given to an old sample. */
+         if(new_measure) {
+        	 if(streamingRate > 0) {
+        		 sensor_header_stamp(&imu_values.header, imu_batch.header.timestamp, streamingRate);
+        	 } else {
+        		 sensor_header_stamp(&imu_values.header, time, 1000 / FIFO_DRAIN_PERIOD_MS);
+        	 }
+        	 messagebus_topic_publish(&imu_topic, &imu_values, sizeof(imu_values));
+         }
 
-         if(accAxisFilteringInProgress) {
+         // The filtering of the calibration only counts new samples.
+         if(accAxisFilteringInProgress && new_measure) {
          	switch(accAxisFilteringState) {
  				case 0:
  					imu_values.acc_offset[accAxisSelected] = 0;
@@ -213,7 +348,7 @@ static THD_FUNCTION(imu_reader_thd, arg) {
          	}
          }
 
-         if(gyroAxisFilteringInProgress) {
+         if(gyroAxisFilteringInProgress && new_measure) {
          	switch(gyroAxisFilteringState) {
  				case 0:
  					imu_values.gyro_offset[gyroAxisSelected] = 0;
@@ -304,7 +439,7 @@ static THD_FUNCTION(imu_reader_thd, arg) {
         	 }
          }
 
-         chThdSleepUntilWindowed(time, time + MS2ST(4)); //reduced the sample rate to 250Hz
+         chThdSleepUntilWindowed(time, time + MS2ST(FIFO_DRAIN_PERIOD_MS)); //reduced the sample rate to 250Hz (FIFO drained at 250Hz in streaming mode)
 
      }
 }
@@ -417,7 +552,13 @@ int8_t imu_start(void)
     // 	status = mpu9250_magnetometer_setup();
     // }
 
+    if(status == MSG_OK && streamingRate > 0){
+    	status = imu_fifo_setup();
+    }
+
     if(status == MSG_OK){
+    	// The FIFO overflows if it is not drained in time, the polled registers are only overwritten.
+    	imu_set_bus_priority(streamingRate > 0 ? I2C_PRIORITY_HIGH : I2C_PRIORITY_NORMAL);
     	imu_configured = true;
     	imuThd = chThdCreateStatic(imu_reader_thd_wa, sizeof(imu_reader_thd_wa), NORMALPRIO, imu_reader_thd, NULL);
     }
@@ -425,11 +566,26 @@ int8_t imu_start(void)
     return status;
 }
 
+int8_t imu_start_streaming(uint16_t rate_hz)
+{
+	if(imu_configured) {
+		return MSG_OK;
+	}
+	if(rate_hz < IMU_STREAMING_MIN_RATE) {
+		rate_hz = IMU_STREAMING_MIN_RATE;
+	} else if(rate_hz > IMU_STREAMING_MAX_RATE) {
+		rate_hz = IMU_STREAMING_MAX_RATE;
+	}
+	streamingRate = rate_hz;
+	return imu_start();
+}
+
 void imu_stop(void) {
     chThdTerminate(imuThd);
     chThdWait(imuThd);
     imuThd = NULL;
     imu_configured = false;
+    streamingRate = 0;
 }
 
 // Gets last axis value read from the sensor.
@@ -8,6 +8,7 @@ extern "C" {
 #include <hal.h>
 #include "sensors/mpu9250.h"
 #include "sensors/icm20948/ICM_20948_C.h"
+#include "sensors/sensor_sample.h"
 
 typedef enum{
     X_AXIS = 0,
@@ -18,6 +19,7 @@ typedef enum{
 
 /** Message containing one measurement from the IMU. */
 typedef struct {
+    sensor_header_t header; // Capture time of the accelerometer and gyroscope measure.
     float acceleration[3]; // m/s^2
     float gyro_rate[3]; // rad/s
     float temperature;
@@ -34,6 +36,20 @@ typedef struct {
     float mag_scale[3]; // Soft iron calibration factors.
 } imu_msg_t;
 
+#define IMU_BATCH_MAX_SAMPLES 16
+#define IMU_STREAMING_MIN_RATE 10 // Hz
+#define IMU_STREAMING_MAX_RATE 1000 // Hz
+
+/** Message containing consecutive samples read from the FIFO of the IMU (see imu_start_streaming). */
+typedef struct {
+    sensor_header_t header; // The timestamp is the system time at which the last sample of the batch was read.
+    uint32_t period_us; // Period between two samples, sample i was taken at header.timestamp - (count-1-i)*period_us.
+    uint8_t count; // Number of samples in the batch.
+    uint8_t overflow; // 1 if samples were lost since the previous batch.
+    int16_t acc_raw[IMU_BATCH_MAX_SAMPLES][3];
+    int16_t gyro_raw[IMU_BATCH_MAX_SAMPLES][3];
+} imu_batch_msg_t;
+
 
  /**
  * @brief   Starts the Inertial Motion Unit (IMU) publisher.
@@ -45,6 +61,20 @@ typedef struct {
  */
 int8_t imu_start(void);
 
+ /**
+ * @brief   Starts the IMU publisher in streaming mode: the samples are stored in the FIFO of the sensor
+ *          at the given rate and read with burst transfers every 4 ms. They are published by batches with
+ *          a imu_batch_msg_t message on the /imu_batch topic and the last sample of each batch is broadcast
+ *          on the /imu topic as with imu_start. The temperature is not updated in this mode.
+ *
+ * @param rate_hz       sampling rate of the accelerometer and gyroscope, between IMU_STREAMING_MIN_RATE
+ *                      and IMU_STREAMING_MAX_RATE (the closest rate available at or above it is used,
+ *                      up to 25 Hz the ICM-20948 only has 25 Hz and 12.5 Hz)
+ *
+ * @return              The operation status, see imu_start.
+ */
+int8_t imu_start_streaming(uint16_t rate_hz);
+
 /**
 * @brief   Stop the Inertial Motion Unit (IMU) publisher.
 *
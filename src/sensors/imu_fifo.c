@@ -0,0 +1,40 @@
+#include <math.h>
+#include "imu_fifo.h"
+
+#define STANDARD_GRAVITY    9.80665f
+#define DEG2RAD(deg) (deg / 180 * M_PI)
+
+#define RES_2G      2.0f
+#define RES_250DPS  250.0f
+#define MAX_INT16   32768.0f
+
+#define ACC_RAW2G           (RES_2G / MAX_INT16)   //2G scale for int16 raw value
+#define GYRO_RAW2DPS        (RES_250DPS / MAX_INT16)   //250DPS (degrees per second) scale for int16 raw value
+
+static inline int16_t read_word(const uint8_t *buf) {
+	return (int16_t)((uint16_t)buf[0] << 8 | buf[1]);
+}
+
+uint16_t imu_fifo_parse(const uint8_t *data, uint16_t len, int16_t (*acc_raw)[3], int16_t (*gyro_raw)[3]) {
+	uint16_t count = len / IMU_FIFO_RECORD_SIZE;
+
+	for(uint16_t i = 0; i < count; i++) {
+		const uint8_t *record = &data[i * IMU_FIFO_RECORD_SIZE];
+		// Change the sign of all axes to have -1g when the robot is still on the plane and the axis points upwards.
+		for(uint8_t axis = 0; axis < 3; axis++) {
+			acc_raw[i][axis] = -read_word(&record[2 * axis]);
+			gyro_raw[i][axis] = read_word(&record[6 + 2 * axis]);
+		}
+	}
+	return count;
+}
+
+void imu_fifo_convert(const int16_t *acc_raw, const int16_t *gyro_raw, const int16_t *acc_offset,
+						const int16_t *gyro_offset, float *acc, float *gyro) {
+	for(uint8_t axis = 0; axis < 3; axis++) {
+		acc[axis] = (acc_raw[axis] - acc_offset[axis]) * STANDARD_GRAVITY * ACC_RAW2G;
+		gyro[axis] = (gyro_raw[axis] - gyro_offset[axis]) * DEG2RAD(GYRO_RAW2DPS);
+	}
+	// Specific case for the z axis because it should not be zero but -1g.
+	acc[2] -= (MAX_INT16 / RES_2G) * STANDARD_GRAVITY * ACC_RAW2G;
+}
@@ -0,0 +1,50 @@
+#ifndef IMU_FIFO_H
+#define IMU_FIFO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/**
+ * Decoding of the FIFO content of the MPU9250 and ICM-20948, both configured to store the accelerometer
+ * followed by the gyroscope (big endian, 12 bytes per sample).
+ */
+
+#define IMU_FIFO_RECORD_SIZE	12	// Accelerometer (6 bytes) + gyroscope (6 bytes).
+#define IMU_FIFO_SIZE			512	// FIFO size of both sensors in bytes.
+#define IMU_FIFO_BURST_LEN		(10*IMU_FIFO_RECORD_SIZE) // Maximum bytes read in a single I2C transaction.
+
+ /**
+ * @brief   Decodes the samples read from the FIFO, with the same sign convention as the register reads
+ * 			(the accelerometer axes are inverted).
+ *
+ * @param data		FIFO bytes
+ * @param len		number of bytes, only complete records are decoded
+ * @param acc_raw	array of len/IMU_FIFO_RECORD_SIZE accelerometer samples
+ * @param gyro_raw	array of len/IMU_FIFO_RECORD_SIZE gyroscope samples
+ *
+ * @return			number of samples decoded
+ */
+uint16_t imu_fifo_parse(const uint8_t *data, uint16_t len, int16_t (*acc_raw)[3], int16_t (*gyro_raw)[3]);
+
+ /**
+ * @brief   Converts a raw sample to physical units (2 g and 250 dps ranges), acc and gyro values are
+ * 			corrected with the offsets as in the register reads.
+ *
+ * @param acc_raw		raw accelerometer sample
+ * @param gyro_raw		raw gyroscope sample
+ * @param acc_offset	accelerometer offsets
+ * @param gyro_offset	gyroscope offsets
+ * @param acc			acceleration [m/s^2]
+ * @param gyro			rotation rate [rad/s]
+ */
+void imu_fifo_convert(const int16_t *acc_raw, const int16_t *gyro_raw, const int16_t *acc_offset,
+						const int16_t *gyro_offset, float *acc, float *gyro);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IMU_FIFO_H */
@@ -3,6 +3,7 @@
 #include "mpu9250.h"
 #include "../i2c_bus.h"
 #include "imu.h"
+#include "imu_fifo.h"
 
 #define STANDARD_GRAVITY    9.80665f 
 #define DEG2RAD(deg) (deg / 180 * M_PI)
@@ -288,5 +289,54 @@ int8_t mpu9250_read(float *gyro, float *acc, float *temp, float *magnet, int16_t
     return MSG_OK;
 }
 
+int8_t mpu9250_fifo_setup(uint8_t sample_rate_div) {
+	int8_t err = 0;
+
+	// DLPF at 184 Hz so that the gyro is sampled at 1 kHz and the divider applies, the FIFO keeps the newest samples when full.
+	if((err = write_reg(imu_addr, CONFIG, 0x01)) != MSG_OK) {
+		return err;
+	}
+	if((err = write_reg(imu_addr, SMPLRT_DIV, sample_rate_div)) != MSG_OK) {
+		return err;
+	}
+	// Accelerometer and gyroscope in the FIFO, in this order (register order).
+	if((err = write_reg(imu_addr, FIFO_EN, 0x78)) != MSG_OK) {
+		return err;
+	}
+	return mpu9250_fifo_reset();
+}
+
+int8_t mpu9250_fifo_reset(void) {
+	int8_t err = 0;
+
+	if((err = write_reg(imu_addr, USER_CTRL, 0x04)) != MSG_OK) { // FIFO_RST, cleared by the sensor.
+		return err;
+	}
+	return write_reg(imu_addr, USER_CTRL, 0x40); // FIFO_EN
+}
+
+int8_t mpu9250_fifo_count(uint16_t *count, uint8_t *overflow, systime_t *time) {
+	int8_t err = 0;
+	uint8_t count_buf[2];
+
+	*count = 0;
+	if((err = read_reg_multi_time(imu_addr, FIFO_COUNTH, count_buf, 2, time)) != MSG_OK) {
+		return err;
+	}
+	uint16_t bytes = ((uint16_t)(count_buf[0] & 0x1F) << 8) | count_buf[1];
+
+	// A full FIFO means that samples were lost and that the records may be misaligned.
+	if(bytes > IMU_FIFO_SIZE - IMU_FIFO_RECORD_SIZE) {
+		*overflow = 1;
+		return mpu9250_fifo_reset();
+	}
+	*count = bytes / IMU_FIFO_RECORD_SIZE;
+	return MSG_OK;
+}
+
+int8_t mpu9250_fifo_read(uint8_t *buf, uint16_t len) {
+	return read_reg_fifo(imu_addr, FIFO_R_W, buf, len, IMU_FIFO_BURST_LEN);
+}
+
 /**************************END PUBLIC FUNCTIONS***********************************/
 
@@ -76,4 +76,44 @@ int8_t mpu9250_read(float *gyro, float *acc, float *temp, float *magnet, int16_t
 */
 int8_t mpu9250_magnetometer_read_sens_adj(float *values);
 
+/**
+* @brief	Configures the FIFO to store the accelerometer and gyroscope samples (see imu_fifo.h), better to
+* 			call after mpu9250_setup().
+*
+* @param sample_rate_div	the sample rate is 1 kHz / (1 + sample_rate_div)
+*
+* @return					The operation status.
+*/
+int8_t mpu9250_fifo_setup(uint8_t sample_rate_div);
+
+/**
+* @brief	Empties the FIFO.
+*
+* @return	The operation status.
+*/
+int8_t mpu9250_fifo_reset(void);
+
+/**
+* @brief	Reads the number of complete samples in the FIFO. The FIFO is reset in case of overflow.
+*
+* @param count		returns the number of samples, 0 after an overflow
+* @param overflow	set to 1 if the FIFO overflowed (untouched otherwise)
+* @param time		returns the system time at which the count was read, the last sample counted was
+* 					taken just before
+*
+* @return			The operation status.
+*/
+int8_t mpu9250_fifo_count(uint16_t *count, uint8_t *overflow, systime_t *time);
+
+/**
+* @brief	Reads the oldest samples of the FIFO with burst reads.
+*
+* @param buf		buffer to store the FIFO bytes
+* @param len		number of bytes to read, multiple of IMU_FIFO_RECORD_SIZE and at most the samples
+* 					given by mpu9250_fifo_count
+*
+* @return			The operation status.
+*/
+int8_t mpu9250_fifo_read(uint8_t *buf, uint16_t len);
+
 #endif // MPU9250_H
@@ -3,6 +3,7 @@
 #include "ch.h"
 #include "hal.h"
 #include "proximity.h"
+#include "proximity_processing.h"
 #include <main.h>
 
 // The proximity sensors sampling is designed in order to sample two sensors at one time, the couples are chosen
@@ -28,6 +29,19 @@
 // active. Each sampling total time takes about 11.8 us:
 // - ADC clock div = 8 => APB2/8 = 84/8 = 10.5 MHz
 // - [sampling (112 cycles) + conversion (12 cycles)] x 1'000'000/10'500'000 = about 11.81 us
+//
+// Oversampling (see proximity_set_oversampling): each trigger converts the couple N times in a row and the
+// N conversions are averaged in the DMA callback, the update frequency is unchanged.
+// The regular sequence is limited to 16 conversions, thus the 8 cycles are divided in N parts of 8/N triggers
+// and the sequence registers are reprogrammed in the DMA callback after each part.
+// The sampling time is reduced so that all the conversions still fit in the 40 us between the trigger and
+// the end of the pulse:
+// - N=2: [56 + 12 cycles] x 4 conversions = about 25.9 us
+// - N=4: [28 + 12 cycles] x 8 conversions = about 30.5 us
+//
+// Scheduling (see proximity_subscribe): only the couples containing a subscribed sensor are pulsed and sampled,
+// the cycle is shortened accordingly. With a single couple the update frequency is 800 / 2 = 400 Hz,
+// with two couples 200 Hz and so on. When no sensor is subscribed, all the couples are sampled.
 
 #define PWM_CLK_FREQ 1000000
 
@@ -44,19 +58,49 @@
 #define SLOW_ON_MEASUREMENT_POS 0.0416 // 0.0416*1000/SLOW_PWM_FREQUENCY=0.26 ms
 
 #define PROXIMITY_ADC_SAMPLE_TIME ADC_SAMPLE_112
+#define PROXIMITY_ADC_SAMPLE_TIME_X2 ADC_SAMPLE_56
+#define PROXIMITY_ADC_SAMPLE_TIME_X4 ADC_SAMPLE_28
 #define DMA_BUFFER_SIZE 1 // 1 sample for each ADC channel
+#define SEQUENCE_LEN (PROXIMITY_NB_CHANNELS*2) // Conversions in one sequence, also the number of triggers for all the sensors x2.
+#define SEQUENCE_PARTS_MAX 4
 
 #define EXTSEL_TIM2_CH2 0x03
 
+// ADC channels of each couple, for each trigger of the complete cycle (see the ADC configuration).
+static const uint8_t trigger_channels[SEQUENCE_LEN/2][2] = {
+	{12, 9}, {12, 9}, {13, 8}, {13, 8}, {14, 10}, {14, 10}, {15, 11}, {15, 11}
+};
+
 static unsigned int adc2_values[PROXIMITY_NB_CHANNELS*2] = {0};
+static unsigned int adc2_sums[PROXIMITY_NB_CHANNELS*2] = {0};
 static BSEMAPHORE_DECL(adc2_ready, true);
+static systime_t adc2_capture_time = 0; // End of the last complete sequence.
 static adcsample_t adc2_proximity_samples[PROXIMITY_NB_CHANNELS*2 * DMA_BUFFER_SIZE];
+static uint8_t oversampling = 1;
+static uint8_t sequencePart = 0;
+static uint8_t sequenceParts = 1;
+static uint8_t triggersPerPart = SEQUENCE_LEN/2;
+static uint32_t sequenceRegs[SEQUENCE_PARTS_MAX][3]; // SQR1, SQR2, SQR3 of each part.
+static uint8_t schedule[PROXIMITY_NB_CHANNELS/2] = {0, 1, 2, 3}; // Couples sampled, in order.
+static uint8_t scheduleLen = PROXIMITY_NB_CHANNELS/2;
+static uint8_t coupleSubscribers[PROXIMITY_NB_CHANNELS/2] = {0};
+static MUTEX_DECL(schedule_lock);
+static uint8_t proxMode = FAST_UPDATE;
 static uint8_t pulseSeqState = 0;
 static uint8_t calibrationInProgress = 0;
 static uint8_t calibrationState = 0;
 static uint8_t calibrationNumSamples = 0;
 static int32_t calibrationSum[PROXIMITY_NB_CHANNELS] = {0};
 static proximity_msg_t prox_values;
+static proximity_msg_t prox_filtered_values;
+static proximity_filter_t prox_filter;
+static uint8_t filter_iir_shift = PROXIMITY_FILTER_DEFAULT_SHIFT;
+static uint8_t filter_median = 1;
+static bool filter_changed = false; // Set by proximity_set_filter, the thread then resets the filter.
+static proximity_band_t bands[PROXIMITY_BANDS_MAX];
+static uint8_t bands_used = 0;
+static proximity_bands_msg_t bands_values;
+EVENTSOURCE_DECL(proximity_events);
 static thread_t *prox_thd_handle = NULL;
 
 /***************************INTERNAL FUNCTIONS************************************/
@@ -72,36 +116,125 @@ static thread_t *prox_thd_handle = NULL;
  */
 static void adc_cb(ADCDriver *adcp, adcsample_t *samples, size_t n)
 {
-    (void) adcp;
     (void) n;
 
     binary_semaphore_t *sem = &adc2_ready;
 
-    /* Reset all samples to zero. */
-    memset(adc2_values, 0, adcp->grpp->num_channels * sizeof(unsigned int));
+    // Accumulate the conversions of this part at their place in the complete sequence.
+    for (uint8_t t = 0; t < triggersPerPart; t++) {
+    	uint8_t cycle_trigger = sequencePart * triggersPerPart + t;
+    	uint8_t dest = (2 * schedule[cycle_trigger / 2] + (cycle_trigger & 1)) * 2;
+    	for (uint8_t r = 0; r < oversampling; r++) {
+    		adc2_sums[dest] += samples[(t * oversampling + r) * 2];
+    		adc2_sums[dest + 1] += samples[(t * oversampling + r) * 2 + 1];
+    	}
+    }
 
-    // Copy the sampled values to the destination buffer.
-    for (size_t i = 0; i < adcp->grpp->num_channels; i++) {
-    	adc2_values[i] = samples[i];
+    sequencePart++;
+    if(sequencePart < sequenceParts) {
+    	// Prepare the channels of the next part, the next trigger is one PWM period away.
+    	adcp->adc->SQR1 = sequenceRegs[sequencePart][0];
+    	adcp->adc->SQR2 = sequenceRegs[sequencePart][1];
+    	adcp->adc->SQR3 = sequenceRegs[sequencePart][2];
+    	return;
+    }
+    sequencePart = 0;
+    if(sequenceParts > 1) {
+    	adcp->adc->SQR1 = sequenceRegs[0][0];
+    	adcp->adc->SQR2 = sequenceRegs[0][1];
+    	adcp->adc->SQR3 = sequenceRegs[0][2];
+    }
+
+    // Copy the averaged values to the destination buffer, the couples not scheduled keep their last values.
+    for (uint8_t c = 0; c < scheduleLen; c++) {
+    	for (uint8_t i = schedule[c] * 4; i < schedule[c] * 4 + 4; i++) {
+    		adc2_values[i] = adc2_sums[i] / oversampling;
+    		adc2_sums[i] = 0;
+    	}
     }
 
     /* Signal the proximity thread that the ADC measurements are done. */
     chSysLockFromISR();
+    adc2_capture_time = chVTGetSystemTimeX();
     chBSemSignalI(sem);
     chSysUnlockFromISR();
 
     pulseSeqState = 1; // Sync with the timer since the first time we get here the ADC and timer could be desync.
 }
 
-//configuration of the ADC
-static const ADCConversionGroup adcgrpcfg2 = {
+ /**
+ * @brief   Returns the rate of the complete sequences in Hz, each scheduled couple takes two PWM periods.
+ */
+static uint16_t sequence_rate(void) {
+	uint16_t pwm_freq = (proxMode == SLOW_UPDATE) ? SLOW_PWM_FREQUENCY : FAST_PWM_FREQUENCY;
+	if(scheduleLen == 0) {
+		return 0;
+	}
+	return pwm_freq / (2 * scheduleLen);
+}
+
+ /**
+ * @brief   Computes the sequence registers of each part of the cycle and the ADC configuration for
+ * 			the current oversampling and schedule.
+ *
+ * @param grp	ADC configuration to update
+ */
+static void prepare_sequence(ADCConversionGroup *grp) {
+	uint8_t triggers = 2 * scheduleLen; // Ambient and reflected for each couple.
+	uint32_t sample_time = PROXIMITY_ADC_SAMPLE_TIME;
+
+	// Largest number of triggers fitting in the 16 conversions of the sequence and dividing the cycle.
+	triggersPerPart = SEQUENCE_LEN / 2 / oversampling;
+	while(triggers % triggersPerPart) {
+		triggersPerPart--;
+	}
+	sequenceParts = triggers / triggersPerPart;
+	uint8_t slots = triggersPerPart * 2 * oversampling;
+
+	for (uint8_t part = 0; part < sequenceParts; part++) {
+		uint32_t sqr[3] = {ADC_SQR1_NUM_CH(slots), 0, 0};
+		for (uint8_t slot = 0; slot < slots; slot++) {
+			// Each trigger converts the two channels of the couple "oversampling" times.
+			uint8_t t = part * triggersPerPart + slot / (2 * oversampling);
+			uint32_t channel = trigger_channels[2 * schedule[t / 2] + (t & 1)][slot & 1];
+			// SQ1-SQ6 are in SQR3, SQ7-SQ12 in SQR2 and SQ13-SQ16 in SQR1, 5 bits each.
+			sqr[2 - slot / 6] |= channel << (5 * (slot % 6));
+		}
+		sequenceRegs[part][0] = sqr[0];
+		sequenceRegs[part][1] = sqr[1];
+		sequenceRegs[part][2] = sqr[2];
+	}
+
+	if(oversampling == 2) {
+		sample_time = PROXIMITY_ADC_SAMPLE_TIME_X2;
+	} else if(oversampling == 4) {
+		sample_time = PROXIMITY_ADC_SAMPLE_TIME_X4;
+	}
+	grp->smpr1 = 0;
+	grp->smpr2 = 0;
+	for (uint8_t i = 0; i < 10; i++) {
+		grp->smpr2 |= sample_time << (3 * i);
+	}
+	for (uint8_t i = 0; i < 6; i++) {
+		grp->smpr1 |= sample_time << (3 * i);
+	}
+
+	grp->num_channels = slots;
+	grp->cr1 = ADC_CR1_DISCEN | ((2 * oversampling - 1) * ADC_CR1_DISCNUM_0);
+	grp->sqr1 = sequenceRegs[0][0];
+	grp->sqr2 = sequenceRegs[0][1];
+	grp->sqr3 = sequenceRegs[0][2];
+}
+
+//configuration of the ADC, the sampling time and sequence are updated by prepare_sequence
+static ADCConversionGroup adcgrpcfg2 = {
     .circular = true,
     // Both ambient and reflected measures are saved before raising the DMA interrupt (and call the adc callback).
     .num_channels = PROXIMITY_NB_CHANNELS*2, 
     .end_cb = adc_cb,
     .error_cb = NULL,
 
-    // Discontinuous mode with 2 conversions per trigger.
+    // Discontinuous mode with 2 conversions per trigger (2 x oversampling).
 	// Every time the sampling is triggered by the timer, two channels are sampled:
 	// - trigger1: IR0 + IR4 sampling
 	// - trigger2: IR1 + IR5 sampling
@@ -163,7 +296,7 @@ static const ADCConversionGroup adcgrpcfg2 = {
  /**
  * @brief   Thread which updates the measures and publishes them
  */
-static THD_WORKING_AREA(proximity_thd_wa, 256);
+static THD_WORKING_AREA(proximity_thd_wa, 1024);
 static THD_FUNCTION(proximity_thd, arg)
 {
     (void) arg;
@@ -175,38 +308,52 @@ static THD_FUNCTION(proximity_thd, arg)
     messagebus_topic_init(&proximity_topic, &prox_topic_lock, &prox_topic_condvar, &prox_values, sizeof(prox_values));
     messagebus_advertise_topic(&bus, &proximity_topic, "/proximity");
 
+    messagebus_topic_t proximity_filtered_topic;
+    MUTEX_DECL(prox_filtered_topic_lock);
+    CONDVAR_DECL(prox_filtered_topic_condvar);
+    messagebus_topic_init(&proximity_filtered_topic, &prox_filtered_topic_lock, &prox_filtered_topic_condvar, &prox_filtered_values, sizeof(prox_filtered_values));
+    messagebus_advertise_topic(&bus, &proximity_filtered_topic, "/proximity_filtered");
+
+    messagebus_topic_t proximity_bands_topic;
+    MUTEX_DECL(prox_bands_topic_lock);
+    CONDVAR_DECL(prox_bands_topic_condvar);
+    messagebus_topic_init(&proximity_bands_topic, &prox_bands_topic_lock, &prox_bands_topic_condvar, &bands_values, sizeof(bands_values));
+    messagebus_advertise_topic(&bus, &proximity_bands_topic, "/proximity_bands");
+
+    proximity_filter_init(&prox_filter, filter_iir_shift, filter_median);
+
     while(chThdShouldTerminateX() == false) {
 
     	chBSemWait(&adc2_ready);
 
-    	prox_values.ambient[0] = adc2_values[0];
-    	prox_values.ambient[1] = adc2_values[4];
-    	prox_values.ambient[2] = adc2_values[8];
-    	prox_values.ambient[3] = adc2_values[12];
-    	prox_values.ambient[4] = adc2_values[1];
-    	prox_values.ambient[5] = adc2_values[5];
-    	prox_values.ambient[6] = adc2_values[9];
-    	prox_values.ambient[7] = adc2_values[13];
-
-    	prox_values.reflected[0] = adc2_values[2];
-    	prox_values.reflected[1] = adc2_values[6];
-    	prox_values.reflected[2] = adc2_values[10];
-    	prox_values.reflected[3] = adc2_values[14];
-    	prox_values.reflected[4] = adc2_values[3];
-    	prox_values.reflected[5] = adc2_values[7];
-    	prox_values.reflected[6] = adc2_values[11];
-    	prox_values.reflected[7] = adc2_values[15];
-
-        for (int i = 0; i < PROXIMITY_NB_CHANNELS; i++) {
-        	if(prox_values.reflected[i] > prox_values.ambient[i]) {
-        		prox_values.delta[i] = 0;
-        	} else {
-        		prox_values.delta[i] = prox_values.ambient[i] - prox_values.reflected[i];
-        	}
-        }
+    	// The filter can be changed by other threads, it restarts from this measure.
+    	if(filter_changed) {
+    		chSysLock();
+    		uint8_t iir_shift = filter_iir_shift;
+    		uint8_t median = filter_median;
+    		filter_changed = false;
+    		chSysUnlock();
+    		proximity_filter_init(&prox_filter, iir_shift, median);
+    	}
+
+    	proximity_process_samples(adc2_values, &prox_values);
+    	sensor_header_stamp(&prox_values.header, adc2_capture_time, sequence_rate());
 
         messagebus_topic_publish(&proximity_topic, &prox_values, sizeof(prox_values));
 
+        proximity_filter_process(&prox_filter, &prox_values, &prox_filtered_values);
+        messagebus_topic_publish(&proximity_filtered_topic, &prox_filtered_values, sizeof(prox_filtered_values));
+
+        // The bands can be changed by other threads.
+        chSysLock();
+        uint8_t changed = proximity_bands_update(bands, bands_used, &prox_values, &bands_values.active);
+        chSysUnlock();
+        if(changed) {
+        	bands_values.changed = changed;
+        	messagebus_topic_publish(&proximity_bands_topic, &bands_values, sizeof(bands_values));
+        	chEvtBroadcastFlags(&proximity_events, changed);
+        }
+
         if(calibrationInProgress) {
         	switch(calibrationState) {
 				case 0:
@@ -243,37 +390,31 @@ static THD_FUNCTION(proximity_thd, arg)
  */
 static void pwm_reset_cb(PWMDriver *pwmp) {
 	(void)pwmp;
-	switch(pulseSeqState) {
-		case 0:
-			break;
-		case 1:
-			pulseSeqState = 2;
-			break;
-		case 2:
-			palSetPad(GPIOB, GPIOB_PULSE_0);
-			pulseSeqState = 3;
-			break;
-		case 3:
-			pulseSeqState = 4;
-			break;
-		case 4:
-			palSetPad(GPIOB, GPIOB_PULSE_1);
-			pulseSeqState = 5;
-			break;
-		case 5:
-			pulseSeqState = 6;
-			break;
-		case 6:
-			palSetPad(GPIOE, GPIOE_PULSE_2);
-			pulseSeqState = 7;
-			break;
-		case 7:
-			pulseSeqState = 8;
-			break;
-		case 8:
-			palSetPad(GPIOE, GPIOE_PULSE_3);
-			pulseSeqState = 1;
-			break;
+	// State 0: not synchronized with the ADC yet.
+	// Odd states: ambient measure of the couple, even states: reflected measure (pulse active).
+	if(pulseSeqState == 0) {
+		return;
+	}
+	if((pulseSeqState & 1) == 0) {
+		switch(schedule[pulseSeqState / 2 - 1]) {
+			case 0:
+				palSetPad(GPIOB, GPIOB_PULSE_0);
+				break;
+			case 1:
+				palSetPad(GPIOB, GPIOB_PULSE_1);
+				break;
+			case 2:
+				palSetPad(GPIOE, GPIOE_PULSE_2);
+				break;
+			case 3:
+				palSetPad(GPIOE, GPIOE_PULSE_3);
+				break;
+		}
+	}
+	if(pulseSeqState >= 2 * scheduleLen) {
+		pulseSeqState = 1;
+	} else {
+		pulseSeqState++;
 	}
 }
 
@@ -293,17 +434,10 @@ static void pwm_ch1_cb(PWMDriver *pwmp) {
 	palClearPad(GPIOE, GPIOE_PULSE_3);
 }
 
-/*************************END INTERNAL FUNCTIONS**********************************/
-
-
-/****************************PUBLIC FUNCTIONS*************************************/
-
-void proximity_start(uint8_t mode)
-{
-	if(ADCD1.state != ADC_STOP) {
-		return;
-	}
-
+/**
+ * @brief   Builds the schedule from the subscriptions and starts the timer and the ADC.
+ */
+static void proximity_hw_start(void) {
     static PWMConfig pwmcfg_proximity = {
         /* timer clock frequency */
         .frequency = PWM_CLK_FREQ,
@@ -321,10 +455,30 @@ void proximity_start(uint8_t mode)
             {.mode = PWM_OUTPUT_DISABLED, .callback = NULL},
         },
     };
-	if(mode==SLOW_UPDATE) {
+	if(proxMode==SLOW_UPDATE) {
 		pwmcfg_proximity.period = SLOW_PWM_CYCLE;
+	} else {
+		pwmcfg_proximity.period = FAST_PWM_CYCLE;
+	}
+
+	scheduleLen = 0;
+	for (uint8_t c = 0; c < PROXIMITY_NB_CHANNELS/2; c++) {
+		if(coupleSubscribers[c] > 0) {
+			schedule[scheduleLen++] = c;
+		}
+	}
+	if(scheduleLen == 0) {
+		for (uint8_t c = 0; c < PROXIMITY_NB_CHANNELS/2; c++) {
+			schedule[c] = c;
+		}
+		scheduleLen = PROXIMITY_NB_CHANNELS/2;
 	}
 
+    prepare_sequence(&adcgrpcfg2);
+    sequencePart = 0;
+    pulseSeqState = 0;
+    memset(adc2_sums, 0, sizeof(adc2_sums));
+
     adcStart(&ADCD1, NULL);
     //adcAcquireBus(&ADCD1);
     // ADC waiting for the trigger from the timer.
@@ -333,18 +487,76 @@ void proximity_start(uint8_t mode)
     /* Init PWM */
     pwmStart(&PWMD2, &pwmcfg_proximity);
 	// Enable channel 1 to set duty cycle for TCRT1000 drivers.
-    if(mode==FAST_UPDATE) {
+    if(proxMode==FAST_UPDATE) {
     	pwmEnableChannel(&PWMD2, 0, (pwmcnt_t) (FAST_PWM_CYCLE * FAST_TCRT1000_DC));
     } else {
     	pwmEnableChannel(&PWMD2, 0, (pwmcnt_t) (SLOW_PWM_CYCLE * SLOW_TCRT1000_DC));
     }
 	pwmEnableChannelNotification(&PWMD2, 0); // Channel 1 interrupt enable to handle pulse shutdown.
     pwmEnablePeriodicNotification(&PWMD2); // PWM general interrupt at the beginning of the period to handle pulse ignition.
-    if(mode==FAST_UPDATE) {
+    if(proxMode==FAST_UPDATE) {
     	pwmEnableChannel(&PWMD2, 1, (pwmcnt_t) (FAST_PWM_CYCLE * FAST_ON_MEASUREMENT_POS)); // Enable channel 2 to trigger the measures.
     } else {
     	pwmEnableChannel(&PWMD2, 1, (pwmcnt_t) (SLOW_PWM_CYCLE * SLOW_ON_MEASUREMENT_POS)); // Enable channel 2 to trigger the measures.
     }
+}
+
+/**
+ * @brief   Stops the timer and the ADC and turns off the pulses.
+ */
+static void proximity_hw_stop(void) {
+	pwmStop(&PWMD2);
+	adcStopConversion(&ADCD1);
+	adcStop(&ADCD1);
+	//adcReleaseBus(&ADCD1);
+	palClearPad(GPIOB, GPIOB_PULSE_0);
+	palClearPad(GPIOB, GPIOB_PULSE_1);
+	palClearPad(GPIOE, GPIOE_PULSE_2);
+	palClearPad(GPIOE, GPIOE_PULSE_3);
+}
+
+/**
+ * @brief   Updates the subscribers count of the couples containing the given sensors and
+ * 			restarts the sampling with the new schedule if it is running.
+ *
+ * @param sensors	bit i set for sensor IRi
+ * @param delta		1 to subscribe, -1 to unsubscribe
+ */
+static void update_subscriptions(uint8_t sensors, int8_t delta) {
+	uint8_t couples = (sensors | (sensors >> 4)) & 0x0F; // IRi and IRi+4 are sampled together.
+
+	chMtxLock(&schedule_lock);
+	for (uint8_t c = 0; c < PROXIMITY_NB_CHANNELS/2; c++) {
+		if(couples & (1 << c)) {
+			if(delta > 0 && coupleSubscribers[c] < UINT8_MAX) {
+				coupleSubscribers[c]++;
+			} else if(delta < 0 && coupleSubscribers[c] > 0) {
+				coupleSubscribers[c]--;
+			}
+		}
+	}
+	if(ADCD1.state != ADC_STOP) {
+		proximity_hw_stop();
+		proximity_hw_start();
+	}
+	chMtxUnlock(&schedule_lock);
+}
+
+/*************************END INTERNAL FUNCTIONS**********************************/
+
+
+/****************************PUBLIC FUNCTIONS*************************************/
+
+void proximity_start(uint8_t mode)
+{
+	if(ADCD1.state != ADC_STOP) {
+		return;
+	}
+
+	chMtxLock(&schedule_lock);
+	proxMode = mode;
+	proximity_hw_start();
+	chMtxUnlock(&schedule_lock);
 
     prox_thd_handle = chThdCreateStatic(proximity_thd_wa, sizeof(proximity_thd_wa), NORMALPRIO, proximity_thd, NULL);
 }
@@ -356,14 +568,29 @@ void proximity_stop(void) {
     chThdTerminate(prox_thd_handle);
     chThdWait(prox_thd_handle);
     prox_thd_handle = NULL;
-	pwmStop(&PWMD2);
-	adcStopConversion(&ADCD1);
-	adcStop(&ADCD1);
-	//adcReleaseBus(&ADCD1);
-	palClearPad(GPIOB, GPIOB_PULSE_0);
-	palClearPad(GPIOB, GPIOB_PULSE_1);
-	palClearPad(GPIOE, GPIOE_PULSE_2);
-	palClearPad(GPIOE, GPIOE_PULSE_3);
+	chMtxLock(&schedule_lock);
+	proximity_hw_stop();
+	chMtxUnlock(&schedule_lock);
+}
+
+void proximity_subscribe(uint8_t sensors) {
+	update_subscriptions(sensors, 1);
+}
+
+void proximity_unsubscribe(uint8_t sensors) {
+	update_subscriptions(sensors, -1);
+}
+
+uint16_t get_prox_rate(unsigned int sensor_number) {
+	if (sensor_number > 7 || ADCD1.state == ADC_STOP) {
+		return 0;
+	}
+	for (uint8_t c = 0; c < scheduleLen; c++) {
+		if(schedule[c] == sensor_number % (PROXIMITY_NB_CHANNELS/2)) {
+			return sequence_rate();
+		}
+	}
+	return 0;
 }
 
 void calibrate_ir(void) {
@@ -396,6 +623,86 @@ int get_calibrated_prox(unsigned int sensor_number) {
 	}
 }
 
+void proximity_set_oversampling(uint8_t n) {
+	if(n != 1 && n != 2 && n != 4) {
+		return;
+	}
+	// The sequence depends on the oversampling, it is changed while the ADC is stopped.
+	chMtxLock(&schedule_lock);
+	if(n != oversampling && ADCD1.state != ADC_STOP) {
+		proximity_hw_stop();
+		oversampling = n;
+		proximity_hw_start();
+	} else {
+		oversampling = n;
+	}
+	chMtxUnlock(&schedule_lock);
+}
+
+void proximity_set_filter(uint8_t iir_shift, uint8_t median) {
+	chSysLock();
+	filter_iir_shift = iir_shift;
+	filter_median = median;
+	filter_changed = true;
+	chSysUnlock();
+}
+
+int get_prox_filtered(unsigned int sensor_number) {
+	if (sensor_number > 7) {
+		return 0;
+	} else {
+		return prox_filtered_values.delta[sensor_number];
+	}
+}
+
+int get_calibrated_prox_filtered(unsigned int sensor_number) {
+	int temp;
+	if (sensor_number > 7) {
+		return 0;
+	} else {
+		temp = prox_filtered_values.delta[sensor_number] - prox_filtered_values.initValue[sensor_number];
+		if (temp>0) {
+			return temp;
+		} else {
+			return 0;
+		}
+	}
+}
+
+int8_t proximity_band_add(unsigned int sensor_number, int16_t on, int16_t off) {
+	if (sensor_number > 7) {
+		return -1;
+	}
+	chSysLock();
+	for (int8_t b = 0; b < PROXIMITY_BANDS_MAX; b++) {
+		if((bands_used & (1 << b)) == 0) {
+			bands[b].sensor = sensor_number;
+			bands[b].on = on;
+			bands[b].off = off;
+			bands_used |= (1 << b);
+			bands_values.active &= ~(1 << b);
+			chSysUnlock();
+			return b;
+		}
+	}
+	chSysUnlock();
+	return -1;
+}
+
+void proximity_band_remove(int8_t band) {
+	if(band < 0 || band >= PROXIMITY_BANDS_MAX) {
+		return;
+	}
+	chSysLock();
+	bands_used &= ~(1 << band);
+	bands_values.active &= ~(1 << band);
+	chSysUnlock();
+}
+
+uint8_t proximity_bands_active(void) {
+	return bands_values.active;
+}
+
 int get_ambient_light(unsigned int sensor_number) {
 	if (sensor_number > 7) {
 		return 0;
@@ -6,35 +6,104 @@ extern "C" {
 #endif
 
 #include <stdint.h>
+#include <ch.h>
+#include "proximity_processing.h"
 
-#define PROXIMITY_NB_CHANNELS 8
 #define FAST_UPDATE 0	// Proximity sensors updated at 100 Hz
 #define SLOW_UPDATE 1	// Proximity sensors updated at 20 Hz
+#define PROXIMITY_OVERSAMPLING_MAX 4
+#define PROXIMITY_FILTER_DEFAULT_SHIFT 2	// IIR filter coefficient of 1/4
 
-/** Struct containing a proximity measurement message. */
+/** Struct containing a bands state message, published only when a band changes. */
 typedef struct {
-    /** Ambient light level (LED is OFF). */
-    unsigned int ambient[PROXIMITY_NB_CHANNELS];
+	uint8_t active;		// Bit i set if the band i is active.
+	uint8_t changed;	// Bit i set if the band i changed since the previous message.
+} proximity_bands_msg_t;
 
-    /** Reflected light level (LED is ON). */
-    unsigned int reflected[PROXIMITY_NB_CHANNELS];
-
-    /** Difference between ambient and reflected. */
-    unsigned int delta[PROXIMITY_NB_CHANNELS];
-
-    /** Initial values saved during calibration. */
-    unsigned int initValue[PROXIMITY_NB_CHANNELS];
-} proximity_msg_t;
+// Flags broadcast on proximity_events: bit i is set when the state of the band i changes.
+extern event_source_t proximity_events;
 
  /**
  * @brief   Starts the proximity measurement module. Make sure that the "ircom" module wasn't started when using this function otherwise there will be conflicts.
  * 			This module also broadcasts the measures through a proximity_msg_t message
- * 			on the /proximity topic
+ * 			on the /proximity topic and the filtered measures through a proximity_msg_t message
+ * 			on the /proximity_filtered topic
  *
  * @param freq	FAST_UPDATE or SLOW_UPDATE. SLOW_UPDATE only used when working with the "range and bearing" extension.
  */
 void proximity_start(uint8_t mode);
 
+ /**
+ * @brief   Sets the number of conversions averaged for each measure. The update frequency is not changed,
+ * 			the ADC sampling time is reduced instead. The sampling is restarted if it is running.
+ *
+ * @param n		1 (default), 2 or 4, other values are ignored
+ */
+void proximity_set_oversampling(uint8_t n);
+
+ /**
+ * @brief   Configures the filter of the /proximity_filtered topic. Applied from the next measure if the
+ * 			sampling is running, the filter then restarts from this measure.
+ *
+ * @param iir_shift		the low-pass filter coefficient is 1/2^iir_shift, 0 disables the filter
+ * @param median		1 to remove the spikes with a median of the last 3 measures, 0 otherwise
+ */
+void proximity_set_filter(uint8_t iir_shift, uint8_t median);
+
+ /**
+ * @brief   Requests the given sensors to be sampled. The sensors are sampled by couples (IRi with IRi+4),
+ * 			only the couples with at least one subscription are pulsed, which increases their update
+ * 			frequency: 400 Hz for a single couple, 200 Hz for two couples, ... (in FAST_UPDATE mode).
+ * 			When no sensor is subscribed all the couples are sampled at 100 Hz.
+ * 			The sampling is restarted if it is running, the other sensors keep their last values.
+ *
+ * @param sensors	bit i set to subscribe to the sensor IRi
+ */
+void proximity_subscribe(uint8_t sensors);
+
+ /**
+ * @brief   Cancels a subscription made with proximity_subscribe.
+ *
+ * @param sensors	bit i set to unsubscribe from the sensor IRi
+ */
+void proximity_unsubscribe(uint8_t sensors);
+
+ /**
+ * @brief   Returns the effective update frequency of the chosen sensor
+ *
+ * @param sensor_number		0-7
+ *
+ * @return					Frequency in Hz, 0 if the sensor is not sampled
+ */
+uint16_t get_prox_rate(unsigned int sensor_number);
+
+ /**
+ * @brief   Adds a threshold band on a sensor, evaluated on each new measure. The crossings are notified
+ * 			through the proximity_events flags and a proximity_bands_msg_t message on the
+ * 			/proximity_bands topic, so that clients don't need to poll get_calibrated_prox.
+ *
+ * @param sensor_number		0-7
+ * @param on				the band becomes active when the calibrated value is above this threshold
+ * @param off				the band becomes inactive when the calibrated value is below this threshold (off <= on)
+ *
+ * @return					Band number (0 to PROXIMITY_BANDS_MAX-1) or -1 if no band is available
+ */
+int8_t proximity_band_add(unsigned int sensor_number, int16_t on, int16_t off);
+
+ /**
+ * @brief   Removes a band added with proximity_band_add.
+ *
+ * @param band		band number
+ */
+void proximity_band_remove(int8_t band);
+
+ /**
+ * @brief   Returns the state of the bands
+ *
+ * @return	Bit i set if the band i is active
+ */
+uint8_t proximity_bands_active(void);
+
 /**
 * @brief   Stop the proximity measurement module
 */
@@ -63,6 +132,14 @@ int get_prox(unsigned int sensor_number);
  */
 int get_calibrated_prox(unsigned int sensor_number);
 
+ /**
+ * @brief   Same as get_prox and get_calibrated_prox but on the filtered measures
+ * 
+ * @param sensor_number		0-7
+ */
+int get_prox_filtered(unsigned int sensor_number);
+int get_calibrated_prox_filtered(unsigned int sensor_number);
+
  /**
  * @brief   Returns the last ambiant light value measured by the chosen sensor
  * 
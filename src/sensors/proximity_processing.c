@@ -0,0 +1,108 @@
+#include <string.h>
+#include "proximity_processing.h"
+
+// Index of the ambient measure of each sensor in the ADC sequence, the reflected measure
+// of the same sensor follows 2 conversions later:
+// IR0 + IR4 ambient, IR0 + IR4 reflected, IR1 + IR5 ambient, IR1 + IR5 reflected, ...
+static const uint8_t ambient_index[PROXIMITY_NB_CHANNELS] = {0, 4, 8, 12, 1, 5, 9, 13};
+#define REFLECTED_OFFSET 2
+
+void proximity_process_samples(const unsigned int *adc_values, proximity_msg_t *msg) {
+	for (int i = 0; i < PROXIMITY_NB_CHANNELS; i++) {
+		msg->ambient[i] = adc_values[ambient_index[i]];
+		msg->reflected[i] = adc_values[ambient_index[i] + REFLECTED_OFFSET];
+		if(msg->reflected[i] > msg->ambient[i]) {
+			msg->delta[i] = 0;
+		} else {
+			msg->delta[i] = msg->ambient[i] - msg->reflected[i];
+		}
+	}
+}
+
+static inline unsigned int median3(unsigned int a, unsigned int b, unsigned int c) {
+	if(a > b) {
+		unsigned int t = a;
+		a = b;
+		b = t;
+	}
+	// Now a <= b, the median is b clamped to [a, c] or c clamped to [a, b].
+	if(c >= b) {
+		return b;
+	}
+	return c > a ? c : a;
+}
+
+void proximity_filter_init(proximity_filter_t *filter, uint8_t iir_shift, uint8_t median) {
+	memset(filter, 0, sizeof(proximity_filter_t));
+	filter->iir_shift = iir_shift;
+	filter->median = median;
+}
+
+void proximity_filter_process(proximity_filter_t *filter, const proximity_msg_t *raw, proximity_msg_t *filtered) {
+	const unsigned int *inputs[2] = {raw->ambient, raw->reflected};
+	unsigned int *outputs[2] = {filtered->ambient, filtered->reflected};
+
+	for(uint8_t m = 0; m < 2; m++) {
+		for(uint8_t i = 0; i < PROXIMITY_NB_CHANNELS; i++) {
+			unsigned int x = inputs[m][i];
+
+			if(filter->median) {
+				unsigned int newest = x;
+				// Until 3 measures are available the last one is used as is.
+				if(filter->count >= 2) {
+					x = median3(x, filter->history[0][m][i], filter->history[1][m][i]);
+				}
+				filter->history[1][m][i] = filter->history[0][m][i];
+				filter->history[0][m][i] = newest;
+			}
+
+			if(filter->iir_shift == 0) {
+				outputs[m][i] = x;
+				continue;
+			}
+			int32_t target = (int32_t)x << PROXIMITY_FILTER_FRAC_BITS;
+			if(filter->count == 0) {
+				// Start from the first measure instead of zero.
+				filter->state[m][i] = target;
+			} else {
+				filter->state[m][i] += (target - filter->state[m][i]) >> filter->iir_shift;
+			}
+			// Rounded to the nearest integer.
+			outputs[m][i] = (filter->state[m][i] + (1 << (PROXIMITY_FILTER_FRAC_BITS - 1))) >> PROXIMITY_FILTER_FRAC_BITS;
+		}
+	}
+	if(filter->count < 2) {
+		filter->count++;
+	}
+
+	for(uint8_t i = 0; i < PROXIMITY_NB_CHANNELS; i++) {
+		if(filtered->reflected[i] > filtered->ambient[i]) {
+			filtered->delta[i] = 0;
+		} else {
+			filtered->delta[i] = filtered->ambient[i] - filtered->reflected[i];
+		}
+		filtered->initValue[i] = raw->initValue[i];
+	}
+	filtered->header = raw->header;
+}
+
+uint8_t proximity_bands_update(const proximity_band_t *bands, uint8_t used, const proximity_msg_t *msg, uint8_t *active) {
+	uint8_t state = *active & used;
+
+	for(uint8_t b = 0; b < PROXIMITY_BANDS_MAX; b++) {
+		if((used & (1 << b)) == 0) {
+			continue;
+		}
+		uint8_t sensor = bands[b].sensor;
+		int value = (int)msg->delta[sensor] - (int)msg->initValue[sensor];
+		if(value > bands[b].on) {
+			state |= (1 << b);
+		} else if(value < bands[b].off) {
+			state &= ~(1 << b);
+		}
+	}
+
+	uint8_t changed = state ^ (*active & used);
+	*active = state;
+	return changed;
+}
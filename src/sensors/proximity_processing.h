@@ -0,0 +1,96 @@
+#ifndef PROXIMITY_PROCESSING_H
+#define PROXIMITY_PROCESSING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "sensor_sample.h"
+
+#define PROXIMITY_NB_CHANNELS 8
+#define PROXIMITY_BANDS_MAX 8
+
+/** Struct containing a proximity measurement message. */
+typedef struct {
+    /** Capture time (end of the ADC sequence), sequence number and rate of the scheduled sensors. */
+    sensor_header_t header;
+
+    /** Ambient light level (LED is OFF). */
+    unsigned int ambient[PROXIMITY_NB_CHANNELS];
+
+    /** Reflected light level (LED is ON). */
+    unsigned int reflected[PROXIMITY_NB_CHANNELS];
+
+    /** Difference between ambient and reflected. */
+    unsigned int delta[PROXIMITY_NB_CHANNELS];
+
+    /** Initial values saved during calibration. */
+    unsigned int initValue[PROXIMITY_NB_CHANNELS];
+} proximity_msg_t;
+
+/** Threshold band with hysteresis on the calibrated value of a sensor (see proximity_band_add). */
+typedef struct {
+	uint8_t sensor;
+	int16_t on;		// The band becomes active above this value.
+	int16_t off;	// The band becomes inactive below this value.
+} proximity_band_t;
+
+ /**
+ * @brief   Converts a complete sequence of ADC conversions into ambient, reflected and delta values.
+ *
+ * @param adc_values	buffer of PROXIMITY_NB_CHANNELS*2 conversions in the order they are sampled
+ * 						(see the sampling sequence described in proximity.c)
+ * @param msg			message to fill, the calibration values (initValue) are left untouched
+ */
+void proximity_process_samples(const unsigned int *adc_values, proximity_msg_t *msg);
+
+#define PROXIMITY_FILTER_FRAC_BITS 4 // Fractional bits kept in the low-pass filter state.
+
+/** State of the filter applied on the ambient and reflected measures of all the sensors. */
+typedef struct {
+	uint8_t iir_shift;		// Low-pass coefficient is 1/2^iir_shift, 0 disables it.
+	uint8_t median;			// Median of 3 enabled.
+	uint8_t count;			// Number of measures received, saturated at 2.
+	unsigned int history[2][2][PROXIMITY_NB_CHANNELS];	// [age][ambient, reflected][sensor]
+	int32_t state[2][PROXIMITY_NB_CHANNELS];			// Low-pass output with PROXIMITY_FILTER_FRAC_BITS fractional bits.
+} proximity_filter_t;
+
+ /**
+ * @brief   Initializes the filter.
+ *
+ * @param filter		filter to initialize
+ * @param iir_shift		the first order low-pass coefficient is 1/2^iir_shift, 0 disables the low-pass
+ * @param median		1 to apply a median of the last 3 measures before the low-pass, 0 otherwise
+ */
+void proximity_filter_init(proximity_filter_t *filter, uint8_t iir_shift, uint8_t median);
+
+ /**
+ * @brief   Filters the ambient and reflected measures, the delta is computed on the filtered values.
+ *
+ * @param filter		filter state
+ * @param raw			last measures
+ * @param filtered		filtered measures, the header and the calibration values are copied from raw
+ */
+void proximity_filter_process(proximity_filter_t *filter, const proximity_msg_t *raw, proximity_msg_t *filtered);
+
+ /**
+ * @brief   Updates the state of threshold bands with hysteresis on the calibrated measures
+ * 			(delta - initValue, see get_calibrated_prox).
+ * 			A band becomes active when the value of its sensor is above the "on" threshold and inactive
+ * 			when it is below the "off" threshold, otherwise the state is unchanged.
+ *
+ * @param bands		array of PROXIMITY_BANDS_MAX bands
+ * @param used		bit i set if the band i is used
+ * @param msg		last measures
+ * @param active	bit i set if the band i is active, updated
+ *
+ * @return			bit i set if the state of the band i changed
+ */
+uint8_t proximity_bands_update(const proximity_band_t *bands, uint8_t used, const proximity_msg_t *msg, uint8_t *active);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PROXIMITY_PROCESSING_H */
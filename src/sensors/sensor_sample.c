@@ -0,0 +1,25 @@
+#include "sensor_sample.h"
+
+void sensor_header_stamp(sensor_header_t *header, uint32_t timestamp, uint16_t rate) {
+	header->timestamp = timestamp;
+	header->sequence++;
+	header->rate = rate;
+}
+
+void sensor_sequence_init(sensor_sequence_t *seq) {
+	seq->last_sequence = 0;
+	seq->started = 0;
+}
+
+uint32_t sensor_sequence_update(sensor_sequence_t *seq, const sensor_header_t *header) {
+	uint32_t missed = 0;
+
+	// The unsigned difference is right across the wrap of the sequence number. The same message
+	// received twice (wait with a timeout) gives a difference of 0 and is not counted.
+	if(seq->started && header->sequence != seq->last_sequence) {
+		missed = header->sequence - seq->last_sequence - 1;
+	}
+	seq->last_sequence = header->sequence;
+	seq->started = 1;
+	return missed;
+}
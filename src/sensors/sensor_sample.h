@@ -0,0 +1,62 @@
+#ifndef SENSOR_SAMPLE_H
+#define SENSOR_SAMPLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/**
+ * Header common to the sensor messages published on the bus, so that the consumers know when the data
+ * was captured (and not when they receive it) and can detect the publications they missed.
+ * messagebus_topic_wait only returns the last value published, the publications made while the
+ * consumer was busy are lost without notice: the sequence number reveals them.
+ * The timestamp is a system time in ticks (CH_CFG_ST_FREQUENCY, 32 bits).
+ */
+
+/** Header placed as the first member of the sensor messages. */
+typedef struct {
+	uint32_t timestamp;	// System time at which the data was captured (ticks).
+	uint32_t sequence;	// Incremented at each publication of the topic.
+	uint16_t rate;		// Nominal rate of the source in Hz, 0 if unknown.
+} sensor_header_t;
+
+/** State of a consumer, used to count the publications it missed. */
+typedef struct {
+	uint32_t last_sequence;
+	uint8_t started;
+} sensor_sequence_t;
+
+ /**
+ * @brief   Fills the header of a message before its publication and increments its sequence number.
+ *
+ * @param header		header to update
+ * @param timestamp		system time at which the data was captured
+ * @param rate			nominal rate of the source in Hz, 0 if unknown
+ */
+void sensor_header_stamp(sensor_header_t *header, uint32_t timestamp, uint16_t rate);
+
+ /**
+ * @brief   Initializes the state of a consumer, the next message received is not counted as a drop.
+ *
+ * @param seq			state to initialize
+ */
+void sensor_sequence_init(sensor_sequence_t *seq);
+
+ /**
+ * @brief   Updates the state of a consumer with a message received (typically with messagebus_topic_wait).
+ *
+ * @param seq			state of the consumer
+ * @param header		header of the message received
+ *
+ * @return				number of publications missed since the previous message received,
+ * 						0 for the first message
+ */
+uint32_t sensor_sequence_update(sensor_sequence_t *seq, const sensor_header_t *header);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SENSOR_SAMPLE_H */
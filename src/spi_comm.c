@@ -2,14 +2,19 @@
 #include <string.h>
 #include <ch.h>
 #include <hal.h>
+#include "camera/camera.h"
 #include "camera/dcmi_camera.h"
+#include "camera/image_codec.h"
 #include "button.h"
 #include "leds.h"
 #include "spi_comm.h"
+#include "cycle_counter.h"
 #include "sensors/proximity.h"
 #include "chprintf.h"
 #include "usbcfg.h"
 
+#define SPI_GPT				GPTD7	// Pauses between the packets.
+
 uint8_t spi_rx_buff[SPI_PACKET_MAX_SIZE];
 uint8_t spi_tx_buff[SPI_PACKET_MAX_SIZE]; //12]; //SPI_PACKET_MAX_SIZE];
 uint8_t *last_img_ptr = NULL;
@@ -17,6 +22,158 @@ uint8_t image_transfer_enabled = 0;
 uint8_t rgb_setting_enabled = 0;
 uint8_t spi_suspend_flag = 0;
 static thread_t *spi_thd_ptr;
+static image_codec_t image_codec;
+static uint16_t image_frame = 0;
+static uint16_t tx_len = 0;
+
+/*
+ * Transfer engine: the packets of a stream are sent by DMA, the end of each exchange starts a one shot
+ * of SPI_GPT for the pause needed by the ESP32 and the end of the pause starts the next packet. So the
+ * whole stream runs in the interrupts and the thread only waits on stream_done.
+ */
+static struct {
+	const uint8_t *data;
+	uint32_t remaining;		// Bytes of the stream not sent yet, the current packet included.
+	uint16_t len;			// Bytes of the current packet.
+	uint16_t packet;		// Index of the packet in the image, the last ones need longer pauses.
+	uint16_t gap;			// Pause after the packets of the stream, in us.
+	uint8_t retries;		// Retries of the current packet.
+	bool flow_control;		// The answer of the ESP32 is checked after each packet.
+	bool gap_running;
+	bool aborted;
+} stream;
+static BSEMAPHORE_DECL(stream_done, true);
+static bool flow_control_enabled = false;
+static spi_stats_t stats;
+
+/* Starts the current packet of the stream, called with the system locked. */
+static void stream_send_packet(void) {
+	stream.len = stream.remaining > SPI_PACKET_MAX_SIZE ? SPI_PACKET_MAX_SIZE : stream.remaining;
+	spiSelectI(&SPID1);
+	spiStartExchangeI(&SPID1, stream.len, stream.data, spi_rx_buff);
+}
+
+/* End of an exchange (DMA interrupt). */
+static void stream_exchange_cb(SPIDriver *spip) {
+	uint16_t gap = stream.packet >= SPI_FAST_PACKETS ? SPI_SLOW_GAP_US : stream.gap;
+
+	chSysLockFromISR();
+	spiUnselectI(spip);
+	stats.packets++;
+	stats.bytes += stream.len;
+
+	// The ESP32 answers 0 in the second byte when it didn't take the packet, it is sent again after a longer pause.
+	if(stream.flow_control && spi_rx_buff[1] == 0) {
+		if(stream.retries < SPI_MAX_RETRIES) {
+			stream.retries++;
+			stats.retries++;
+			gap = SPI_RETRY_GAP_US;
+		} else {
+			stream.aborted = true;
+			stream.remaining = 0;
+		}
+	} else {
+		stream.retries = 0;
+		stream.data += stream.len;
+		stream.remaining -= stream.len;
+		stream.packet++;
+	}
+
+	stream.gap_running = true;
+	gptStartOneShotI(&SPI_GPT, gap);
+	if(stream.remaining == 0) {
+		chBSemSignalI(&stream_done);
+	}
+	chSysUnlockFromISR();
+}
+
+/* End of the pause between two packets (timer interrupt). */
+static void stream_gap_cb(GPTDriver *gptp) {
+	(void)gptp;
+
+	chSysLockFromISR();
+	stream.gap_running = false;
+	if(stream.remaining > 0) {
+		stream_send_packet();
+	}
+	chSysUnlockFromISR();
+}
+
+/*
+ * Sends a buffer in packets of SPI_PACKET_MAX_SIZE bytes and waits until the last exchange is done, the pause
+ * following it runs in the background. The buffer must not be modified before the function returns.
+ *
+ * The answer of the ESP32 is checked after each packet only for the images, when flow_control is true.
+ *
+ * Returns false if the stream was stopped because the ESP32 didn't take a packet.
+ */
+static bool stream_send(const uint8_t *data, uint32_t len, uint16_t gap_us, bool flow_control) {
+	if(len == 0) {
+		return true;
+	}
+
+	chSysLock();
+	stream.data = data;
+	stream.remaining = len;
+	stream.gap = gap_us;
+	stream.retries = 0;
+	stream.flow_control = flow_control;
+	stream.aborted = false;
+	if(!stream.gap_running) { // Otherwise started at the end of the pause.
+		stream_send_packet();
+	}
+	chSysUnlock();
+
+	chBSemWait(&stream_done);
+	return !stream.aborted;
+}
+
+/*
+ * Write function of the image encoder, groups the payload in packets of SPI_PACKET_MAX_SIZE bytes.
+ */
+static void spi_write_payload(const uint8_t *data, uint32_t len, void *arg) {
+	bool *ok = (bool *)arg;
+
+	while(len > 0 && *ok) {
+		uint32_t n = SPI_PACKET_MAX_SIZE - tx_len;
+		if(n > len) {
+			n = len;
+		}
+		memcpy(&spi_tx_buff[tx_len], data, n);
+		tx_len += n;
+		data += n;
+		len -= n;
+		if(tx_len == SPI_PACKET_MAX_SIZE) {
+			*ok = stream_send(spi_tx_buff, tx_len, SPI_GAP_US, flow_control_enabled);
+			tx_len = 0;
+		}
+	}
+}
+
+/*
+ * Sends the last image as a frame of image_codec.h: the header in a first packet, then the payload.
+ */
+static bool spi_send_compressed_image(uint8_t accepted, uint8_t near) {
+	image_codec_header_t header;
+	uint16_t width = cam_get_image_width();
+	uint16_t height = cam_get_image_height();
+	pixel_format_t format = cam_get_image_size() == (uint32_t)width * height ? PIXEL_FORMAT_GREYSCALE : PIXEL_FORMAT_RGB565;
+	uint8_t *img = cam_get_last_image_ptr();
+	bool ok;
+
+	image_codec_prepare(&image_codec, &header, img, width, height, format,
+						image_codec_select(accepted, format), near, image_frame++);
+
+	memcpy(spi_tx_buff, &header, IMAGE_CODEC_HEADER_SIZE);
+	ok = stream_send(spi_tx_buff, IMAGE_CODEC_HEADER_SIZE, SPI_GAP_US, flow_control_enabled);
+
+	tx_len = 0;
+	image_codec_encode(&image_codec, &header, img, spi_write_payload, &ok);
+	if(ok && tx_len > 0) {
+		ok = stream_send(spi_tx_buff, tx_len, SPI_SLOW_GAP_US, flow_control_enabled);
+	}
+	return ok;
+}
 
 /*
  * SPI communication thread.
@@ -26,12 +183,10 @@ static THD_FUNCTION(spi_thread, p) {
 	(void)p;
 	chRegSetThreadName("SPI thread");
 
-	uint8_t rx_err = 0;
-	volatile uint32_t delay = 0;
-	uint16_t packetId = 0;
-	uint16_t numPackets = 0;
-	uint32_t remainingBytes = 0;
 	systime_t time;
+	rtcnt_t start;
+	uint32_t full_size;
+	bool ok;
 
 	chThdSleepMilliseconds(50); // Wait for the camera to be configured.
 	//wait_dcmi_ready(); // To be implemented...
@@ -117,71 +272,40 @@ static THD_FUNCTION(spi_thread, p) {
 			memset(spi_tx_buff, 101, 12); // When the intensity value of the RGB LEDs is out of range, then their state isn't changed.
 		}
 
-		spiSelect(&SPID1);
-		spiExchange(&SPID1, 12, spi_tx_buff, spi_rx_buff);
-		spiUnselect(&SPID1);
-
-		// A little pause between transactions is needed for the communication to work, 5000 NOP loops last about 350-500 us.
-		for(delay=0; delay<SPI_DELAY*2; delay++) {
-			__NOP();
-		}
+		stream.packet = 0;
+		stream_send(spi_tx_buff, 12, SPI_EXCHANGE_GAP_US, false);
 
 		button_set_state(spi_rx_buff[0]);
 
 		if(image_transfer_enabled == 1) {
-			if(spi_rx_buff[1] == 0xB7) { // -'I' => camera image
-
-				numPackets = cam_get_image_size()/SPI_PACKET_MAX_SIZE;
-				remainingBytes = cam_get_image_size()%SPI_PACKET_MAX_SIZE;
-
-				rx_err = 0;
-
-				last_img_ptr = cam_get_last_image_ptr();
-
-	//			memset(spi_tx_buff, 0xFF, SPI_PACKET_MAX_SIZE);
-	//			memset(last_img_ptr, 0xFF, SPI_PACKET_MAX_SIZE);
-
-				for(packetId=0; packetId<numPackets; packetId++) {
-					spiSelect(&SPID1);
-					spiExchange(&SPID1, SPI_PACKET_MAX_SIZE, &last_img_ptr[packetId*SPI_PACKET_MAX_SIZE], spi_rx_buff);
-					spiUnselect(&SPID1);
-
-					// A bigger delay between transactions for the last transactions increases the robustness of the communication.
-					// This is due to the ESP32 that somehow doesn't support the expected communication speed.
-					if(packetId >= 7) {
-						for(delay=0; delay<(SPI_DELAY*3); delay++) {
-							__NOP();
-						}
-					} else {
-						// A little pause between transactions is needed for the communication to work, 5000 NOP loops last about 350-500 us.
-						for(delay=0; delay<SPI_DELAY; delay++) {
-							__NOP();
-						}
-					}
-
-					if(spi_rx_buff[1] == 0) { // No answer from ESP32...restart the sequence.
-					//	rx_err = 1;
-					//	break;
-					}
-				}
-
-				if(remainingBytes>0 && rx_err==0) {
-					spiSelect(&SPID1);
-					spiExchange(&SPID1, remainingBytes, &last_img_ptr[packetId*SPI_PACKET_MAX_SIZE], spi_rx_buff);
-					spiUnselect(&SPID1);
-
-					// A little pause between transactions is needed for the communication to work, 5000 NOP loops last about 350-500 us.
-					for(delay=0; delay<(SPI_DELAY*3); delay++) {
-						__NOP();
-					}
-
-					if(spi_rx_buff[1] == 0) { // No answer from ESP32...restart the sequence.
-					//	rx_err = 1;
-					//	break;
+			if(spi_rx_buff[1] == 0xB7 || spi_rx_buff[1] == 0xBD) { // -'I' => camera image, -'C' => compressed camera image (accepted codecs, largest error)
+				start = chSysGetRealtimeCounterX();
+				stream.packet = 0;
+
+				if(spi_rx_buff[1] == 0xBD) {
+					ok = spi_send_compressed_image(spi_rx_buff[2], spi_rx_buff[3]);
+				} else {
+					// The full packets then the remaining bytes, with the longer pause after the last packet.
+					last_img_ptr = cam_get_last_image_ptr();
+					full_size = cam_get_image_size() - cam_get_image_size()%SPI_PACKET_MAX_SIZE;
+					ok = stream_send(last_img_ptr, full_size, SPI_GAP_US, flow_control_enabled);
+					if(ok) {
+						ok = stream_send(&last_img_ptr[full_size], cam_get_image_size() - full_size, SPI_SLOW_GAP_US, flow_control_enabled);
 					}
 				}
 
 				dcmi_release_last_image_ptr();
+				chSysLock();
+				if(ok) {
+					stats.frames++;
+				} else {
+					stats.aborted++;
+				}
+				stats.frame_time = CYCLES_TO_US(chSysGetRealtimeCounterX() - start);
+				if(stats.frame_time > stats.frame_time_max) {
+					stats.frame_time_max = stats.frame_time;
+				}
+				chSysUnlock();
 
 			} else if(spi_rx_buff[1] == 0xB6) { // -'J' => camera settings
 
@@ -198,13 +322,21 @@ void spi_comm_start(void) {
 	// SPI1 maximum speed is 42 MHz, ESP32 supports at most 10MHz, so use a prescaler of 1/8 (84 MHz / 8 = 10.5 MHz).
 	// SPI1 configuration (10.5 MHz, CPHA=0, CPOL=0, MSb first).
 	static const SPIConfig hs_spicfg = {
-		NULL,
+		stream_exchange_cb,
 		GPIOA,
 		15,
 		SPI_CR1_BR_1
 		//SPI_CR1_BR_1 | SPI_CR1_BR_0 // 5.25 MHz
 	};
 	spiStart(&SPID1, &hs_spicfg);	// Setup transfer parameters.
+	// Timer counting the pauses in us.
+	static const GPTConfig gptcfg = {
+		1000000,
+		stream_gap_cb,
+		0,
+		0
+	};
+	gptStart(&SPI_GPT, &gptcfg);
 	spi_thd_ptr = chThdCreateStatic(spi_thread_wa, sizeof(spi_thread_wa), NORMALPRIO, spi_thread, NULL);
 }
 
@@ -246,4 +378,22 @@ void spi_comm_resume(void) {
 	}
 }
 
+void spi_flow_control_enable(void) {
+	flow_control_enabled = true;
+}
+
+void spi_flow_control_disable(void) {
+	flow_control_enabled = false;
+}
 
+void spi_get_stats(spi_stats_t *s) {
+	chSysLock();
+	*s = stats;
+	chSysUnlock();
+}
+
+void spi_reset_stats(void) {
+	chSysLock();
+	memset(&stats, 0, sizeof(stats));
+	chSysUnlock();
+}
@@ -7,6 +7,24 @@
 #define SPI_DELAY 5000
 #define SPI_PACKET_MAX_SIZE 4092
 
+// Pauses needed by the ESP32 between two packets, timed by a hardware timer.
+#define SPI_GAP_US 400				// Between the first packets of an image.
+#define SPI_SLOW_GAP_US 1200		// After the last packets of an image, the ESP32 doesn't keep up with the speed.
+#define SPI_EXCHANGE_GAP_US 800		// After the exchange of the RGB LEDs and button state.
+#define SPI_RETRY_GAP_US 2000		// Before sending again a packet not taken by the ESP32.
+#define SPI_FAST_PACKETS 7			// Number of packets of an image followed by SPI_GAP_US.
+#define SPI_MAX_RETRIES 3			// Retries of a packet before giving up the image.
+
+typedef struct {
+	uint32_t frames;			// Images sent.
+	uint32_t aborted;			// Images given up because a packet wasn't taken after SPI_MAX_RETRIES retries.
+	uint32_t packets;			// Exchanges done, retries included.
+	uint32_t bytes;
+	uint32_t retries;			// Packets sent again because the ESP32 answered 0.
+	uint32_t frame_time;		// Time to send the last image (us).
+	uint32_t frame_time_max;
+} spi_stats_t;
+
 void spi_comm_start(void);
 void spi_image_transfer_enable(void);
 void spi_image_transfer_disable(void);
@@ -16,4 +34,18 @@ uint8_t spi_rgb_setting_is_enabled(void);
 void spi_comm_suspend(void);
 void spi_comm_resume(void);
 
+/**
+ * @brief   Enables the flow control of the images: the ESP32 answers 0 in the second byte of a packet it
+ * 			couldn't take and the packet is sent again. Disabled by default, for the ESP32 firmwares
+ * 			that don't answer during the images.
+ */
+void spi_flow_control_enable(void);
+void spi_flow_control_disable(void);
+
+/**
+ * @brief   Copies the counters of the images sent.
+ */
+void spi_get_stats(spi_stats_t *s);
+void spi_reset_stats(void);
+
 #endif /* SPI_COMM_H */
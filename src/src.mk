@@ -12,16 +12,26 @@ CSRC += $(GLOBAL_PATH)/ChibiOS_ext/os/hal/ports/STM32/STM32F4xx/dcmi_lld.c
 CSRC += $(GLOBAL_PATH)/ChibiOS_ext/os/hal/src/dcmi.c
 CSRC += $(GLOBAL_PATH)/ChibiOS_ext/os/hal/src/spi3_slave.c
 CSRC += $(GLOBAL_PATH)/src/audio/audio_thread.c
+CSRC += $(GLOBAL_PATH)/src/audio/gcc_phat.c
+CSRC += $(GLOBAL_PATH)/src/audio/mic_metrics.c
 CSRC += $(GLOBAL_PATH)/src/audio/microphone.c
+CSRC += $(GLOBAL_PATH)/src/audio/mixer.c
 CSRC += $(GLOBAL_PATH)/src/audio/mp45dt02_processing.c
+CSRC += $(GLOBAL_PATH)/src/audio/pdm_decimator.c
+CSRC += $(GLOBAL_PATH)/src/audio/pdm_demux.c
 CSRC += $(GLOBAL_PATH)/src/audio/play_melody.c
+CSRC += $(GLOBAL_PATH)/src/audio/resampler.c
 CSRC += $(GLOBAL_PATH)/src/button.c
 CSRC += $(GLOBAL_PATH)/src/camera/camera.c
 CSRC += $(GLOBAL_PATH)/src/camera/dcmi_camera.c
+CSRC += $(GLOBAL_PATH)/src/camera/image_codec.c
 CSRC += $(GLOBAL_PATH)/src/camera/ov2640.c
 CSRC += $(GLOBAL_PATH)/src/camera/ov7670.c
+CSRC += $(GLOBAL_PATH)/src/camera/pixel_convert.c
 CSRC += $(GLOBAL_PATH)/src/camera/po6030.c
 CSRC += $(GLOBAL_PATH)/src/camera/po8030.c
+CSRC += $(GLOBAL_PATH)/src/camera/vision.c
+CSRC += $(GLOBAL_PATH)/src/camera/vision_processing.c
 CSRC += $(GLOBAL_PATH)/src/cmd.c
 CSRC += $(GLOBAL_PATH)/src/epuck1x/Asercom.c
 CSRC += $(GLOBAL_PATH)/src/epuck1x/Asercom2.c
@@ -54,11 +64,15 @@ CSRC += $(GLOBAL_PATH)/src/sensors/battery_level.c
 CSRC += $(GLOBAL_PATH)/src/sensors/ground.c
 CSRC += $(GLOBAL_PATH)/src/sensors/icm20948/ICM_20948_C.c
 CSRC += $(GLOBAL_PATH)/src/sensors/imu.c
+CSRC += $(GLOBAL_PATH)/src/sensors/imu_fifo.c
 CSRC += $(GLOBAL_PATH)/src/sensors/mpu9250.c
 CSRC += $(GLOBAL_PATH)/src/sensors/proximity.c
+CSRC += $(GLOBAL_PATH)/src/sensors/proximity_processing.c
+CSRC += $(GLOBAL_PATH)/src/sensors/sensor_sample.c
 CSRC += $(GLOBAL_PATH)/src/serial_comm.c
 CSRC += $(GLOBAL_PATH)/src/spi_comm.c
 CSRC += $(GLOBAL_PATH)/src/sdio.c
+CSRC += $(GLOBAL_PATH)/src/sd_logger.c
 CSRC += $(GLOBAL_PATH)/src/usbcfg.c
 CSRC += $(GLOBAL_PATH)/src/uc_usage.c
 CSRC += $(GLOBAL_PATH)/src/chibios-syscalls/malloc_lock.c
@@ -84,8 +98,11 @@ CSRC += $(GLOBAL_PATH)/src/parameter/parameter.c
 CSRC += $(GLOBAL_PATH)/src/parameter/parameter_msgpack.c
 CSRC += $(GLOBAL_PATH)/src/parameter/parameter_print.c
 CSRC += $(GLOBAL_PATH)/src/fat.c
+CSRC += $(GLOBAL_PATH)/src/fat_diskio.c
 CSRC += $(GLOBAL_PATH)/src/audio/play_sound_file.c
+CSRC += $(GLOBAL_PATH)/src/audio/sound_direction.c
 CSRC += $(GLOBAL_PATH)/src/behaviors.c
+CSRC += $(GLOBAL_PATH)/src/obstacle_avoidance.c
 CSRC += $(GLOBAL_PATH)/src/ircom/ircom.c
 CSRC += $(GLOBAL_PATH)/src/ircom/ircomReceive.c
 CSRC += $(GLOBAL_PATH)/src/ircom/ircomTools.c
@@ -0,0 +1,45 @@
+/*
+ * Timing helpers of the host tests. On x86 the time stamp counter gives cycles, elsewhere
+ * the monotonic clock gives nanoseconds.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT	"cycles"
+
+static inline uint64_t bench_now(void) {
+	return __rdtsc();
+}
+#else
+#include <time.h>
+#define BENCH_UNIT	"ns"
+
+static inline uint64_t bench_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+#endif
+
+/* Number of runs of each benchmark, the fastest one is kept. */
+#define BENCH_RUNS	20
+
+/* Runs "code" BENCH_RUNS times and stores the fastest run in "best". */
+#define BENCH(best, code) do { \
+	(best) = UINT64_MAX; \
+	for(int bench_run = 0; bench_run < BENCH_RUNS; bench_run++) { \
+		uint64_t bench_start = bench_now(); \
+		code; \
+		uint64_t bench_time = bench_now() - bench_start; \
+		if(bench_time < (best)) { \
+			(best) = bench_time; \
+		} \
+	} \
+} while(0)
+
+#endif /* BENCH_H */
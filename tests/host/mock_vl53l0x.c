@@ -0,0 +1,115 @@
+/*
+ * Register model of the VL53L0X behind the I2C bus, replaces i2c_bus.c for the tests of the
+ * VL53L0X driver. The driver (vl53l0x_i2c_platform.c) is compiled unchanged, each call to
+ * i2c_transfer is one transaction on the bus and is counted. The transactions given together to
+ * i2c_submit_multi are served at once, the mergeable reads of consecutive registers being counted
+ * as a single burst as with the scheduler of i2c_bus.c.
+ *
+ * The sensor has 8 pages of 256 registers, the page is selected by the register 0xFF. Starting
+ * a measure (SYSRANGE_START) makes a result ready immediately, clearing the interrupt
+ * (SYSTEM_INTERRUPT_CLEAR) clears the result status.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+#include "i2c_bus.h"
+#include "mock_vl53l0x.h"
+
+#define VL53L0X_I2C_ADDR		0x29
+#define REG_SYSRANGE_START		0x00
+#define REG_INTERRUPT_CLEAR		0x0B
+#define REG_INTERRUPT_STATUS	0x13
+#define REG_RANGE_STATUS		0x14
+#define REG_PAGE				0xFF
+
+static uint8_t regs[8][256];
+static uint32_t transactions = 0;
+static uint32_t bytes = 0;
+
+static uint8_t *reg(uint8_t index) {
+	if(index == REG_PAGE) {
+		return &regs[0][REG_PAGE];
+	}
+	return &regs[regs[0][REG_PAGE] & 0x07][index];
+}
+
+static int on_page0(void) {
+	return (regs[0][REG_PAGE] & 0x07) == 0;
+}
+
+void mock_vl53l0x_set(uint8_t index, uint8_t value) {
+	regs[0][index] = value;
+}
+
+uint32_t mock_vl53l0x_transactions(void) {
+	return transactions;
+}
+
+uint32_t mock_vl53l0x_bytes(void) {
+	return bytes;
+}
+
+void i2c_transaction_init(i2c_transaction_t *t, uint8_t addr, const uint8_t *txbuf, size_t txlen,
+							uint8_t *rxbuf, size_t rxlen) {
+	memset(t, 0, sizeof(i2c_transaction_t));
+	t->addr = addr;
+	t->txbuf = txbuf;
+	t->txlen = txlen;
+	t->rxbuf = rxbuf;
+	t->rxlen = rxlen;
+	t->deadline = TIME_INFINITE;
+	t->timeout = MS2ST(4);
+}
+
+/* Executes a transaction, it is counted unless it is merged with the previous one. */
+static msg_t execute(const i2c_transaction_t *t, bool merged) {
+	if(t->addr != VL53L0X_I2C_ADDR || t->txlen == 0) {
+		return MSG_RESET;
+	}
+	if(merged) {
+		bytes += t->rxlen;
+	} else {
+		transactions++;
+		bytes += t->txlen + t->rxlen;
+	}
+
+	uint8_t index = t->txbuf[0];
+	for(size_t i = 1; i < t->txlen; i++) {
+		uint8_t r = index + i - 1;
+		*reg(r) = t->txbuf[i];
+		if(r == REG_INTERRUPT_CLEAR && t->txbuf[i] == 1 && on_page0()) {
+			regs[0][REG_INTERRUPT_STATUS] = 0;
+		}
+	}
+	if(t->txlen > 1 && index == REG_SYSRANGE_START && on_page0() && (t->txbuf[1] & 0x01)) {
+		regs[0][REG_SYSRANGE_START] = 0;
+		regs[0][REG_INTERRUPT_STATUS] = 0x04;
+		regs[0][REG_RANGE_STATUS] = 0x01 | (11 << 3);
+	}
+	for(size_t i = 0; i < t->rxlen; i++) {
+		t->rxbuf[i] = *reg(index + i);
+	}
+	return MSG_OK;
+}
+
+static bool is_mergeable_read(const i2c_transaction_t *t) {
+	return (t->flags & I2C_FLAG_MERGEABLE) && !(t->flags & I2C_FLAG_SEPARATE_READ) &&
+			t->txlen == 1 && t->rxlen > 0;
+}
+
+msg_t i2c_transfer(i2c_transaction_t *t) {
+	return execute(t, false);
+}
+
+void i2c_submit_multi(i2c_transaction_t *t, uint8_t count) {
+	for(uint8_t i = 0; i < count; i++) {
+		bool merged = i > 0 && is_mergeable_read(&t[i - 1]) && is_mergeable_read(&t[i]) &&
+				t[i].addr == t[i - 1].addr && t[i].txbuf[0] == (uint8_t)(t[i - 1].txbuf[0] + t[i - 1].rxlen) &&
+				t[i - 1].status == MSG_OK;
+		t[i].status = execute(&t[i], merged);
+	}
+}
+
+msg_t i2c_wait(i2c_transaction_t *t) {
+	return t->status;
+}
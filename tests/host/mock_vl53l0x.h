@@ -0,0 +1,13 @@
+#ifndef MOCK_VL53L0X_H
+#define MOCK_VL53L0X_H
+
+#include <stdint.h>
+
+/* Sets a register of the page 0. */
+void mock_vl53l0x_set(uint8_t index, uint8_t value);
+
+/* Number of transactions and of bytes (register addresses included) since the start. */
+uint32_t mock_vl53l0x_transactions(void);
+uint32_t mock_vl53l0x_bytes(void);
+
+#endif /* MOCK_VL53L0X_H */
@@ -0,0 +1,23 @@
+/*
+ * C version of arm_bitreversal_32, which CMSIS-DSP only provides in assembly for the Cortex-M
+ * (arm_bitreversal2.S). Swaps the complex values of each pair of offsets of the table.
+ */
+
+#include <stdint.h>
+
+void arm_bitreversal_32(uint32_t *pSrc, const uint16_t bitRevLen, const uint16_t *pBitRevTable);
+
+void arm_bitreversal_32(uint32_t *pSrc, const uint16_t bitRevLen, const uint16_t *pBitRevTable) {
+	for(uint16_t i = 0; i < bitRevLen; i += 2) {
+		uint32_t a = pBitRevTable[i] >> 2;
+		uint32_t b = pBitRevTable[i + 1] >> 2;
+		uint32_t tmp;
+
+		tmp = pSrc[a];
+		pSrc[a] = pSrc[b];
+		pSrc[b] = tmp;
+		tmp = pSrc[a + 1];
+		pSrc[a + 1] = pSrc[b + 1];
+		pSrc[b + 1] = tmp;
+	}
+}
@@ -0,0 +1,33 @@
+/*
+ * Minimal replacement of the ChibiOS kernel header for the host build (see tests/host/Makefile).
+ * Only the types and constants used by the firmware sources compiled on the host are declared,
+ * the functions are implemented by the tests which need them.
+ */
+
+#ifndef CH_H
+#define CH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef int32_t msg_t;
+typedef uint32_t systime_t;
+typedef uint32_t rtcnt_t;
+
+typedef struct {
+	int32_t cnt;
+} binary_semaphore_t;
+
+#define MSG_OK			(msg_t)0
+#define MSG_TIMEOUT		(msg_t)-1
+#define MSG_RESET		(msg_t)-2
+
+#define TIME_IMMEDIATE	((systime_t)0)
+#define TIME_INFINITE	((systime_t)-1)
+
+#define CH_CFG_ST_FREQUENCY	10000
+#define MS2ST(msec)		((systime_t)(((uint32_t)(msec) * CH_CFG_ST_FREQUENCY + 999) / 1000))
+#define US2ST(usec)		((systime_t)(((uint32_t)(usec) * CH_CFG_ST_FREQUENCY + 999999) / 1000000))
+
+#endif /* CH_H */
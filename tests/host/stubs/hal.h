@@ -0,0 +1,12 @@
+/*
+ * Minimal replacement of the ChibiOS HAL header for the host build (see tests/host/Makefile).
+ */
+
+#ifndef HAL_H
+#define HAL_H
+
+#include "ch.h"
+
+typedef uint32_t i2cflags_t;
+
+#endif /* HAL_H */
@@ -0,0 +1,97 @@
+/*
+ * GCC-PHAT delay estimation on synthetic signals: white noise delayed by a fractional number
+ * of samples (windowed sinc interpolation) with some uncorrelated noise on each microphone,
+ * in the layout used by sound_direction.c (10 ms at 16 kHz, four interleaved microphones).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+#include "audio/gcc_phat.h"
+#include "bench.h"
+
+#define FFT_SIZE		256
+#define SAMPLES			160
+#define MICS			4
+#define MAX_LAG			5
+#define SINC_HALF_LEN	40
+#define SOURCE_LEN		(SAMPLES + 2 * SINC_HALF_LEN + 1)
+#define SIGNAL_SCALE	8000.0
+#define NOISE			100		// Amplitude of the uncorrelated noise.
+#define LOUD_NOISE		50		// Gain of the noise giving loud uncorrelated sources.
+#define MAX_ERROR		0.15	// Samples, the parabolic interpolation is biased by up to 0.11 sample at quarter delays.
+#define MIN_PEAK		0.5
+#define MAX_UNCORRELATED_PEAK	0.2
+
+static float32_t work[3 * FFT_SIZE];
+static double source[SOURCE_LEN];
+static int16_t frame[SAMPLES * MICS];
+
+static int16_t noise(void) {
+	return rand() % (2 * NOISE) - NOISE;
+}
+
+/*
+ * Mic 0 receives the source delayed by "delay" samples, mic 1 receives it without delay,
+ * mics 2 and 3 only receive noise.
+ */
+static void synthesize(double delay) {
+	for(int n = 0; n < SAMPLES; n++) {
+		int c = SINC_HALF_LEN + n;
+		double delayed = 0;
+		for(int k = -SINC_HALF_LEN; k <= SINC_HALF_LEN; k++) {
+			double x = k - delay;
+			double sinc = fabs(x) < 1e-9 ? 1 : sin(M_PI * x) / (M_PI * x);
+			double window = 0.5 + 0.5 * cos(M_PI * k / (SINC_HALF_LEN + 1));
+			delayed += source[c - k] * sinc * window;
+		}
+		frame[MICS * n + 0] = (int16_t)(delayed * SIGNAL_SCALE) + noise();
+		frame[MICS * n + 1] = (int16_t)(source[c] * SIGNAL_SCALE) + noise();
+		frame[MICS * n + 2] = noise();
+		frame[MICS * n + 3] = noise();
+	}
+}
+
+int main(void) {
+	gcc_phat_t gcc;
+	float peak;
+	int failed = 0;
+
+	if(gcc_phat_init(&gcc, FFT_SIZE, work) != 0) {
+		printf("FAILED to initialize\n");
+		return 1;
+	}
+
+	srand(1);
+	for(int i = 0; i < SOURCE_LEN; i++) {
+		source[i] = 2.0 * rand() / RAND_MAX - 1.0;
+	}
+
+	for(double delay = -3.0; delay <= 3.0; delay += 0.25) {
+		synthesize(delay);
+		float estimate = gcc_phat_delay(&gcc, &frame[0], &frame[1], SAMPLES, MICS, MAX_LAG, &peak);
+		bool ok = fabs(estimate - delay) <= MAX_ERROR && peak >= MIN_PEAK;
+		printf("delay %+.2f: estimate %+.3f, peak %.3f%s\n", delay, estimate, peak, ok ? "" : " FAILED");
+		failed |= !ok;
+	}
+
+	// The noise alone is below the whitening threshold, every bin is dropped.
+	gcc_phat_delay(&gcc, &frame[2], &frame[3], SAMPLES, MICS, MAX_LAG, &peak);
+	printf("uncorrelated noise: peak %.3f%s\n", peak, peak == 0 ? "" : " FAILED");
+	failed |= peak != 0;
+
+	// Loud uncorrelated sources are whitened but don't give a peak.
+	for(int n = 0; n < SAMPLES; n++) {
+		frame[MICS * n + 2] = LOUD_NOISE * noise();
+		frame[MICS * n + 3] = LOUD_NOISE * noise();
+	}
+	gcc_phat_delay(&gcc, &frame[2], &frame[3], SAMPLES, MICS, MAX_LAG, &peak);
+	printf("uncorrelated sources: peak %.3f%s\n", peak, peak > 0 && peak <= MAX_UNCORRELATED_PEAK ? "" : " FAILED");
+	failed |= peak == 0 || peak > MAX_UNCORRELATED_PEAK;
+
+	uint64_t best;
+	BENCH(best, gcc_phat_delay(&gcc, &frame[0], &frame[1], SAMPLES, MICS, MAX_LAG, &peak));
+	printf("%llu %s per delay (FFT of %d points)\n", (unsigned long long)best, BENCH_UNIT, FFT_SIZE);
+	return failed;
+}
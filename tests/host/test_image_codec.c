@@ -0,0 +1,264 @@
+/*
+ * Image codecs: camera-like images (gradients, flat areas, edges and some noise) are encoded then
+ * decoded with a decoder written from the description of image_codec.h (the same as
+ * python_scripts/decode_image.py). QOI565 and lossless GREY_DELTA must give back the same pixels,
+ * near-lossless GREY_DELTA must stay within "near" of them, noise must fall back to the raw codec.
+ * The compression ratio and the time per pixel are printed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "camera/image_codec.h"
+#include "bench.h"
+
+#define WIDTH	160
+#define HEIGHT	120
+#define PIXELS	(WIDTH * HEIGHT)
+
+static uint8_t rgb[PIXELS * 2], grey[PIXELS], decoded[PIXELS * 2];
+static uint8_t payload[PIXELS * 4];
+static uint32_t payload_len;
+static uint32_t largest_chunk;
+static image_codec_t codec;
+static int failed = 0;
+
+static void expect(int ok, const char *what) {
+	if(!ok) {
+		printf("FAILED: %s\n", what);
+		failed = 1;
+	}
+}
+
+static void store(const uint8_t *data, uint32_t len, void *arg) {
+	(void)arg;
+	if(payload_len + len <= sizeof(payload)) {
+		memcpy(&payload[payload_len], data, len);
+	}
+	payload_len += len;
+	if(len > largest_chunk) {
+		largest_chunk = len;
+	}
+}
+
+static void make_images(void) {
+	srand(1);
+	for(int y = 0; y < HEIGHT; y++) {
+		for(int x = 0; x < WIDTH; x++) {
+			int i = y * WIDTH + x;
+			// Sky gradient at the top, a flat wall with a dark door, a noisy floor at the bottom.
+			uint8_t r, g, b;
+			if(y < 40) {
+				r = 8 + y / 4;
+				g = 30 + y / 2;
+				b = 31;
+			} else if(y < 90) {
+				int door = x >= 60 && x < 90;
+				r = door ? 6 : 24;
+				g = door ? 10 : 44;
+				b = door ? 4 : 16;
+			} else {
+				r = 12 + rand() % 2;
+				g = 24 + rand() % 3;
+				b = 8 + rand() % 2;
+			}
+			uint16_t px = (r << 11) | (g << 5) | b;
+			rgb[2*i] = px >> 8;
+			rgb[2*i + 1] = px & 0xFF;
+			// Luminance of the same scene with a little noise.
+			int luma = (77 * (r << 3) + 150 * (g << 2) + 29 * (b << 3)) >> 8;
+			grey[i] = luma > 0 && rand() % 3 == 0 ? luma - 1 : luma;
+		}
+	}
+}
+
+static void decode_qoi565(const uint8_t *in, uint32_t pixels, uint8_t *out) {
+	uint16_t index[64] = {0}, prev = 0;
+	uint32_t pos = 0, n = 0;
+
+	while(n < pixels) {
+		uint8_t b = in[pos++];
+		uint16_t px;
+		if(b == 0xFE) {
+			px = (in[pos] << 8) | in[pos + 1];
+			pos += 2;
+		} else if((b >> 6) == 3) {
+			for(int k = 0; k <= (b & 0x3F) && n < pixels; k++, n++) {
+				out[2*n] = prev >> 8;
+				out[2*n + 1] = prev & 0xFF;
+			}
+			continue;
+		} else if((b >> 6) == 0) {
+			px = index[b];
+		} else {
+			int r = prev >> 11, g = (prev >> 5) & 0x3F, bl = prev & 0x1F, dr, dg, db;
+			if((b >> 6) == 1) {
+				dr = ((b >> 4) & 3) - 2;
+				dg = ((b >> 2) & 3) - 2;
+				db = (b & 3) - 2;
+			} else {
+				dg = (b & 0x3F) - 32;
+				dr = (in[pos] >> 4) - 8 + (dg >> 1);
+				db = (in[pos] & 0x0F) - 8 + (dg >> 1);
+				pos++;
+			}
+			px = (((r + dr) & 0x1F) << 11) | (((g + dg) & 0x3F) << 5) | ((bl + db) & 0x1F);
+		}
+		index[(3 * (px >> 11) + 5 * ((px >> 5) & 0x3F) + 7 * (px & 0x1F)) % 64] = px;
+		out[2*n] = px >> 8;
+		out[2*n + 1] = px & 0xFF;
+		n++;
+		prev = px;
+	}
+}
+
+static uint8_t predict(uint8_t a, uint8_t b, uint8_t c) {
+	uint8_t max = a > b ? a : b;
+	uint8_t min = a > b ? b : a;
+	if(c >= max) {
+		return min;
+	}
+	if(c <= min) {
+		return max;
+	}
+	return a + b - c;
+}
+
+static void decode_grey_delta(const uint8_t *in, uint32_t len, uint8_t near, uint8_t *out) {
+	int8_t residuals[PIXELS + 1];
+	uint32_t count = 0, pos = 0;
+	int step = 2 * near + 1;
+
+	while(pos < len && count < PIXELS) {
+		uint8_t b = in[pos++];
+		if(b == 0xC0) {
+			residuals[count++] = (int8_t)in[pos++];
+		} else if((b >> 6) == 0) {
+			residuals[count++] = (b & 0x20) ? (b & 0x3F) - 64 : (b & 0x3F);
+		} else if((b >> 6) == 1) {
+			for(int k = 0; k <= (b & 0x3F) && count < PIXELS; k++) {
+				residuals[count++] = 0;
+			}
+		} else {
+			residuals[count++] = ((b >> 3) & 7) - 4;
+			residuals[count++] = (b & 7) - 4;
+		}
+	}
+	expect(count == PIXELS && pos == len, "residuals of all the pixels");
+
+	for(int y = 0; y < HEIGHT; y++) {
+		for(int x = 0; x < WIDTH; x++) {
+			int i = y * WIDTH + x, pred, value;
+			if(y == 0) {
+				pred = x == 0 ? 128 : out[i - 1];
+			} else if(x == 0) {
+				pred = out[i - WIDTH];
+			} else {
+				pred = predict(out[i - 1], out[i - WIDTH], out[i - WIDTH - 1]);
+			}
+			if(near == 0) {
+				value = (pred + residuals[i]) & 0xFF;
+			} else {
+				value = pred + residuals[i] * step;
+				value = value < 0 ? 0 : (value > 255 ? 255 : value);
+			}
+			out[i] = value;
+		}
+	}
+}
+
+/*
+ * Prepares and encodes a frame, checks the header against the payload written.
+ */
+static void encode(image_codec_header_t *header, const uint8_t *image, pixel_format_t format, uint8_t codec_wanted,
+					uint8_t near) {
+	image_codec_prepare(&codec, header, image, WIDTH, HEIGHT, format, codec_wanted, near, 7);
+	payload_len = 0;
+	largest_chunk = 0;
+	image_codec_encode(&codec, header, image, store, NULL);
+
+	expect(memcmp(header->magic, IMAGE_CODEC_MAGIC, 2) == 0 && header->frame == 7, "header");
+	expect(header->width == WIDTH && header->height == HEIGHT && header->format == format, "header size");
+	expect(header->size == payload_len, "payload of the size announced");
+}
+
+static void check_qoi565(void) {
+	image_codec_header_t header;
+
+	encode(&header, rgb, PIXEL_FORMAT_RGB565, IMAGE_CODEC_QOI565, 0);
+	expect(header.codec == IMAGE_CODEC_QOI565, "QOI565 used");
+	expect(largest_chunk <= IMAGE_CODEC_CHUNK, "payload given by chunks");
+	decode_qoi565(payload, PIXELS, decoded);
+	expect(memcmp(decoded, rgb, sizeof(rgb)) == 0, "QOI565 lossless");
+	printf("QOI565              %5.1f %% of the raw size\n", 100.0 * header.size / sizeof(rgb));
+}
+
+static void check_grey_delta(void) {
+	image_codec_header_t header;
+	uint32_t lossless_size;
+
+	encode(&header, grey, PIXEL_FORMAT_GREYSCALE, IMAGE_CODEC_GREY_DELTA, 0);
+	expect(header.codec == IMAGE_CODEC_GREY_DELTA && header.near == 0, "GREY_DELTA used");
+	decode_grey_delta(payload, payload_len, 0, decoded);
+	expect(memcmp(decoded, grey, sizeof(grey)) == 0, "GREY_DELTA lossless");
+	lossless_size = header.size;
+	printf("GREY_DELTA          %5.1f %% of the raw size\n", 100.0 * header.size / sizeof(grey));
+
+	for(uint8_t near = 1; near <= IMAGE_CODEC_MAX_NEAR; near *= 4) {
+		encode(&header, grey, PIXEL_FORMAT_GREYSCALE, IMAGE_CODEC_GREY_DELTA, near);
+		expect(header.near == near, "near in the header");
+		decode_grey_delta(payload, payload_len, near, decoded);
+		int max_error = 0;
+		for(int i = 0; i < PIXELS; i++) {
+			int error = abs(decoded[i] - grey[i]);
+			if(error > max_error) {
+				max_error = error;
+			}
+		}
+		expect(max_error <= near, "error within near");
+		expect(header.size <= lossless_size, "near-lossless smaller");
+		printf("GREY_DELTA near %2u  %5.1f %% of the raw size, largest error %d\n", near,
+				100.0 * header.size / sizeof(grey), max_error);
+	}
+}
+
+static void check_raw(void) {
+	static uint8_t noise[PIXELS * 2];
+	image_codec_header_t header;
+
+	for(int i = 0; i < PIXELS * 2; i++) {
+		noise[i] = rand();
+	}
+	encode(&header, noise, PIXEL_FORMAT_RGB565, IMAGE_CODEC_QOI565, 0);
+	expect(header.codec == IMAGE_CODEC_RAW && header.size == sizeof(noise), "noise sent raw");
+	expect(largest_chunk == sizeof(noise) && memcmp(payload, noise, sizeof(noise)) == 0, "raw pixels at once");
+
+	encode(&header, grey, PIXEL_FORMAT_GREYSCALE, IMAGE_CODEC_QOI565, 0);
+	expect(header.codec == IMAGE_CODEC_RAW, "QOI565 refused for greyscale");
+
+	expect(image_codec_select(IMAGE_CODEC_MASK(IMAGE_CODEC_QOI565) | IMAGE_CODEC_MASK(IMAGE_CODEC_GREY_DELTA),
+			PIXEL_FORMAT_RGB565) == IMAGE_CODEC_QOI565, "QOI565 selected for RGB565");
+	expect(image_codec_select(IMAGE_CODEC_MASK(IMAGE_CODEC_QOI565), PIXEL_FORMAT_GREYSCALE) == IMAGE_CODEC_RAW,
+			"raw selected when no codec fits");
+}
+
+int main(void) {
+	image_codec_header_t header;
+	uint64_t best;
+
+	make_images();
+	check_qoi565();
+	check_grey_delta();
+	check_raw();
+	if(!failed) {
+		printf("decoded images as expected\n");
+	}
+
+	encode(&header, rgb, PIXEL_FORMAT_RGB565, IMAGE_CODEC_QOI565, 0);
+	BENCH(best, image_codec_encode(&codec, &header, rgb, store, NULL); payload_len = 0);
+	printf("QOI565 %.2f %s per pixel\n", (double)best / PIXELS, BENCH_UNIT);
+	encode(&header, grey, PIXEL_FORMAT_GREYSCALE, IMAGE_CODEC_GREY_DELTA, 0);
+	BENCH(best, image_codec_encode(&codec, &header, grey, store, NULL); payload_len = 0);
+	printf("GREY_DELTA %.2f %s per pixel\n", (double)best / PIXELS, BENCH_UNIT);
+	return failed;
+}
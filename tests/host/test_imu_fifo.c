@@ -0,0 +1,97 @@
+/*
+ * IMU FIFO decoding: a FIFO dump built from a trace of the robot (still on the plane, then turning
+ * and accelerating) is decoded with the sign convention of the register reads, an incomplete record
+ * at the end is left for the next read, and the samples converted with the offsets measured while
+ * still give 0 m/s^2 on x and y, -1 g on z and the expected rotation rate.
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include "sensors/imu_fifo.h"
+
+#define SAMPLES		(IMU_FIFO_SIZE / IMU_FIFO_RECORD_SIZE)
+#define GRAVITY		9.80665f
+#define LSB_PER_G	16384		// 2 g range.
+#define LSB_PER_DPS	131.072f	// 250 dps range.
+
+static int16_t trace_acc[SAMPLES][3], trace_gyro[SAMPLES][3];
+static uint8_t fifo[IMU_FIFO_SIZE];
+static int failed = 0;
+
+static void expect(int ok, const char *what) {
+	if(!ok) {
+		printf("FAILED: %s\n", what);
+		failed = 1;
+	}
+}
+
+static void put_word(uint8_t *buf, int16_t value) {
+	buf[0] = (uint16_t)value >> 8;
+	buf[1] = value & 0xFF;
+}
+
+/*
+ * Raw values as read from the sensor: still during the first half, then turning at 90 dps around z
+ * while accelerating at 0.5 g along x. The sensor has small offsets on every axis.
+ */
+static void make_fifo(void) {
+	static const int16_t acc_bias[3] = {120, -80, 40};
+	static const int16_t gyro_bias[3] = {-15, 22, 7};
+
+	for(int i = 0; i < SAMPLES; i++) {
+		int moving = i >= SAMPLES / 2;
+		int16_t acc[3] = {moving ? -LSB_PER_G / 2 : 0, 0, LSB_PER_G};
+		int16_t gyro[3] = {0, 0, moving ? lroundf(90 * LSB_PER_DPS) : 0};
+		for(int axis = 0; axis < 3; axis++) {
+			trace_acc[i][axis] = acc[axis] + acc_bias[axis];
+			trace_gyro[i][axis] = gyro[axis] + gyro_bias[axis];
+			put_word(&fifo[i * IMU_FIFO_RECORD_SIZE + 2 * axis], trace_acc[i][axis]);
+			put_word(&fifo[i * IMU_FIFO_RECORD_SIZE + 6 + 2 * axis], trace_gyro[i][axis]);
+		}
+	}
+}
+
+int main(void) {
+	int16_t acc_raw[SAMPLES][3], gyro_raw[SAMPLES][3];
+	int16_t acc_offset[3], gyro_offset[3];
+	float acc[3], gyro[3];
+	int32_t acc_sum[3] = {0}, gyro_sum[3] = {0};
+
+	make_fifo();
+
+	// One record and a half: the half record stays in the FIFO.
+	expect(imu_fifo_parse(fifo, IMU_FIFO_RECORD_SIZE + IMU_FIFO_RECORD_SIZE / 2, acc_raw, gyro_raw) == 1,
+			"incomplete record left");
+	expect(imu_fifo_parse(fifo, SAMPLES * IMU_FIFO_RECORD_SIZE, acc_raw, gyro_raw) == SAMPLES, "whole FIFO");
+	for(int i = 0; i < SAMPLES; i++) {
+		for(int axis = 0; axis < 3; axis++) {
+			expect(acc_raw[i][axis] == -trace_acc[i][axis], "accelerometer axes inverted");
+			expect(gyro_raw[i][axis] == trace_gyro[i][axis], "gyroscope axes kept");
+		}
+	}
+
+	// Offsets measured while still, as done by the calibration.
+	for(int i = 0; i < SAMPLES / 2; i++) {
+		for(int axis = 0; axis < 3; axis++) {
+			acc_sum[axis] += acc_raw[i][axis];
+			gyro_sum[axis] += gyro_raw[i][axis];
+		}
+	}
+	for(int axis = 0; axis < 3; axis++) {
+		acc_offset[axis] = acc_sum[axis] / (SAMPLES / 2);
+		gyro_offset[axis] = gyro_sum[axis] / (SAMPLES / 2);
+	}
+
+	imu_fifo_convert(acc_raw[0], gyro_raw[0], acc_offset, gyro_offset, acc, gyro);
+	expect(acc[0] == 0 && acc[1] == 0 && fabsf(acc[2] + GRAVITY) < 1e-4f, "still: -1 g on z");
+	expect(gyro[0] == 0 && gyro[1] == 0 && gyro[2] == 0, "still: no rotation");
+
+	imu_fifo_convert(acc_raw[SAMPLES - 1], gyro_raw[SAMPLES - 1], acc_offset, gyro_offset, acc, gyro);
+	expect(fabsf(acc[0] - GRAVITY / 2) < 1e-3f, "moving: 0.5 g on x");
+	expect(fabsf(gyro[2] - 90 * (float)M_PI / 180) < 1e-3f, "moving: 90 dps around z");
+	printf("moving: acc %.4f m/s^2, gyro %.4f rad/s\n", acc[0], gyro[2]);
+	if(!failed) {
+		printf("samples as expected\n");
+	}
+	return failed;
+}
@@ -0,0 +1,81 @@
+/*
+ * IR communication tools: sampling windows built from traces of the 8 proximity sensors while another
+ * robot emits (a square wave on the sensors facing it, ambient light with noise on the other ones).
+ * The sensor receiving the strongest signal and its number of switches around the mean must be found,
+ * windows without signal must be rejected, and the words must be converted to bits and back.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ircom/ircom.h"
+#include "ircom/ircomTools.h"
+
+#define AMBIENT		3000
+
+// Only used by ircomGetTime, defined by ircom.c in the firmware.
+volatile Ircom ircomData;
+
+static int16_t window[IRCOM_SAMPLING_WINDOW * PROXIMITY_NB_CHANNELS];
+static int failed = 0;
+
+static void expect(int ok, const char *what) {
+	if(!ok) {
+		printf("FAILED: %s\n", what);
+		failed = 1;
+	}
+}
+
+static void make_ambient(void) {
+	srand(1);
+	for(int i = 0; i < IRCOM_SAMPLING_WINDOW * PROXIMITY_NB_CHANNELS; i++) {
+		window[i] = AMBIENT + rand() % 21 - 10;
+	}
+}
+
+/* Square wave of the given peak to peak amplitude toggling every "half" samples. */
+static void add_signal(int sensor, int amplitude, int half) {
+	for(int i = 0; i < IRCOM_SAMPLING_WINDOW; i++) {
+		window[i * PROXIMITY_NB_CHANNELS + sensor] = 1500 + ((i / half) % 2 ? 0 : amplitude);
+	}
+}
+
+static void check_windows(void) {
+	int amplitude;
+
+	make_ambient();
+	expect(ircomWindowMaxSensor(window) == -1, "no signal in ambient light");
+	expect(ircomWindowSwitchCount(window, 3, &amplitude) == -1, "ambient light rejected");
+	expect(amplitude <= 20, "amplitude of the ambient noise");
+
+	add_signal(5, 300, 2);
+	add_signal(2, 100, 4);
+	add_signal(6, IRCOM_DETECTION_THRESHOLD_AMPLITUDE - 1, 1);
+	expect(ircomWindowMaxSensor(window) == 5, "sensor facing the emitter");
+	expect(ircomWindowSwitchCount(window, 5, &amplitude) == IRCOM_SAMPLING_WINDOW / 2 - 1, "switches of a mark");
+	expect(amplitude == 300, "amplitude of the strongest signal");
+	expect(ircomWindowSwitchCount(window, 2, &amplitude) == IRCOM_SAMPLING_WINDOW / 4 - 1, "switches of a space");
+	expect(amplitude == 100, "amplitude of the weaker signal");
+	expect(ircomWindowSwitchCount(window, 6, &amplitude) == -1, "signal below the detection threshold");
+}
+
+static void check_words(void) {
+	ircomWord w;
+
+	ircomInt2Bin(0xA5, w);
+	for(int i = 0; i < IRCOM_WORDSIZE; i++) {
+		expect(w[i] == ((0xA5 >> (IRCOM_WORDSIZE - 1 - i)) & 1), "bits most significant first");
+	}
+	for(long n = 0; n < (1 << IRCOM_WORDSIZE); n++) {
+		ircomInt2Bin(n, w);
+		expect(ircomBin2Int(w) == n, "word converted back");
+	}
+}
+
+int main(void) {
+	check_windows();
+	check_words();
+	if(!failed) {
+		printf("windows and words as expected\n");
+	}
+	return failed;
+}
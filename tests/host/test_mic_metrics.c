@@ -0,0 +1,78 @@
+/*
+ * Microphone metrics: a trace of the 4 microphones with known signals (sine with a DC offset, square wave,
+ * silence, full scale) gives the expected peak, RMS, zero crossings and offset, then the time per
+ * frame of 10 ms is measured.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "audio/mic_metrics.h"
+#include "bench.h"
+
+#define FRAMES		160		// 10 ms at 16 kHz.
+#define SAMPLES		(FRAMES * MIC_METRICS_CHANNELS)
+#define SINE_PERIOD	32
+#define SQUARE_HALF	8
+
+static int16_t trace[SAMPLES];
+static int failed = 0;
+
+static void expect(int ok, const char *what) {
+	if(!ok) {
+		printf("FAILED: %s\n", what);
+		failed = 1;
+	}
+}
+
+static void make_trace(void) {
+	for(int i = 0; i < FRAMES; i++) {
+		trace[4*i] = 200 + lround(1000 * sin(2 * M_PI * i / SINE_PERIOD));
+		trace[4*i + 1] = (i / SQUARE_HALF) % 2 ? -3000 : 3000;
+		trace[4*i + 2] = 0;
+		trace[4*i + 3] = i % 2 ? INT16_MIN : INT16_MAX;
+	}
+}
+
+static void check_metrics(void) {
+	mic_metrics_t m[MIC_METRICS_CHANNELS];
+
+	mic_metrics_compute(trace, SAMPLES, m);
+
+	expect(m[0].peak_to_peak == 2000, "sine peak to peak");
+	expect(m[0].peak == 1200, "sine peak");
+	expect(abs(m[0].rms - 707) <= 2, "sine RMS without the offset");
+	expect(m[0].dc_offset == 200, "sine offset");
+	expect(m[0].zero_crossings == 2 * FRAMES / SINE_PERIOD, "sine zero crossings");
+
+	expect(m[1].peak_to_peak == 6000 && m[1].peak == 3000, "square peak");
+	expect(m[1].rms == 3000 && m[1].dc_offset == 0, "square RMS");
+	expect(m[1].zero_crossings == FRAMES / SQUARE_HALF - 1, "square zero crossings");
+
+	expect(m[2].peak_to_peak == 0 && m[2].peak == 0 && m[2].rms == 0, "silence");
+	expect(m[2].zero_crossings == 0 && m[2].dc_offset == 0, "silence offset");
+
+	expect(m[3].peak_to_peak == UINT16_MAX && m[3].peak == 32768, "full scale peak");
+	expect(m[3].rms == 32767 && m[3].dc_offset == 0, "full scale RMS");
+	expect(m[3].zero_crossings == FRAMES - 1, "full scale zero crossings");
+
+	// Less than a frame of the 4 microphones.
+	mic_metrics_compute(trace, MIC_METRICS_CHANNELS - 1, m);
+	for(int ch = 0; ch < MIC_METRICS_CHANNELS; ch++) {
+		expect(m[ch].peak_to_peak == 0 && m[ch].rms == 0 && m[ch].zero_crossings == 0, "empty buffer");
+	}
+}
+
+int main(void) {
+	mic_metrics_t m[MIC_METRICS_CHANNELS];
+	uint64_t best;
+
+	make_trace();
+	check_metrics();
+	if(!failed) {
+		printf("metrics as expected\n");
+	}
+	BENCH(best, mic_metrics_compute(trace, SAMPLES, m));
+	printf("%.2f %s per sample\n", (double)best / SAMPLES, BENCH_UNIT);
+	return failed;
+}
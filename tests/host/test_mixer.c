@@ -0,0 +1,146 @@
+/*
+ * Mixer: silence is the middle of the DAC range, a full scale stream at unity gain uses the whole range,
+ * a tone has the expected period and amplitude, several voices are summed and saturated, the underruns
+ * of a stream are counted and a stream stops its voice when it ends.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "audio/mixer.h"
+#include "bench.h"
+
+#define FREQ	16000
+#define BLOCK	256
+
+static mixer_t mixer;
+static uint16_t out[BLOCK];
+static int failed = 0;
+
+static void expect(int ok, const char *what) {
+	if(!ok) {
+		printf("FAILED: %s\n", what);
+		failed = 1;
+	}
+}
+
+/* Stream of a recorded trace, given by blocks of at most "chunk" samples to simulate underruns. */
+typedef struct {
+	const int16_t *samples;
+	uint32_t len;
+	uint32_t pos;
+	uint16_t chunk;
+} trace_t;
+
+static int32_t trace_source(int16_t *buf, uint16_t n, void *arg) {
+	trace_t *t = arg;
+
+	if(t->pos == t->len) {
+		return MIXER_SOURCE_END;
+	}
+	if(n > t->chunk) {
+		n = t->chunk;
+	}
+	if(n > t->len - t->pos) {
+		n = t->len - t->pos;
+	}
+	for(uint16_t i = 0; i < n; i++) {
+		buf[i] = t->samples[t->pos++];
+	}
+	return n;
+}
+
+static void check_silence(void) {
+	mixer_init(&mixer, FREQ);
+	expect(mixer_mix(&mixer, out, BLOCK) == 0, "no voice playing");
+	for(int i = 0; i < BLOCK; i++) {
+		expect(out[i] == MIXER_DAC_ZERO, "silence in the middle of the range");
+	}
+}
+
+static void check_tone(void) {
+	uint16_t min = MIXER_DAC_MAX, max = 0;
+
+	// 1 kHz at 16 kHz: period of 16 samples.
+	mixer_init(&mixer, FREQ);
+	mixer_set_tone(&mixer, 2, 1000);
+	expect(mixer_mix(&mixer, out, BLOCK) == 0x4, "tone on the voice 2");
+	for(int i = 0; i < BLOCK; i++) {
+		if(out[i] < min) min = out[i];
+		if(out[i] > max) max = out[i];
+		if(i >= 16) {
+			expect(out[i] == out[i - 16], "tone period");
+		}
+	}
+	// MIXER_TONE_AMPLITUDE in 16 bits is 256 for the 12 bits of the DAC.
+	expect(max == MIXER_DAC_ZERO + 256 && min == MIXER_DAC_ZERO - 256, "tone amplitude");
+
+	mixer_set_gain(&mixer, 2, MIXER_GAIN_UNITY / 2);
+	mixer_mix(&mixer, out, BLOCK);
+	min = MIXER_DAC_MAX;
+	max = 0;
+	for(int i = 0; i < BLOCK; i++) {
+		if(out[i] < min) min = out[i];
+		if(out[i] > max) max = out[i];
+	}
+	expect(max == MIXER_DAC_ZERO + 128 && min == MIXER_DAC_ZERO - 128, "tone at half gain");
+
+	mixer_set_tone(&mixer, 2, 0);
+	expect(mixer_active_voices(&mixer) == 0, "tone stopped by a null frequency");
+}
+
+static void check_streams(void) {
+	static int16_t samples[3 * BLOCK];
+	trace_t a = {samples, 3 * BLOCK, 0, BLOCK};
+	trace_t b = {samples, 2 * BLOCK, 0, BLOCK / 2};
+
+	srand(1);
+	for(int i = 0; i < 3 * BLOCK; i++) {
+		samples[i] = rand();
+	}
+	samples[0] = INT16_MAX;
+	samples[1] = INT16_MIN;
+
+	mixer_init(&mixer, FREQ);
+	mixer_set_stream(&mixer, 0, trace_source, &a);
+	expect(mixer_mix(&mixer, out, BLOCK) == 0x1, "stream playing");
+	expect(out[0] == MIXER_DAC_MAX && out[1] == 0, "full scale stream uses the whole range");
+	for(int i = 0; i < BLOCK; i++) {
+		expect(out[i] == MIXER_DAC_ZERO + (samples[i] >> 4), "stream at unity gain");
+	}
+
+	// A second stream giving half a block at once: the end of its blocks is silent.
+	mixer_set_stream(&mixer, 1, trace_source, &b);
+	mixer_mix(&mixer, out, BLOCK);
+	for(int i = 0; i < BLOCK; i++) {
+		int32_t sum = samples[BLOCK + i] + (i < BLOCK / 2 ? samples[i] : 0);
+		int32_t expected = MIXER_DAC_ZERO + (sum >> 4);
+		if(expected > MIXER_DAC_MAX) expected = MIXER_DAC_MAX;
+		if(expected < 0) expected = 0;
+		expect(out[i] == expected, "two streams summed and saturated");
+	}
+	expect(mixer.voices[0].underruns == 0 && mixer.voices[1].underruns == 1, "underrun counted");
+
+	mixer_mix(&mixer, out, BLOCK);
+	expect(mixer_mix(&mixer, out, BLOCK) == 0x2, "first stream ended");
+	mixer_stop(&mixer, 1);
+	expect(mixer_active_voices(&mixer) == 0, "second stream stopped");
+}
+
+int main(void) {
+	uint64_t best;
+
+	check_silence();
+	check_tone();
+	check_streams();
+	if(!failed) {
+		printf("samples as expected\n");
+	}
+
+	mixer_init(&mixer, FREQ);
+	for(uint8_t v = 0; v < MIXER_VOICES; v++) {
+		mixer_set_tone(&mixer, v, 440 * (v + 1));
+	}
+	BENCH(best, mixer_mix(&mixer, out, BLOCK));
+	printf("%.2f %s per sample with %d tones\n", (double)best / BLOCK, BENCH_UNIT, MIXER_VOICES);
+	return failed;
+}
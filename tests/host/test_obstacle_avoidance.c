@@ -0,0 +1,98 @@
+/*
+ * Obstacle avoidance: traces of calibrated proximity values of a robot driving towards obstacles.
+ * Without obstacle the speeds are the targets, an obstacle on one side slows down the wheel of
+ * that side more and more as the robot gets closer, mirrored obstacles give mirrored speeds and
+ * the values below OA_NOISE_THR are ignored.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "obstacle_avoidance.h"
+
+#define TARGET		500		// step/s
+#define STEPS		32
+
+static int failed = 0;
+
+static void expect(int ok, const char *what) {
+	if(!ok) {
+		printf("FAILED: %s\n", what);
+		failed = 1;
+	}
+}
+
+static void compute(const int16_t *prox, int32_t target_left, int32_t target_right, int32_t *left, int32_t *right) {
+	int16_t p[8];
+
+	// The function clears the noise in the array it is given.
+	memcpy(p, prox, sizeof(p));
+	obstacle_avoidance_compute(p, target_left, target_right, left, right);
+}
+
+static void check_free_space(void) {
+	static const int16_t noise[8] = {4, 0, 3, -2, 1, 4, 0, 2};
+	int32_t left, right;
+
+	compute(noise, TARGET, TARGET, &left, &right);
+	expect(left == TARGET && right == TARGET, "noise ignored going forward");
+	compute(noise, -TARGET, -TARGET, &left, &right);
+	expect(left == -TARGET && right == -TARGET, "noise ignored going backward");
+	compute(noise, TARGET, -TARGET, &left, &right);
+	expect(left == TARGET && right == -TARGET, "noise ignored turning");
+}
+
+/*
+ * The robot approaches a wall on its front right (sensors 0 and 1), the mirrored trace is the
+ * same wall on its front left (sensors 7 and 6).
+ */
+static void check_approach(void) {
+	int32_t prev_turn = 0;
+
+	for(int step = 0; step < STEPS; step++) {
+		int16_t right_wall[8] = {0}, left_wall[8] = {0};
+		int32_t left, right, mirror_left, mirror_right;
+
+		// Reflected light grows roughly with the inverse square of the distance.
+		int16_t value = 40000 / ((STEPS + 4 - step) * (STEPS + 4 - step));
+		right_wall[0] = value;
+		right_wall[1] = value / 2;
+		left_wall[7] = right_wall[0];
+		left_wall[6] = right_wall[1];
+
+		compute(right_wall, TARGET, TARGET, &left, &right);
+		compute(left_wall, TARGET, TARGET, &mirror_left, &mirror_right);
+
+		int32_t turn = right - left;
+		if(value < OA_NOISE_THR) {
+			expect(turn == 0, "far wall ignored");
+			continue;
+		}
+		expect(left < TARGET, "wall on the right slows down the left wheel");
+		expect(turn > 0, "wall on the right turns to the left");
+		expect(turn >= prev_turn, "turn grows while approaching");
+		expect(mirror_left - mirror_right == turn, "wall on the left turns as much to the right");
+		prev_turn = turn;
+	}
+	expect(prev_turn > TARGET, "close wall turns on the spot");
+}
+
+static void check_head_on(void) {
+	int16_t prox[8] = {0};
+	int32_t left, right;
+
+	// A wall right in front slows down both wheels by the same amount.
+	prox[0] = 200;
+	prox[7] = 200;
+	compute(prox, TARGET, TARGET, &left, &right);
+	expect(left < TARGET && left == right, "wall in front slows down without turning");
+}
+
+int main(void) {
+	check_free_space();
+	check_approach();
+	check_head_on();
+	if(!failed) {
+		printf("speeds as expected\n");
+	}
+	return failed;
+}
@@ -0,0 +1,160 @@
+/*
+ * PDM to PCM decimator: signal to noise ratio of a sine coded by a sigma-delta modulator
+ * and time spent per output sample, at the three supported output frequencies, then saturation
+ * of a signal above the full scale with the gain of mp45dt02_processing.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "audio/pdm_decimator.h"
+#include "bench.h"
+
+#define DURATION_MS		1000
+#define BLOCK_BYTES		(PDM_DECIMATOR_PDM_FREQ / 8 / 1000)	// 1 ms per microphone, as in mp45dt02_processing.c.
+#define PDM_BYTES		(DURATION_MS * BLOCK_BYTES)
+#define TONE_FREQ		1000.0
+#define TONE_AMPLITUDE	0.5		// Relative to the full scale of the modulator.
+#define MAX_GAIN_ERR_DB	0.5
+#define CLIP_GAIN		4		// AUDIO_IN_VOLUME, the sine of TONE_AMPLITUDE is 2 times above the full scale.
+
+/* Two microphones interleaved byte by byte, the second one is silent (alternating bits). */
+static uint8_t pdm[2 * PDM_BYTES];
+static int16_t pcm[2 * DURATION_MS * 32];
+
+/*
+ * Second order sigma-delta modulator, the first bit in time is the MSB of each byte.
+ */
+static void modulate(double freq, double amplitude) {
+	double i1 = 0, i2 = 0;
+
+	for(int i = 0; i < PDM_BYTES; i++) {
+		uint8_t byte = 0;
+		for(int bit = 0; bit < 8; bit++) {
+			double t = (double)(i * 8 + bit) / PDM_DECIMATOR_PDM_FREQ;
+			double x = amplitude * sin(2 * M_PI * freq * t);
+			double y = (i2 >= 0) ? 1 : -1;
+			i1 += x - y;
+			i2 += i1 - y;
+			byte = (byte << 1) | (y > 0);
+		}
+		pdm[2 * i] = byte;
+		pdm[2 * i + 1] = 0x55;
+	}
+}
+
+/*
+ * Fits a sine of known frequency on the second half of the output (the filters have settled)
+ * and returns the ratio between its power and the power of the residual.
+ */
+static double snr_db(const int16_t *x, int stride, int n, double fs, double freq, double *amplitude) {
+	int start = n / 2;
+	double sc = 0, ss = 0, sig = 0, err = 0;
+
+	for(int i = start; i < n; i++) {
+		sc += x[i * stride] * cos(2 * M_PI * freq * i / fs);
+		ss += x[i * stride] * sin(2 * M_PI * freq * i / fs);
+	}
+	double a = 2 * sc / (n - start);
+	double b = 2 * ss / (n - start);
+	for(int i = start; i < n; i++) {
+		double m = a * cos(2 * M_PI * freq * i / fs) + b * sin(2 * M_PI * freq * i / fs);
+		err += (x[i * stride] - m) * (x[i * stride] - m);
+		sig += m * m;
+	}
+	*amplitude = hypot(a, b);
+	return 10 * log10(sig / err);
+}
+
+static int run(const pdm_decimator_t *dec) {
+	pdm_decimator_t d[2];
+	int n = 0;
+
+	memcpy(&d[0], dec, sizeof(pdm_decimator_t));
+	memcpy(&d[1], dec, sizeof(pdm_decimator_t));
+	for(int block = 0; block < DURATION_MS; block++) {
+		const uint8_t *in = &pdm[2 * block * BLOCK_BYTES];
+		pdm_decimator_process(&d[0], &in[0], BLOCK_BYTES, 2, &pcm[2 * n], 2);
+		n += pdm_decimator_process(&d[1], &in[1], BLOCK_BYTES, 2, &pcm[2 * n + 1], 2);
+	}
+	return n;
+}
+
+/*
+ * The samples above the full scale must saturate without wrapping around: where the output with a
+ * gain of 1 multiplied by the gain exceeds the full scale, the output with the gain must stay close
+ * to the limit of the same sign. The half-band filter comes after the gain, so the saturated signal
+ * is filtered and the limits are not always reached exactly.
+ */
+static int check_clipping(uint32_t freq) {
+	static int16_t unity[DURATION_MS * 32];
+	pdm_decimator_t dec;
+	int16_t max = 0, min = 0;
+	int errors = 0;
+
+	pdm_decimator_init(&dec, freq, 1);
+	int n = run(&dec);
+	for(int i = 0; i < n; i++) {
+		unity[i] = pcm[2 * i];
+	}
+	pdm_decimator_init(&dec, freq, CLIP_GAIN);
+	run(&dec);
+	for(int i = n / 2; i < n; i++) {
+		int32_t expected = CLIP_GAIN * unity[i];
+		int16_t x = pcm[2 * i];
+		max = x > max ? x : max;
+		min = x < min ? x : min;
+		if((expected > INT16_MAX && x < INT16_MAX / 2) || (expected < INT16_MIN && x > INT16_MIN / 2)) {
+			errors++;
+		}
+	}
+	printf("%5u Hz: gain %d, output between %d and %d, %d samples wrapped\n", freq, CLIP_GAIN, min, max, errors);
+	return max == INT16_MAX && min == INT16_MIN && errors == 0;
+}
+
+int main(void) {
+	// The noise of the modulator rises with the bandwidth, the minimum SNR is lower at 32 kHz.
+	static const struct {
+		uint32_t freq;
+		double min_snr_db;
+	} rates[] = {
+		{8000, 75.0},
+		{16000, 68.0},
+		{32000, 55.0},
+	};
+	int failed = 0;
+
+	modulate(TONE_FREQ, TONE_AMPLITUDE);
+
+	for(unsigned r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+		uint32_t freq = rates[r].freq;
+		pdm_decimator_t dec;
+		if(pdm_decimator_init(&dec, freq, 1) != 0) {
+			printf("%5u Hz: not supported\n", freq);
+			failed = 1;
+			continue;
+		}
+
+		int n = run(&dec);
+		double amplitude;
+		double snr = snr_db(&pcm[0], 2, n, freq, TONE_FREQ, &amplitude);
+
+		uint64_t best;
+		BENCH(best, run(&dec));
+
+		// Two microphones are converted by each run.
+		printf("%5u Hz: %d samples, amplitude %.0f (%.0f expected), SNR %.1f dB, %.1f %s/sample\n",
+				freq, n, amplitude, TONE_AMPLITUDE * 32768, snr, (double)best / (2 * n), BENCH_UNIT);
+		double gain_err = 20 * log10(amplitude / (TONE_AMPLITUDE * 32768));
+		if(n != (int)(DURATION_MS * freq / 1000) || snr < rates[r].min_snr_db || fabs(gain_err) > MAX_GAIN_ERR_DB) {
+			printf("FAILED\n");
+			failed = 1;
+		}
+		if(!check_clipping(freq)) {
+			printf("FAILED\n");
+			failed = 1;
+		}
+	}
+	return failed;
+}
@@ -0,0 +1,102 @@
+/*
+ * PDM demultiplexing: pdm_demux and pdm_demux_dual must give exactly the same bytes as the
+ * lookup table version they replace (previously in mp45dt02_processing.c), the time spent
+ * per buffer of 1 ms is compared.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "audio/pdm_demux.h"
+#include "bench.h"
+
+#define WORDS		128		// 1 ms of two microphones at 1.024 MHz.
+#define RANDOM_RUNS	10000
+
+#define CHANNEL_DEMUX_MASK 0x55
+
+// Decode matrix: from 8 bits to 4 bits.
+static const uint8_t Channel_Demux[128] = {
+  0x00, 0x01, 0x00, 0x01, 0x02, 0x03, 0x02, 0x03,
+  0x00, 0x01, 0x00, 0x01, 0x02, 0x03, 0x02, 0x03,
+  0x04, 0x05, 0x04, 0x05, 0x06, 0x07, 0x06, 0x07,
+  0x04, 0x05, 0x04, 0x05, 0x06, 0x07, 0x06, 0x07,
+  0x00, 0x01, 0x00, 0x01, 0x02, 0x03, 0x02, 0x03,
+  0x00, 0x01, 0x00, 0x01, 0x02, 0x03, 0x02, 0x03,
+  0x04, 0x05, 0x04, 0x05, 0x06, 0x07, 0x06, 0x07,
+  0x04, 0x05, 0x04, 0x05, 0x06, 0x07, 0x06, 0x07,
+  0x08, 0x09, 0x08, 0x09, 0x0a, 0x0b, 0x0a, 0x0b,
+  0x08, 0x09, 0x08, 0x09, 0x0a, 0x0b, 0x0a, 0x0b,
+  0x0c, 0x0d, 0x0c, 0x0d, 0x0e, 0x0f, 0x0e, 0x0f,
+  0x0c, 0x0d, 0x0c, 0x0d, 0x0e, 0x0f, 0x0e, 0x0f,
+  0x08, 0x09, 0x08, 0x09, 0x0a, 0x0b, 0x0a, 0x0b,
+  0x08, 0x09, 0x08, 0x09, 0x0a, 0x0b, 0x0a, 0x0b,
+  0x0c, 0x0d, 0x0c, 0x0d, 0x0e, 0x0f, 0x0e, 0x0f,
+  0x0c, 0x0d, 0x0c, 0x0d, 0x0e, 0x0f, 0x0e, 0x0f
+};
+
+static void pdm_demux_ref(const uint16_t *in, uint16_t *out, uint32_t len) {
+	const uint8_t *in8 = (const uint8_t *)in;
+	uint8_t *out8 = (uint8_t *)out;
+	uint8_t a, b;
+
+	for(uint32_t index=0; index<len; index++) {
+		a = in8[(index*2)]; // MSByte.
+		b = in8[(index*2)+1]; // LSByte.
+		out8[(index*2)] = Channel_Demux[a & CHANNEL_DEMUX_MASK] | Channel_Demux[b & CHANNEL_DEMUX_MASK] << 4; // Extract left and swap bytes.
+		out8[(index*2)+1] = Channel_Demux[(a>>1) & CHANNEL_DEMUX_MASK] | Channel_Demux[(b>>1) & CHANNEL_DEMUX_MASK] << 4; // Extract right and swap bytes.
+	}
+}
+
+static int check(const uint16_t *in_a, const uint16_t *in_b, uint32_t len) {
+	uint16_t ref_a[WORDS], ref_b[WORDS], out_a[WORDS], out_b[WORDS], out[WORDS];
+
+	pdm_demux_ref(in_a, ref_a, len);
+	pdm_demux_ref(in_b, ref_b, len);
+	pdm_demux(in_a, out, len);
+	pdm_demux_dual(in_a, in_b, out_a, out_b, len);
+	if(memcmp(ref_a, out, len * sizeof(uint16_t)) != 0) {
+		printf("pdm_demux differs from the reference\n");
+		return 1;
+	}
+	if(memcmp(ref_a, out_a, len * sizeof(uint16_t)) != 0 || memcmp(ref_b, out_b, len * sizeof(uint16_t)) != 0) {
+		printf("pdm_demux_dual differs from the reference\n");
+		return 1;
+	}
+	return 0;
+}
+
+int main(void) {
+	static uint16_t in_a[WORDS], in_b[WORDS], out_a[WORDS], out_b[WORDS];
+
+	// All the possible words.
+	for(uint32_t v = 0; v < 0x10000; v++) {
+		uint16_t a = v, b = ~v;
+		if(check(&a, &b, 1)) {
+			printf("FAILED on 0x%04x\n", v);
+			return 1;
+		}
+	}
+	// Buffers of every length up to 1 ms, to cover the handling of the last odd word.
+	srand(1);
+	for(int run = 0; run < RANDOM_RUNS; run++) {
+		uint32_t len = 1 + run % WORDS;
+		for(uint32_t i = 0; i < len; i++) {
+			in_a[i] = rand();
+			in_b[i] = rand();
+		}
+		if(check(in_a, in_b, len)) {
+			printf("FAILED on a buffer of %u words\n", len);
+			return 1;
+		}
+	}
+	printf("bit exact on all the words and on %d random buffers\n", RANDOM_RUNS);
+
+	uint64_t ref, single, dual;
+	BENCH(ref, pdm_demux_ref(in_a, out_a, WORDS); pdm_demux_ref(in_b, out_b, WORDS));
+	BENCH(single, pdm_demux(in_a, out_a, WORDS); pdm_demux(in_b, out_b, WORDS));
+	BENCH(dual, pdm_demux_dual(in_a, in_b, out_a, out_b, WORDS));
+	printf("1 ms of the four microphones: table %llu, pdm_demux %llu, pdm_demux_dual %llu %s\n",
+			(unsigned long long)ref, (unsigned long long)single, (unsigned long long)dual, BENCH_UNIT);
+	return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * Pixel conversion kernels: each kernel must give exactly the same bytes as its per-pixel scalar
+ * reference, in place or not, then both are timed per pixel on a QQVGA image (160x120).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "camera/pixel_convert.h"
+#include "bench.h"
+
+#define WIDTH	160
+#define HEIGHT	120
+#define PIXELS	(WIDTH * HEIGHT)
+#define SIZE	(PIXELS * PIXEL_FORMAT_RGB565)
+
+static uint8_t image[SIZE], out[SIZE], ref[SIZE];
+static int failed = 0;
+
+static void expect(int ok, const char *what) {
+	if(!ok) {
+		printf("FAILED: %s\n", what);
+		failed = 1;
+	}
+}
+
+static void check_colours(void) {
+	static const uint8_t white[2] = {0xFF, 0xFF};
+	static const uint8_t red[4] = {0xF8, 0x00, 0xF8, 0x00};
+	static const uint8_t blue[4] = {0x00, 0x1F, 0x00, 0x1F};
+	uint8_t grey, yuv[4];
+
+	pixel_rgb565_to_grey(white, &grey, 1);
+	expect(grey == 255, "white is 255 in greyscale");
+	pixel_rgb565_to_yuv422(red, yuv, 2);
+	expect(yuv[0] == yuv[2] && yuv[1] < 128 && yuv[3] > 200, "red in YUV");
+	pixel_rgb565_to_yuv422(blue, yuv, 2);
+	expect(yuv[0] == yuv[2] && yuv[1] > 200 && yuv[3] < 128, "blue in YUV");
+}
+
+static void check_kernels(void) {
+	// Lengths which are not multiples of the pixels processed per word.
+	for(uint32_t pixels = 1; pixels <= 64; pixels++) {
+		memset(out, 0, SIZE);
+		memset(ref, 0, SIZE);
+		pixel_rgb565_to_grey(image, out, pixels);
+		pixel_rgb565_to_grey_ref(image, ref, pixels);
+		expect(memcmp(out, ref, pixels) == 0, "greyscale of a few pixels");
+		pixel_rgb565_to_yuv422(image, out, pixels);
+		pixel_rgb565_to_yuv422_ref(image, ref, pixels);
+		expect(memcmp(out, ref, (pixels & ~1) * 2) == 0, "YUV of a few pixels");
+	}
+
+	// Whole image in place.
+	memcpy(out, image, SIZE);
+	pixel_rgb565_to_grey(out, out, PIXELS);
+	pixel_rgb565_to_grey_ref(image, ref, PIXELS);
+	expect(memcmp(out, ref, PIXELS) == 0, "greyscale in place");
+	memcpy(out, image, SIZE);
+	pixel_rgb565_to_yuv422(out, out, PIXELS);
+	pixel_rgb565_to_yuv422_ref(image, ref, PIXELS);
+	expect(memcmp(out, ref, SIZE) == 0, "YUV in place");
+
+	for(uint8_t factor = 1; factor <= 4; factor *= 2) {
+		for(pixel_format_t format = PIXEL_FORMAT_GREYSCALE; format <= PIXEL_FORMAT_RGB565; format++) {
+			for(uint16_t width = 4; width <= WIDTH; width += 4) {
+				uint16_t height = 12;
+				uint32_t len = (width / factor) * (height / factor) * format;
+				memcpy(out, image, SIZE);
+				memset(ref, 0, SIZE);
+				expect(pixel_downscale(out, out, width, height, format, factor) == 0, "downscale accepted");
+				pixel_downscale_ref(image, ref, width, height, format, factor);
+				expect(memcmp(out, ref, len) == 0, "downscale in place");
+			}
+		}
+	}
+	expect(pixel_downscale(image, out, WIDTH, HEIGHT, PIXEL_FORMAT_RGB565, 3) != 0, "factor 3 rejected");
+
+	memcpy(out, image, SIZE);
+	expect(pixel_crop(out, out, WIDTH, HEIGHT, PIXEL_FORMAT_RGB565, 10, 20, 50, 30) == 0, "crop accepted");
+	for(int line = 0; line < 30; line++) {
+		expect(memcmp(&out[line * 50 * 2], &image[((20 + line) * WIDTH + 10) * 2], 50 * 2) == 0, "crop");
+	}
+	expect(pixel_crop(image, out, WIDTH, HEIGHT, PIXEL_FORMAT_RGB565, 150, 0, 20, 10) != 0, "crop outside rejected");
+}
+
+static void report(const char *name, uint64_t kernel, uint64_t reference, uint32_t pixels) {
+	printf("%-22s %6.2f %s/pixel (reference %6.2f)\n", name, (double)kernel / pixels, BENCH_UNIT,
+			(double)reference / pixels);
+}
+
+static void benchmark(void) {
+	uint64_t kernel, reference;
+
+	BENCH(kernel, pixel_rgb565_to_grey(image, out, PIXELS));
+	BENCH(reference, pixel_rgb565_to_grey_ref(image, ref, PIXELS));
+	report("RGB565 to greyscale", kernel, reference, PIXELS);
+
+	BENCH(kernel, pixel_rgb565_to_yuv422(image, out, PIXELS));
+	BENCH(reference, pixel_rgb565_to_yuv422_ref(image, ref, PIXELS));
+	report("RGB565 to YUV 4:2:2", kernel, reference, PIXELS);
+
+	BENCH(kernel, pixel_downscale(image, out, WIDTH, HEIGHT, PIXEL_FORMAT_RGB565, 2));
+	BENCH(reference, pixel_downscale_ref(image, ref, WIDTH, HEIGHT, PIXEL_FORMAT_RGB565, 2));
+	report("RGB565 downscale 2x", kernel, reference, PIXELS);
+
+	BENCH(kernel, pixel_downscale(image, out, WIDTH, HEIGHT, PIXEL_FORMAT_GREYSCALE, 2));
+	BENCH(reference, pixel_downscale_ref(image, ref, WIDTH, HEIGHT, PIXEL_FORMAT_GREYSCALE, 2));
+	report("greyscale downscale 2x", kernel, reference, PIXELS);
+}
+
+int main(void) {
+	srand(1);
+	for(uint32_t i = 0; i < SIZE; i++) {
+		image[i] = rand();
+	}
+
+	check_colours();
+	check_kernels();
+	if(!failed) {
+		printf("identical to the references\n");
+	}
+	benchmark();
+	return failed;
+}
@@ -0,0 +1,146 @@
+/*
+ * Proximity processing: an ADC sequence is split into the ambient, reflected and delta values of each
+ * sensor, then traces of measures go through the filter (median of 3 against spikes, low-pass against
+ * noise) and the threshold bands with hysteresis.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "sensors/proximity_processing.h"
+
+static int failed = 0;
+
+static void expect(int ok, const char *what) {
+	if(!ok) {
+		printf("FAILED: %s\n", what);
+		failed = 1;
+	}
+}
+
+/*
+ * Builds the ADC sequence sampled by proximity.c: IR0 + IR4 ambient, IR0 + IR4 reflected,
+ * IR1 + IR5 ambient, IR1 + IR5 reflected, ...
+ */
+static void make_sequence(const unsigned int *ambient, const unsigned int *reflected, unsigned int *adc) {
+	for(int i = 0; i < PROXIMITY_NB_CHANNELS / 2; i++) {
+		adc[4*i] = ambient[i];
+		adc[4*i + 1] = ambient[i + 4];
+		adc[4*i + 2] = reflected[i];
+		adc[4*i + 3] = reflected[i + 4];
+	}
+}
+
+static void measure(proximity_msg_t *msg, unsigned int ambient, unsigned int reflected) {
+	unsigned int amb[PROXIMITY_NB_CHANNELS], refl[PROXIMITY_NB_CHANNELS], adc[2 * PROXIMITY_NB_CHANNELS];
+
+	for(int i = 0; i < PROXIMITY_NB_CHANNELS; i++) {
+		amb[i] = ambient;
+		refl[i] = reflected;
+	}
+	make_sequence(amb, refl, adc);
+	proximity_process_samples(adc, msg);
+}
+
+static void check_samples(void) {
+	unsigned int ambient[PROXIMITY_NB_CHANNELS], reflected[PROXIMITY_NB_CHANNELS], adc[2 * PROXIMITY_NB_CHANNELS];
+	proximity_msg_t msg;
+
+	for(int i = 0; i < PROXIMITY_NB_CHANNELS; i++) {
+		ambient[i] = 3000 + i;
+		reflected[i] = 2000 + 100 * i;
+	}
+	reflected[6] = 3100; // More light with the LED off, no obstacle.
+	make_sequence(ambient, reflected, adc);
+	memset(&msg, 0, sizeof(msg));
+	proximity_process_samples(adc, &msg);
+
+	for(int i = 0; i < PROXIMITY_NB_CHANNELS; i++) {
+		expect(msg.ambient[i] == ambient[i], "ambient of each sensor");
+		expect(msg.reflected[i] == reflected[i], "reflected of each sensor");
+		if(i != 6) {
+			expect(msg.delta[i] == ambient[i] - reflected[i], "delta of each sensor");
+		}
+	}
+	expect(msg.delta[6] == 0, "negative delta clamped to 0");
+}
+
+static void check_median(void) {
+	// A single spike in a steady trace, the median removes it after the first two measures.
+	static const unsigned int trace[] = {1000, 1000, 1000, 3000, 1000, 1000, 1200, 1200, 1200};
+	static const unsigned int expected[] = {1000, 1000, 1000, 1000, 1000, 1000, 1000, 1200, 1200};
+	proximity_filter_t filter;
+	proximity_msg_t raw, filtered;
+
+	proximity_filter_init(&filter, 0, 1);
+	memset(&raw, 0, sizeof(raw));
+	for(unsigned int i = 0; i < sizeof(trace) / sizeof(trace[0]); i++) {
+		measure(&raw, 4000, 4000 - trace[i]);
+		raw.header.sequence = i;
+		proximity_filter_process(&filter, &raw, &filtered);
+		expect(filtered.reflected[3] == 4000 - expected[i], "spike removed by the median");
+		expect(filtered.delta[3] == expected[i], "delta of the filtered values");
+		expect(filtered.header.sequence == i, "header copied");
+	}
+}
+
+static void check_low_pass(void) {
+	proximity_filter_t filter;
+	proximity_msg_t raw, filtered;
+	unsigned int prev = 0;
+
+	// Step from 1000 to 2000 with a coefficient of 1/4, the output starts from the first measure.
+	proximity_filter_init(&filter, 2, 0);
+	measure(&raw, 1000, 0);
+	proximity_filter_process(&filter, &raw, &filtered);
+	expect(filtered.ambient[0] == 1000, "low-pass starts from the first measure");
+	prev = filtered.ambient[0];
+	measure(&raw, 2000, 0);
+	for(int i = 0; i < 40; i++) {
+		proximity_filter_process(&filter, &raw, &filtered);
+		expect(filtered.ambient[0] >= prev, "step response is monotonic");
+		prev = filtered.ambient[0];
+		if(i == 0) {
+			expect(filtered.ambient[0] == 1250, "first step of 1/4");
+		}
+	}
+	expect(prev >= 1999 && prev <= 2000, "low-pass converges to the step");
+}
+
+static void check_bands(void) {
+	// Calibrated values of the sensors 0 and 5 along the trace.
+	static const int trace[][2] = {
+		{0, 0}, {60, 250}, {120, 250}, {80, 350}, {51, 250}, {40, 199}, {101, 201}, {100, 0}
+	};
+	static const uint8_t expected_active[] = {0x0, 0x0, 0x1, 0x3, 0x3, 0x0, 0x1, 0x1};
+	static const uint8_t expected_changed[] = {0x0, 0x0, 0x1, 0x2, 0x0, 0x3, 0x1, 0x0};
+	proximity_band_t bands[PROXIMITY_BANDS_MAX];
+	proximity_msg_t msg;
+	uint8_t active = 0x80; // Not used, cleared by the first update.
+
+	memset(bands, 0, sizeof(bands));
+	bands[0] = (proximity_band_t){.sensor = 0, .on = 100, .off = 50};
+	bands[1] = (proximity_band_t){.sensor = 5, .on = 300, .off = 200};
+	memset(&msg, 0, sizeof(msg));
+	for(int i = 0; i < PROXIMITY_NB_CHANNELS; i++) {
+		msg.initValue[i] = 30;
+	}
+
+	for(unsigned int i = 0; i < sizeof(trace) / sizeof(trace[0]); i++) {
+		msg.delta[0] = 30 + trace[i][0];
+		msg.delta[5] = 30 + trace[i][1];
+		uint8_t changed = proximity_bands_update(bands, 0x3, &msg, &active);
+		expect(active == expected_active[i], "state of the bands");
+		expect(changed == expected_changed[i], "bands changed");
+	}
+}
+
+int main(void) {
+	check_samples();
+	check_median();
+	check_low_pass();
+	check_bands();
+	if(!failed) {
+		printf("measures as expected\n");
+	}
+	return failed;
+}
@@ -0,0 +1,133 @@
+/*
+ * Sampling rate converter: at equal rates the output is the input delayed by RESAMPLER_TAPS / 2
+ * samples, a tone resampled up or down keeps its frequency and amplitude (less than 3 dB lost near
+ * the cut-off frequency), a tone above the output Nyquist frequency is attenuated by more than 26 dB. The time per output sample is measured for the 44.1 kHz files
+ * played at the rate of the DAC.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "audio/resampler.h"
+#include "bench.h"
+
+#define DELAY		(RESAMPLER_TAPS / 2)
+#define DURATION	0.1		// Seconds of each tone.
+#define MAX_INPUT	4410
+#define MAX_OUTPUT	8000
+#define AMPLITUDE	10000
+
+static int16_t input[MAX_INPUT], output[MAX_OUTPUT];
+static resampler_t r;
+static int failed = 0;
+
+static void expect(int ok, const char *what) {
+	if(!ok) {
+		printf("FAILED: %s\n", what);
+		failed = 1;
+	}
+}
+
+/*
+ * Resamples the "len" first samples of the input with the converter initialized, returns the number
+ * of output samples.
+ */
+static uint32_t resample(uint32_t len) {
+	uint32_t in = 0, out = 0;
+
+	while(out < MAX_OUTPUT) {
+		if(resampler_needs_input(&r)) {
+			if(in == len) {
+				break;
+			}
+			resampler_push(&r, input[in++]);
+		} else {
+			output[out++] = resampler_output(&r);
+		}
+	}
+	return out;
+}
+
+/*
+ * Resamples a tone of DURATION seconds, returns the number of output samples.
+ */
+static uint32_t resample_tone(uint32_t in_freq, uint32_t out_freq, double tone) {
+	uint32_t len = DURATION * in_freq;
+
+	for(uint32_t i = 0; i < len; i++) {
+		input[i] = lround(AMPLITUDE * sin(2 * M_PI * tone * i / in_freq));
+	}
+	resampler_init(&r, in_freq, out_freq);
+	return resample(len);
+}
+
+/*
+ * Amplitude and frequency of the output, the start of the output (filter not yet filled) is skipped.
+ */
+static void analyse(uint32_t len, uint32_t out_freq, double *amplitude, double *frequency) {
+	uint32_t skip = 2 * RESAMPLER_TAPS;
+	uint32_t first = 0, last = 0, crossings = 0;
+	double sum_sq = 0;
+
+	for(uint32_t i = skip; i < len; i++) {
+		sum_sq += (double)output[i] * output[i];
+		if(output[i - 1] < 0 && output[i] >= 0) {
+			if(crossings == 0) {
+				first = i;
+			}
+			last = i;
+			crossings++;
+		}
+	}
+	*amplitude = sqrt(2 * sum_sq / (len - skip));
+	*frequency = crossings > 1 ? (double)(crossings - 1) * out_freq / (last - first) : 0;
+}
+
+static void check_delay(void) {
+	expect(resampler_init(&r, 16000, 16000) == 0, "equal rates accepted");
+	srand(1);
+	for(int i = 0; i < 256; i++) {
+		input[i] = rand();
+		resampler_push(&r, input[i]);
+		expect(!resampler_needs_input(&r), "one output per input at equal rates");
+		int16_t out = resampler_output(&r);
+		expect(out == (i >= DELAY ? input[i - DELAY] : 0), "pure delay at equal rates");
+		expect(resampler_needs_input(&r), "one input per output at equal rates");
+	}
+}
+
+/*
+ * Checks the output of a tone, its amplitude relative to the input must be between min_gain and max_gain.
+ */
+static void check_tone(uint32_t in_freq, uint32_t out_freq, double tone, double min_gain, double max_gain) {
+	double amplitude, frequency;
+	uint32_t len = resample_tone(in_freq, out_freq, tone);
+	uint32_t expected_len = DURATION * out_freq;
+
+	analyse(len, out_freq, &amplitude, &frequency);
+	printf("%5u Hz to %5u Hz, tone of %5.0f Hz: %u samples, amplitude %5.0f, frequency %6.1f Hz\n",
+			in_freq, out_freq, tone, len, amplitude, frequency);
+	expect(abs((int)len - (int)expected_len) <= 1, "number of output samples");
+	expect(amplitude >= min_gain * AMPLITUDE && amplitude <= max_gain * AMPLITUDE, "amplitude");
+	if(tone < out_freq / 2) {
+		expect(fabs(frequency - tone) < 0.01 * tone, "frequency kept");
+	}
+}
+
+int main(void) {
+	uint64_t best;
+
+	expect(resampler_init(&r, 0, 16000) != 0, "null rate rejected");
+	expect(resampler_init(&r, 4 * 16000 + 1, 16000) != 0, "ratio above RESAMPLER_MAX_RATIO rejected");
+	check_delay();
+	check_tone(8000, 16000, 1000, 0.98, 1.02);
+	check_tone(44100, 16000, 1000, 0.98, 1.02);
+	check_tone(44100, 16000, 5000, 0.71, 1.02);
+	check_tone(44100, 16000, 12000, 0, 0.05);
+	check_tone(22050, 16000, 10000, 0, 0.05);
+
+	resample_tone(44100, 16000, 1000);
+	BENCH(best, resample(DURATION * 44100));
+	printf("%.2f %s per output sample\n", (double)best / (DURATION * 16000), BENCH_UNIT);
+	return failed;
+}
@@ -0,0 +1,148 @@
+/*
+ * Blob and line detection: a synthetic QQVGA frame (160x120, RGB565) with a red square, a blue U (two bars
+ * joined at the bottom, merged while labelling), a red speck below the minimum area and a dark line is
+ * given by strips of lines as from the camera. The blobs and the line must be found exactly, a lost
+ * strip must be reported, then the time per frame is measured.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "camera/vision_processing.h"
+#include "bench.h"
+
+#define WIDTH		160
+#define HEIGHT		120
+#define STRIP		8		// Lines given at once.
+
+#define GREY		0x8410
+#define RED			0xF800
+#define BLUE		0x001F
+#define BLACK		0x0000
+
+static uint8_t frame[WIDTH * HEIGHT * 2];
+static vision_t vision;
+static int failed = 0;
+
+static void expect(int ok, const char *what) {
+	if(!ok) {
+		printf("FAILED: %s\n", what);
+		failed = 1;
+	}
+}
+
+static void fill(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, uint16_t colour) {
+	for(uint16_t y = y0; y <= y1; y++) {
+		for(uint16_t x = x0; x <= x1; x++) {
+			frame[2 * (y * WIDTH + x)] = colour >> 8;
+			frame[2 * (y * WIDTH + x) + 1] = colour & 0xFF;
+		}
+	}
+}
+
+static void make_frame(void) {
+	fill(0, 0, WIDTH - 1, HEIGHT - 1, GREY);
+	fill(20, 10, 49, 39, RED);
+	fill(120, 10, 124, 49, BLUE);
+	fill(140, 10, 144, 49, BLUE);
+	fill(120, 50, 144, 54, BLUE);
+	fill(60, 60, 61, 61, RED);
+	fill(100, 100, 109, 119, BLACK);
+}
+
+static uint32_t ticks = 0;
+
+static uint32_t fake_clock(void) {
+	return ticks++;
+}
+
+static const vision_config_t config = {
+	.classes = {
+		{.y_min = 0, .y_max = 255, .u_min = 0, .u_max = 110, .v_min = 200, .v_max = 255},	// Red.
+		{.y_min = 0, .y_max = 255, .u_min = 200, .u_max = 255, .v_min = 0, .v_max = 255},	// Blue.
+	},
+	.nb_classes = 2,
+	.min_area = 10,
+	.line_first_row = 100,
+	.line_rows = 20,
+	.line_dark = 1,
+	.edge_threshold = 40,
+};
+
+static bool process_frame(uint16_t skipped_strip) {
+	bool done = false;
+
+	for(uint16_t line = 0; line < HEIGHT; line += STRIP) {
+		if(line / STRIP == skipped_strip) {
+			continue;
+		}
+		done = vision_process_lines(&vision, &frame[line * WIDTH * 2], line, STRIP);
+	}
+	return done;
+}
+
+static void check_frame(void) {
+	vision_result_t result;
+
+	expect(vision_init(&vision, &config, VISION_FORMAT_RGB565, WIDTH, HEIGHT, fake_clock) == 0, "init");
+	expect(process_frame(UINT16_MAX), "frame complete after the last strip");
+	vision_get_result(&vision, &result);
+
+	expect(result.incomplete == 0, "nothing missing");
+	expect(result.nb_blobs == 2, "speck below the minimum area ignored");
+	const vision_blob_t *square = &result.blobs[0];
+	expect(square->cls == 0 && square->area == 900, "red square, largest first");
+	expect(square->x_min == 20 && square->x_max == 49 && square->y_min == 10 && square->y_max == 39, "square box");
+	expect(square->x == 34 && square->y == 24, "square centroid");
+	const vision_blob_t *u = &result.blobs[1];
+	expect(u->cls == 1 && u->area == 525, "blue U merged in one blob");
+	expect(u->x_min == 120 && u->x_max == 144 && u->y_min == 10 && u->y_max == 54, "U box");
+
+	expect(result.line.position == 105 && result.line.width == 10, "line position");
+	expect(result.line.contrast == 128, "line contrast");
+	for(int stage = 0; stage < VISION_STAGES; stage++) {
+		expect(result.cycles[stage] > 0, "time of each stage measured");
+	}
+
+	// The strip of the lines 48 to 55 is lost: the bottom of the U is missing.
+	process_frame(6);
+	vision_get_result(&vision, &result);
+	expect(result.incomplete & VISION_LINES_MISSING, "lost strip reported");
+	expect(result.nb_blobs == 3 && result.blobs[0].area == 900, "U split by the lost strip");
+}
+
+static void check_greyscale(void) {
+	static uint8_t grey[WIDTH * HEIGHT];
+	static const vision_config_t bright = {
+		.classes = {{.y_min = 200, .y_max = 255, .u_min = 0, .u_max = 255, .v_min = 0, .v_max = 255}},
+		.nb_classes = 1,
+		.min_area = 1,
+	};
+	vision_result_t result;
+
+	memset(grey, 50, sizeof(grey));
+	for(int y = 30; y < 40; y++) {
+		memset(&grey[y * WIDTH + 70], 220, 20);
+	}
+	expect(vision_init(&vision, &bright, VISION_FORMAT_GREYSCALE, WIDTH, HEIGHT, NULL) == 0, "init greyscale");
+	expect(vision_process_lines(&vision, grey, 0, HEIGHT), "whole greyscale frame at once");
+	vision_get_result(&vision, &result);
+	expect(result.nb_blobs == 1 && result.blobs[0].area == 200, "bright blob");
+	expect(result.blobs[0].x == 79 && result.blobs[0].y == 34, "bright blob centroid");
+	expect(result.line.position == VISION_NO_LINE, "line detection disabled");
+}
+
+int main(void) {
+	uint64_t best;
+
+	make_frame();
+	check_frame();
+	check_greyscale();
+	if(!failed) {
+		printf("blobs and line as expected\n");
+	}
+
+	vision_init(&vision, &config, VISION_FORMAT_RGB565, WIDTH, HEIGHT, NULL);
+	BENCH(best, process_frame(UINT16_MAX));
+	printf("%.2f %s per pixel\n", (double)best / (WIDTH * HEIGHT), BENCH_UNIT);
+	return failed;
+}
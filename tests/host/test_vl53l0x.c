@@ -0,0 +1,124 @@
+/*
+ * VL53L0X driver on the register model of mock_vl53l0x.c: number of I2C transactions of the
+ * configuration done at start, of a timing budget change and of a measure.
+ * The register shadowing and the read-ahead of the results bring these numbers down from
+ * 98, 79 and 5 transactions with the original platform layer of ST.
+ */
+
+#include <stdio.h>
+#include "sensors/VL53L0X/Api/core/inc/vl53l0x_api.h"
+#include "mock_vl53l0x.h"
+
+#define VL53L0X_ADDR	0x52	// 8 bits address, as in VL53L0X.h.
+#define MEASURES		100
+
+/* Expected transactions. */
+#define CONFIG_TRANSACTIONS		41
+#define BUDGET_TRANSACTIONS		33
+#define POLLED_TRANSACTIONS		4	// Data ready status, results and interrupt clear.
+#define INTERRUPT_TRANSACTIONS	4	// Results and interrupt clear.
+
+static VL53L0X_Dev_t dev;
+static int failed = 0;
+
+static void expect(const char *what, uint32_t transactions, uint32_t expected) {
+	printf("%-32s %3u transactions%s\n", what, transactions, transactions == expected ? "" : " FAILED");
+	if(transactions != expected) {
+		printf("  expected %u\n", expected);
+		failed = 1;
+	}
+}
+
+/* A result with the range status "range valid" (11) and the given range. */
+static void set_result(uint16_t range) {
+	mock_vl53l0x_set(VL53L0X_REG_RESULT_INTERRUPT_STATUS, 0x04);
+	mock_vl53l0x_set(VL53L0X_REG_RESULT_RANGE_STATUS, 11 << 3);
+	mock_vl53l0x_set(VL53L0X_REG_RESULT_RANGE_STATUS + 10, range >> 8);
+	mock_vl53l0x_set(VL53L0X_REG_RESULT_RANGE_STATUS + 11, range & 0xFF);
+}
+
+int main(void) {
+	VL53L0X_Error status;
+	uint32_t start;
+
+	// Timeouts and VCSEL periods read back by the timing budget functions.
+	mock_vl53l0x_set(VL53L0X_REG_PRE_RANGE_CONFIG_VCSEL_PERIOD, 6);
+	mock_vl53l0x_set(VL53L0X_REG_PRE_RANGE_CONFIG_TIMEOUT_MACROP_HI, 0x00);
+	mock_vl53l0x_set(VL53L0X_REG_PRE_RANGE_CONFIG_TIMEOUT_MACROP_HI + 1, 0x50);
+	mock_vl53l0x_set(VL53L0X_REG_FINAL_RANGE_CONFIG_VCSEL_PERIOD, 4);
+	mock_vl53l0x_set(VL53L0X_REG_FINAL_RANGE_CONFIG_TIMEOUT_MACROP_HI, 0x01);
+	mock_vl53l0x_set(VL53L0X_REG_FINAL_RANGE_CONFIG_TIMEOUT_MACROP_HI + 1, 0x20);
+	mock_vl53l0x_set(VL53L0X_REG_MSRC_CONFIG_TIMEOUT_MACROP, 0x20);
+	mock_vl53l0x_set(VL53L0X_REG_SYSTEM_SEQUENCE_CONFIG, 0xE8);
+
+	dev.I2cDevAddr = VL53L0X_ADDR;
+	VL53L0X_ShadowReset(&dev);
+	if(VL53L0X_DataInit(&dev) != VL53L0X_ERROR_NONE) {
+		printf("FAILED: DataInit\n");
+		return 1;
+	}
+
+	// Long range configuration and data ready interrupt, as done by the thread of VL53L0X.c.
+	start = mock_vl53l0x_transactions();
+	status = VL53L0X_SetLimitCheckEnable(&dev, VL53L0X_CHECKENABLE_SIGMA_FINAL_RANGE, 1);
+	status |= VL53L0X_SetLimitCheckEnable(&dev, VL53L0X_CHECKENABLE_SIGNAL_RATE_FINAL_RANGE, 1);
+	status |= VL53L0X_SetLimitCheckValue(&dev, VL53L0X_CHECKENABLE_SIGNAL_RATE_FINAL_RANGE, (FixPoint1616_t)(0.1*65536));
+	status |= VL53L0X_SetVcselPulsePeriod(&dev, VL53L0X_VCSEL_PERIOD_PRE_RANGE, 18);
+	status |= VL53L0X_SetVcselPulsePeriod(&dev, VL53L0X_VCSEL_PERIOD_FINAL_RANGE, 14);
+	status |= VL53L0X_SetMeasurementTimingBudgetMicroSeconds(&dev, 33000);
+	status |= VL53L0X_SetGpioConfig(&dev, 0, VL53L0X_DEVICEMODE_CONTINUOUS_RANGING,
+				VL53L0X_GPIOFUNCTIONALITY_NEW_MEASURE_READY, VL53L0X_INTERRUPTPOLARITY_LOW);
+	uint32_t budget;
+	status |= VL53L0X_GetMeasurementTimingBudgetMicroSeconds(&dev, &budget);
+	if(status != VL53L0X_ERROR_NONE) {
+		printf("FAILED: configuration status %d\n", status);
+		return 1;
+	}
+	expect("configuration", mock_vl53l0x_transactions() - start, CONFIG_TRANSACTIONS);
+
+	// Timing budget change in the high speed mode (VL53L0X_applyTimingBudget).
+	start = mock_vl53l0x_transactions();
+	status = VL53L0X_SetVcselPulsePeriod(&dev, VL53L0X_VCSEL_PERIOD_PRE_RANGE, 14);
+	status |= VL53L0X_SetVcselPulsePeriod(&dev, VL53L0X_VCSEL_PERIOD_FINAL_RANGE, 10);
+	status |= VL53L0X_SetMeasurementTimingBudgetMicroSeconds(&dev, 20000);
+	if(status != VL53L0X_ERROR_NONE) {
+		printf("FAILED: timing budget status %d\n", status);
+		return 1;
+	}
+	expect("timing budget change", mock_vl53l0x_transactions() - start, BUDGET_TRANSACTIONS);
+
+	// Measures polled: data ready status, results, interrupt clear.
+	start = mock_vl53l0x_transactions();
+	uint32_t start_bytes = mock_vl53l0x_bytes();
+	for(int i = 0; i < MEASURES; i++) {
+		VL53L0X_RangingMeasurementData_t measure;
+		uint8_t ready = 0;
+		set_result(0x100 | i);
+		status = VL53L0X_GetMeasurementDataReady(&dev, &ready);
+		status |= VL53L0X_GetRangingMeasurementData(&dev, &measure);
+		status |= VL53L0X_ClearInterruptMask(&dev, 0);
+		if(status != VL53L0X_ERROR_NONE || !ready || measure.RangeMilliMeter != (0x100 | i)) {
+			printf("FAILED: polled measure %d (status %d, ready %d, range %d)\n", i, status, ready,
+					measure.RangeMilliMeter);
+			return 1;
+		}
+	}
+	expect("polled measure", (mock_vl53l0x_transactions() - start) / MEASURES, POLLED_TRANSACTIONS);
+	printf("%-32s %3u bytes\n", "polled measure", (mock_vl53l0x_bytes() - start_bytes) / MEASURES);
+
+	// Measures read on the data ready interrupt.
+	start = mock_vl53l0x_transactions();
+	for(int i = 0; i < MEASURES; i++) {
+		VL53L0X_RangingMeasurementData_t measure;
+		set_result(0x200 | i);
+		status = VL53L0X_GetRangingMeasurementData(&dev, &measure);
+		status |= VL53L0X_ClearInterruptMask(&dev, 0);
+		if(status != VL53L0X_ERROR_NONE || measure.RangeMilliMeter != (0x200 | i)) {
+			printf("FAILED: measure %d on interrupt (status %d, range %d)\n", i, status, measure.RangeMilliMeter);
+			return 1;
+		}
+	}
+	expect("measure on interrupt", (mock_vl53l0x_transactions() - start) / MEASURES, INTERRUPT_TRANSACTIONS);
+
+	return failed;
+}